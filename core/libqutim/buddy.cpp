@@ -28,6 +28,7 @@
 #include <QTextDocument>
 #include <QStringBuilder>
 #include "iconloader.h"
+#include "statuschangebus.h"
 
 namespace qutim_sdk_0_3
 {
@@ -123,6 +124,8 @@ void BuddyPrivate::_q_status_changed(const Status &now, const Status &old)
 		 q->setChatState(ChatUnit::ChatStateInActive);
 	else if(now.type() == Status::Offline)
 		q->setChatState(ChatUnit::ChatStateGone);
+	if (StatusChangeBus *bus = StatusChangeBus::instance())
+		bus->publish(q, now, old);
 }
 
 //void Buddy::setStatus(const Status &status)
@@ -172,6 +172,26 @@ void ChatSession::appendMessage(const qutim_sdk_0_3::Message &message)
 	append(message);
 }
 
+int ChatSession::unreadCount() const
+{
+	int count = 0;
+	const_cast<ChatSession*>(this)->virtual_hook(UnreadCountHook, &count);
+	return count;
+}
+
+MessageList ChatSession::unreadRange(int offset, int count) const
+{
+	UnreadRangeArgument argument = { offset, count, MessageList() };
+	const_cast<ChatSession*>(this)->virtual_hook(UnreadRangeHook, &argument);
+	return argument.messages;
+}
+
+void ChatSession::addContacts(const QList<Buddy*> &contacts)
+{
+	if (!contacts.isEmpty())
+		virtual_hook(AddContactsHook, const_cast<QList<Buddy*>*>(&contacts));
+}
+
 bool ChatSession::isActive()
 {
 	return d_func()->active;
@@ -203,8 +223,23 @@ void ChatSession::setActive(bool active)
 
 void ChatSession::virtual_hook(int id, void *data)
 {
-	Q_UNUSED(id);
-	Q_UNUSED(data);
+	// Sessions which don't keep unread messages on their own get the defaults
+	switch (id) {
+	case UnreadCountHook:
+		*reinterpret_cast<int*>(data) = unread().count();
+		break;
+	case UnreadRangeHook: {
+		UnreadRangeArgument &argument = *reinterpret_cast<UnreadRangeArgument*>(data);
+		argument.messages = unread().mid(argument.offset, argument.count);
+		break;
+	}
+	case AddContactsHook:
+		foreach (Buddy *buddy, *reinterpret_cast<QList<Buddy*>*>(data))
+			addContact(buddy);
+		break;
+	default:
+		break;
+	}
 }
 
 class ChatLayerPrivate
@@ -46,11 +46,25 @@ class LIBQUTIM_EXPORT ChatSession : public QObject
 	Q_DECLARE_PRIVATE(ChatSession)
 	Q_PROPERTY(bool active READ isActive WRITE setActive NOTIFY activated)
 	Q_PROPERTY(qutim_sdk_0_3::MessageList unread READ unread NOTIFY unreadChanged)
+	Q_PROPERTY(int unreadCount READ unreadCount NOTIFY unreadCountChanged)
 	Q_PROPERTY(QDateTime dateOpened READ dateOpened WRITE setDateOpened NOTIFY dateOpenedChanged)
 	Q_PROPERTY(qutim_sdk_0_3::ChatUnit *unit READ unit WRITE setChatUnit NOTIFY unitChanged)
 public:
 	typedef std::function<void (quint64, const Message &, const QString &)> AppendHandler;
 
+	enum ChatSessionHookEnum {
+		UnreadCountHook = 0x100,
+		UnreadRangeHook,
+		AddContactsHook
+	};
+
+	struct UnreadRangeArgument
+	{
+		int offset;
+		int count;
+		MessageList messages;
+	};
+
 	virtual ~ChatSession();
 
 	virtual ChatUnit *getUnit() const = 0;
@@ -60,7 +74,27 @@ public:
 	void append(const Message &message, const AppendHandler &handler);
 	virtual QTextDocument *getInputField() = 0;
 	virtual void markRead(quint64 id) = 0;
+	/*!
+	  Returns all unread messages. Session may keep only part of them in memory,
+	  so prefer unreadCount() and unreadRange() for large lists.
+	*/
 	virtual MessageList unread() const = 0;
+	/*!
+	  Returns count of unread messages without building the list.
+	*/
+	int unreadCount() const;
+	/*!
+	  Returns up to \a count unread messages starting from \a offset, the
+	  whole tail if \a count is negative. Messages which were loaded from disk
+	  store their original id in the "unreadId" property, it should be passed
+	  to markRead().
+	*/
+	MessageList unreadRange(int offset, int count = -1) const;
+	/*!
+	  Adds all \a contacts at once, i.e. participants of just joined
+	  conference. It's much cheaper than addContact() for each of them.
+	*/
+	void addContacts(const QList<qutim_sdk_0_3::Buddy*> &contacts);
 	bool isActive();
 	QDateTime dateOpened() const;
 	void setDateOpened(const QDateTime &date);
@@ -83,7 +117,18 @@ signals:
 	void contactRemoved(qutim_sdk_0_3::Buddy *c);
 	void activated(bool active);
 	void unitChanged(qutim_sdk_0_3::ChatUnit *unit);
+	/*!
+	  Is emitted when the first unread messages change, the list may be
+	  truncated. Use unreadCountChanged() to track all of them.
+	*/
 	void unreadChanged(const qutim_sdk_0_3::MessageList &);
+	void unreadCountChanged(int count);
+	/*!
+	  Is emitted when markRead() has removed message with \a id from the
+	  unread list, or all of them if \a id is 0xffffffffffffffff. It lets
+	  listeners follow read messages without fetching unreadRange().
+	*/
+	void unreadMarked(quint64 id);
 protected:
 	ChatSession(ChatLayer *chat);
 	virtual void virtual_hook(int id, void *data);
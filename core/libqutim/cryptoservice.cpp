@@ -32,12 +32,17 @@
 #include <QDataStream>
 #include <QBuffer>
 #include <QCoreApplication>
+#include <QMetaMethod>
 #include "debug.h"
 
 namespace qutim_sdk_0_3
 {
 // is must be named as a lot of another variables
 static QPointer<CryptoService> self;
+static bool storageEncrypted = false;
+// Encrypted files start with this header, it can't be the beginning of json
+static const char storageMagic[] = "QENC\x01";
+static const int storageMagicSize = sizeof(storageMagic) - 1;
 
 CryptoService::CryptoService()
 {
@@ -64,6 +69,76 @@ QVariant CryptoService::decrypt(const QVariant &value)
 	return self.isNull() ? value : self.data()->decryptImpl(value);
 }
 
+// Bulk methods are looked up by name, so the vtable stays compatible with
+// services built before them
+static bool invokeDataMethod(const char *signature, const QByteArray &data, QByteArray *result)
+{
+	const QMetaObject *meta = self.data()->metaObject();
+	const int index = meta->indexOfMethod(signature);
+	if (index < 0)
+		return false;
+	return meta->method(index).invoke(self.data(), Qt::DirectConnection,
+									  Q_RETURN_ARG(QByteArray, *result),
+									  Q_ARG(QByteArray, data));
+}
+
+QByteArray CryptoService::cryptData(const QByteArray &data)
+{
+	if (self.isNull())
+		return data;
+	QByteArray result;
+	if (invokeDataMethod("cryptDataImpl(QByteArray)", data, &result))
+		return result;
+	return self.data()->cryptImpl(data).toByteArray();
+}
+
+QByteArray CryptoService::decryptData(const QByteArray &data)
+{
+	if (self.isNull())
+		return data;
+	QByteArray result;
+	if (invokeDataMethod("decryptDataImpl(QByteArray)", data, &result))
+		return result;
+	return self.data()->decryptImpl(data).toByteArray();
+}
+
+bool CryptoService::isStorageEncrypted()
+{
+	if (!storageEncrypted || self.isNull())
+		return false;
+	// Service without a key would return data as is
+	const QMetaObject *meta = self.data()->metaObject();
+	const int index = meta->indexOfMethod("hasKeyImpl()");
+	bool hasKey = true;
+	if (index >= 0)
+		meta->method(index).invoke(self.data(), Qt::DirectConnection, Q_RETURN_ARG(bool, hasKey));
+	return hasKey;
+}
+
+void CryptoService::setStorageEncrypted(bool encrypted)
+{
+	storageEncrypted = encrypted;
+}
+
+bool CryptoService::isStorageData(const QByteArray &data)
+{
+	return data.startsWith(QByteArray::fromRawData(storageMagic, storageMagicSize));
+}
+
+QByteArray CryptoService::toStorageData(const QByteArray &data)
+{
+	if (!isStorageEncrypted())
+		return data;
+	return QByteArray::fromRawData(storageMagic, storageMagicSize) + cryptData(data);
+}
+
+QByteArray CryptoService::fromStorageData(const QByteArray &data)
+{
+	if (!isStorageData(data))
+		return data;
+	return decryptData(data.mid(storageMagicSize));
+}
+
 QVariant CryptoService::variantFromData(const QByteArray &data) const
 {
 	QVariant result;
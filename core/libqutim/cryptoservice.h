@@ -40,6 +40,18 @@ class LIBQUTIM_EXPORT CryptoService : public QObject
 public:
 	static QVariant crypt(const QVariant &value);
 	static QVariant decrypt(const QVariant &value);
+	// Bulk api for large buffers, i.e. files. Service may implement it by
+	// invokable cryptDataImpl(QByteArray) and decryptDataImpl(QByteArray)
+	// methods, otherwise cryptImpl() and decryptImpl() are used
+	static QByteArray cryptData(const QByteArray &data);
+	static QByteArray decryptData(const QByteArray &data);
+	// Files of the profile are encrypted if the profile was created so and
+	// the service has a key, it may tell so by invokable bool hasKeyImpl()
+	static bool isStorageEncrypted();
+	static void setStorageEncrypted(bool encrypted);
+	static bool isStorageData(const QByteArray &data);
+	static QByteArray toStorageData(const QByteArray &data);
+	static QByteArray fromStorageData(const QByteArray &data);
 	virtual QVariant cryptImpl(const QVariant &value) const = 0;
 	virtual QVariant decryptImpl(const QVariant &value) const = 0;
 	virtual void setPassword(const QString &password, const QVariant &data) = 0;
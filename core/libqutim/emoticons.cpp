@@ -60,7 +60,10 @@ struct EmoticonsThemeData : public QSharedData
 	EmoticonsThemeData(const EmoticonsThemeData &o) : QSharedData(o), provider(o.provider) {}
 	~EmoticonsThemeData()
 	{
-		Emoticons::p->cache.remove(provider->themeName());
+		// Theme of a backend is cached by its name
+		const QString name = provider ? provider->themeName() : QString();
+		if (Emoticons::p && Emoticons::p->cache.value(name) == this)
+			Emoticons::p->cache.remove(name);
 		delete provider;
 	}
 	EmoticonsProvider *provider;
@@ -250,6 +253,13 @@ EmoticonsTheme &EmoticonsTheme::operator =(const EmoticonsTheme &other)
 	return *this;
 }
 
+EmoticonsTheme EmoticonsTheme::fromProvider(EmoticonsProvider *provider)
+{
+	EmoticonsThemeData *data = new EmoticonsThemeData;
+	data->provider = provider;
+	return EmoticonsTheme(data);
+}
+
 bool EmoticonsTheme::isNull() const
 {
 	return !p || !p->provider;
@@ -270,6 +280,11 @@ QString EmoticonsTheme::themeName() const
 	return isNull() ? QString(nullThemeName) : p->provider->themeName();
 }
 
+const EmoticonsProvider *EmoticonsTheme::provider() const
+{
+	return p ? p->provider : 0;
+}
+
 //	EmoticonsTheme EmoticonsTheme::pseudoClone()
 //	{
 //		return EmoticonsTheme(new PseudoEmoticonsProvider(p->provider));
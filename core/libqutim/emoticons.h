@@ -70,12 +70,15 @@ public:
 	EmoticonsTheme(const EmoticonsTheme &theme);
 	~EmoticonsTheme();
 	EmoticonsTheme &operator =(const EmoticonsTheme &theme);
+	// Theme owns the provider, it isn't shared with the themes of backends
+	static EmoticonsTheme fromProvider(EmoticonsProvider *provider);
 
 	bool isNull() const;
 
 	QHash<QString, QStringList> emoticonsMap() const;
 	QStringList emoticonsIndexes() const;
 	QString themeName() const;
+	const EmoticonsProvider *provider() const;
 
 	//		EmoticonsTheme pseudoClone();
 
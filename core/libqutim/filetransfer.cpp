@@ -35,12 +35,60 @@
 #include <QDir>
 #include <QDirIterator>
 #include <QBitArray>
+#include <QElapsedTimer>
+#include <QTimer>
 
 namespace qutim_sdk_0_3
 {
 
 #define REMEMBER_ALL_ABILITIES 1
 
+// Minimal interval between two progressChanged signals in msecs
+const qint64 PROGRESS_INTERVAL = 250;
+// Minimal interval between two speed samples in msecs
+const qint64 SPEED_SAMPLE_INTERVAL = 1000;
+
+static qint64 currentTime()
+{
+	static QElapsedTimer timer;
+	if (!timer.isValid())
+		timer.start();
+	return timer.elapsed();
+}
+
+// Token bucket, is refilled by rate bytes per second and
+// can store up to one second of traffic
+struct FileTransferBucket
+{
+	FileTransferBucket() : rate(0), tokens(0), lastRefill(0) {}
+	void setRate(qint64 bytesPerSecond)
+	{
+		rate = qMax<qint64>(bytesPerSecond, 0);
+		tokens = rate;
+		lastRefill = currentTime();
+	}
+	void refill(qint64 now)
+	{
+		if (rate > 0 && now > lastRefill) {
+			tokens = qMin(rate, tokens + (now - lastRefill) * rate / 1000);
+			lastRefill = now;
+		}
+	}
+	qint64 available(qint64 bytes) const { return rate > 0 ? qMin(bytes, tokens) : bytes; }
+	void take(qint64 bytes) { if (rate > 0) tokens -= bytes; }
+	// Time in msecs till the bucket has enough tokens for bytes
+	qint64 waitTime(qint64 bytes) const
+	{
+		if (rate <= 0)
+			return 0;
+		bytes = qMin(bytes, rate);
+		return tokens >= bytes ? 0 : ((bytes - tokens) * 1000 + rate - 1) / rate;
+	}
+	qint64 rate;
+	qint64 tokens;
+	qint64 lastRefill;
+};
+
 struct FileTransferScope
 {
 	struct Observer
@@ -60,6 +108,7 @@ struct FileTransferScope
 	QList<FileTransferFactory*> factories;
 	QMap<ChatUnit*, Observer> observers;
 	FileTransferManager *manager;
+	FileTransferBucket bucket;
 	bool inited;
 };
 typedef QMap<ChatUnit*, FileTransferScope::Observer> FileTransferObserverMap;
@@ -172,10 +221,16 @@ public:
 		direction(d), error(FileTransferJob::NoError),
 		state(FileTransferJob::Initiation), currentIndex(-1),
 		progress(0), fileProgress(0), totalSize(0), q_ptr(q),
-		skipToNextFactoryAtError(true)
+		skipToNextFactoryAtError(true), emittedProgress(0), lastEmitTime(0),
+		sampleProgress(0), sampleTime(-1), speed(0)
 	{}
 	void addFile(const QFileInfo &info);
 	QIODevice *device(int index);
+	void updateProgress(bool force);
+	void updateSpeed(qint64 now);
+	void _q_emitProgress() { updateProgress(true); }
+	void _q_emitBandwidthAvailable() { emit q_func()->bandwidthAvailable(); }
+	void _q_updateSpeed() { updateSpeed(currentTime()); }
 	ChatUnit *unit;
 	QString title;
 	bool accepted;
@@ -194,8 +249,56 @@ public:
 	FileTransferJob *q_ptr;
 	QDir dir;
 	bool skipToNextFactoryAtError;
+	qint64 emittedProgress;
+	qint64 lastEmitTime;
+	qint64 sampleProgress;
+	qint64 sampleTime;
+	qint64 speed;
+	QTimer progressTimer;
+	QTimer bandwidthTimer;
+	// Takes speed samples when there is no progress, so speed goes down while stalled
+	QTimer speedTimer;
+	FileTransferBucket bucket;
 };
 
+void FileTransferJobPrivate::updateProgress(bool force)
+{
+	Q_Q(FileTransferJob);
+	qint64 now = currentTime();
+	updateSpeed(now);
+	if (progress == emittedProgress)
+		return;
+	if (!force && progress != totalSize && now - lastEmitTime < PROGRESS_INTERVAL) {
+		if (!progressTimer.isActive())
+			progressTimer.start(PROGRESS_INTERVAL - (now - lastEmitTime));
+		return;
+	}
+	progressTimer.stop();
+	lastEmitTime = now;
+	emittedProgress = progress;
+	emit q->progressChanged(progress);
+}
+
+void FileTransferJobPrivate::updateSpeed(qint64 now)
+{
+	if (sampleTime < 0) {
+		sampleTime = now;
+		sampleProgress = progress;
+		return;
+	}
+	qint64 elapsed = now - sampleTime;
+	if (elapsed < SPEED_SAMPLE_INTERVAL)
+		return;
+	qint64 current = (progress - sampleProgress) * 1000 / elapsed;
+	// Exponential moving average, smooths bursts of fast chunks
+	qint64 oldSpeed = speed;
+	speed = speed > 0 ? (speed * 3 + current) / 4 : current;
+	sampleTime = now;
+	sampleProgress = progress;
+	if (speed != oldSpeed)
+		emit q_func()->speedChanged(speed);
+}
+
 void FileTransferJobPrivate::addFile(const QFileInfo &info)
 {
 	FileTransferInfo ftInfo;
@@ -219,6 +322,12 @@ FileTransferJob::FileTransferJob(ChatUnit *unit, FileTransferJob::Direction dire
 	Q_D(FileTransferJob);
 	d->unit = unit;
 	d->factory = factory;
+	d->progressTimer.setSingleShot(true);
+	connect(&d->progressTimer, SIGNAL(timeout()), SLOT(_q_emitProgress()));
+	d->bandwidthTimer.setSingleShot(true);
+	connect(&d->bandwidthTimer, SIGNAL(timeout()), SLOT(_q_emitBandwidthAvailable()));
+	d->speedTimer.setInterval(SPEED_SAMPLE_INTERVAL);
+	connect(&d->speedTimer, SIGNAL(timeout()), SLOT(_q_updateSpeed()));
 }
 
 FileTransferJob::~FileTransferJob()
@@ -316,6 +425,34 @@ qint64 FileTransferJob::totalSize() const
 	return d_func()->totalSize;
 }
 
+qint64 FileTransferJob::speed() const
+{
+	return d_func()->speed;
+}
+
+int FileTransferJob::estimatedTime() const
+{
+	Q_D(const FileTransferJob);
+	if (d->speed <= 0 || d->totalSize <= 0)
+		return -1;
+	return int(qMax<qint64>(d->totalSize - d->progress, 0) / d->speed);
+}
+
+qint64 FileTransferJob::bandwidthLimit() const
+{
+	return d_func()->bucket.rate;
+}
+
+void FileTransferJob::setBandwidthLimit(qint64 bytesPerSecond)
+{
+	Q_D(FileTransferJob);
+	d->bucket.setRate(bytesPerSecond);
+	if (d->bandwidthTimer.isActive()) {
+		d->bandwidthTimer.stop();
+		emit bandwidthAvailable();
+	}
+}
+
 FileTransferJob::State FileTransferJob::state() const
 {
 	return d_func()->state;
@@ -435,7 +572,30 @@ void FileTransferJob::setFileProgress(qint64 fileProgress)
 		return;
 	d->fileProgress = fileProgress;
 	d->progress += delta;
-	emit progressChanged(d->progress);
+	d->updateProgress(false);
+}
+
+qint64 FileTransferJob::requestBandwidth(qint64 bytes)
+{
+	Q_D(FileTransferJob);
+	FileTransferBucket &global = scope()->bucket;
+	if (bytes <= 0 || (d->bucket.rate <= 0 && global.rate <= 0))
+		return bytes;
+	qint64 now = currentTime();
+	d->bucket.refill(now);
+	global.refill(now);
+	qint64 allowed = global.available(d->bucket.available(bytes));
+	if (allowed <= 0) {
+		// Wait till there is enough tokens for a reasonable chunk, not just for a single byte
+		qint64 chunk = qMin<qint64>(bytes, 4096);
+		qint64 wait = qMax(d->bucket.waitTime(chunk), global.waitTime(chunk));
+		if (!d->bandwidthTimer.isActive())
+			d->bandwidthTimer.start(int(qMax<qint64>(wait, 10)));
+		return 0;
+	}
+	d->bucket.take(allowed);
+	global.take(allowed);
+	return allowed;
 }
 
 void FileTransferJob::setError(FileTransferJob::ErrorType err)
@@ -478,6 +638,13 @@ void FileTransferJob::setState(FileTransferJob::State state)
 	if (d->state != state) {
 		d->state = state;
 		d->stateString = LocalizedString();
+		if (state == Started) {
+			d->speedTimer.start();
+		} else if (state == Finished || state == Error) {
+			d->bandwidthTimer.stop();
+			d->speedTimer.stop();
+			d->updateProgress(true);
+		}
 		emit stateChanged(state);
 		emit stateStringChanged(stateString());
 	}
@@ -710,6 +877,7 @@ FileTransferManager::FileTransferManager() : d_ptr(new FileTransferManagerPrivat
 	QStringList names = Config().value("filetransfer/factories").toStringList();
 	if (!names.isEmpty())
 		scope()->factories = sortFactories(names, scope()->factories);
+	scope()->bucket.setRate(Config().value("filetransfer/bandwidthLimit", qint64(0)));
 }
 
 FileTransferManager::~FileTransferManager()
@@ -775,6 +943,17 @@ QList<FileTransferFactory*> FileTransferManager::factories()
 	return scope()->factories;
 }
 
+qint64 FileTransferManager::bandwidthLimit()
+{
+	return scope()->bucket.rate;
+}
+
+void FileTransferManager::setBandwidthLimit(qint64 bytesPerSecond)
+{
+	scope()->bucket.setRate(bytesPerSecond);
+	Config().setValue("filetransfer/bandwidthLimit", scope()->bucket.rate);
+}
+
 void FileTransferManager::updateFactories(const QStringList &factoryClassNames)
 {
 	Config().setValue("filetransfer/factories", factoryClassNames);
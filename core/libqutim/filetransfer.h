@@ -78,6 +78,9 @@ class LIBQUTIM_EXPORT FileTransferJob : public QObject
 	Q_PROPERTY(qint64 totalSize READ totalSize NOTIFY totalSizeChanged)
 	Q_PROPERTY(qint64 fileSize READ fileSize NOTIFY fileSizeChanged)
 	Q_PROPERTY(qint64 progress READ progress NOTIFY progressChanged)
+	Q_PROPERTY(qint64 speed READ speed NOTIFY speedChanged)
+	Q_PROPERTY(int estimatedTime READ estimatedTime NOTIFY speedChanged)
+	Q_PROPERTY(qint64 bandwidthLimit READ bandwidthLimit WRITE setBandwidthLimit)
 	Q_PROPERTY(qutim_sdk_0_3::FileTransferJob::State state READ state NOTIFY stateChanged)
 	Q_PROPERTY(qutim_sdk_0_3::ChatUnit *chatUnit READ chatUnit)
 public:
@@ -103,6 +106,14 @@ public:
 	qint64 fileSize() const;
 	qint64 progress() const;
 	qint64 totalSize() const;
+	// Average transfer speed in bytes per second
+	qint64 speed() const;
+	// Estimated time till the end of transfer in seconds, -1 if unknown
+	int estimatedTime() const;
+	// Limit in bytes per second for this job, 0 means unlimited. It has effect
+	// only for jobs of factories with CanLimitBandwidth capability
+	qint64 bandwidthLimit() const;
+	void setBandwidthLimit(qint64 bytesPerSecond);
 	State state() const;
 	LocalizedString stateString();
 	ErrorType error() const;
@@ -121,7 +132,13 @@ protected:
 	void init(int filesCount, qint64 totalSize, const QString &title);
 	// Device for local files to read/write
 	QIODevice *setCurrentIndex(int index);
+	// progressChanged is emitted not more often than once per 250 msecs,
+	// so it's ok to call it for every chunk
 	void setFileProgress(qint64 fileProgress);
+	// Asks both job's and global bandwidth limiters for permission to transfer
+	// up to bytes, returns the allowed amount of data. If it's 0, backend should
+	// wait for bandwidthAvailable signal
+	qint64 requestBandwidth(qint64 bytes);
 	void setError(ErrorType error);
 	void setErrorString(const LocalizedString &error);
 	void setState(State state);
@@ -144,9 +161,14 @@ private: // don't tell moc, doxygen or kdevelop, but those signals are in fact p
 	void stateStringChanged(const qutim_sdk_0_3::LocalizedString &);
 	void finished();
 	void accepted();
+	void speedChanged(qint64);
+	void bandwidthAvailable();
 private:
 	friend class FileTransferManager;
 	QScopedPointer<FileTransferJobPrivate> d_ptr;
+	Q_PRIVATE_SLOT(d_func(), void _q_emitProgress())
+	Q_PRIVATE_SLOT(d_func(), void _q_emitBandwidthAvailable())
+	Q_PRIVATE_SLOT(d_func(), void _q_updateSpeed())
 };
 
 class LIBQUTIM_EXPORT FileTransferObserver : public QObject
@@ -174,7 +196,10 @@ class LIBQUTIM_EXPORT FileTransferFactory : public QObject
 	Q_ENUMS(Capability)
 public:
 	enum Capability {
-		CanSendMultiple = 0x01
+		CanSendMultiple = 0x01,
+		// Jobs ask requestBandwidth before reading or writing, so both
+		// job's and global bandwidth limits are applied to them
+		CanLimitBandwidth = 0x02
 	};
 	Q_DECLARE_FLAGS(Capabilities, Capability)
 	FileTransferFactory(const LocalizedString &name, Capabilities capabilities);
@@ -217,6 +242,9 @@ public:
 	// factories.
 	// TODO: come up with a more appropriate name
 	static void updateFactories(const QStringList &factoryClassNames);
+	// Limit in bytes per second shared by all jobs, 0 means unlimited
+	static qint64 bandwidthLimit();
+	static void setBandwidthLimit(qint64 bytesPerSecond);
 protected:
 	virtual QIODevice *doOpenFile(FileTransferJob *job) = 0;
 	virtual void handleJob(FileTransferJob *job, FileTransferJob *oldJob) = 0;
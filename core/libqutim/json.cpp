@@ -33,6 +33,13 @@
 #include "../3rdparty/k8json/k8json.h"
 //#include <k8json/k8json.h>
 #include <QMetaProperty>
+#include <QVarLengthArray>
+#include <QtAlgorithms>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define JSON_SCAN_SSE2
+#  include <emmintrin.h>
+#endif
 
 namespace qutim_sdk_0_3
 {
@@ -60,8 +67,144 @@ namespace qutim_sdk_0_3
 									   zeroInvalid);
 		}
 
+		// Blanks are all characters up to space, everything else including comments
+		// is left for k8json
+		static const uchar *skipPlainBlanks(const uchar *s, const uchar *end)
+		{
+			// Most of blanks are single spaces and new lines, don't bother SSE for them
+			if (s == end || *s > ' ' || ++s == end || *s > ' ')
+				return s;
+#ifdef JSON_SCAN_SSE2
+			const __m128i space = _mm_set1_epi8(' ');
+			while (end - s >= 16) {
+				const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+				// chunk <= ' ' as unsigned bytes
+				const __m128i blank = _mm_cmpeq_epi8(_mm_min_epu8(chunk, space), chunk);
+				const quint32 mask = ~quint32(_mm_movemask_epi8(blank)) & 0xffff;
+				if (mask)
+					return s + qCountTrailingZeroBits(mask);
+				s += 16;
+			}
+#endif
+			while (s < end && *s <= ' ')
+				++s;
+			return s;
+		}
+
+		// Looks for the end of the string started before s, returns pointer to the closing quote
+		static const uchar *scanString(const uchar *s, const uchar *end)
+		{
+#ifdef JSON_SCAN_SSE2
+			const __m128i quote = _mm_set1_epi8('"');
+			const __m128i backslash = _mm_set1_epi8('\\');
+#endif
+			forever {
+#ifdef JSON_SCAN_SSE2
+				while (end - s >= 16) {
+					const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+					const quint32 mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+																		 _mm_cmpeq_epi8(chunk, backslash)));
+					if (mask) {
+						s += qCountTrailingZeroBits(mask);
+						break;
+					}
+					s += 16;
+				}
+#endif
+				while (s < end && *s != '"' && *s != '\\')
+					++s;
+				if (s >= end)
+					return 0;
+				if (*s == '"')
+					return s;
+				// Skip escaped character, hex digits of unicode escapes need no special care
+				s += 2;
+			}
+		}
+
+		static inline bool isSpecial(uchar ch)
+		{
+			switch (ch) {
+			case '"': case '{': case '}': case '[': case ']':
+			case '/': case '#': case '\'': case '\\':
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		/*
+		  Fast path of skipRecord for the most common case of history files:
+		  a plain JSON object or list. Only brackets and strings are tracked,
+		  so scalar values are skipped at the speed of memory scan.
+		  Returns pointer after the closing bracket, or null if the record
+		  contains anything k8json may interpret in its own way (comments,
+		  single-quoted strings, bad nesting), the caller should fall back
+		  to k8json in this case.
+		*/
+		static const uchar *scanRecord(const uchar *s, const uchar *end)
+		{
+			QVarLengthArray<uchar, 32> stack;
+#ifdef JSON_SCAN_SSE2
+			const __m128i specials[] = {
+				_mm_set1_epi8('"'), _mm_set1_epi8('{'), _mm_set1_epi8('}'),
+				_mm_set1_epi8('['), _mm_set1_epi8(']'), _mm_set1_epi8('/'),
+				_mm_set1_epi8('#'), _mm_set1_epi8('\''), _mm_set1_epi8('\\')
+			};
+#endif
+			while (s < end) {
+#ifdef JSON_SCAN_SSE2
+				while (end - s >= 16) {
+					const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+					__m128i hits = _mm_cmpeq_epi8(chunk, specials[0]);
+					for (int i = 1; i < int(sizeof(specials) / sizeof(specials[0])); ++i)
+						hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, specials[i]));
+					const quint32 mask = _mm_movemask_epi8(hits);
+					if (mask) {
+						s += qCountTrailingZeroBits(mask);
+						break;
+					}
+					s += 16;
+				}
+#endif
+				while (s < end && !isSpecial(*s))
+					++s;
+				if (s >= end)
+					return 0;
+				switch (*s) {
+				case '"':
+					if (!(s = scanString(s + 1, end)))
+						return 0;
+					break;
+				case '{':
+					stack.append('}');
+					break;
+				case '[':
+					stack.append(']');
+					break;
+				case '}':
+				case ']':
+					if (stack.isEmpty() || stack.last() != *s)
+						return 0;
+					stack.removeLast();
+					if (stack.isEmpty())
+						return s + 1;
+					break;
+				default:
+					return 0;
+				}
+				++s;
+			}
+			return 0;
+		}
+
 		const uchar *skipBlanks(const uchar *s, int *maxLength)
 		{
+			if (s && *maxLength > 0) {
+				const uchar *next = skipPlainBlanks(s, s + *maxLength);
+				*maxLength -= next - s;
+				s = next;
+			}
 			return K8JSON::skipBlanks(s, maxLength);
 		}
 
@@ -72,6 +215,15 @@ namespace qutim_sdk_0_3
 
 		const uchar *skipRecord(const uchar *s, int *maxLength)
 		{
+			if (s && *maxLength > 0) {
+				const uchar *begin = skipPlainBlanks(s, s + *maxLength);
+				if (begin < s + *maxLength && (*begin == '{' || *begin == '[')) {
+					if (const uchar *next = scanRecord(begin, s + *maxLength)) {
+						*maxLength -= next - s;
+						return skipBlanks(next, maxLength);
+					}
+				}
+			}
 			return K8JSON::skipRec(s, maxLength);
 		}
 
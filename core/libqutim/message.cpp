@@ -36,6 +36,7 @@
 #include "conference.h"
 #include "utils.h"
 #include "emoticons.h"
+#include "textparser.h"
 #include <QDebug>
 
 QDebug operator<<(QDebug dbg, const qutim_sdk_0_3::Message &msg)
@@ -128,14 +129,8 @@ public:
 	QVariant getHtml() const {
 		if (html.isEmpty()) {
 			QString &mutableHtml = const_cast<QString&>(html);
-			mutableHtml = text.toHtmlEscaped();
-			// keep leading whitespaces
-			mutableHtml.replace(QLatin1String("\n "), QLatin1String("<br/>&nbsp;"));
-			mutableHtml.replace(QLatin1Char('\n'), QLatin1String("<br/>"));
-			// replace tabs by 4 spaces
-			mutableHtml.replace(QLatin1Char('\t'), QLatin1String("&nbsp; &nbsp; "));
-			// keep multiple whitespaces
-			mutableHtml.replace(QLatin1String("  "), QLatin1String(" &nbsp;"));
+			// escapes text, keeps line breaks, tabs and multiple whitespaces
+			mutableHtml = TextParser::toHtml(text);
 		}
 		return html;
 	}
@@ -220,12 +215,13 @@ bool Message::hasProperty(const QString &name) const
 
 QString Message::formattedHtml() const
 {
-	QString html = UrlParser::parseUrls(this->html(), UrlParser::Html);
-
-	if (property("topic", false))
-		return html;
-
-	return Emoticons::theme().parseEmoticons(html);
+	TextParser::Flags flags = TextParser::Urls;
+	if (!property("topic", false))
+		flags |= TextParser::Emoticons;
+	// Plain text is escaped while rendering, so it's parsed only once
+	if (p->html.isEmpty())
+		return TextParser::toHtml(p->text, flags);
+	return TextParser::toHtml(p->html, flags | TextParser::Html);
 }
 
 bool Message::isSimiliar(const Message &other, int flags) const
@@ -42,6 +42,7 @@
 #include "servicemanager_p.h"
 #include "libqutim_version.h"
 #include "sound_p.h"
+#include "timerservice.h"
 #include <QPluginLoader>
 #include <QSettings>
 #include <QDir>
@@ -841,6 +842,9 @@ void ModuleManager::onQuit()
 	}
 
 	Event("aboutToQuit").send();
+	// Wakeup counters get to the log before the logger is unloaded
+	if (TimerService *timers = TimerService::instance())
+		timers->dump();
 	foreach(QPointer<Plugin> plugin, d->plugins) {
 		if (!plugin.isNull() && plugin.data()->info().data()->loaded) {
 			plugin.data()->unload();
@@ -24,6 +24,7 @@
 ****************************************************************************/
 
 #include "notification.h"
+#include "notificationscheduler.h"
 #include "sound_p.h"
 #include "dynamicpropertydata_p.h"
 #include "message.h"
@@ -544,6 +545,11 @@ QList<NotificationAction> NotificationRequest::actions() const
 
 Notification *NotificationRequest::send()
 {
+	// Storms of notifications are cut before the filters, they are expensive
+	NotificationScheduler *scheduler = NotificationScheduler::instance();
+	if (scheduler && scheduler->schedule(*this) != NotificationScheduler::Deliver)
+		return 0;
+
 	HandlerMap::iterator itr = handlers()->end();
 	HandlerMap::iterator begin = handlers()->begin();
 	while (itr != begin) {
@@ -559,9 +565,18 @@ Notification *NotificationRequest::send()
 			continue;
 
 		// Check that the notifications has not been rejected
-		QSet<QByteArray> allowed = backend->d_ptr->allowedRejectedNotifications;
-		QSet<QByteArray> rejectionReasons = d_ptr->rejectionReasons - allowed;
-		if (!rejectionReasons.isEmpty())
+		const QSet<QByteArray> &allowed = backend->d_ptr->allowedRejectedNotifications;
+		bool rejected = false;
+		foreach (const QByteArray &reason, d_ptr->rejectionReasons) {
+			if (!allowed.contains(reason)) {
+				rejected = true;
+				break;
+			}
+		}
+		if (rejected)
+			continue;
+
+		if (scheduler && !scheduler->acquireBackend(typeName, d_ptr->type))
 			continue;
 
 		if (!notification) {
@@ -733,6 +748,8 @@ NotificationManager::NotificationManager()
 	cfg.beginGroup(QLatin1String("notification"));
 	*blockedBackends() = cfg.value(QLatin1String("blockedBackends"), QStringList());
 	cfg.endGroup();
+	// Start tracking of accounts' connections as early as possible
+	NotificationScheduler::instance();
 }
 
 } // namespace qutim_sdk_0_3
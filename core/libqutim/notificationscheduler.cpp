@@ -0,0 +1,367 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "notificationscheduler.h"
+#include "accountmanager.h"
+#include "account.h"
+#include "buddy.h"
+#include "status.h"
+#include "config.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QPointer>
+
+namespace qutim_sdk_0_3
+{
+
+enum { TypesCount = Notification::LastType + 1 };
+
+struct TokenBucket
+{
+	TokenBucket() : rate(0), burst(0), tokens(0), updated(0) {}
+	void setup(double r, double b, qint64 now)
+	{
+		rate = r;
+		burst = qMax(1.0, b);
+		tokens = burst;
+		updated = now;
+	}
+	bool acquire(qint64 now)
+	{
+		// Zero rate means that there is no limit at all
+		if (rate <= 0)
+			return true;
+		tokens = qMin(burst, tokens + (now - updated) * rate / 1000.0);
+		updated = now;
+		if (tokens < 1.0)
+			return false;
+		tokens -= 1.0;
+		return true;
+	}
+	double rate;
+	double burst;
+	double tokens;
+	qint64 updated;
+};
+
+struct Aggregation
+{
+	Aggregation() : count(0) {}
+	int count;
+	NotificationRequest first;
+	QStringList names;
+};
+
+struct AccountState
+{
+	AccountState() : connected(-1), window(-1) {}
+	qint64 connected;
+	int window;
+};
+
+class NotificationSchedulerPrivate
+{
+public:
+	NotificationSchedulerPrivate()
+		: backendRate(0), backendBurst(0), defaultWindow(0),
+		  suppressed(0), dropped(0), aggregated(0) {}
+	void track(Account *account);
+
+	NotificationScheduler *q;
+	QElapsedTimer clock;
+	TokenBucket types[TypesCount];
+	Aggregation aggregations[TypesCount];
+	QHash<QByteArray, TokenBucket> backends;
+	double backendRate;
+	double backendBurst;
+	QHash<Account*, AccountState> accounts;
+	int defaultWindow;
+	QTimer flushTimer;
+	quint64 suppressed;
+	quint64 dropped;
+	quint64 aggregated;
+};
+
+static bool isStatusType(Notification::Type type)
+{
+	return type == Notification::UserOnline
+			|| type == Notification::UserOffline
+			|| type == Notification::UserChangedStatus;
+}
+
+// Only these ones have sense as "N events" summary, messages are never merged
+static bool isAggregatable(Notification::Type type)
+{
+	return isStatusType(type)
+			|| type == Notification::ChatUserJoined
+			|| type == Notification::ChatUserLeft;
+}
+
+// Messages must reach every backend, tray and contact list show them until read
+static bool isRateLimited(const QByteArray &backendType, Notification::Type type)
+{
+	if (type == Notification::IncomingMessage || type == Notification::ChatIncomingMessage)
+		return false;
+	return backendType == "Popup" || backendType == "Sound" || backendType == "Vibration";
+}
+
+static QString summaryText(Notification::Type type, int count)
+{
+	switch (type) {
+	case Notification::UserOnline:
+		return QCoreApplication::translate("Notification", "%n contact(s) came online", 0, count);
+	case Notification::UserOffline:
+		return QCoreApplication::translate("Notification", "%n contact(s) went offline", 0, count);
+	case Notification::UserChangedStatus:
+		return QCoreApplication::translate("Notification", "%n contact(s) changed status", 0, count);
+	case Notification::ChatUserJoined:
+		return QCoreApplication::translate("Notification", "%n user(s) joined conferences", 0, count);
+	case Notification::ChatUserLeft:
+		return QCoreApplication::translate("Notification", "%n user(s) left conferences", 0, count);
+	default:
+		return Notification::typeText(type);
+	}
+}
+
+void NotificationSchedulerPrivate::track(Account *account)
+{
+	if (accounts.contains(account))
+		return;
+	AccountState &state = accounts[account];
+	state.window = account->config(QStringLiteral("notification"))
+			.value(QStringLiteral("suppressionWindow"), -1);
+	QObject::connect(account, SIGNAL(statusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)),
+					 q, SLOT(onAccountStatusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)));
+	QObject::connect(account, SIGNAL(destroyed(QObject*)), q, SLOT(onAccountDestroyed(QObject*)));
+}
+
+static QPointer<NotificationScheduler> self;
+
+NotificationScheduler *NotificationScheduler::instance()
+{
+	// Timers must not outlive the application
+	if (!self && QCoreApplication::instance())
+		self = new NotificationScheduler(QCoreApplication::instance());
+	return self;
+}
+
+NotificationScheduler::NotificationScheduler(QObject *parent)
+	: QObject(parent), d_ptr(new NotificationSchedulerPrivate)
+{
+	Q_D(NotificationScheduler);
+	d->q = this;
+	d->clock.start();
+	d->flushTimer.setSingleShot(true);
+	connect(&d->flushTimer, SIGNAL(timeout()), SLOT(flushAggregated()));
+	reloadSettings();
+
+	if (AccountManager *manager = AccountManager::instance()) {
+		foreach (Account *account, manager->accounts())
+			d->track(account);
+		connect(manager, &AccountManager::accountAdded, this, [d] (Account *account) {
+			d->track(account);
+		});
+	}
+}
+
+NotificationScheduler::~NotificationScheduler()
+{
+}
+
+void NotificationScheduler::reloadSettings()
+{
+	Q_D(NotificationScheduler);
+	Config cfg;
+	cfg.beginGroup(QStringLiteral("notification/scheduler"));
+	const qint64 now = d->clock.elapsed();
+	const double typeRate = cfg.value(QStringLiteral("typeRate"), 1.0);
+	const double typeBurst = cfg.value(QStringLiteral("typeBurst"), 5.0);
+	for (int i = 0; i < TypesCount; ++i)
+		d->types[i].setup(typeRate, typeBurst, now);
+	d->backendRate = cfg.value(QStringLiteral("backendRate"), 4.0);
+	d->backendBurst = cfg.value(QStringLiteral("backendBurst"), 10.0);
+	d->backends.clear();
+	d->defaultWindow = cfg.value(QStringLiteral("suppressionWindow"), 20000);
+	d->flushTimer.setInterval(cfg.value(QStringLiteral("aggregationInterval"), 2000));
+	cfg.endGroup();
+}
+
+NotificationScheduler::Decision NotificationScheduler::schedule(const NotificationRequest &request)
+{
+	Q_D(NotificationScheduler);
+	// Summaries and delayed requests have already passed the scheduler
+	if (request.property("scheduled", false))
+		return Deliver;
+
+	const Notification::Type type = request.type();
+	const qint64 now = d->clock.elapsed();
+
+	if (isStatusType(type)) {
+		Buddy *buddy = qobject_cast<Buddy*>(request.object());
+		if (Account *account = buddy ? buddy->account() : 0) {
+			const Status::Type status = account->status().type();
+			if (status == Status::Offline || status == Status::Connecting) {
+				++d->suppressed;
+				return Suppress;
+			}
+			d->track(account);
+			const AccountState &state = d->accounts.value(account);
+			const int window = state.window >= 0 ? state.window : d->defaultWindow;
+			if (state.connected >= 0 && now - state.connected < window) {
+				++d->suppressed;
+				return Suppress;
+			}
+		}
+	}
+
+	if (!isAggregatable(type))
+		return Deliver;
+
+	Aggregation &aggregation = d->aggregations[type];
+	// Once merging has begun all events go to the summary to keep their order
+	if (aggregation.count == 0 && d->types[type].acquire(now))
+		return Deliver;
+
+	if (aggregation.count == 0)
+		aggregation.first = request;
+	if (aggregation.names.size() < 3) {
+		if (QObject *object = request.object()) {
+			QString name = object->property("title").toString();
+			if (name.isEmpty())
+				name = object->property("id").toString();
+			if (!name.isEmpty())
+				aggregation.names << name;
+		}
+	}
+	++aggregation.count;
+	++d->aggregated;
+	if (!d->flushTimer.isActive())
+		d->flushTimer.start();
+	return Aggregate;
+}
+
+bool NotificationScheduler::acquireBackend(const QByteArray &backendType, Notification::Type type)
+{
+	Q_D(NotificationScheduler);
+	if (!isRateLimited(backendType, type))
+		return true;
+	const qint64 now = d->clock.elapsed();
+	QHash<QByteArray, TokenBucket>::iterator it = d->backends.find(backendType);
+	if (it == d->backends.end()) {
+		it = d->backends.insert(backendType, TokenBucket());
+		it->setup(d->backendRate, d->backendBurst, now);
+	}
+	if (it->acquire(now))
+		return true;
+	++d->dropped;
+	return false;
+}
+
+int NotificationScheduler::suppressionWindow(Account *account) const
+{
+	Q_D(const NotificationScheduler);
+	const int window = d->accounts.value(account).window;
+	return window >= 0 ? window : d->defaultWindow;
+}
+
+void NotificationScheduler::setSuppressionWindow(Account *account, int msecs)
+{
+	Q_D(NotificationScheduler);
+	d->track(account);
+	d->accounts[account].window = msecs;
+	Config cfg = account->config(QStringLiteral("notification"));
+	if (msecs < 0)
+		cfg.remove(QStringLiteral("suppressionWindow"));
+	else
+		cfg.setValue(QStringLiteral("suppressionWindow"), msecs);
+}
+
+quint64 NotificationScheduler::suppressedCount() const
+{
+	return d_func()->suppressed;
+}
+
+quint64 NotificationScheduler::droppedCount() const
+{
+	return d_func()->dropped;
+}
+
+quint64 NotificationScheduler::aggregatedCount() const
+{
+	return d_func()->aggregated;
+}
+
+void NotificationScheduler::resetCounters()
+{
+	Q_D(NotificationScheduler);
+	d->suppressed = 0;
+	d->dropped = 0;
+	d->aggregated = 0;
+}
+
+void NotificationScheduler::onAccountStatusChanged(const Status &current, const Status &previous)
+{
+	Q_D(NotificationScheduler);
+	Account *account = qobject_cast<Account*>(sender());
+	if (!account)
+		return;
+	if (current.type() != Status::Offline && previous.type() == Status::Connecting)
+		d->accounts[account].connected = d->clock.elapsed();
+	else if (current.type() == Status::Offline)
+		d->accounts[account].connected = -1;
+}
+
+void NotificationScheduler::onAccountDestroyed(QObject *object)
+{
+	d_func()->accounts.remove(static_cast<Account*>(object));
+}
+
+void NotificationScheduler::flushAggregated()
+{
+	Q_D(NotificationScheduler);
+	for (int i = 0; i < TypesCount; ++i) {
+		Aggregation &aggregation = d->aggregations[i];
+		if (aggregation.count == 0)
+			continue;
+		NotificationRequest request;
+		if (aggregation.count == 1) {
+			request = aggregation.first;
+		} else {
+			request = NotificationRequest(static_cast<Notification::Type>(i));
+			request.setTitle(summaryText(request.type(), aggregation.count));
+			QString text = aggregation.names.join(QStringLiteral(", "));
+			if (aggregation.count > aggregation.names.size())
+				text += QStringLiteral(", ...");
+			request.setText(text);
+			request.setProperty("aggregatedCount", aggregation.count);
+		}
+		request.setProperty("scheduled", true);
+		aggregation = Aggregation();
+		request.send();
+	}
+}
+
+} // namespace qutim_sdk_0_3
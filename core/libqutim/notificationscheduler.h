@@ -0,0 +1,107 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef NOTIFICATIONSCHEDULER_H
+#define NOTIFICATIONSCHEDULER_H
+
+#include "notification.h"
+
+namespace qutim_sdk_0_3
+{
+
+class Account;
+class NotificationSchedulerPrivate;
+
+/*!
+  NotificationScheduler protects notification backends from storms of
+  notifications, i.e. when hundreds of contacts come online right after login.
+
+  Every request passes it before filters and backends are called. Status
+  notifications of buddies are dropped during the configurable window after
+  their account has connected. Every notification type has a token bucket,
+  requests over the limit are merged to a single summary notification like
+  "42 contacts came online". Presentational backends, i.e. popups and sounds,
+  have a token bucket too, so they can't be produced faster than the limit.
+  Backends which keep the state, like tray and contact list, and incoming
+  messages are never limited.
+
+  Scheduler is owned by the application object, instance() returns null
+  before its creation and after its destruction.
+
+  Limits are stored in "notification/scheduler" group of the config.
+*/
+class LIBQUTIM_EXPORT NotificationScheduler : public QObject
+{
+	Q_OBJECT
+	Q_DECLARE_PRIVATE(NotificationScheduler)
+public:
+	enum Decision
+	{
+		Deliver,
+		Suppress,
+		Aggregate
+	};
+
+	static NotificationScheduler *instance();
+	~NotificationScheduler();
+
+	/*!
+	  Returns whether \a request should be delivered now. If the request is
+	  aggregated scheduler takes care of it and sends the summary later.
+	*/
+	Decision schedule(const NotificationRequest &request);
+	/*!
+	  Takes a token from the bucket of backend \a backendType for the
+	  notification of \a type, returns false if the backend is overloaded.
+	*/
+	bool acquireBackend(const QByteArray &backendType, Notification::Type type);
+
+	/*!
+	  Returns duration of notifications suppression after connection of
+	  \a account in milliseconds.
+	*/
+	int suppressionWindow(Account *account) const;
+	void setSuppressionWindow(Account *account, int msecs);
+
+	// Counters since start of the application
+	quint64 suppressedCount() const;
+	quint64 droppedCount() const;
+	quint64 aggregatedCount() const;
+	void resetCounters();
+public slots:
+	void reloadSettings();
+private slots:
+	void onAccountStatusChanged(const qutim_sdk_0_3::Status &current,
+								const qutim_sdk_0_3::Status &previous);
+	void onAccountDestroyed(QObject *object);
+	void flushAggregated();
+private:
+	NotificationScheduler(QObject *parent);
+	QScopedPointer<NotificationSchedulerPrivate> d_ptr;
+};
+
+} // namespace qutim_sdk_0_3
+
+#endif // NOTIFICATIONSCHEDULER_H
@@ -238,6 +238,7 @@ bool Profile::acceptData(const QVariantMap &data, const QString &password, bool
 	QFile file(configDir + "/profilehash");
 	if (service && (!checkHash || file.open(QIODevice::ReadOnly))) {
 		service->setPassword(password, QVariant());
+		CryptoService::setStorageEncrypted(config.value("encryptStorage", false));
 
 		if (checkHash) {
 			QByteArray data = service->decrypt(file.readAll()).toByteArray();
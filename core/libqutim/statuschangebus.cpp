@@ -0,0 +1,159 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "statuschangebus.h"
+#include "buddy.h"
+#include "config.h"
+#include <QCoreApplication>
+#include <QTimer>
+
+namespace qutim_sdk_0_3
+{
+
+class StatusChangeBusPrivate
+{
+public:
+	StatusChangeList pending;
+	QHash<Buddy*, int> indexes;
+	QTimer timer;
+};
+
+static void collectChangedInfos(const Status &current, const Status &previous, QStringList &result)
+{
+	const QHash<QString, QVariantHash> now = current.extendedInfos();
+	const QHash<QString, QVariantHash> old = previous.extendedInfos();
+	QHash<QString, QVariantHash>::const_iterator it = now.constBegin();
+	for (; it != now.constEnd(); ++it) {
+		QHash<QString, QVariantHash>::const_iterator jt = old.constFind(it.key());
+		if ((jt == old.constEnd() || jt.value() != it.value()) && !result.contains(it.key()))
+			result << it.key();
+	}
+	for (it = old.constBegin(); it != old.constEnd(); ++it) {
+		if (!now.contains(it.key()) && !result.contains(it.key()))
+			result << it.key();
+	}
+}
+
+static QPointer<StatusChangeBus> self;
+
+StatusChangeBus *StatusChangeBus::instance()
+{
+	// Timer must not outlive the application
+	if (!self && QCoreApplication::instance())
+		self = new StatusChangeBus(QCoreApplication::instance());
+	return self;
+}
+
+StatusChangeBus::StatusChangeBus(QObject *parent)
+	: QObject(parent), d_ptr(new StatusChangeBusPrivate)
+{
+	Q_D(StatusChangeBus);
+	qRegisterMetaType<StatusChangeList>();
+	d->timer.setSingleShot(true);
+	d->timer.setInterval(Config().group(QStringLiteral("statusBus")).value(QStringLiteral("interval"), 50));
+	connect(&d->timer, SIGNAL(timeout()), SLOT(onTimeout()));
+}
+
+StatusChangeBus::~StatusChangeBus()
+{
+}
+
+void StatusChangeBus::publish(Buddy *buddy, const Status &current, const Status &previous)
+{
+	Q_D(StatusChangeBus);
+	if (!isSignalConnected(QMetaMethod::fromSignal(&StatusChangeBus::changed))
+			&& !isSignalConnected(QMetaMethod::fromSignal(&StatusChangeBus::typesChanged))) {
+		return;
+	}
+
+	QHash<Buddy*, int>::iterator it = d->indexes.find(buddy);
+	if (it == d->indexes.end() || d->pending.at(it.value()).buddy != buddy) {
+		StatusChange change;
+		change.buddy = buddy;
+		change.previousType = previous.type();
+		it = d->indexes.insert(buddy, d->pending.size());
+		d->pending.append(change);
+	}
+	StatusChange &change = d->pending[it.value()];
+	change.type = current.type();
+	change.textChanged |= current.text() != previous.text();
+	collectChangedInfos(current, previous, change.changedInfos);
+
+	if (!d->timer.isActive())
+		d->timer.start();
+}
+
+void StatusChangeBus::flush()
+{
+	Q_D(StatusChangeBus);
+	d->timer.stop();
+	if (d->pending.isEmpty())
+		return;
+	StatusChangeList changes;
+	changes.swap(d->pending);
+	d->indexes.clear();
+
+	// Buddies might have been destroyed since the change
+	StatusChangeList::iterator it = changes.begin();
+	while (it != changes.end()) {
+		if (it->buddy)
+			++it;
+		else
+			it = changes.erase(it);
+	}
+	if (changes.isEmpty())
+		return;
+
+	emit changed(changes);
+	if (isSignalConnected(QMetaMethod::fromSignal(&StatusChangeBus::typesChanged))) {
+		StatusChangeList types;
+		foreach (const StatusChange &change, changes) {
+			if (change.isTypeChanged())
+				types << change;
+		}
+		if (!types.isEmpty())
+			emit typesChanged(types);
+	}
+}
+
+int StatusChangeBus::interval() const
+{
+	return d_func()->timer.interval();
+}
+
+void StatusChangeBus::setInterval(int msecs)
+{
+	Q_D(StatusChangeBus);
+	d->timer.setInterval(msecs);
+	Config cfg = Config().group(QStringLiteral("statusBus"));
+	cfg.setValue(QStringLiteral("interval"), msecs);
+}
+
+void StatusChangeBus::onTimeout()
+{
+	flush();
+}
+
+} // namespace qutim_sdk_0_3
@@ -0,0 +1,109 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef STATUSCHANGEBUS_H
+#define STATUSCHANGEBUS_H
+
+#include "status.h"
+#include <QPointer>
+#include <QVector>
+#include <QStringList>
+
+namespace qutim_sdk_0_3
+{
+
+class Buddy;
+class StatusChangeBusPrivate;
+
+/*!
+  StatusChange is a compact record of status change of the \a buddy. If the
+  buddy has changed its status several times during one batch the changes are
+  merged, so previousType is the type before the first change and type is the
+  type after the last one.
+*/
+struct LIBQUTIM_EXPORT StatusChange
+{
+	StatusChange() : previousType(Status::Offline), type(Status::Offline), textChanged(false) {}
+	inline bool isTypeChanged() const { return previousType != type; }
+	inline bool isOnlineChanged() const
+	{ return (previousType == Status::Offline) != (type == Status::Offline); }
+
+	QPointer<Buddy> buddy;
+	Status::Type previousType;
+	Status::Type type;
+	bool textChanged;
+	// Names of extended infos which were added, removed or changed
+	QStringList changedInfos;
+};
+
+typedef QVector<StatusChange> StatusChangeList;
+
+/*!
+  StatusChangeBus publishes status changes of all buddies in batches.
+
+  Handling of Buddy::statusChanged() for each of thousands of contacts during
+  login is expensive, as every receiver gets two Status copies. Receivers
+  which need only kind of the change should connect to changed() or
+  typesChanged() instead, they are called once per batch. Changes are
+  computed only while anybody is connected.
+
+  Interval of batches is stored in "statusBus" group of the config. Bus is
+  owned by the application object, instance() returns null before its
+  creation and after its destruction.
+*/
+class LIBQUTIM_EXPORT StatusChangeBus : public QObject
+{
+	Q_OBJECT
+	Q_DECLARE_PRIVATE(StatusChangeBus)
+public:
+	static StatusChangeBus *instance();
+	~StatusChangeBus();
+
+	/*!
+	  Is called by Buddy on every emission of Buddy::statusChanged().
+	*/
+	void publish(Buddy *buddy, const Status &current, const Status &previous);
+	/*!
+	  Delivers pending changes immediately.
+	*/
+	void flush();
+	int interval() const;
+	void setInterval(int msecs);
+signals:
+	void changed(const qutim_sdk_0_3::StatusChangeList &changes);
+	// Only changes of status type, the list is never empty
+	void typesChanged(const qutim_sdk_0_3::StatusChangeList &changes);
+private slots:
+	void onTimeout();
+private:
+	StatusChangeBus(QObject *parent);
+	QScopedPointer<StatusChangeBusPrivate> d_ptr;
+};
+
+} // namespace qutim_sdk_0_3
+
+Q_DECLARE_METATYPE(qutim_sdk_0_3::StatusChangeList)
+
+#endif // STATUSCHANGEBUS_H
@@ -0,0 +1,489 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2012 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "textparser.h"
+#include "emoticons.h"
+#include <QUrl>
+#include <string.h>
+
+namespace qutim_sdk_0_3
+{
+
+typedef EmoticonsProvider::Emoticon EmoticonData;
+typedef QHash<QChar, QList<EmoticonData> > EmoticonsHash;
+
+// Characters allowed after the host part of url, except of word ones
+static const char urlPathChars[] = "+.[]!%$/(),:;@'&=~-";
+static const char urlQueryChars[] = "+.[]!%$/(),:;@'&=~-";
+static const char urlFragmentChars[] = "+.[]!%$/\\()|,:;@&=~-";
+
+static inline bool isAsciiLetter(ushort ch)
+{
+	return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z');
+}
+
+static inline bool isAsciiLetterOrNumber(ushort ch)
+{
+	return isAsciiLetter(ch) || (ch >= '0' && ch <= '9');
+}
+
+static inline bool isWordChar(const QChar &ch)
+{
+	return ch.isLetterOrNumber() || ch.isMark() || ch == QLatin1Char('_');
+}
+
+static inline bool isEmailLocalChar(ushort ch)
+{
+	return isAsciiLetterOrNumber(ch) || ch == '-' || ch == '_' || ch == '.';
+}
+
+static inline bool isEmailDomainChar(ushort ch)
+{
+	return isAsciiLetterOrNumber(ch) || ch == '-' || ch == '_';
+}
+
+static inline bool startsWith(const QChar *c, const QChar *end, const char *str)
+{
+	for (; *str; ++str, ++c) {
+		if (c == end || c->toLower().unicode() != ushort(*str))
+			return false;
+	}
+	return true;
+}
+
+// Html entities which can't be part of url, i.e. it's quoted or in brackets
+static inline bool isUrlDelimiterEntity(const QChar *c, const QChar *end)
+{
+	return startsWith(c, end, "&lt;") || startsWith(c, end, "&gt;") || startsWith(c, end, "&quot;");
+}
+
+static const QChar *skipUrlChars(const QChar *c, const QChar *end, const char *chars, bool html)
+{
+	for (; c < end; ++c) {
+		const ushort ch = c->unicode();
+		if (html && ch == '&' && isUrlDelimiterEntity(c, end))
+			break;
+		if (!isWordChar(*c) && (ch == 0 || ch > 127 || !strchr(chars, ch)))
+			break;
+	}
+	return c;
+}
+
+// Matches domain name with at least one dot. Top level domain of e-mail
+// may consist only of latin letters, top level domain of url may not
+// contain minus sign.
+static int domainLength(const QChar *s, const QChar *end, bool email)
+{
+	int result = 0;
+	int labelLength = 0;
+	for (const QChar *c = s; c < end; ++c) {
+		if (*c == QLatin1Char('.')) {
+			if (labelLength == 0)
+				break;
+			labelLength = 0;
+			const QChar *tld = c + 1;
+			while (tld < end && (email ? isAsciiLetter(tld->unicode()) : isWordChar(*tld)))
+				++tld;
+			if (tld > c + 1)
+				result = tld - s;
+		} else if (email ? isEmailDomainChar(c->unicode()) : (isWordChar(*c) || *c == QLatin1Char('-'))) {
+			++labelLength;
+		} else {
+			break;
+		}
+	}
+	return result;
+}
+
+// ([a-z]+(\+[a-z]+)?://|www\.)host(:port)?(/path(\?query)?(#fragment)?)?
+static int webUrlLength(const QChar *s, const QChar *end, bool html)
+{
+	const QChar *c = s;
+	if (startsWith(c, end, "www.")) {
+		c += 4;
+	} else {
+		while (c < end && isAsciiLetter(c->unicode()))
+			++c;
+		if (c < end && *c == QLatin1Char('+')) {
+			const QChar *subScheme = ++c;
+			while (c < end && isAsciiLetter(c->unicode()))
+				++c;
+			if (c == subScheme)
+				return 0;
+		}
+		if (c == s || !startsWith(c, end, "://"))
+			return 0;
+		c += 3;
+	}
+	const int host = domainLength(c, end, false);
+	if (!host)
+		return 0;
+	c += host;
+	if (c + 1 < end && *c == QLatin1Char(':') && c[1].isDigit()) {
+		c += 2;
+		while (c < end && c->isDigit())
+			++c;
+	}
+	if (c < end && *c == QLatin1Char('/')) {
+		c = skipUrlChars(c + 1, end, urlPathChars, html);
+		if (c < end && *c == QLatin1Char('?'))
+			c = skipUrlChars(c + 1, end, urlQueryChars, html);
+		if (c < end && *c == QLatin1Char('#'))
+			c = skipUrlChars(c + 1, end, urlFragmentChars, html);
+	}
+	return c - s;
+}
+
+// Returns pointer after the end of tag or null if tag is not closed
+static const QChar *skipTag(const QChar *c, const QChar *end)
+{
+	QChar quote;
+	for (++c; c < end; ++c) {
+		if (!quote.isNull()) {
+			if (*c == quote)
+				quote = QChar();
+		} else if (*c == QLatin1Char('\'') || *c == QLatin1Char('"')) {
+			quote = *c;
+		} else if (*c == QLatin1Char('>')) {
+			return c + 1;
+		}
+	}
+	return 0;
+}
+
+static bool isAnchorTag(const QChar *c, const QChar *end, bool *closing)
+{
+	++c;
+	*closing = (c < end && *c == QLatin1Char('/'));
+	if (*closing)
+		++c;
+	if (c + 1 >= end || c->toLower() != QLatin1Char('a'))
+		return false;
+	++c;
+	return c->isSpace() || *c == QLatin1Char('>') || *c == QLatin1Char('/');
+}
+
+// Returns pointer after the end of entity or null if it's just an ampersand
+static const QChar *skipEntity(const QChar *c, const QChar *end)
+{
+	const QChar *name = ++c;
+	if (c < end && *c == QLatin1Char('#'))
+		++c;
+	while (c < end && c - name < 32 && isAsciiLetterOrNumber(c->unicode()))
+		++c;
+	if (c < end && *c == QLatin1Char(';') && c - name > 1)
+		return c + 1;
+	return 0;
+}
+
+static QString unescapeUrl(const QString &url)
+{
+	if (!url.contains(QLatin1Char('&')))
+		return url;
+	QString result;
+	result.reserve(url.size());
+	const QChar *c = url.constData();
+	const QChar *end = c + url.size();
+	while (c < end) {
+		const QChar *entityEnd = (*c == QLatin1Char('&')) ? skipEntity(c, end) : 0;
+		if (!entityEnd) {
+			result += *c++;
+			continue;
+		}
+		const QString name = QString::fromRawData(c + 1, entityEnd - c - 2);
+		if (name == QLatin1String("amp"))
+			result += QLatin1Char('&');
+		else if (name == QLatin1String("lt"))
+			result += QLatin1Char('<');
+		else if (name == QLatin1String("gt"))
+			result += QLatin1Char('>');
+		else if (name == QLatin1String("quot"))
+			result += QLatin1Char('"');
+		else if (name == QLatin1String("apos"))
+			result += QLatin1Char('\'');
+		else if (name.startsWith(QLatin1Char('#')))
+			result += QChar(name.startsWith(QLatin1String("#x"), Qt::CaseInsensitive)
+							? name.mid(2).toUShort(0, 16) : name.mid(1).toUShort());
+		else
+			result += QString(c, entityEnd - c);
+		c = entityEnd;
+	}
+	return result;
+}
+
+static inline int emoticonLength(const QChar *c, const QChar *end, const QString &code)
+{
+	const int length = code.size();
+	if (length == 0 || end - c < length)
+		return 0;
+	const QChar *s = code.constData();
+	for (int i = 0; i < length; ++i) {
+		if (c[i].toLower() != s[i])
+			return 0;
+	}
+	return length;
+}
+
+static inline void appendToken(TextParser::TokenList &tokens, TextParser::TokenType type,
+							   const QString &text, const QChar *from, const QChar *to,
+							   const QString &data = QString())
+{
+	if (from == to)
+		return;
+	TextParser::Token token = { type, QStringRef(&text, from - text.constData(), to - from), data };
+	tokens << token;
+}
+
+static TextParser::TokenList tokenizeText(const QString &text, TextParser::Flags flags,
+										  const EmoticonsHash &emoticons)
+{
+	TextParser::TokenList tokens;
+	const bool html = flags & TextParser::Html;
+	const bool strict = flags & TextParser::StrictEmoticons;
+	const QChar *begin = text.constData();
+	const QChar *end = begin + text.size();
+	const QChar *textStart = begin;
+	const QChar *c = begin;
+	bool inAnchor = false;
+	bool tagsClosed = true;
+	while (c < end) {
+		const ushort ch = c->unicode();
+		if (html && ch == '<' && tagsClosed) {
+			if (const QChar *tagEnd = skipTag(c, end)) {
+				bool closing;
+				if (isAnchorTag(c, end, &closing))
+					inAnchor = !closing;
+				appendToken(tokens, TextParser::Text, text, textStart, c);
+				appendToken(tokens, TextParser::Tag, text, c, tagEnd);
+				c = textStart = tagEnd;
+				continue;
+			}
+			// There is no '>' till the end, so don't look for it again
+			tagsClosed = false;
+		}
+		// Text of links is neither linkified second time nor has emoticons
+		if (inAnchor) {
+			++c;
+			continue;
+		}
+		if (flags & TextParser::Urls) {
+			const QChar *urlStart = 0;
+			const QChar *urlEnd = 0;
+			if (ch == '@') {
+				// E-mail's local part is already passed, so look behind
+				const QChar *local = c;
+				while (local > textStart && isEmailLocalChar(local[-1].unicode()))
+					--local;
+				if (local != c) {
+					if (int domain = domainLength(c + 1, end, true)) {
+						urlStart = local;
+						urlEnd = c + 1 + domain;
+					}
+				}
+			} else if (isAsciiLetter(ch) && (c == begin || !isWordChar(c[-1]))) {
+				if (int length = webUrlLength(c, end, html)) {
+					urlStart = c;
+					urlEnd = c + length;
+				}
+			}
+			if (urlStart) {
+				QString url(urlStart, urlEnd - urlStart);
+				if (html)
+					url = unescapeUrl(url);
+				if (url.startsWith(QLatin1String("www."), Qt::CaseInsensitive))
+					url.prepend(QLatin1String("http://"));
+				else if (!url.contains(QLatin1String("//")))
+					url.prepend(QLatin1String("mailto:"));
+				appendToken(tokens, TextParser::Text, text, textStart, urlStart);
+				appendToken(tokens, TextParser::Url, text, urlStart, urlEnd, url);
+				c = textStart = urlEnd;
+				continue;
+			}
+		}
+		if (!emoticons.isEmpty() && (!strict || c == begin || c[-1].isSpace())) {
+			EmoticonsHash::const_iterator it = emoticons.constFind(c->toLower());
+			if (it != emoticons.constEnd()) {
+				const QChar *emoticonEnd = 0;
+				foreach (const EmoticonData &emoticon, it.value()) {
+					const QString &code = html ? emoticon.matchTextEscaped : emoticon.matchText;
+					const int length = emoticonLength(c, end, code);
+					if (length && (!strict || c + length == end || c[length].isSpace())) {
+						emoticonEnd = c + length;
+						appendToken(tokens, TextParser::Text, text, textStart, c);
+						appendToken(tokens, TextParser::Emoticon, text, c, emoticonEnd, emoticon.picHTMLCode);
+						break;
+					}
+				}
+				if (emoticonEnd) {
+					c = textStart = emoticonEnd;
+					continue;
+				}
+			}
+		}
+		if (html && ch == '&') {
+			if (const QChar *entityEnd = skipEntity(c, end)) {
+				appendToken(tokens, TextParser::Text, text, textStart, c);
+				appendToken(tokens, TextParser::Entity, text, c, entityEnd);
+				c = textStart = entityEnd;
+				continue;
+			}
+		}
+		++c;
+	}
+	appendToken(tokens, TextParser::Text, text, textStart, end);
+	return tokens;
+}
+
+TextParser::TokenList TextParser::tokenize(const QString &text, Flags flags)
+{
+	if (flags & (Emoticons | StrictEmoticons))
+		return tokenize(text, flags, qutim_sdk_0_3::Emoticons::theme());
+	return tokenizeText(text, flags, EmoticonsHash());
+}
+
+TextParser::TokenList TextParser::tokenize(const QString &text, Flags flags, const EmoticonsTheme &theme)
+{
+	EmoticonsHash emoticons;
+	if ((flags & (Emoticons | StrictEmoticons)) && !theme.isNull())
+		emoticons = theme.provider()->emoticonsByChar();
+	return tokenizeText(text, flags, emoticons);
+}
+
+// Escapes plain text as the Message::html() always did: line breaks,
+// tabs and sequences of whitespaces are preserved
+static void appendEscaped(QString &html, const QStringRef &text, int &spaces)
+{
+	const QChar *c = text.constData();
+	const QChar *end = c + text.size();
+	for (; c < end; ++c) {
+		switch (c->unicode()) {
+		case L'\n':
+			html += QLatin1String("<br/>");
+			// keep leading whitespace
+			if (c + 1 < end && c[1] == QLatin1Char(' ')) {
+				html += QLatin1String("&nbsp;");
+				++c;
+			}
+			spaces = 0;
+			break;
+		case L'\t':
+			html += QLatin1String("&nbsp; &nbsp; ");
+			spaces = 1;
+			break;
+		case L' ':
+			if (spaces++ & 1)
+				html += QLatin1String("&nbsp;");
+			else
+				html += QLatin1Char(' ');
+			break;
+		case L'<':
+			html += QLatin1String("&lt;");
+			spaces = 0;
+			break;
+		case L'>':
+			html += QLatin1String("&gt;");
+			spaces = 0;
+			break;
+		case L'&':
+			html += QLatin1String("&amp;");
+			spaces = 0;
+			break;
+		case L'"':
+			html += QLatin1String("&quot;");
+			spaces = 0;
+			break;
+		default:
+			html += *c;
+			spaces = 0;
+			break;
+		}
+	}
+}
+
+static inline void appendText(QString &html, const QStringRef &text, bool escape)
+{
+	int spaces = 0;
+	if (escape)
+		appendEscaped(html, text, spaces);
+	else
+		html += text;
+}
+
+QString TextParser::toHtml(const TokenList &tokens, Flags flags)
+{
+	QString html;
+	if (tokens.isEmpty())
+		return html;
+	const bool escape = !(flags & Html);
+	html.reserve(tokens.first().text.string()->size() * 1.2);
+	int spaces = 0;
+	foreach (const Token &token, tokens) {
+		switch (token.type) {
+		case Text:
+			if (escape)
+				appendEscaped(html, token.text, spaces);
+			else
+				html += token.text;
+			continue;
+		case Tag:
+		case Entity:
+			html += token.text;
+			break;
+		case Url: {
+			const QUrl url = QUrl::fromUserInput(token.data);
+			const QByteArray urlEncoded = url.toEncoded();
+			html += QLatin1String("<a href='");
+			html += QLatin1String(urlEncoded.constData(), urlEncoded.size());
+			html += QLatin1String("' title='");
+			html += url.toString();
+			html += QLatin1String("' target='_blank'>");
+			appendText(html, token.text, escape);
+			html += QLatin1String("</a>");
+			break;
+		}
+		case Emoticon: {
+			// %4 in emoticon's html code is replaced by its text
+			const QString &code = token.data;
+			int i = 0, last = 0;
+			while ((i = code.indexOf(QLatin1String("%4"), last)) != -1) {
+				html += code.midRef(last, i - last);
+				appendText(html, token.text, escape);
+				last = i + 2;
+			}
+			html += code.midRef(last);
+			break;
+		}
+		}
+		spaces = 0;
+	}
+	return html;
+}
+
+QString TextParser::toHtml(const QString &text, Flags flags)
+{
+	return toHtml(tokenize(text, flags), flags);
+}
+
+} //namespace qutim_sdk_0_3
@@ -0,0 +1,95 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2012 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef TEXTPARSER_H
+#define TEXTPARSER_H
+
+#include "libqutim_global.h"
+#include <QVector>
+
+namespace qutim_sdk_0_3
+{
+
+class EmoticonsTheme;
+
+/*!
+  TextParser splits message text into tokens in one linear pass: html tags,
+  html entities, urls, e-mail addresses and emoticons. The result may be
+  rendered to html by toHtml().
+
+  Parser has no shared state, so it can be used from any thread.
+*/
+class LIBQUTIM_EXPORT TextParser
+{
+public:
+	enum Flag {
+		None            = 0x00,
+		// Text is html, tags and entities are passed through untouched
+		Html            = 0x01,
+		Urls            = 0x02,
+		Emoticons       = 0x04,
+		// Emoticons must be surrounded by spaces
+		StrictEmoticons = 0x08
+	};
+	Q_DECLARE_FLAGS(Flags, Flag)
+
+	enum TokenType {
+		Text,
+		Tag,
+		Entity,
+		Url,
+		Emoticon
+	};
+
+	struct Token
+	{
+		TokenType type;
+		QStringRef text;
+		// Url of Url token, html code of Emoticon token
+		QString data;
+	};
+	typedef QVector<Token> TokenList;
+
+	/*!
+	  Splits \a text to tokens, emoticons are taken from the current theme.
+	*/
+	static TokenList tokenize(const QString &text, Flags flags = None);
+	static TokenList tokenize(const QString &text, Flags flags, const EmoticonsTheme &theme);
+	/*!
+	  Renders \a tokens to html. If tokens were taken from plain text, it's
+	  escaped, line breaks and repeated whitespaces are kept.
+	*/
+	static QString toHtml(const TokenList &tokens, Flags flags = None);
+	static QString toHtml(const QString &text, Flags flags = None);
+private:
+	TextParser();
+	~TextParser();
+};
+
+} //namespace qutim_sdk_0_3
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(qutim_sdk_0_3::TextParser::Flags)
+
+#endif // TEXTPARSER_H
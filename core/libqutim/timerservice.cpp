@@ -0,0 +1,302 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "timerservice.h"
+#include "debug.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QTimer>
+#include <QSet>
+
+namespace qutim_sdk_0_3
+{
+
+class CoalescingTimerPrivate
+{
+public:
+	CoalescingTimerPrivate()
+		: interval(0), slack(-1), singleShot(false), active(false), deadline(0), service(0) {}
+	inline int realSlack() const { return slack >= 0 ? slack : interval / 10; }
+	// Timer must be fired not later than this moment
+	inline qint64 latest() const { return deadline + realSlack(); }
+	QByteArray owner() const;
+
+	CoalescingTimer *q;
+	int interval;
+	int slack;
+	bool singleShot;
+	bool active;
+	qint64 deadline;
+	// Service which keeps the timer while it is active
+	TimerService *service;
+};
+
+QByteArray CoalescingTimerPrivate::owner() const
+{
+	if (!q->objectName().isEmpty())
+		return q->objectName().toUtf8();
+	if (QObject *parent = q->parent())
+		return parent->metaObject()->className();
+	return q->metaObject()->className();
+}
+
+class TimerServicePrivate
+{
+public:
+	TimerServicePrivate() : wakeups(0), timeouts(0), dispatching(false) {}
+	inline qint64 now() const { return customClock ? customClock() : clock.elapsed(); }
+	QElapsedTimer clock;
+	TimerService::Clock customClock;
+	QTimer timer;
+	QList<CoalescingTimer*> timers;
+	QHash<QByteArray, quint64> owners;
+	quint64 wakeups;
+	quint64 timeouts;
+	bool dispatching;
+};
+
+CoalescingTimer::CoalescingTimer(QObject *parent)
+	: QObject(parent), d_ptr(new CoalescingTimerPrivate)
+{
+	d_func()->q = this;
+}
+
+CoalescingTimer::~CoalescingTimer()
+{
+	stop();
+}
+
+int CoalescingTimer::interval() const
+{
+	return d_func()->interval;
+}
+
+void CoalescingTimer::setInterval(int msecs)
+{
+	Q_D(CoalescingTimer);
+	d->interval = qMax(0, msecs);
+	if (d->active)
+		start();
+}
+
+int CoalescingTimer::slack() const
+{
+	return d_func()->realSlack();
+}
+
+void CoalescingTimer::setSlack(int msecs)
+{
+	Q_D(CoalescingTimer);
+	d->slack = msecs;
+	if (d->active)
+		d->service->reschedule();
+}
+
+bool CoalescingTimer::isSingleShot() const
+{
+	return d_func()->singleShot;
+}
+
+void CoalescingTimer::setSingleShot(bool singleShot)
+{
+	d_func()->singleShot = singleShot;
+}
+
+bool CoalescingTimer::isActive() const
+{
+	return d_func()->active;
+}
+
+void CoalescingTimer::start()
+{
+	if (TimerService *service = TimerService::instance())
+		service->add(this);
+}
+
+void CoalescingTimer::start(int msecs)
+{
+	d_func()->interval = qMax(0, msecs);
+	start();
+}
+
+void CoalescingTimer::stop()
+{
+	Q_D(CoalescingTimer);
+	if (d->active)
+		d->service->remove(this);
+}
+
+static QPointer<TimerService> self;
+
+TimerService *TimerService::instance()
+{
+	if (!self && QCoreApplication::instance())
+		self = new TimerService(QCoreApplication::instance());
+	return self;
+}
+
+TimerService::TimerService(QObject *parent) : QObject(parent), d_ptr(new TimerServicePrivate)
+{
+	Q_D(TimerService);
+	d->clock.start();
+	d->timer.setSingleShot(true);
+	connect(&d->timer, SIGNAL(timeout()), SLOT(onTimeout()));
+}
+
+TimerService::~TimerService()
+{
+	Q_D(TimerService);
+	// Timers may outlive the application
+	foreach (CoalescingTimer *timer, d->timers)
+		timer->d_func()->active = false;
+}
+
+void TimerService::setClock(const Clock &clock)
+{
+	Q_D(TimerService);
+	d->customClock = clock;
+	reschedule();
+}
+
+qint64 TimerService::nextWakeup() const
+{
+	Q_D(const TimerService);
+	if (d->timers.isEmpty())
+		return -1;
+	qint64 latest = d->timers.first()->d_func()->latest();
+	for (int i = 1; i < d->timers.size(); ++i)
+		latest = qMin(latest, d->timers.at(i)->d_func()->latest());
+	return latest;
+}
+
+quint64 TimerService::wakeupCount() const
+{
+	return d_func()->wakeups;
+}
+
+quint64 TimerService::timeoutCount() const
+{
+	return d_func()->timeouts;
+}
+
+QHash<QByteArray, quint64> TimerService::ownerWakeups() const
+{
+	return d_func()->owners;
+}
+
+void TimerService::dump() const
+{
+	Q_D(const TimerService);
+	debug() << "TimerService:" << d->wakeups << "wakeups for" << d->timeouts << "timeouts,"
+			<< d->timers.size() << "active timers";
+	QHash<QByteArray, quint64>::const_iterator it = d->owners.constBegin();
+	for (; it != d->owners.constEnd(); ++it)
+		debug() << "  " << it.key() << it.value();
+}
+
+void TimerService::resetCounters()
+{
+	Q_D(TimerService);
+	d->wakeups = 0;
+	d->timeouts = 0;
+	d->owners.clear();
+}
+
+void TimerService::add(CoalescingTimer *timer)
+{
+	Q_D(TimerService);
+	CoalescingTimerPrivate *p = timer->d_func();
+	p->deadline = d->now() + p->interval;
+	if (!p->active) {
+		p->active = true;
+		p->service = this;
+		d->timers << timer;
+	}
+	reschedule();
+}
+
+void TimerService::remove(CoalescingTimer *timer)
+{
+	Q_D(TimerService);
+	timer->d_func()->active = false;
+	d->timers.removeOne(timer);
+	reschedule();
+}
+
+void TimerService::reschedule()
+{
+	Q_D(TimerService);
+	// Timers are rescheduled once after the dispatching
+	if (d->dispatching)
+		return;
+	const qint64 latest = nextWakeup();
+	if (latest < 0)
+		d->timer.stop();
+	else
+		d->timer.start(int(qMax<qint64>(0, latest - d->now())));
+}
+
+void TimerService::onTimeout()
+{
+	Q_D(TimerService);
+	const qint64 now = d->now();
+	QList<QPointer<CoalescingTimer> > expired;
+	foreach (CoalescingTimer *timer, d->timers) {
+		if (timer->d_func()->deadline <= now)
+			expired << timer;
+	}
+	QSet<QByteArray> owners;
+	int fired = 0;
+	d->dispatching = true;
+	foreach (const QPointer<CoalescingTimer> &timer, expired) {
+		if (!timer)
+			continue;
+		CoalescingTimerPrivate *p = timer->d_func();
+		// Handlers of the previous timers could stop or restart it
+		if (!p->active || p->deadline > now)
+			continue;
+		if (p->singleShot) {
+			p->active = false;
+			d->timers.removeOne(timer);
+		} else {
+			// Don't try to catch up missed intervals
+			p->deadline = qMax(p->deadline + p->interval, now + 1);
+		}
+		++fired;
+		owners.insert(p->owner());
+		emit timer->timeout();
+	}
+	d->dispatching = false;
+	if (fired) {
+		++d->wakeups;
+		d->timeouts += fired;
+		foreach (const QByteArray &owner, owners)
+			++d->owners[owner];
+	}
+	reschedule();
+}
+
+} // namespace qutim_sdk_0_3
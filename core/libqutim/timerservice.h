@@ -0,0 +1,141 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef TIMERSERVICE_H
+#define TIMERSERVICE_H
+
+#include "libqutim_global.h"
+#include <QHash>
+#include <functional>
+
+namespace qutim_sdk_0_3
+{
+
+class CoalescingTimerPrivate;
+class TimerServicePrivate;
+
+/*!
+  CoalescingTimer is a replacement of QTimer for periodic jobs which don't
+  need exact time, like polls, keep-alive pings or timeouts.
+
+  Every timer has a slack, timeout() is emitted somewhere in the
+  [interval, interval + slack] range after the start. TimerService uses it
+  to wake up the application once for several timers, so many components
+  don't wake up the processor one by one.
+
+  Wakeups are accounted per owner, the owner is objectName() of the timer
+  or class name of its parent.
+*/
+class LIBQUTIM_EXPORT CoalescingTimer : public QObject
+{
+	Q_OBJECT
+	Q_DECLARE_PRIVATE(CoalescingTimer)
+	Q_PROPERTY(int interval READ interval WRITE setInterval)
+	Q_PROPERTY(int slack READ slack WRITE setSlack)
+	Q_PROPERTY(bool singleShot READ isSingleShot WRITE setSingleShot)
+	Q_PROPERTY(bool active READ isActive)
+public:
+	explicit CoalescingTimer(QObject *parent = 0);
+	~CoalescingTimer();
+
+	int interval() const;
+	void setInterval(int msecs);
+	/*!
+	  Returns maximum delay of timeout() in milliseconds. By default it is
+	  a tenth of the interval.
+	*/
+	int slack() const;
+	void setSlack(int msecs);
+	bool isSingleShot() const;
+	void setSingleShot(bool singleShot);
+	bool isActive() const;
+public slots:
+	void start();
+	void start(int msecs);
+	void stop();
+signals:
+	void timeout();
+private:
+	friend class TimerService;
+	QScopedPointer<CoalescingTimerPrivate> d_ptr;
+};
+
+/*!
+  TimerService schedules all active instances of CoalescingTimer.
+
+  On every wakeup it fires all timers whose interval has passed, next wakeup
+  is planned at the latest moment allowed by the most urgent timer.
+*/
+class LIBQUTIM_EXPORT TimerService : public QObject
+{
+	Q_OBJECT
+	Q_DECLARE_PRIVATE(TimerService)
+public:
+	typedef std::function<qint64 ()> Clock;
+
+	/*!
+	  Returns the service, it's owned by the application and is null
+	  without QCoreApplication.
+	*/
+	static TimerService *instance();
+	~TimerService();
+
+	/*!
+	  Replaces the monotonic clock in milliseconds, so tests can simulate
+	  time. Empty \a clock restores the real one.
+	*/
+	void setClock(const Clock &clock);
+	/*!
+	  Returns the moment of the next wakeup by the clock, or -1 if there
+	  are no active timers.
+	*/
+	qint64 nextWakeup() const;
+
+	// Counters since start of the application
+	quint64 wakeupCount() const;
+	quint64 timeoutCount() const;
+	/*!
+	  Returns count of wakeups in which timers of every owner were fired.
+	*/
+	QHash<QByteArray, quint64> ownerWakeups() const;
+	/*!
+	  Prints counters to the debug output.
+	*/
+	void dump() const;
+	void resetCounters();
+private slots:
+	void onTimeout();
+private:
+	friend class CoalescingTimer;
+	TimerService(QObject *parent);
+	void add(CoalescingTimer *timer);
+	void remove(CoalescingTimer *timer);
+	void reschedule();
+	QScopedPointer<TimerServicePrivate> d_ptr;
+};
+
+} // namespace qutim_sdk_0_3
+
+#endif // TIMERSERVICE_H
@@ -28,6 +28,7 @@
 #include "systeminfo.h"
 #include "utils.h"
 #include "message.h"
+#include "textparser.h"
 #include <QDate>
 #include <QLocale>
 #include <QDesktopWidget>
@@ -445,98 +446,24 @@ namespace qutim_sdk_0_3
 	UrlParser::UrlTokenList UrlParser::tokenize(const QString &text, Flags flags)
 	{
 		UrlTokenList result;
-		static QRegExp linkRegExp("([a-zA-Z0-9\\-\\_\\.]+@([a-zA-Z0-9\\-\\_]+\\.)+[a-zA-Z]+)|"
-								  "([a-z]+(\\+[a-z]+)?://|www\\.)"
-								  "[\\w-]+(\\.[\\w-]+)*\\.\\w+"
-								  "(:\\d+)?"
-								  "(/[\\w\\+\\.\\[\\]!%\\$/\\(\\),:;@'&=~-]*"
-								  "(\\?[\\w\\+\\.\\[\\]!%\\$/\\(\\),:;@\\'&=~-]*)?"
-								  "(#[\\w\\+\\.\\[\\]!%\\$/\\\\\\(\\)\\|,:;@&=~-]*)?)?",
-								  Qt::CaseInsensitive);
-		Q_ASSERT(linkRegExp.isValid());
-		QList<QPair<int, int> > tags;
-		int currentTag = 0;
-		if (flags & Html) {
-			enum TagParserState {
-				AtText,
-				AtTag,
-				AtSingleQuote,
-				AtDoubleQuote
-			};
-			TagParserState state = AtText;
-			int start = 0;
-			for (int i = 0; i < text.size(); ++i) {
-				QChar ch = text.at(i);
-				switch (state) {
-				case AtText:
-					if (ch == QLatin1Char('<')) {
-						state = AtTag;
-						start = i;
-					}
-					break;
-				case AtTag:
-					if (ch == QLatin1Char('>')) {
-						tags << qMakePair(start, i);
-						state = AtText;
-					} else if (ch == QLatin1Char('\'')) {
-						state = AtSingleQuote;
-					} else if (ch == QLatin1Char('\"')) {
-						state = AtDoubleQuote;
-					}
-					break;
-				case AtSingleQuote:
-					if (ch == QLatin1Char('\''))
-						state = AtTag;
-					break;
-				case AtDoubleQuote:
-					if (ch == QLatin1Char('\"'))
-						state = AtTag;
-					break;
-				}
-			}
-		}
-		int pos = 0;
+		TextParser::Flags parserFlags = TextParser::Urls;
+		if (flags & Html)
+			parserFlags |= TextParser::Html;
 		int lastPos = 0;
-		while (((pos = linkRegExp.indexIn(text, pos)) != -1)) {
-			QString link = linkRegExp.cap(0);
-			while (currentTag < tags.size() && tags.at(currentTag).second < pos)
-				currentTag++;
-			if (currentTag < tags.size()) {
-				const QPair<int, int> &pair = tags.at(currentTag);
-				int left = qBound(pair.first, pos, pair.second);
-				int right = qBound(pair.first, pos + link.size(), pair.second);
-				if (left != right) {
-					pos += link.size();
-					continue;
-				}
+		foreach (const TextParser::Token &token, TextParser::tokenize(text, parserFlags)) {
+			if (token.type != TextParser::Url)
+				continue;
+			const int pos = token.text.position();
+			if (pos != lastPos) {
+				UrlToken tok = { text.midRef(lastPos, pos - lastPos), QString() };
+				result << tok;
 			}
-			UrlToken tok = { text.midRef(lastPos, pos - lastPos), QString() };
-			if (!tok.text.isEmpty()) {
-				if (!result.isEmpty() && result.last().url.isEmpty()) {
-					QStringRef tmp = result.last().text;
-					result.last().text = QStringRef(tmp.string(), tmp.position(), tmp.size() + tok.text.size());
-				} else {
-					result << tok;
-				}
-			}
-			tok.text = text.midRef(pos, link.size());
-			pos += link.size();
-			if (flags & Html)
-				link = unescape(link);
-			if (link.startsWith(QLatin1String("www."), Qt::CaseInsensitive))
-				link.prepend(QLatin1String("http://"));
-			else if(!link.contains(QLatin1String("//")))
-				link.prepend(QLatin1String("mailto:"));
-			tok.url = link;
-			result << tok;
-			lastPos = pos;
-		}
-		if (!result.isEmpty() && result.last().url.isEmpty()) {
-			result.last().text = text.midRef(result.last().text.position());
-		} else {
-			UrlToken tok = { text.midRef(lastPos), QString() };
+			UrlToken tok = { token.text, token.data };
 			result << tok;
+			lastPos = pos + token.text.size();
 		}
+		UrlToken tok = { text.midRef(lastPos), QString() };
+		result << tok;
 		return result;
 	}
 
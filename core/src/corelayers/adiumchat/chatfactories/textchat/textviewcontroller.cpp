@@ -43,6 +43,7 @@
 #include <qutim/thememanager.h>
 #include <qutim/utils.h>
 #include <QTimer>
+#include <algorithm>
 
 using namespace qutim_sdk_0_3;
 
@@ -51,12 +52,17 @@ namespace Core
 namespace AdiumChat
 {
 enum { EmoticonObjectType = 0x666 };
+// Time of the message is stored in format of its first block
+enum { MessageTimeProperty = QTextFormat::UserProperty + 1 };
 
 TextViewController::TextViewController()
 {
+	m_session = 0;
 	m_cache.setMaxCost(40);
 	m_isLastIncoming = false;
 	m_scrollBarPosition = 0;
+	m_canLoadOlder = true;
+	m_loading = false;
 	Config cfg = Config(QLatin1String("appearance")).group(QLatin1String("chat"));
 	m_groupUntil = cfg.value<ushort>(QLatin1String("groupUntil"), 900);
 	cfg.beginGroup(QLatin1String("textview"));
@@ -74,6 +80,10 @@ TextViewController::TextViewController()
 	m_bulletReceivedColor.setNamedColor(cfg.value(QLatin1String("bulletReceivedColor"),
 												  QLatin1String("#00990b")));
 	m_bulletSize = cfg.value("bulletSize", 5);
+	// Zero disables the limit
+	m_maxBlockCount = cfg.value(QLatin1String("maxBlockCount"), 5000);
+	m_limit = m_maxBlockCount;
+	m_pageSize = cfg.value(QLatin1String("historyPageSize"), 50);
 	cfg.beginGroup(QLatin1String("font"));
 #ifdef Q_WS_MAEMO_5
 	m_font.setFamily(cfg.value(QLatin1String("family"), QLatin1String("Nokia Sans")));
@@ -114,17 +124,32 @@ void TextViewController::appendMessage(const qutim_sdk_0_3::Message &msg)
 	QTextCursor cursor(this);
 	cursor.beginEditBlock();
 	bool shouldScroll = isNearBottom();
+	cursor.movePosition(QTextCursor::End);
+	insertMessage(cursor, msg);
+	if (shouldScroll) {
+		// User is back at the bottom, older pages aren't needed anymore
+		m_limit = m_maxBlockCount;
+		QTimer::singleShot(0, this, SLOT(ensureScrolling()));
+	}
+	cursor.endEditBlock();
+	trim();
+}
+
+void TextViewController::insertMessage(QTextCursor &cursor, const qutim_sdk_0_3::Message &msg)
+{
 	QTextCharFormat defaultFormat;
 	defaultFormat.setFont(m_font);
 	defaultFormat.setForeground(m_baseColor);
 	cursor.setCharFormat(defaultFormat);
-	cursor.movePosition(QTextCursor::End);
+	QTextBlockFormat timeFormat;
+	timeFormat.setProperty(MessageTimeProperty, msg.time());
 	QString currentSender = makeName(msg);
 	bool isMe = msg.text().startsWith(QLatin1String("/me "));
 	bool isService = msg.property("service", false);
 	if(isMe || msg.property("action", false)) {
 		QString text = isMe ? msg.text().mid(4) : msg.text();
 		cursor.insertText(QLatin1String("\n"));
+		cursor.mergeBlockFormat(timeFormat);
 		QTextCharFormat format = defaultFormat;
 		format.setFontWeight(QFont::Bold);
 		format.setForeground(msg.isIncoming() ? m_incomingColor : m_outgoingColor);
@@ -143,6 +168,7 @@ void TextViewController::appendMessage(const qutim_sdk_0_3::Message &msg)
 		m_lastSender.clear();
 	} else if (isService) {
 		cursor.insertText(QLatin1String("\n"));
+		cursor.mergeBlockFormat(timeFormat);
 		QTextCharFormat format = defaultFormat;
 		format.setForeground(m_serviceColor);
 		appendText(cursor, msg.text(), format, false);
@@ -150,6 +176,7 @@ void TextViewController::appendMessage(const qutim_sdk_0_3::Message &msg)
 	} else {
 		if (m_isLastIncoming != msg.isIncoming() || currentSender != m_lastSender || shouldBreak(msg.time())) {
 			cursor.insertBlock();
+			cursor.mergeBlockFormat(timeFormat);
 			QTextCharFormat format = defaultFormat;
 			format.setFontWeight(QFont::Bold);
 			format.setForeground(msg.isIncoming() ? m_incomingColor : m_outgoingColor);
@@ -172,6 +199,7 @@ void TextViewController::appendMessage(const qutim_sdk_0_3::Message &msg)
 		m_lastTime = msg.time();
 		m_isLastIncoming = msg.isIncoming();
 		cursor.insertText(QLatin1String("\n"));
+		cursor.mergeBlockFormat(timeFormat);
 		bool showReceived = msg.isIncoming();
 		if (msg.property("history", false))
 			showReceived = true;
@@ -182,9 +210,139 @@ void TextViewController::appendMessage(const qutim_sdk_0_3::Message &msg)
 		cursor.insertText(QLatin1String(" "), defaultFormat);
 		appendText(cursor, msg.text(), defaultFormat, true);
 	}
-	if (shouldScroll)
-		QTimer::singleShot(0, this, SLOT(ensureScrolling()));
+}
+
+void TextViewController::loadOlder()
+{
+	QPointer<ChatUnit> unit = m_session ? m_session->unit() : 0;
+	if (m_loading || !m_canLoadOlder || !unit || !History::instance())
+		return;
+	const QDateTime to = firstTime();
+	if (!to.isValid())
+		return;
+	m_loading = true;
+	History::instance()->read(unit, to, m_pageSize).connect(this, [this, unit] (const MessageList &messages) {
+		m_loading = false;
+		if (messages.size() < m_pageSize)
+			m_canLoadOlder = false;
+		if (!unit)
+			return;
+		MessageList page;
+		page.reserve(messages.size());
+		foreach (Message message, messages) {
+			if (!message.chatUnit())
+				message.setChatUnit(unit);
+			if (message.text().isEmpty() || !message.chatUnit())
+				continue;
+			message.setProperty("history", true);
+			page << message;
+		}
+		if (!page.isEmpty())
+			prependMessages(page);
+	});
+}
+
+void TextViewController::prependMessages(const MessageList &messages)
+{
+	const int oldLength = characterCount();
+	const int oldBlockCount = blockCount();
+	const qreal oldHeight = documentLayout()->documentSize().height();
+	QVector<int> oldSizes;
+	oldSizes.reserve(m_emoticons.size());
+	foreach (const EmoticonTrack &track, m_emoticons)
+		oldSizes << track.movie->indexes.size();
+
+	// Grouping of the page doesn't depend on the end of the chat
+	const QString lastSender = m_lastSender;
+	const QDateTime lastTime = m_lastTime;
+	const bool isLastIncoming = m_isLastIncoming;
+	m_lastSender.clear();
+	m_lastTime = QDateTime();
+	m_isLastIncoming = false;
+
+	QTextCursor cursor(this);
+	cursor.beginEditBlock();
+	cursor.movePosition(QTextCursor::Start);
+	foreach (const Message &message, messages)
+		insertMessage(cursor, message);
 	cursor.endEditBlock();
+
+	m_lastSender = lastSender;
+	m_lastTime = lastTime;
+	m_isLastIncoming = isLastIncoming;
+
+	// Move everything which was at the document before
+	const int delta = characterCount() - oldLength;
+	foreach (qint64 id, m_cache.keys())
+		*m_cache.object(id) += delta;
+	for (int i = 0; i < m_emoticons.size(); ++i) {
+		QVector<int> &indexes = m_emoticons.at(i).movie->indexes;
+		const int oldSize = i < oldSizes.size() ? oldSizes.at(i) : 0;
+		for (int j = 0; j < oldSize; ++j)
+			indexes[j] += delta;
+		// New positions are appended, but they are before the old ones
+		std::rotate(indexes.begin(), indexes.begin() + oldSize, indexes.end());
+	}
+	if (m_maxBlockCount > 0)
+		m_limit += blockCount() - oldBlockCount;
+
+	if (m_textEdit) {
+		QScrollBar *scrollBar = m_textEdit.data()->verticalScrollBar();
+		const qreal height = documentLayout()->documentSize().height();
+		scrollBar->setValue(scrollBar->value() + qRound(height - oldHeight));
+	}
+}
+
+void TextViewController::trim()
+{
+	if (m_limit <= 0)
+		return;
+	// Remove blocks by chunks, layout is too expensive to be done on every message
+	const int count = blockCount();
+	if (count <= m_limit + m_limit / 10)
+		return;
+	const QTextBlock block = findBlockByNumber(count - m_limit);
+	// Keep the first empty block and the separator of the remaining one, so
+	// the document looks like a new one and the first message keeps its format
+	const int cut = block.position() - 1;
+	if (cut <= 0)
+		return;
+	const qreal cutHeight = documentLayout()->blockBoundingRect(block).top();
+	QTextCursor cursor(this);
+	cursor.setPosition(0);
+	cursor.setPosition(cut, QTextCursor::KeepAnchor);
+	cursor.removeSelectedText();
+
+	foreach (qint64 id, m_cache.keys()) {
+		int *pos = m_cache.object(id);
+		if (*pos < cut)
+			m_cache.remove(id);
+		else
+			*pos -= cut;
+	}
+	for (int i = 0; i < m_emoticons.size(); ++i) {
+		QVector<int> &indexes = m_emoticons.at(i).movie->indexes;
+		const int removed = std::lower_bound(indexes.begin(), indexes.end(), cut) - indexes.begin();
+		indexes.remove(0, removed);
+		for (int j = 0; j < indexes.size(); ++j)
+			indexes[j] -= cut;
+	}
+	m_canLoadOlder = true;
+
+	if (m_textEdit && !isNearBottom()) {
+		QScrollBar *scrollBar = m_textEdit.data()->verticalScrollBar();
+		scrollBar->setValue(scrollBar->value() - qRound(cutHeight));
+	}
+}
+
+QDateTime TextViewController::firstTime() const
+{
+	for (QTextBlock block = begin(); block.isValid(); block = block.next()) {
+		const QTextBlockFormat format = block.blockFormat();
+		if (format.hasProperty(MessageTimeProperty))
+			return format.property(MessageTimeProperty).toDateTime();
+	}
+	return QDateTime();
 }
 
 void TextViewController::appendText(QTextCursor &cursor, const QString &text,
@@ -204,29 +362,11 @@ void TextViewController::appendText(QTextCursor &cursor, const QString &text,
 			continue;
 		}
 		const QList<EmoticonsTheme::Token> tokens = Emoticons::theme().tokenize(textToken.text.toString());
-		QString objectReplacement(QChar::ObjectReplacementCharacter);
-		QTextCharFormat emoticonFormat;
-		emoticonFormat.setObjectType(EmoticonObjectType);
-		int emoticonIndex;
 		for (int i = 0; i < tokens.size(); i++) {
 			const EmoticonsTheme::Token &token = tokens.at(i);
 			switch(token.type) {
 			case EmoticonsTheme::Image:
-				if (m_animateEmoticons) {
-					emoticonIndex = addEmoticon(token.imgPath);
-					emoticonFormat.setProperty(QTextFormat::UserProperty, emoticonIndex);
-					m_emoticons.at(emoticonIndex).movie->indexes << cursor.position();
-					cursor.insertText(objectReplacement, emoticonFormat);
-				} else {
-					if (!m_images.contains(token.imgPath)) {
-						addResource(ImageResource, QUrl(token.imgPath), QPixmap(token.imgPath));
-						m_images.insert(token.imgPath);
-					}
-					QTextImageFormat imageFormat;
-					imageFormat.setName(token.imgPath);
-					imageFormat.setToolTip(token.text);
-					cursor.insertImage(imageFormat);
-				}
+				insertEmoticon(cursor, token.imgPath, token.text);
 				break;
 			case EmoticonsTheme::Text:
 				cursor.insertText(token.text, format);
@@ -237,6 +377,27 @@ void TextViewController::appendText(QTextCursor &cursor, const QString &text,
 	}
 }
 
+void TextViewController::insertEmoticon(QTextCursor &cursor, const QString &imgPath, const QString &text)
+{
+	if (m_animateEmoticons) {
+		QTextCharFormat emoticonFormat;
+		emoticonFormat.setObjectType(EmoticonObjectType);
+		int emoticonIndex = addEmoticon(imgPath);
+		emoticonFormat.setProperty(QTextFormat::UserProperty, emoticonIndex);
+		m_emoticons.at(emoticonIndex).movie->indexes << cursor.position();
+		cursor.insertText(QString(QChar::ObjectReplacementCharacter), emoticonFormat);
+	} else {
+		if (!m_images.contains(imgPath)) {
+			addResource(ImageResource, QUrl(imgPath), QPixmap(imgPath));
+			m_images.insert(imgPath);
+		}
+		QTextImageFormat imageFormat;
+		imageFormat.setName(imgPath);
+		imageFormat.setToolTip(text);
+		cursor.insertImage(imageFormat);
+	}
+}
+
 bool TextViewController::isNearBottom()
 {
 	if (!m_textEdit)
@@ -320,6 +481,12 @@ void TextViewController::onAnchorClicked(const QUrl &url)
 	}
 }
 
+void TextViewController::onScrollBarValueChanged(int value)
+{
+	if (value == 0)
+		loadOlder();
+}
+
 void TextViewController::animate()
 {
 	EmoticonMovie *movie = static_cast<EmoticonMovie*>(sender());
@@ -379,6 +546,8 @@ void TextViewController::init()
 	m_lastSender.clear();
 	m_lastTime = QDateTime();
 	m_isLastIncoming = false;
+	m_limit = m_maxBlockCount;
+	m_canLoadOlder = true;
 }
 
 void TextViewController::loadHistory()
@@ -427,11 +596,15 @@ QString TextViewController::quote()
 
 void TextViewController::setTextEdit(QTextBrowser *edit)
 {
-	if (m_textEdit)
+	if (m_textEdit) {
 		disconnect(m_textEdit.data(), 0, this, 0);
+		disconnect(m_textEdit.data()->verticalScrollBar(), 0, this, 0);
+	}
 	m_textEdit = edit;
 	if (m_textEdit) {
 		connect(m_textEdit.data(), SIGNAL(anchorClicked(QUrl)), this, SLOT(onAnchorClicked(QUrl)));
+		connect(m_textEdit.data()->verticalScrollBar(), SIGNAL(valueChanged(int)),
+				this, SLOT(onScrollBarValueChanged(int)));
 		QPalette p = m_textEdit.data()->viewport()->palette();
 		p.setColor(QPalette::Base, m_backgroundColor);
 		m_textEdit.data()->viewport()->setPalette(p);
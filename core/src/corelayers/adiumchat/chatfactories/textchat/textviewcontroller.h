@@ -35,6 +35,8 @@
 #include <QTextObjectInterface>
 #include <QMovie>
 
+class TestTextViewController;
+
 namespace Core
 {
 namespace AdiumChat
@@ -71,13 +73,15 @@ public:
 	virtual qutim_sdk_0_3::ChatSession *getSession() const;
 	virtual void appendMessage(const qutim_sdk_0_3::Message &msg);
 	void appendText(QTextCursor &cursor, const QString &text, const QTextCharFormat &format, bool emo);
+	void insertEmoticon(QTextCursor &cursor, const QString &imgPath, const QString &text);
 	virtual void clearChat();
 	virtual QString quote();
 	void setTextEdit(QTextBrowser *edit);
 	int scrollBarPosition() const { return m_scrollBarPosition; }
 	void setScrollBarPosition(int pos) { m_scrollBarPosition = pos; }
 	bool isNearBottom();
-
+	bool canLoadOlder() const { return m_canLoadOlder; }
+	void loadOlder();
 
 	// From QTextObjectInterface
 	virtual void drawObject(QPainter *painter, const QRectF &rect, QTextDocument *doc,
@@ -89,11 +93,17 @@ public slots:
 	void ensureScrolling();
 protected slots:
 	void onAnchorClicked(const QUrl &url);
+	void onScrollBarValueChanged(int value);
 	void animate();
 private:
+	friend class ::TestTextViewController;
 	QPixmap createBullet(const QColor &color);
 	void init();
 	void loadHistory();
+	void insertMessage(QTextCursor &cursor, const qutim_sdk_0_3::Message &msg);
+	void prependMessages(const qutim_sdk_0_3::MessageList &messages);
+	void trim();
+	QDateTime firstTime() const;
 	int addEmoticon(const QString &filename);
 	QString makeName(const qutim_sdk_0_3::Message &mes);
 	bool shouldBreak(const QDateTime &time);
@@ -108,6 +118,12 @@ private:
 	bool m_atAnimation;
 	short m_groupUntil;
 	int m_scrollBarPosition;
+	// Maximum count of blocks, it's extended while user reads older messages
+	int m_maxBlockCount;
+	int m_limit;
+	int m_pageSize;
+	bool m_canLoadOlder;
+	bool m_loading;
 	int m_bulletSize;
 	QFont m_font;
 	QColor m_backgroundColor;
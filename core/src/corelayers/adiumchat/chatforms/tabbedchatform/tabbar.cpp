@@ -426,7 +426,7 @@ bool TabBar::event(QEvent *event)
 
 void TabBar::chatStateChanged(ChatUnit::ChatState state, ChatSessionImpl *session)
 {
-	if(session->unread().count())
+	if(session->unreadCount())
 		return;
 	QIcon icon = ChatLayerImpl::iconForState(state, session->getUnit());
 	setSessionIcon(session, icon);
@@ -434,7 +434,7 @@ void TabBar::chatStateChanged(ChatUnit::ChatState state, ChatSessionImpl *sessio
 
 void TabBar::statusChanged(const Status &status, ChatSessionImpl *session)
 {
-	if(session->unread().count())
+	if(session->unreadCount())
 		return;
 	setSessionIcon(session, status.icon());
 }
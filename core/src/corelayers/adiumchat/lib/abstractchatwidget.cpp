@@ -67,8 +67,8 @@ void AbstractChatWidget::setTitle(ChatSessionImpl *s)
 	if (customIcon)
 		icon = Icon("view-choose");
 	QString title;
-	if(s->unread().count())
-		title = tr("Chat with %1 (have %2 unread messages)").arg(u->title()).arg(s->unread().count());
+	if(s->unreadCount())
+		title = tr("Chat with %1 (have %2 unread messages)").arg(u->title()).arg(s->unreadCount());
 	else
 		title = tr("Chat with %1").arg(u->title());
 	if (Conference *c = qobject_cast<Conference *>(u)) {
@@ -95,8 +95,8 @@ QString AbstractChatWidget::titleForSession(ChatSessionImpl *s)
 	ChatUnit *u = s->getUnit();
 	QString title;
 
-	if(s->unread().count())
-		title = tr("Chat with %1 (have %2 unread messages)").arg(u->title()).arg(s->unread().count());
+	if(s->unreadCount())
+		title = tr("Chat with %1 (have %2 unread messages)").arg(u->title()).arg(s->unreadCount());
 	else
 		title = tr("Chat with %1").arg(u->title());
 
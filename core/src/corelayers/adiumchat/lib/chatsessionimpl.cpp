@@ -69,6 +69,7 @@ ChatSessionImpl::ChatSessionImpl(ChatUnit* unit, ChatLayer* chat)
 	d->lastMessagesIndex = 0;
 	Config cfg = Config("appearance").group("chat");
 	d->sendToLastActiveResource = cfg.value("sendToLastActiveResource", false);
+	d->unread.setMemoryLimit(cfg.value("unreadMemoryLimit", 200));
 	d->inactive_timer.setSingleShot(true);
 
 	connect(&d->inactive_timer,SIGNAL(timeout()),d,SLOT(onActiveTimeout()));
@@ -126,8 +127,7 @@ void ChatSessionImpl::doAppendMessage(Message &message)
 	if ((!isActive() && !message.property("service", false))
 			&& message.isIncoming()
 			&& !message.property("history", false)) {
-		d->unread.append(message);
-		emit unreadChanged(d->unread);
+		d->emitUnreadChanged(d->unread.append(message));
 	}
 
 	//if (!message.isIncoming())
@@ -291,22 +291,51 @@ void ChatSessionImpl::markRead(quint64 id)
 	Q_D(ChatSessionImpl);
 	if (id == Q_UINT64_C(0xffffffffffffffff)) {
 		d->unread.clear();
-		unreadChanged(d->unread);
+		d->emitUnreadChanged(true);
+		emit unreadMarked(id);
 		return;
 	}
-	MessageList::iterator it = d->unread.begin();
-	for (; it != d->unread.end(); it++) {
-		if (it->id() == id) {
-			d->unread.erase(it);
-			unreadChanged(d->unread);
-			return;
-		}
+	bool inMemory;
+	if (d->unread.remove(id, &inMemory)) {
+		d->emitUnreadChanged(inMemory);
+		emit unreadMarked(id);
 	}
 }
 
 MessageList ChatSessionImpl::unread() const
 {
-	return d_func()->unread;
+	return d_func()->unread.messages();
+}
+
+void ChatSessionImplPrivate::emitUnreadChanged(bool headChanged)
+{
+	Q_Q(ChatSessionImpl);
+	// Full list may be huge, so only its in-memory head is sent and only
+	// when it's changed. Count is sent every time
+	if (headChanged)
+		emit q->unreadChanged(unread.messages(0, unread.memoryCount()));
+	emit q->unreadCountChanged(unread.count());
+}
+
+void ChatSessionImpl::virtual_hook(int id, void *data)
+{
+	Q_D(ChatSessionImpl);
+	switch (id) {
+	case UnreadCountHook:
+		*reinterpret_cast<int*>(data) = d->unread.count();
+		break;
+	case UnreadRangeHook: {
+		UnreadRangeArgument &argument = *reinterpret_cast<UnreadRangeArgument*>(data);
+		argument.messages = d->unread.messages(argument.offset, argument.count);
+		break;
+	}
+	case AddContactsHook:
+		d->model.data()->addContacts(*reinterpret_cast<QList<Buddy*>*>(data));
+		emit buddiesChanged();
+		break;
+	default:
+		ChatSession::virtual_hook(id, data);
+	}
 }
 
 void ChatSessionImpl::setChatUnit(ChatUnit* unit)
@@ -317,6 +346,7 @@ void ChatSessionImpl::setChatUnit(ChatUnit* unit)
 	ChatUnit *oldUnit = d->chatUnit.data();
 	static_cast<ChatLayerImpl*>(ChatLayer::instance())->onUnitChanged(oldUnit, unit);
 	d->chatUnit = unit;
+	d->unread.setUnit(unit);
 	connect(unit,SIGNAL(destroyed(QObject*)),SLOT(deleteLater()));
 	setParent(unit);
 
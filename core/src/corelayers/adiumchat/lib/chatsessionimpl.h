@@ -81,6 +81,8 @@ public:
 	bool isJavaScriptSupported() const;
 	void onInitialHistoryLoaded(const MessageList & messagelist);
 	void appendAwaitingMessages();
+protected:
+	virtual void virtual_hook(int id, void *data);
 signals:
 	void buddiesChanged();
 	void chatUnitChanged(qutim_sdk_0_3::ChatUnit *);
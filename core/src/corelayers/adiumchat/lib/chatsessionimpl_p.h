@@ -32,6 +32,7 @@
 #include <qutim/message.h>
 #include <qutim/status.h>
 #include <qutim/chatunit.h>
+#include "unreadstore.h"
 
 class QMenu;
 class QTextDocument;
@@ -72,6 +73,7 @@ public:
 	virtual ~ChatSessionImplPrivate();
 	void fillMenu(QMenu *menu, ChatUnit *unit, const ChatUnitList &lowerUnits, bool root = true);
 	ChatViewController *getController();
+	void emitUnreadChanged(bool headChanged);
 	void ensureController();
 	QPointer<QObject> controller;
 	QPointer<ChatUnit> chatUnit;
@@ -87,7 +89,7 @@ public:
 	qint8 focus;
 	qint8 lastMessagesIndex;
 	QTimer inactive_timer;
-	MessageList unread;
+	UnreadStore unread;
 	MessageList lastMessages;
 	MessageList awaitingMessages;
 	HistoryStatus fetchingHistory = Fetching;
@@ -26,6 +26,9 @@
 
 #include "chatsessionmodel.h"
 #include <QMetaMethod>
+#include <QSet>
+#include <algorithm>
+#include <iterator>
 
 namespace Core
 {
@@ -75,7 +78,48 @@ void ChatSessionModel::addContact(Buddy *unit)
 	int index = it - m_units.begin();
 	beginInsertRows(QModelIndex(), index, index);
 	m_units.insert(index, unit);
+	watch(unit);
+	endInsertRows();
+}
 
+void ChatSessionModel::addContacts(const QList<Buddy*> &contacts)
+{
+	QSet<Buddy*> known;
+	foreach (const Node &node, m_units)
+		known.insert(node.unit);
+	QList<Node> nodes;
+	nodes.reserve(contacts.size());
+	foreach (Buddy *unit, contacts) {
+		if (known.contains(unit))
+			continue;
+		known.insert(unit);
+		nodes << Node(unit);
+	}
+	if (nodes.isEmpty())
+		return;
+	std::sort(nodes.begin(), nodes.end());
+	if (m_units.isEmpty()) {
+		beginInsertRows(QModelIndex(), 0, nodes.size() - 1);
+		m_units.swap(nodes);
+		foreach (const Node &node, m_units)
+			watch(node.unit);
+		endInsertRows();
+		return;
+	}
+	// Rows are spread over the whole list, so a reset is cheaper than
+	// lots of separate insertions
+	beginResetModel();
+	foreach (const Node &node, nodes)
+		watch(node.unit);
+	QList<Node> units;
+	units.reserve(m_units.size() + nodes.size());
+	std::merge(m_units.begin(), m_units.end(), nodes.begin(), nodes.end(), std::back_inserter(units));
+	m_units.swap(units);
+	endResetModel();
+}
+
+void ChatSessionModel::watch(Buddy *unit)
+{
 	auto unitMeta = unit->metaObject();
 	int funcIndex = unitMeta->indexOfProperty("priority");
 	QMetaProperty priorityProperty = unitMeta->property(funcIndex);
@@ -90,7 +134,6 @@ void ChatSessionModel::addContact(Buddy *unit)
 			this, SLOT(onStatusChanged(qutim_sdk_0_3::Status)));
 	connect(unit, SIGNAL(destroyed(QObject*)),
 			this, SLOT(onContactDestroyed(QObject*)));
-	endInsertRows();
 }
 
 void ChatSessionModel::removeContact(Buddy *unit)
@@ -61,6 +61,7 @@ public:
 	virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
 	virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
 	void addContact(qutim_sdk_0_3::Buddy *c);
+	void addContacts(const QList<qutim_sdk_0_3::Buddy*> &contacts);
 	void removeContact(qutim_sdk_0_3::Buddy *c);
 private slots:
 	void onNameChanged(const QString &title, const QString &oldTitle);
@@ -68,6 +69,7 @@ private slots:
 	void onContactDestroyed(QObject *obj);
 	void onPriorityChanged(const int &oldPriority, const int &newPriority);
 private:
+	void watch(qutim_sdk_0_3::Buddy *unit);
 	struct Node {
 		Node(qutim_sdk_0_3::Buddy *u, const QString &t) : title(t), unit(u) {}
 		Node(qutim_sdk_0_3::Buddy *u) : title(u->title()), unit(u) {}
@@ -199,7 +199,7 @@ bool SessionListWidget::event(QEvent *event)
 
 void SessionListWidget::chatStateChanged(ChatUnit::ChatState state, ChatSessionImpl *session)
 {
-	if(session->unread().count())
+	if(session->unreadCount())
 		return;
 	QIcon icon = ChatLayerImpl::iconForState(state,session->getUnit());
 	if(Buddy *b = qobject_cast<Buddy*>(session->unit()))
@@ -0,0 +1,228 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+
+#include "unreadstore.h"
+#include <qutim/account.h>
+#include <qutim/protocol.h>
+#include <qutim/systeminfo.h>
+#include <qutim/cryptoservice.h>
+#include <qutim/debug.h>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+
+namespace Core
+{
+namespace AdiumChat
+{
+
+UnreadStore::UnreadStore() : m_memoryLimit(200)
+{
+}
+
+UnreadStore::~UnreadStore()
+{
+	if (m_file.isOpen()) {
+		m_file.close();
+		m_file.remove();
+	}
+}
+
+void UnreadStore::setUnit(ChatUnit *unit)
+{
+	m_unit = unit;
+	if (!unit || !unit->account())
+		return;
+	Account *account = unit->account();
+	const QString key = account->protocol()->id() + QLatin1Char('/')
+			+ account->id() + QLatin1Char('/') + unit->id();
+	const QString path = SystemInfo::getPath(SystemInfo::HistoryDir) + QLatin1String("/unread/")
+			+ QLatin1String(QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Md5).toHex());
+	if (path == m_path)
+		return;
+	// Messages which are already spilled stay in the old file
+	if (m_file.isOpen() && m_messages.size() == m_index.size())
+		resetFile();
+	if (!m_file.isOpen())
+		m_path = path;
+}
+
+void UnreadStore::setMemoryLimit(int limit)
+{
+	m_memoryLimit = qMax(1, limit);
+}
+
+bool UnreadStore::append(const Message &message)
+{
+	const quint64 id = message.id();
+	if (m_index.contains(id))
+		return m_messages.contains(id);
+
+	Entry entry = { id, -1 };
+	// Spilled messages are always the tail, so first ones are cheap to get
+	if (m_messages.size() == m_index.size() && m_messages.size() < m_memoryLimit) {
+		m_messages.insert(id, message);
+	} else if (openFile()) {
+		const QByteArray data = CryptoService::toStorageData(serialize(message));
+		entry.offset = m_file.size();
+		m_file.seek(entry.offset);
+		QDataStream out(&m_file);
+		out << data;
+		if (out.status() != QDataStream::Ok) {
+			qWarning() << "Failed to spill unread message to" << m_file.fileName();
+			entry.offset = -1;
+		}
+	}
+	if (entry.offset == -1)
+		m_messages.insert(id, message);
+	m_index.insert(id, m_entries.insert(m_entries.end(), entry));
+	return entry.offset == -1;
+}
+
+bool UnreadStore::remove(quint64 id, bool *inMemory)
+{
+	QHash<quint64, EntryList::iterator>::iterator it = m_index.find(id);
+	if (it == m_index.end())
+		return false;
+	m_entries.erase(it.value());
+	m_index.erase(it);
+	const bool memory = m_messages.remove(id) > 0;
+	if (inMemory)
+		*inMemory = memory;
+	if (m_messages.size() == m_index.size() && m_file.isOpen())
+		resetFile();
+	return true;
+}
+
+void UnreadStore::clear()
+{
+	m_entries.clear();
+	m_index.clear();
+	m_messages.clear();
+	if (m_file.isOpen())
+		resetFile();
+}
+
+MessageList UnreadStore::messages(int offset, int count) const
+{
+	MessageList result;
+	if (offset < 0 || offset >= m_index.size())
+		return result;
+	if (count < 0 || count > m_index.size() - offset)
+		count = m_index.size() - offset;
+	result.reserve(count);
+
+	EntryList::const_iterator it = m_entries.constBegin();
+	for (int i = 0; i < offset; ++i)
+		++it;
+	for (; count > 0; --count, ++it) {
+		if (it->offset == -1) {
+			result << m_messages.value(it->id);
+			continue;
+		}
+		QByteArray data;
+		m_file.seek(it->offset);
+		QDataStream in(&m_file);
+		in >> data;
+		result << deserialize(CryptoService::fromStorageData(data), it->id);
+	}
+	return result;
+}
+
+bool UnreadStore::openFile()
+{
+	if (m_file.isOpen())
+		return true;
+	if (m_path.isEmpty())
+		return false;
+	QDir().mkpath(QFileInfo(m_path).absolutePath());
+	m_file.setFileName(m_path);
+	if (!m_file.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+		qWarning() << "Can't open" << m_path << m_file.errorString();
+		return false;
+	}
+	return true;
+}
+
+void UnreadStore::resetFile()
+{
+	m_file.close();
+	m_file.remove();
+}
+
+QByteArray UnreadStore::serialize(const Message &message) const
+{
+	QByteArray data;
+	QDataStream out(&data, QIODevice::WriteOnly);
+	out << message.text() << message.html() << message.time() << message.isIncoming();
+	out << (message.chatUnit() ? message.chatUnit()->id() : QString());
+	QList<QByteArray> names;
+	QList<QVariant> values;
+	foreach (const QByteArray &name, message.dynamicPropertyNames()) {
+		const QVariant value = message.property(name.constData());
+		const int type = value.userType();
+		// Pointers and custom types can't be restored from the disk
+		if (type >= QMetaType::User || type == QMetaType::QObjectStar || type == QMetaType::VoidStar)
+			continue;
+		names << name;
+		values << value;
+	}
+	out << names << values;
+	return data;
+}
+
+Message UnreadStore::deserialize(const QByteArray &data, quint64 id) const
+{
+	QDataStream in(data);
+	QString text;
+	QString html;
+	QDateTime time;
+	bool incoming;
+	QString unitId;
+	QList<QByteArray> names;
+	QList<QVariant> values;
+	in >> text >> html >> time >> incoming >> unitId >> names >> values;
+
+	Message message(text);
+	message.setHtml(html);
+	message.setTime(time);
+	message.setIncoming(incoming);
+	ChatUnit *unit = m_unit.data();
+	if (unit && unit->id() != unitId && unit->account()) {
+		if (ChatUnit *source = unit->account()->getUnit(unitId, false))
+			unit = source;
+	}
+	message.setChatUnit(unit);
+	for (int i = 0; i < names.size() && i < values.size(); ++i)
+		message.setProperty(names.at(i).constData(), values.at(i));
+	// Restored message has a new id, the original one is needed for markRead
+	message.setProperty("unreadId", id);
+	return message;
+}
+
+}
+}
@@ -0,0 +1,93 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+
+#ifndef UNREADSTORE_H
+#define UNREADSTORE_H
+
+#include <QLinkedList>
+#include <QHash>
+#include <QFile>
+#include <QPointer>
+#include <qutim/message.h>
+
+namespace Core
+{
+namespace AdiumChat
+{
+
+using namespace qutim_sdk_0_3;
+
+// Unread messages of the session in arrival order. First memoryLimit()
+// messages are kept in memory, the rest are spilled to the file of the session
+// and are read back only on request.
+class UnreadStore
+{
+	Q_DISABLE_COPY(UnreadStore)
+public:
+	UnreadStore();
+	~UnreadStore();
+
+	void setUnit(ChatUnit *unit);
+	int memoryLimit() const { return m_memoryLimit; }
+	void setMemoryLimit(int limit);
+
+	// Returns true if the message is kept in memory
+	bool append(const Message &message);
+	// Returns false if there is no message with such id, O(1)
+	bool remove(quint64 id, bool *inMemory = 0);
+	void clear();
+
+	int count() const { return m_index.size(); }
+	int memoryCount() const { return m_messages.size(); }
+	bool isEmpty() const { return m_index.isEmpty(); }
+	MessageList messages(int offset = 0, int count = -1) const;
+
+private:
+	struct Entry
+	{
+		quint64 id;
+		qint64 offset; // -1 for messages in memory
+	};
+	typedef QLinkedList<Entry> EntryList;
+
+	bool openFile();
+	void resetFile();
+	QByteArray serialize(const Message &message) const;
+	Message deserialize(const QByteArray &data, quint64 id) const;
+
+	EntryList m_entries;
+	QHash<quint64, EntryList::iterator> m_index;
+	QHash<quint64, Message> m_messages;
+	int m_memoryLimit;
+	QPointer<ChatUnit> m_unit;
+	QString m_path;
+	mutable QFile m_file;
+};
+
+}
+}
+
+#endif // UNREADSTORE_H
@@ -25,36 +25,190 @@
 
 #include "chatspellchecker.h"
 #include <qutim/servicemanager.h>
+#include <qutim/config.h>
 #include <QTextEdit>
 #include <QPlainTextEdit>
 #include <QContextMenuEvent>
+#include <QElapsedTimer>
 
 namespace Core {
 
+// Time given to the speller per iteration of the event loop
+enum { CheckBudget = 10 };
+
+SpellCache *SpellCache::instance()
+{
+	static SpellCache cache;
+	return &cache;
+}
+
+SpellCache::SpellCache() : m_cacheSize(20000), m_cache(0)
+{
+	m_timer.setInterval(0);
+	m_timer.setSingleShot(true);
+	connect(&m_timer, SIGNAL(timeout()), SLOT(processQueue()));
+}
+
+void SpellCache::setSpellChecker(SpellChecker *speller)
+{
+	if (m_speller == speller)
+		return;
+	clear();
+	m_speller = speller;
+}
+
+void SpellCache::setLanguage(const QString &language)
+{
+	if (m_language == language)
+		return;
+	m_language = language;
+	// Queued words are checked by the previous dictionary, so drop them
+	m_cache = 0;
+	m_queue.clear();
+	m_queued.clear();
+}
+
+QCache<QString, bool> *SpellCache::cache()
+{
+	if (!m_cache) {
+		m_cache = m_caches.value(m_language);
+		if (!m_cache) {
+			m_cache = new QCache<QString, bool>(m_cacheSize);
+			m_caches.insert(m_language, m_cache);
+		}
+	}
+	return m_cache;
+}
+
+SpellCache::Result SpellCache::check(const QString &word)
+{
+	if (bool *correct = cache()->object(word))
+		return *correct ? Correct : Misspelled;
+	if (!m_speller)
+		return Correct;
+	if (!m_queued.contains(word)) {
+		m_queued.insert(word);
+		m_queue.enqueue(word);
+		if (!m_timer.isActive())
+			m_timer.start();
+	}
+	return Unknown;
+}
+
+bool SpellCache::isCorrect(const QString &word)
+{
+	if (bool *correct = cache()->object(word))
+		return *correct;
+	if (!m_speller)
+		return true;
+	const bool correct = m_speller->isCorrect(word);
+	cache()->insert(word, new bool(correct));
+	return correct;
+}
+
+void SpellCache::store(const QString &word)
+{
+	if (m_speller)
+		m_speller->store(word);
+	cache()->insert(word, new bool(true));
+}
+
+void SpellCache::processQueue()
+{
+	if (!m_speller) {
+		m_queue.clear();
+		m_queued.clear();
+		return;
+	}
+	QElapsedTimer timer;
+	timer.start();
+	QCache<QString, bool> *words = cache();
+	while (!m_queue.isEmpty() && timer.elapsed() < CheckBudget) {
+		const QString word = m_queue.dequeue();
+		m_queued.remove(word);
+		words->insert(word, new bool(m_speller->isCorrect(word)));
+	}
+	if (!m_queue.isEmpty())
+		m_timer.start();
+	emit wordsChecked();
+}
+
+void SpellCache::clear()
+{
+	qDeleteAll(m_caches);
+	m_caches.clear();
+	m_cache = 0;
+	m_queue.clear();
+	m_queued.clear();
+}
+
 SpellHighlighter::SpellHighlighter(QTextDocument *doc) : QSyntaxHighlighter(doc)
 {
 	m_format.setUnderlineStyle(QTextCharFormat::SpellCheckUnderline);
 	m_format.setUnderlineColor(Qt::red);
+	connect(SpellCache::instance(), SIGNAL(wordsChecked()), SLOT(onWordsChecked()));
+}
+
+static inline bool isWordCharacter(const QChar &ch)
+{
+	// Same as \w of QRegExp
+	return ch.isLetterOrNumber() || ch.isMark() || ch == QLatin1Char('_');
 }
 
 void SpellHighlighter::highlightBlock(const QString &text)
 {
-	if (!m_speller)
+	SpellCache *cache = SpellCache::instance();
+	if (!cache->spellChecker())
 		return;
 
-	static QRegExp expression(QLatin1String("\\b\\w+\\b"));
+	bool pending = false;
+	const int size = text.size();
+	const QChar *data = text.constData();
+	for (int index = 0; index < size;) {
+		if (!isWordCharacter(data[index])) {
+			++index;
+			continue;
+		}
+		int end = index + 1;
+		while (end < size && isWordCharacter(data[end]))
+			++end;
+		// The word outlives the block text in the queue and the cache
+		const QString word = text.mid(index, end - index);
+		switch (cache->check(word)) {
+		case SpellCache::Misspelled:
+			setFormat(index, end - index, m_format);
+			break;
+		case SpellCache::Unknown:
+			pending = true;
+			break;
+		default:
+			break;
+		}
+		index = end;
+	}
+	if (pending)
+		m_pending << currentBlock();
+}
 
-	int index = text.indexOf(expression);
-	while (index >= 0) {
-		int length = expression.matchedLength();
-		if (!m_speller->isCorrect(expression.cap(0)))
-			setFormat(index, length, m_format);
-		index = text.indexOf(expression, index + length);
+void SpellHighlighter::onWordsChecked()
+{
+	if (m_pending.isEmpty())
+		return;
+	QList<QTextBlock> blocks;
+	blocks.swap(m_pending);
+	QSet<int> used;
+	foreach (const QTextBlock &block, blocks) {
+		if (block.isValid() && block.document() == document() && !used.contains(block.blockNumber())) {
+			used.insert(block.blockNumber());
+			rehighlightBlock(block);
+		}
 	}
 }
 
 ChatSpellChecker::ChatSpellChecker() : m_chatForm("ChatForm")
 {
+	SpellCache::instance()->setSpellChecker(m_speller);
+	loadSettings();
 	if (m_speller)
 		connect(m_speller, SIGNAL(dictionaryChanged()), SLOT(onDictionaryChanged()));
 	connect(ChatLayer::instance(), SIGNAL(sessionCreated(qutim_sdk_0_3::ChatSession*)),
@@ -63,6 +217,14 @@ ChatSpellChecker::ChatSpellChecker() : m_chatForm("ChatForm")
 			SLOT(onServiceChanged(QByteArray)));
 }
 
+void ChatSpellChecker::loadSettings()
+{
+	Config cfg = Config().group(QStringLiteral("speller"));
+	SpellCache *cache = SpellCache::instance();
+	cache->setCacheSize(cfg.value(QStringLiteral("cacheSize"), 20000));
+	cache->setLanguage(cfg.value(QStringLiteral("language"), QString()));
+}
+
 void ChatSpellChecker::onSessionCreated(qutim_sdk_0_3::ChatSession *session)
 {
 	Q_ASSERT(session);
@@ -149,7 +311,7 @@ void ChatSpellChecker::onTextEditContextMenuRequested(const QPoint &pos)
 			}
 		}
 
-		if (!m_word.isEmpty() && !m_speller->isCorrect(m_word)) {
+		if (!m_word.isEmpty() && !SpellCache::instance()->isCorrect(m_word)) {
 			QAction *before = !menu->actions().isEmpty() ? menu->actions().first() : 0;
 			Q_ASSERT(m_speller);
 			foreach (const QString &suggestion, m_speller->suggest(m_word).mid(0, 5))
@@ -179,7 +341,7 @@ void ChatSpellChecker::onAddToDictionaryTriggered()
 {
 	if (!m_speller)
 		return;
-	m_speller->store(m_word);
+	SpellCache::instance()->store(m_word);
 	SpellHighlighter *highlighter = m_highlighters.value(m_cursor.document());
 	Q_ASSERT(highlighter);
 	highlighter->rehighlightBlock(m_cursor.block());
@@ -187,6 +349,8 @@ void ChatSpellChecker::onAddToDictionaryTriggered()
 
 void ChatSpellChecker::onDictionaryChanged()
 {
+	// Dictionary is reloaded when the language is changed
+	loadSettings();
 	foreach (SpellHighlighter *highlighter, m_highlighters)
 		highlighter->rehighlight();
 }
@@ -196,6 +360,8 @@ void ChatSpellChecker::onServiceChanged(const QByteArray &name)
 	if (name != "SpellChecker")
 		return;
 	connect(m_speller, SIGNAL(dictionaryChanged()), SLOT(onDictionaryChanged()));
+	SpellCache::instance()->setSpellChecker(m_speller);
+	loadSettings();
 	foreach (SpellHighlighter *highlighter, m_highlighters)
 		highlighter->rehighlight();
 }
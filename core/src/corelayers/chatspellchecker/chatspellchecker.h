@@ -34,6 +34,12 @@
 #include <QSyntaxHighlighter>
 #include <QTextCursor>
 #include <QMetaMethod>
+#include <QCache>
+#include <QPointer>
+#include <QQueue>
+#include <QTimer>
+#include <QSet>
+#include <QTextBlock>
 
 namespace Core {
 
@@ -41,15 +47,62 @@ using namespace qutim_sdk_0_3;
 
 class ChatSpellChecker;
 
+// Results of the spell checker shared by all inputs. Words which are not
+// cached yet are checked in small portions from the event loop, so typing
+// and pasting never wait for the speller.
+class SpellCache : public QObject
+{
+	Q_OBJECT
+public:
+	enum Result { Correct, Misspelled, Unknown };
+
+	static SpellCache *instance();
+
+	// Drops all cached results, they are meaningless for another speller
+	void setSpellChecker(SpellChecker *speller);
+	SpellChecker *spellChecker() const { return m_speller; }
+	// Switches to the cache of the \a language, results of other ones are kept
+	void setLanguage(const QString &language);
+	QString language() const { return m_language; }
+	void setCacheSize(int size) { m_cacheSize = size; }
+
+	// Returns Unknown and schedules the check if the word isn't cached
+	Result check(const QString &word);
+	// Checks the word synchronously if it's not cached
+	bool isCorrect(const QString &word);
+	void store(const QString &word);
+	void clear();
+signals:
+	void wordsChecked();
+private slots:
+	void processQueue();
+private:
+	SpellCache();
+	QCache<QString, bool> *cache();
+
+	QPointer<SpellChecker> m_speller;
+	QString m_language;
+	int m_cacheSize;
+	// Every language has its own cache, so switching between them is cheap
+	QHash<QString, QCache<QString, bool>*> m_caches;
+	QCache<QString, bool> *m_cache;
+	QQueue<QString> m_queue;
+	QSet<QString> m_queued;
+	QTimer m_timer;
+};
+
 class SpellHighlighter : public QSyntaxHighlighter
 {
 	Q_OBJECT
 public:
 	explicit SpellHighlighter(QTextDocument *doc);
 	virtual void highlightBlock(const QString &text);
+private slots:
+	void onWordsChecked();
 private:
-	qutim_sdk_0_3::ServicePointer<SpellChecker> m_speller;
 	QTextCharFormat m_format;
+	// Blocks with words which are being checked now
+	QList<QTextBlock> m_pending;
 };
 
 class ChatSpellChecker : public QObject, public StartupModule
@@ -68,6 +121,7 @@ private slots:
 	void onDictionaryChanged();
 	void onServiceChanged(const QByteArray &name);
 private:
+	void loadSettings();
 	void insertAction(QMenu *menu, QAction *before, const QString &text, const char *slot);
 private:
 	ServicePointer<QObject> m_chatForm;
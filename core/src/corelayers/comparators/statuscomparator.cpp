@@ -5,6 +5,9 @@ namespace Core {
 StatusComparator::StatusComparator()
 {
 	Q_UNUSED(QT_TRANSLATE_NOOP("ContactList", "Sort by contact's status"));
+	// Order depends only on status type, so text changes are not interesting
+	connect(qutim_sdk_0_3::StatusChangeBus::instance(), &qutim_sdk_0_3::StatusChangeBus::typesChanged,
+			this, &StatusComparator::onTypesChanged);
 }
 
 int StatusComparator::compare(qutim_sdk_0_3::Contact *a, qutim_sdk_0_3::Contact *b)
@@ -18,12 +21,13 @@ int StatusComparator::compare(qutim_sdk_0_3::Contact *a, qutim_sdk_0_3::Contact
 void StatusComparator::doStartListen(qutim_sdk_0_3::Contact *contact)
 {
 	connect(contact, SIGNAL(nameChanged(QString,QString)), SLOT(onContactChanged()));
-	connect(contact, SIGNAL(statusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)), SLOT(onContactChanged()));
+	m_contacts.insert(contact);
 }
 
 void StatusComparator::doStopListen(qutim_sdk_0_3::Contact *contact)
 {
 	contact->disconnect(this);
+	m_contacts.remove(contact);
 }
 
 void StatusComparator::onContactChanged()
@@ -31,4 +35,12 @@ void StatusComparator::onContactChanged()
 	emit contactChanged(static_cast<qutim_sdk_0_3::Contact*>(sender()));
 }
 
+void StatusComparator::onTypesChanged(const qutim_sdk_0_3::StatusChangeList &changes)
+{
+	foreach (const qutim_sdk_0_3::StatusChange &change, changes) {
+		if (m_contacts.contains(change.buddy.data()))
+			emit contactChanged(static_cast<qutim_sdk_0_3::Contact*>(change.buddy.data()));
+	}
+}
+
 } // namespace Core
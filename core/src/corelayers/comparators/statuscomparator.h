@@ -1,6 +1,8 @@
 #ifndef CORE_STATUSCOMPARATOR_H
 #define CORE_STATUSCOMPARATOR_H
 #include <qutim/contact.h>
+#include <qutim/statuschangebus.h>
+#include <QSet>
 
 namespace Core {
 
@@ -16,6 +18,9 @@ protected:
 	virtual void doStopListen(qutim_sdk_0_3::Contact *contact);
 private slots:
 	void onContactChanged();
+	void onTypesChanged(const qutim_sdk_0_3::StatusChangeList &changes);
+private:
+	QSet<qutim_sdk_0_3::Buddy*> m_contacts;
 };
 
 } // namespace Core
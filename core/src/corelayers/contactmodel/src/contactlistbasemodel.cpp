@@ -58,6 +58,10 @@ ContactListBaseModel::ContactListBaseModel(QObject *parent) :
 
 	m_realAccountRequestId = Event::registerType("real-account-request");
 	m_realUnitRequestId = Event::registerType("real-chatunit-request");
+
+	// Status changes come in batches, it's much cheaper during login
+	connect(StatusChangeBus::instance(), &StatusChangeBus::changed,
+			this, &ContactListBaseModel::onStatusesChanged);
 }
 
 QModelIndex ContactListBaseModel::index(int row, int column, const QModelIndex &parent) const
@@ -451,6 +455,7 @@ void ContactListBaseModel::onContactDestroyed(QObject *obj)
 	if (it != m_contactHash.end()) {
 		QList<ContactNode*> contacts = *it;
 		m_contactHash.erase(it);
+		m_onlineContacts.remove(contact);
 
 		foreach (ContactNode *node, contacts) {
 			ContactListNode *parentNode = node->parent();
@@ -539,23 +544,30 @@ void ContactListBaseModel::onContactTagsChanged(const QStringList &current, cons
 	}
 }
 
-void ContactListBaseModel::onStatusChanged(const Status &current, const Status &previous)
+void ContactListBaseModel::onStatusesChanged(const StatusChangeList &changes)
 {
-	Contact *contact = static_cast<Contact*>(sender());
-	const bool wasOnline = (previous != Status::Offline);
-	const bool online = (current != Status::Offline);
-
-	if (online == wasOnline) {
-		onContactChanged(contact);
-	} else {
+	foreach (const StatusChange &change, changes) {
+		Contact *contact = qobject_cast<Contact*>(change.buddy.data());
 		ContactHash::Iterator it = m_contactHash.find(contact);
-		if (it != m_contactHash.end()) {
-			foreach (ContactNode *node, *it) {
-				QModelIndex contactIndex = createIndex(node);
-				dataChanged(contactIndex, contactIndex);
+		if (it == m_contactHash.end())
+			continue;
 
-				updateItemCount(contact, node->parent(), online ? 1 : -1, 0);
-			}
+		// The contact could be added with its new status before the batch came
+		const bool online = (contact->status() != Status::Offline);
+		const bool wasOnline = m_onlineContacts.contains(contact);
+		if (online == wasOnline) {
+			onContactChanged(contact);
+			continue;
+		}
+		if (online)
+			m_onlineContacts.insert(contact);
+		else
+			m_onlineContacts.remove(contact);
+		foreach (ContactNode *node, *it) {
+			QModelIndex contactIndex = createIndex(node);
+			dataChanged(contactIndex, contactIndex);
+
+			updateItemCount(contact, node->parent(), online ? 1 : -1, 0);
 		}
 	}
 }
@@ -620,11 +632,14 @@ ContactListBaseModel::ContactNode *ContactListBaseModel::ensureContact(Contact *
 		beginInsertRows(parentIndex, index, index);
 		it = parent->contacts.insert(it, ContactNode(contact, *parent));
 		ContactNode &node = *it;
-		m_contactHash[contact].append(&node);
-		Q_ASSERT(m_contactHash[contact].count(&node) == 1);
+		QList<ContactNode *> &nodes = m_contactHash[contact];
+		if (nodes.isEmpty() && contact->status() != Status::Offline)
+			m_onlineContacts.insert(contact);
+		nodes.append(&node);
+		Q_ASSERT(nodes.count(&node) == 1);
 		endInsertRows();
 
-		const bool online = (contact->status() != Status::Offline);
+		const bool online = m_onlineContacts.contains(contact);
 		updateItemCount(contact, parent, online ? 1 : 0, 1);
 	}
 
@@ -648,12 +663,14 @@ void ContactListBaseModel::eraseContact(Contact *contact, ContactListBaseModel::
 		ContactHash::Iterator jt = m_contactHash.find(contact);
 		Q_ASSERT(jt != m_contactHash.end());
 		jt->removeOne(&node);
-		if (jt->isEmpty())
+		const bool online = m_onlineContacts.contains(contact);
+		if (jt->isEmpty()) {
 			m_contactHash.erase(jt);
+			m_onlineContacts.remove(contact);
+		}
 		parent->contacts.erase(it);
 		endRemoveRows();
 
-		const bool online = (contact->status() != Status::Offline);
 		updateItemCount(contact, parent, online ? -1 : 0, -1);
 	}
 }
@@ -818,8 +835,11 @@ void ContactListBaseModel::removeAccountNode(Account *account, ContactListBaseMo
 void ContactListBaseModel::clearContacts(ContactListBaseModel::BaseNode *current)
 {
 	if (ContactListNode *list = node_cast<ContactListNode*>(current)) {
-		for (int i = 0; i < list->contacts.size(); ++i)
-			m_contactHash.remove(list->contacts[i].contact.data());
+		for (int i = 0; i < list->contacts.size(); ++i) {
+			Contact *contact = list->contacts[i].contact.data();
+			m_contactHash.remove(contact);
+			m_onlineContacts.remove(contact);
+		}
 	}
 	if (TagListNode *list = node_cast<TagListNode*>(current)) {
 		for (int i = 0; i < list->tags.size(); ++i)
@@ -883,8 +903,6 @@ void ContactListBaseModel::connectContact(Contact *contact)
 			this, SLOT(onContactChanged()));
 	connect(contact, SIGNAL(avatarChanged(QString)),
 			this, SLOT(onContactChanged()));
-	connect(contact, SIGNAL(statusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)),
-			this, SLOT(onStatusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)));
 	m_comparator->startListen(contact);
 }
 
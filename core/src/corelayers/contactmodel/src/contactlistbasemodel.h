@@ -30,8 +30,10 @@
 #include <qutim/contact.h>
 #include <qutim/servicemanager.h>
 #include <qutim/notification.h>
+#include <qutim/statuschangebus.h>
 #include <QAbstractItemModel>
 #include <QBasicTimer>
+#include <QSet>
 
 class ContactListFrontModel;
 
@@ -269,7 +271,7 @@ private slots:
 	void onContactChanged(qutim_sdk_0_3::Contact *contact, bool parentsChanged = false);
 	void onContactChanged();
 	void onContactTagsChanged(const QStringList &current, const QStringList &previous);
-	void onStatusChanged(const qutim_sdk_0_3::Status &current, const qutim_sdk_0_3::Status &previous);
+	void onStatusesChanged(const qutim_sdk_0_3::StatusChangeList &changes);
 	void onNotificationFinished();
 
 	void connectContact(qutim_sdk_0_3::Contact *contact);
@@ -328,6 +330,9 @@ private:
 
 	RootNode m_root;
 	ContactHash m_contactHash;
+	// Contacts counted as online, status changes come with a delay so the
+	// current status of the contact may be not applied yet
+	QSet<qutim_sdk_0_3::Contact*> m_onlineContacts;
 	NotificationHash m_notificationHash;
 	mutable QStringList m_emptyTags;
 	QStringList m_tags;
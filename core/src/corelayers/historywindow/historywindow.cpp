@@ -25,6 +25,7 @@
 ****************************************************************************/
 
 #include "historywindow.h"
+#include "ui_historywindow.h"
 #include <QPoint>
 #include <QApplication>
 #include <QDesktopWidget>
@@ -64,17 +65,17 @@ static inline ChatUnit *findContact(const History::ContactInfo &info)
 	return nullptr;
 }
 
-HistoryWindow::HistoryWindow(const ChatUnit *unit)
+HistoryWindow::HistoryWindow(const ChatUnit *unit) : ui(new Ui::HistoryWindowClass)
 {
-	ui.setupUi(this);
+	ui->setupUi(this);
 
-	ui.historyLog->setHtml("<p align='center'><span style='font-size:36pt;'>"
+	ui->historyLog->setHtml("<p align='center'><span style='font-size:36pt;'>"
 			+ tr("No History") + "</span></p>");
-	ui.label_in->setText( tr( "In: %L1").arg( 0 ) );
-	ui.label_out->setText( tr( "Out: %L1").arg( 0 ) );
-	ui.label_all->setText( tr( "All: %L1").arg( 0 ) );
+	ui->label_in->setText( tr( "In: %L1").arg( 0 ) );
+	ui->label_out->setText( tr( "Out: %L1").arg( 0 ) );
+	ui->label_all->setText( tr( "All: %L1").arg( 0 ) );
 	Shortcut *shortcut = new Shortcut("findNext", this);
-	connect(shortcut, SIGNAL(activated()), ui.searchButton, SLOT(click()));
+	connect(shortcut, SIGNAL(activated()), ui->searchButton, SLOT(click()));
 	shortcut = new Shortcut("findPrevious", this);
 	connect(shortcut, SIGNAL(activated()), SLOT(findPrevious()));
 
@@ -84,13 +85,13 @@ HistoryWindow::HistoryWindow(const ChatUnit *unit)
 	QList<int> sizes;
 	sizes.append(80);
 	sizes.append(250);
-	ui.splitter->setSizes(sizes);
-	ui.splitter->setCollapsible(1,false);
+	ui->splitter->setSizes(sizes);
+	ui->splitter->setCollapsible(1,false);
 	setIcons();
 
 	m_unitInfo = unit ? History::info(unit) : History::ContactInfo();
 
-	connect(ui.dateTreeWidget, &QTreeWidget::itemExpanded, this, &HistoryWindow::fillMonth);
+	connect(ui->dateTreeWidget, &QTreeWidget::itemExpanded, this, &HistoryWindow::fillMonth);
 
 	fillAccountComboBox();
 
@@ -103,30 +104,34 @@ HistoryWindow::HistoryWindow(const ChatUnit *unit)
 	SystemIntegration::show(this);
 }
 
+HistoryWindow::~HistoryWindow()
+{
+}
+
 void HistoryWindow::setUnit(const ChatUnit *unit)
 {
 	m_unitInfo = unit ? History::info(unit) : History::ContactInfo();
 	History::AccountInfo accountInfo = m_unitInfo;
-	int accountIndex = ui.accountComboBox->findData(QVariant::fromValue(accountInfo));
+	int accountIndex = ui->accountComboBox->findData(QVariant::fromValue(accountInfo));
 	if (accountIndex > -1) {
-		ui.accountComboBox->setCurrentIndex(accountIndex);
-		int contactIndex = ui.fromComboBox->findData(m_unitInfo.contact);
+		ui->accountComboBox->setCurrentIndex(accountIndex);
+		int contactIndex = ui->fromComboBox->findData(m_unitInfo.contact);
 		if (!contactIndex) {
 			fillDateTreeWidget(0);
 		} else {
-			ui.fromComboBox->setCurrentIndex(contactIndex);
+			ui->fromComboBox->setCurrentIndex(contactIndex);
 			return;
 		}
 	}
 	fillContactComboBox(0);
-	ui.historyLog->setHtml("<p align='center'><span style='font-size:36pt;'>"
+	ui->historyLog->setHtml("<p align='center'><span style='font-size:36pt;'>"
 						   + tr("No History") + "</span></p>");
 }
 
 void HistoryWindow::setIcons()
 {
 //	setWindowIcon(Icon("history"));
-//	ui.searchButton->setIcon(Icon("search"));
+//	ui->searchButton->setIcon(Icon("search"));
 }
 
 void HistoryWindow::fillAccountComboBox()
@@ -140,29 +145,29 @@ void HistoryWindow::fillAccountComboBox()
 				if (!account->name().isEmpty())
 				name += QStringLiteral(" - ") + account->name();
 			}
-			ui.accountComboBox->addItem(icon, name, QVariant::fromValue(info));
+			ui->accountComboBox->addItem(icon, name, QVariant::fromValue(info));
 		}
 
-		connect(ui.accountComboBox, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
+		connect(ui->accountComboBox, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
 				this, &HistoryWindow::fillContactComboBox);
-		int accountIndex = ui.accountComboBox->findData(QVariant::fromValue<History::AccountInfo>(m_unitInfo));
+		int accountIndex = ui->accountComboBox->findData(QVariant::fromValue<History::AccountInfo>(m_unitInfo));
 		if (accountIndex < 0)
 			fillContactComboBox(0);
 		else
-			ui.accountComboBox->setCurrentIndex(accountIndex);
+			ui->accountComboBox->setCurrentIndex(accountIndex);
 	});
 }
 
 void HistoryWindow::fillContactComboBox(int index)
 {
-	if (ui.accountComboBox->count() == 0)
+	if (ui->accountComboBox->count() == 0)
 		return;
-	auto accountInfo = ui.accountComboBox->itemData(index).value<History::AccountInfo>();
-	ui.fromComboBox->clear();
+	auto accountInfo = ui->accountComboBox->itemData(index).value<History::AccountInfo>();
+	ui->fromComboBox->clear();
 
 	history()->contacts(accountInfo).connect(this, [this, accountInfo] (const QVector<History::ContactInfo> &contacts) {
-		int index = ui.accountComboBox->currentIndex();
-		auto currentAccountInfo = ui.accountComboBox->itemData(index).value<History::AccountInfo>();
+		int index = ui->accountComboBox->currentIndex();
+		auto currentAccountInfo = ui->accountComboBox->itemData(index).value<History::AccountInfo>();
 		if (!(accountInfo == currentAccountInfo))
 			return;
 
@@ -177,33 +182,33 @@ void HistoryWindow::fillContactComboBox(int index)
 					name += QStringLiteral(" - ") + unit->title();
 			}
 
-			ui.fromComboBox->addItem(name, QVariant::fromValue(info));
+			ui->fromComboBox->addItem(name, QVariant::fromValue(info));
 		}
 
-		ui.fromComboBox->model()->sort(0);
+		ui->fromComboBox->model()->sort(0);
 
-		m_contactConnection = connect(ui.fromComboBox, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
+		m_contactConnection = connect(ui->fromComboBox, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
 									  this, &HistoryWindow::fillDateTreeWidget);
-		int contactIndex = ui.fromComboBox->findData(QVariant::fromValue(m_unitInfo));
+		int contactIndex = ui->fromComboBox->findData(QVariant::fromValue(m_unitInfo));
 		if (!contactIndex)
 			fillDateTreeWidget(0);
 		else
-			ui.fromComboBox->setCurrentIndex(contactIndex);
+			ui->fromComboBox->setCurrentIndex(contactIndex);
 	});
 }
 
 void HistoryWindow::fillDateTreeWidget(int index)
 {
-	if (ui.fromComboBox->count() == 0)
+	if (ui->fromComboBox->count() == 0)
 		return;
-	auto contactInfo = ui.fromComboBox->itemData(index).value<History::ContactInfo>();
-	ui.dateTreeWidget->clear();
+	auto contactInfo = ui->fromComboBox->itemData(index).value<History::ContactInfo>();
+	ui->dateTreeWidget->clear();
 
-	setWindowTitle(QStringLiteral("%1 (%2)").arg(ui.fromComboBox->currentText(), ui.accountComboBox->currentText()));
+	setWindowTitle(QStringLiteral("%1 (%2)").arg(ui->fromComboBox->currentText(), ui->accountComboBox->currentText()));
 
 	history()->months(contactInfo, m_search).connect(this, [this, contactInfo] (const QList<QDate> &months) {
-		int index = ui.fromComboBox->currentIndex();
-		auto currentContactInfo = ui.fromComboBox->itemData(index).value<History::ContactInfo>();
+		int index = ui->fromComboBox->currentIndex();
+		auto currentContactInfo = ui->fromComboBox->itemData(index).value<History::ContactInfo>();
 		if (!(currentContactInfo == contactInfo))
 			return;
 
@@ -213,7 +218,7 @@ void HistoryWindow::fillDateTreeWidget(int index)
 
 		for (const QDate &date : months) {
 			if (!year || year->data(0, Qt::UserRole).toInt() != date.year()) {
-				year = new QTreeWidgetItem(ui.dateTreeWidget);
+				year = new QTreeWidgetItem(ui->dateTreeWidget);
 				year->setText(0, QString::number(date.year()));
 				year->setIcon(0, yearIcon);
 				year->setData(0, Qt::UserRole, date.year());
@@ -229,24 +234,24 @@ void HistoryWindow::fillDateTreeWidget(int index)
 		}
 
 		if (month)
-			ui.dateTreeWidget->setCurrentItem(month);
+			ui->dateTreeWidget->setCurrentItem(month);
 	});
 }
 
 void HistoryWindow::fillMonth(QTreeWidgetItem *monthItem)
 {
-	if (ui.fromComboBox->count() == 0)
+	if (ui->fromComboBox->count() == 0)
 		return;
 	if (monthItem->data(0, Qt::UserRole).type() != QVariant::Date)
 		return;
 
-	auto contactIndex = ui.fromComboBox->currentIndex();
-	auto contactInfo = ui.fromComboBox->itemData(contactIndex).value<History::ContactInfo>();
+	auto contactIndex = ui->fromComboBox->currentIndex();
+	auto contactInfo = ui->fromComboBox->itemData(contactIndex).value<History::ContactInfo>();
 	auto month = monthItem->data(0, Qt::UserRole).toDate();
 
 	history()->dates(contactInfo, month, m_search).connect(this, [this, contactInfo, month] (const QList<QDate> &dates) {
-		int contactIndex = ui.fromComboBox->currentIndex();
-		auto currentContactInfo = ui.fromComboBox->itemData(contactIndex).value<History::ContactInfo>();
+		int contactIndex = ui->fromComboBox->currentIndex();
+		auto currentContactInfo = ui->fromComboBox->itemData(contactIndex).value<History::ContactInfo>();
 		if (!(currentContactInfo == contactInfo))
 			return;
 
@@ -263,7 +268,7 @@ void HistoryWindow::fillMonth(QTreeWidgetItem *monthItem)
 			return nullptr;
 		};
 
-		auto monthItem = findChild(findChild(ui.dateTreeWidget->invisibleRootItem(), month.year()), month);
+		auto monthItem = findChild(findChild(ui->dateTreeWidget->invisibleRootItem(), month.year()), month);
 		if (!monthItem)
 			return;
 
@@ -287,22 +292,22 @@ void HistoryWindow::on_dateTreeWidget_currentItemChanged(QTreeWidgetItem *dayIte
 	if (monthItem->data(0, Qt::UserRole).type() != QVariant::Date)
 		return;
 
-	auto contactIndex = ui.fromComboBox->currentIndex();
-	auto contactInfo = ui.fromComboBox->itemData(contactIndex).value<History::ContactInfo>();
+	auto contactIndex = ui->fromComboBox->currentIndex();
+	auto contactInfo = ui->fromComboBox->itemData(contactIndex).value<History::ContactInfo>();
 	auto date = dayItem->data(0, Qt::UserRole).toDate();
 	QDateTime from(date, QTime(0, 0));
 	QDateTime to(date, QTime(23, 59, 59, 999));
 	int count = std::numeric_limits<int>::max();
 
 	history()->read(contactInfo, from, to, count).connect(this, [this, contactInfo, date] (const MessageList &messages) {
-		int contactIndex = ui.fromComboBox->currentIndex();
-		auto currentContactInfo = ui.fromComboBox->itemData(contactIndex).value<History::ContactInfo>();
+		int contactIndex = ui->fromComboBox->currentIndex();
+		auto currentContactInfo = ui->fromComboBox->itemData(contactIndex).value<History::ContactInfo>();
 		if (!(currentContactInfo == contactInfo))
 			return;
 
-		QTextDocument *doc = ui.historyLog->document();
+		QTextDocument *doc = ui->historyLog->document();
 		doc->setParent(0);
-		ui.historyLog->setDocument(0);
+		ui->historyLog->setDocument(0);
 		doc->clear();
 		QTextCursor cursor = QTextCursor(doc);
 		QTextCharFormat defaultFont = cursor.charFormat();
@@ -356,45 +361,45 @@ void HistoryWindow::on_dateTreeWidget_currentItemChanged(QTreeWidgetItem *dayIte
 			}
 		}
 		cursor.endEditBlock();
-		doc->setParent(ui.historyLog);
-		ui.historyLog->setDocument(doc);
+		doc->setParent(ui->historyLog);
+		ui->historyLog->setDocument(doc);
 		if (m_search_word.isEmpty())
-			ui.historyLog->moveCursor(QTextCursor::End);
+			ui->historyLog->moveCursor(QTextCursor::End);
 		else
-			ui.historyLog->find(m_search_word);
-		ui.historyLog->verticalScrollBar()->setValue(ui.historyLog->verticalScrollBar()->maximum());
+			ui->historyLog->find(m_search_word);
+		ui->historyLog->verticalScrollBar()->setValue(ui->historyLog->verticalScrollBar()->maximum());
 
-		ui.label_in->setText(tr("In: %L1").arg(in_count));
-		ui.label_out->setText(tr("Out: %L1").arg(out_count));
-		ui.label_all->setText(tr("All: %L1").arg(in_count + out_count));
+		ui->label_in->setText(tr("In: %L1").arg(in_count));
+		ui->label_out->setText(tr("Out: %L1").arg(out_count));
+		ui->label_all->setText(tr("All: %L1").arg(in_count + out_count));
 	});
 }
 
 void HistoryWindow::on_searchButton_clicked()
 {
-	if (ui.accountComboBox->count() && ui.fromComboBox->count()) {
-		QString searchWord = ui.searchEdit->text().toLower();
+	if (ui->accountComboBox->count() && ui->fromComboBox->count()) {
+		QString searchWord = ui->searchEdit->text().toLower();
 		if (m_search_word == searchWord) {
-			if (!ui.historyLog->find(m_search_word)) {
-				ui.historyLog->moveCursor(QTextCursor::Start);
-				ui.historyLog->find(m_search_word);
-				ui.historyLog->ensureCursorVisible();
+			if (!ui->historyLog->find(m_search_word)) {
+				ui->historyLog->moveCursor(QTextCursor::Start);
+				ui->historyLog->find(m_search_word);
+				ui->historyLog->ensureCursorVisible();
 			}
 		} else {
 			m_search_word = searchWord;
 			m_search.setPattern(QLatin1Char('(') + QRegularExpression::escape(searchWord) + QLatin1Char(')'));
 			m_search.setPatternOptions(QRegularExpression::MultilineOption | QRegularExpression::CaseInsensitiveOption);
-			fillDateTreeWidget(ui.fromComboBox->currentIndex());
+			fillDateTreeWidget(ui->fromComboBox->currentIndex());
 		}
 	}
 }
 
 void HistoryWindow::findPrevious()
 {
-	if (!ui.historyLog->find(m_search_word, QTextDocument::FindBackward)) {
-		ui.historyLog->moveCursor(QTextCursor::End);
-		ui.historyLog->find(m_search_word);
-		ui.historyLog->ensureCursorVisible();
+	if (!ui->historyLog->find(m_search_word, QTextDocument::FindBackward)) {
+		ui->historyLog->moveCursor(QTextCursor::End);
+		ui->historyLog->find(m_search_word);
+		ui->historyLog->ensureCursorVisible();
 	}
 }
 
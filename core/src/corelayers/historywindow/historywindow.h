@@ -32,20 +32,26 @@
 #include <QRegularExpression>
 #include <qutim/chatunit.h>
 #include <qutim/history.h>
-#include "ui_historywindow.h"
+#include "historywindow_global.h"
+
+class QTreeWidgetItem;
+
+namespace Ui {
+class HistoryWindowClass;
+}
 
 using namespace qutim_sdk_0_3;
 
 namespace Core
 {
-class JsonEngine;
 
-class HistoryWindow : public QWidget
+class HISTORYWINDOW_EXPORT HistoryWindow : public QWidget
 {
 	Q_OBJECT
 
 public:
 	HistoryWindow(const ChatUnit *unit);
+	~HistoryWindow();
 	void setUnit(const ChatUnit *unit);
 
 private slots:
@@ -59,7 +65,7 @@ private slots:
 private:
 	void fillAccountComboBox();
 	void setIcons();
-	Ui::HistoryWindowClass ui;
+	QScopedPointer<Ui::HistoryWindowClass> ui;
 	QMetaObject::Connection m_contactConnection;
 	History::ContactInfo m_unitInfo;
 	QRegularExpression m_search;
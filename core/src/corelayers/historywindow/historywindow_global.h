@@ -0,0 +1,37 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef HISTORYWINDOW_GLOBAL_H
+#define HISTORYWINDOW_GLOBAL_H
+
+#include <qglobal.h>
+
+#if defined(HISTORYWINDOW_LIBRARY)
+#  define HISTORYWINDOW_EXPORT Q_DECL_EXPORT
+#else
+#  define HISTORYWINDOW_EXPORT Q_DECL_IMPORT
+#endif
+
+#endif // HISTORYWINDOW_GLOBAL_H
@@ -53,6 +53,9 @@ Idle::Idle()
 	if(platform)
 		++platform_ref;
 
+	d->checkTimer.setObjectName(QLatin1String("Idle"));
+	// Idle time is measured in seconds, there is no need to be exact
+	d->checkTimer.setSlack(500);
 	connect(&d->checkTimer, SIGNAL(timeout()), SLOT(doCheck()));
 	start();
 }
@@ -30,6 +30,7 @@
 #include <QCursor>
 #include <QDateTime>
 #include <QTimer>
+#include <qutim/timerservice.h>
 
 namespace Psi
 {
@@ -85,7 +86,7 @@ public:
 	bool active;
 	int idleTime;
 	QDateTime startTime;
-	QTimer checkTimer;
+	qutim_sdk_0_3::CoalescingTimer checkTimer;
 };
 }
 
@@ -29,6 +29,8 @@
 #include <QFile>
 #include <QSaveFile>
 #include <qutim/debug.h>
+#include <qutim/cryptoservice.h>
+#include <qutim/systeminfo.h>
 #include <QRect>
 #include <QStringList>
 #include <QDataStream>
@@ -204,11 +206,27 @@ namespace Core
 		}
 	}
 
+	// Only profile's files are encrypted, share and system dirs are never touched
+	static bool isProfileFile(const QString &fileName)
+	{
+		return fileName.startsWith(SystemInfo::getPath(SystemInfo::ConfigDir));
+	}
+
 	QVariant JsonConfigBackend::load(const QString &fileName)
 	{
-		JsonFile file(fileName);
 		QVariant var;
-		file.load(var);
+		QFile input(fileName);
+		if (input.open(QIODevice::ReadOnly) && CryptoService::isStorageData(input.peek(16))) {
+			const QByteArray data = CryptoService::fromStorageData(input.readAll());
+			int len = data.size();
+			const char *s = Json::skipBlanks(data.constData(), &len);
+			if (s && len > 0)
+				Json::parseRecord(var, s, &len);
+		} else {
+			input.close();
+			JsonFile file(fileName);
+			file.load(var);
+		}
 		if (var.type() == QVariant::Map || var.type() == QVariant::List
 			|| var.type() == QVariant::String) {
 			validateVariant(&var);
@@ -218,14 +236,14 @@ namespace Core
 
 	void JsonConfigBackend::save(const QString &fileName, const QVariant &entry)
 	{
+		const bool encrypt = CryptoService::isStorageEncrypted() && isProfileFile(fileName);
 		QSaveFile file(fileName);
-		if (file.open(QFile::WriteOnly | QIODevice::Text)) {
+		if (file.open(encrypt ? QIODevice::WriteOnly : QFile::WriteOnly | QIODevice::Text)) {
 			QByteArray data;
 			Json::generate(data, entry, 2, variantGeneratorExt);
 //			qDebug() << QString::fromUtf8(data, data.size());
-			file.write(data);
+			file.write(encrypt ? CryptoService::toStorageData(data) : data);
 			file.commit();
 		}
 	}
 }
-
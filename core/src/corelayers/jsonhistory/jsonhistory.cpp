@@ -29,6 +29,9 @@
 #include <qutim/protocol.h>
 #include <qutim/systeminfo.h>
 #include <qutim/json.h>
+#include <qutim/cryptoservice.h>
+#include <QSaveFile>
+#include <QtEndian>
 #include <QStringBuilder>
 #include <QThreadPool>
 #include "historywindow.h"
@@ -40,6 +43,50 @@
 namespace Core
 {
 
+// Encrypted history is a sequence of separately encrypted records, each one
+// is prefixed by 32-bit big endian length, so new messages are appended
+// without rewriting of the whole month
+static const char recordsMagic[] = "QENR\x01";
+enum { RecordsMagicSize = sizeof(recordsMagic) - 1 };
+
+static bool isEncryptedRecords(const QByteArray &header)
+{
+	return header.startsWith(QByteArray::fromRawData(recordsMagic, RecordsMagicSize));
+}
+
+static QByteArray encryptRecord(const QByteArray &record)
+{
+	const QByteArray data = CryptoService::cryptData(record);
+	uchar length[4];
+	qToBigEndian<quint32>(data.size(), length);
+	return QByteArray(reinterpret_cast<const char *>(length), 4) + data;
+}
+
+static QByteArray decryptRecords(const QByteArray &file)
+{
+	QByteArray result("[\n");
+	const char *s = file.constData() + RecordsMagicSize;
+	const char *end = file.constData() + file.size();
+	bool first = true;
+	while (end - s >= 4) {
+		const quint32 length = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(s));
+		s += 4;
+		// The last record could be truncated by a crash during writing
+		if (quint32(end - s) < length)
+			break;
+		const QByteArray record = CryptoService::decryptData(QByteArray::fromRawData(s, length));
+		s += length;
+		if (record.isEmpty())
+			continue;
+		if (!first)
+			result += ",\n";
+		first = false;
+		result += record;
+	}
+	result += "\n]";
+	return result;
+}
+
 JsonHistoryJob::JsonHistoryJob(JsonHistoryScope::Ptr scope)
 	: d(scope)
 {
@@ -103,7 +150,6 @@ JsonHistory::~JsonHistory()
 
 uint JsonHistoryScope::findEnd(QFile &file)
 {
-	int len = file.size();
 	QByteArray data;
 	uchar *fmap = file.map(0, file.size());
 	if(!fmap)
@@ -111,16 +157,19 @@ uint JsonHistoryScope::findEnd(QFile &file)
 		data = file.readAll();
 		fmap = (uchar *)data.constData();
 	}
-	uint end = file.size();
+	uint end = findEnd(fmap, file.size());
+	if(data.isEmpty())
+		file.unmap(fmap);
+	return end;
+}
+
+uint JsonHistoryScope::findEnd(const uchar *fmap, int len)
+{
+	uint end = len;
 	const uchar *s = Json::skipBlanks(fmap, &len);
-	uchar qch = *s;
-	if(!s || (qch != '[' && qch != '{'))
-	{
-		if(data.isEmpty())
-			file.unmap(fmap);
+	if(!s || (*s != '[' && *s != '{'))
 		return end;
-	}
-	qch = (qch == '{' ? '}' : ']');
+	uchar qch = (*s == '{' ? '}' : ']');
 	s++;
 	len--;
 	bool first = true;
@@ -147,11 +196,27 @@ uint JsonHistoryScope::findEnd(QFile &file)
 		if(!(s = Json::skipRecord(s, &len)))
 			break;
 	}
-	if(data.isEmpty())
-		file.unmap(fmap);
 	return end;
 }
 
+const uchar *JsonHistoryScope::mapFile(QFile &file, QByteArray &data, int *len)
+{
+	const QByteArray header = file.peek(16);
+	if (isEncryptedRecords(header) || CryptoService::isStorageData(header)) {
+		data = isEncryptedRecords(header) ? decryptRecords(file.readAll())
+										  : CryptoService::fromStorageData(file.readAll());
+		*len = data.size();
+		return reinterpret_cast<const uchar *>(data.constData());
+	}
+	*len = file.size();
+	const uchar *fmap = file.map(0, file.size());
+	if (!fmap) {
+		data = file.readAll();
+		fmap = reinterpret_cast<const uchar *>(data.constData());
+	}
+	return fmap;
+}
+
 QString JsonHistoryScope::getFileName(const Message &message) const
 {
 	return getFileName(History::info(message.chatUnit()), message.time().date());
@@ -190,12 +255,91 @@ void JsonHistory::store(const Message &message)
 		QDate date = message.time().date();
 
 		QString fileName = d->getFileName(contactInfo, date);
+
+		// So, writing message section
+		QByteArray record(" {\n");
+		foreach(const QByteArray &name, message.dynamicPropertyNames()) {
+			QByteArray data;
+			if(!Json::generate(data, message.property(name), 2))
+				continue;
+			record += "  ";
+			record += Json::quote(QString::fromUtf8(name)).toUtf8();
+			record += ": ";
+			record += data;
+			record += ",\n";
+		}
+		record += "  \"datetime\": \"";
+		QDateTime time = message.time();
+		if(!time.isValid())
+			time = QDateTime::currentDateTime();
+		record += time.toString(Qt::ISODate).toLatin1();
+		record += "\",\n  \"in\": ";
+		record += message.isIncoming() ? "true" : "false";
+		record += ",\n  \"text\": ";
+		record += Json::quote(message.text()).toUtf8();
+		record += ",\n  \"html\": ";
+		record += Json::quote(message.html()).toUtf8();
+		record += "\n }";
+		// Writing end
+
 		QFile file(fileName);
 		QDateTime lastModified = QFileInfo(fileName).lastModified();
 
 		bool new_file = !file.exists();
 		if(!file.open(QIODevice::ReadWrite))
 			return;
+
+		const QByteArray header = file.peek(16);
+		const bool records = isEncryptedRecords(header);
+		const bool convert = !records && !new_file
+				&& (CryptoService::isStorageEncrypted() || CryptoService::isStorageData(header));
+		if (records || convert || (new_file && CryptoService::isStorageEncrypted())) {
+			// Plain text never goes to encrypted file, so the message waits
+			// until the key is available
+			QList<QByteArray> &pending = d->pendingRecords[fileName];
+			pending << record;
+			if (!CryptoService::isStorageEncrypted()) {
+				if (pending.size() == 1)
+					qWarning() << "History is not written until the storage is unlocked:" << fileName;
+				if (new_file)
+					file.remove();
+				return;
+			}
+			QByteArray data;
+			foreach (const QByteArray &pendingRecord, pending)
+				data += encryptRecord(pendingRecord);
+			d->pendingRecords.remove(fileName);
+
+			if (!convert) {
+				if (new_file)
+					file.write(recordsMagic, RecordsMagicSize);
+				else
+					file.seek(file.size());
+				file.write(data);
+				return;
+			}
+
+			// Plain or entirely encrypted file is converted to records once
+			QByteArray mapped;
+			int len;
+			const uchar *fmap = JsonHistoryScope::mapFile(file, mapped, &len);
+			const QByteArray content = QByteArray::fromRawData(reinterpret_cast<const char *>(fmap),
+																JsonHistoryScope::findEnd(fmap, len));
+			const int start = content.indexOf('[');
+			const QByteArray old = start < 0 ? QByteArray() : content.mid(start + 1).trimmed();
+			file.close();
+			QSaveFile output(fileName);
+			if (output.open(QIODevice::WriteOnly)) {
+				output.write(recordsMagic, RecordsMagicSize);
+				if (!old.isEmpty())
+					output.write(encryptRecord(old));
+				output.write(data);
+				output.commit();
+			}
+			d->cache.remove(fileName);
+			return;
+		}
+
 		if(new_file) {
 			file.write("[\n");
 		} else {
@@ -209,32 +353,7 @@ void JsonHistory::store(const Message &message)
 			file.seek(end);
 			file.write(",\n");
 		}
-
-		// So, writing message section
-		file.write(" {\n");
-		foreach(const QByteArray &name, message.dynamicPropertyNames()) {
-			QByteArray data;
-			if(!Json::generate(data, message.property(name), 2))
-				continue;
-			file.write("  ");
-			file.write(Json::quote(QString::fromUtf8(name)).toUtf8());
-			file.write(": ");
-			file.write(data);
-			file.write(",\n");
-		}
-		file.write("  \"datetime\": \"");
-		QDateTime time = message.time();
-		if(!time.isValid())
-			time = QDateTime::currentDateTime();
-		file.write(time.toString(Qt::ISODate).toLatin1());
-		file.write("\",\n  \"in\": ");
-		file.write(message.isIncoming() ? "true" : "false");
-		file.write(",\n  \"text\": ");
-		file.write(Json::quote(message.text()).toUtf8());
-		file.write(",\n  \"html\": ");
-		file.write(Json::quote(message.html()).toUtf8());
-		file.write("\n }");
-		// Writing end
+		file.write(record);
 
 		uint end = file.pos();
 		file.write("\n]");
@@ -272,13 +391,10 @@ AsyncResult<MessageList> JsonHistory::read(const ContactInfo &info, const QDateT
 			QFile file(dir.filePath(files[i]));
 			if (!file.open(QIODevice::ReadOnly))
 				continue;
-			int len = file.size();
+			int len;
 			QByteArray data;
-			const uchar *fmap = file.map(0, file.size());
-			if (!fmap) {
-				data = file.readAll();
-				fmap = (uchar *)data.constData();
-			}
+			const uchar *fmap = JsonHistoryScope::mapFile(file, data, &len);
+			const int size = len;
 			const uchar *s = Json::skipBlanks(fmap, &len);
 			uchar qch = *s;
 			if (!s || (qch != '[' && qch != '{'))
@@ -308,7 +424,7 @@ AsyncResult<MessageList> JsonHistory::read(const ContactInfo &info, const QDateT
 			for (int i = 0; i < pointers.size(); i++) {
 				value.clear();
 				s = pointers[i];
-				len = file.size() + 1 - (s - fmap);
+				len = size + 1 - (s - fmap);
 				Json::parseRecord(value, s, &len);
 				QVariantMap message = value.toMap();
 				Message item;
@@ -439,18 +555,14 @@ AsyncResult<QList<QDate>> JsonHistory::dates(const ContactInfo &contact, const Q
 		QSet<QDate> result;
 
 		QFile file(scope->getFileName(contact, month));
-		if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+		if (!file.open(QIODevice::ReadOnly)) {
 			handler.handle(result.toList());
 			return;
 		}
 
-		int len = file.size();
+		int len;
 		QByteArray data;
-		const uchar *fmap = file.map(0, file.size());
-		if (!fmap) {
-			data = file.readAll();
-			fmap = (uchar *)data.constData();
-		}
+		const uchar *fmap = JsonHistoryScope::mapFile(file, data, &len);
 		const uchar *s = Json::skipBlanks(fmap, &len);
 		QVariant val;
 		uchar qch = *s;
@@ -46,6 +46,9 @@ public:
 	typedef QSharedPointer<JsonHistoryScope> Ptr;
 
 	uint findEnd(QFile &file);
+	static uint findEnd(const uchar *fmap, int len);
+	// Maps plain files, encrypted ones are decoded into json array in data
+	static const uchar *mapFile(QFile &file, QByteArray &data, int *len);
 	QString getFileName(const Message &message) const;
 	QString getFileName(const History::ContactInfo &info, const QDate &time) const;
 	QDir getAccountDir(const History::AccountInfo &info) const;
@@ -60,6 +63,8 @@ public:
 	typedef QHash<QString, EndValue> EndCache;
 	bool hasJobRunnable;
 	EndCache cache;
+	// Records of encrypted files wait here until the storage key is available
+	QHash<QString, QList<QByteArray> > pendingRecords;
 
 	QMutex queueLock;
 	QQueue< std::function<void ()> > queue;
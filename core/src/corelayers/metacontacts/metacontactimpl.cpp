@@ -327,7 +327,7 @@ void MetaContactImpl::setActiveContact(Contact* contact)
 void MetaContactImpl::onSessionCreated(ChatSession *session)
 {
 	MetaContact *contact = qobject_cast<MetaContact*>(session->unit());
-	if (contact == this->metaContact() && session->unread().count() == 0)
+	if (contact == this->metaContact() && session->unreadCount() == 0)
 		setActiveContact();
 }
 
@@ -104,13 +104,6 @@ NotificationFilterImpl::NotificationFilterImpl()
 	registerFilter(this, LowPriority);
 	connect(ChatLayer::instance(), SIGNAL(sessionCreated(qutim_sdk_0_3::ChatSession*)),
 			SLOT(onSessionCreated(qutim_sdk_0_3::ChatSession*)));
-
-	foreach (Protocol *proto, Protocol::all()) {
-		foreach (Account *acc, proto->accounts())
-			onAccountCreated(acc);
-		connect(proto, SIGNAL(accountCreated(qutim_sdk_0_3::Account*)),
-				SLOT(onAccountCreated(qutim_sdk_0_3::Account*)));
-	}
 }
 
 NotificationFilterImpl::~NotificationFilterImpl()
@@ -124,7 +117,9 @@ void NotificationFilterImpl::filter(NotificationRequest &request)
 	QString sender_name = request.property("senderName", QString());
 	QObject *sender = request.object();
 	if (!sender) {
-		request.setTitle(toString(reqType, sender_name));
+		// Summaries from the scheduler already have their own title
+		if (request.title().isEmpty())
+			request.setTitle(toString(reqType, sender_name));
 		return;
 	}
 
@@ -172,25 +167,12 @@ void NotificationFilterImpl::filter(NotificationRequest &request)
 	}
 
 
+	// Notifications of accounts which are loading their rosters are
+	// suppressed by NotificationScheduler before filters
 	switch (reqType) {
 	case Notification::UserChangedStatus:
 	case Notification::UserOnline:
-	case Notification::UserOffline: {
-		Buddy *buddy = qobject_cast<Buddy*>(request.object());
-		if (buddy) {
-			Account *acc = buddy->account();
-			Status::Type status = acc->status().type();
-			if (status == Status::Offline || status == Status::Connecting ||
-				m_connectingAccounts.contains(buddy->account()))
-			{
-				// We don't want the notification because the buddy's account is
-				// either loading its roster or offline.
-				request.reject("loadingRoster");
-			}
-		}
-
-		// fall through
-	}
+	case Notification::UserOffline:
 	case Notification::OutgoingMessage:
 	case Notification::IncomingMessage:
 	case Notification::ChatIncomingMessage:
@@ -311,41 +293,6 @@ void NotificationFilterImpl::onUnitDestroyed()
 	m_notifications.remove(static_cast<ChatUnit*>(sender()));
 }
 
-void NotificationFilterImpl::onAccountCreated(qutim_sdk_0_3::Account *account)
-{
-	connect(account, SIGNAL(statusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)),
-			SLOT(onAccountStatusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)));
-}
-
-void NotificationFilterImpl::onAccountStatusChanged(const qutim_sdk_0_3::Status &status,
-													const qutim_sdk_0_3::Status &previous)
-{
-	Account *acc = sender_cast<Account*>(sender());
-	if (status.type() != Status::Offline && previous.type() == Status::Connecting) {
-		QTimer *timer = m_connectingAccounts.value(acc);
-		if (!timer) {
-			timer = new QTimer(this);
-			timer->setInterval(20000);
-			timer->setSingleShot(true);
-			timer->setProperty("account", qVariantFromValue(acc));
-			connect(timer, SIGNAL(timeout()), SLOT(onAccountConnected()));
-			m_connectingAccounts.insert(acc, timer);
-		} else {
-			timer->stop();
-		}
-		timer->start();
-	}
-}
-
-void NotificationFilterImpl::onAccountConnected()
-{
-	QTimer *timer = sender_cast<QTimer*>(sender());
-	Account *acc = timer->property("account").value<Account*>();
-	Q_ASSERT(acc);
-	timer->deleteLater();
-	m_connectingAccounts.remove(acc);
-}
-
 
 } // namespace Core
 
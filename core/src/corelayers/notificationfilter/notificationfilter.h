@@ -53,14 +53,9 @@ private slots:
 	void onSessionActivated(bool active);
 	void onNotificationFinished();
 	void onUnitDestroyed();
-	void onAccountCreated(qutim_sdk_0_3::Account *account);
-	void onAccountStatusChanged(const qutim_sdk_0_3::Status &status,
-								const qutim_sdk_0_3::Status &previous);
-	void onAccountConnected();
 private:
 	typedef QMultiHash<ChatUnit*, QPointer<Notification> > Notifications;
 	Notifications m_notifications;
-	QHash<Account*, QTimer*> m_connectingAccounts;
 };
 
 } // namespace Core
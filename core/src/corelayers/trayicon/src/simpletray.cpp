@@ -43,6 +43,8 @@
 namespace Core
 {
 
+enum { SilentCheckLimit = 16 };
+
 class ProtocolSeparatorActionGenerator : public ActionGenerator
 {
 public:
@@ -178,8 +180,8 @@ void SimpleTray::onActivated(QSystemTrayIcon::ActivationReason reason)
 
 void SimpleTray::onSessionCreated(qutim_sdk_0_3::ChatSession *session)
 {
-	connect(session, SIGNAL(unreadChanged(qutim_sdk_0_3::MessageList)),
-			this, SLOT(onUnreadChanged(qutim_sdk_0_3::MessageList)));
+	connect(session, SIGNAL(unreadCountChanged(int)),
+			this, SLOT(onUnreadChanged(int)));
 	connect(session, SIGNAL(destroyed()), this, SLOT(onSessionDestroyed()));
 }
 
@@ -190,22 +192,22 @@ void SimpleTray::onSessionDestroyed()
 	updateGeneratedIcon();
 }
 
-void SimpleTray::onUnreadChanged(qutim_sdk_0_3::MessageList unread)
+void SimpleTray::onUnreadChanged(int count)
 {
 	ChatSession *session = sender_cast<ChatSession*>(sender());
 
-	MessageList::iterator itr = unread.begin();
-	while (itr != unread.end()) {
-		if (itr->property("silent", false))
-			itr = unread.erase(itr);
-		else
-			++itr;
+	// Don't load long lists from the disk, they are never silent as a whole
+	if (count > 0 && count <= SilentCheckLimit) {
+		foreach (const Message &message, session->unreadRange(0, count)) {
+			if (message.property("silent", false))
+				--count;
+		}
 	}
 
-	if (unread.isEmpty())
+	if (count == 0)
 		m_sessions.remove(session);
 	else
-		m_sessions.insert(session, unread.count());
+		m_sessions.insert(session, count);
 
 	updateGeneratedIcon();
 }
@@ -68,7 +68,7 @@ private slots:
 	void onActivated(QSystemTrayIcon::ActivationReason);
 	void onSessionCreated(qutim_sdk_0_3::ChatSession *session);
 	void onSessionDestroyed();
-	void onUnreadChanged(qutim_sdk_0_3::MessageList unread);
+	void onUnreadChanged(int count);
 	void onAccountDestroyed(QObject *obj);
 	void onAccountCreated(qutim_sdk_0_3::Account *);
 	void onStatusChanged(const qutim_sdk_0_3::Status &);
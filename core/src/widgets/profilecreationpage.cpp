@@ -79,6 +79,7 @@ ProfileCreationPage::ProfileCreationPage(QWidget *parent) :
 	registerField("historyDir", ui->historyEdit);
 	registerField("dataDir", ui->dataEdit);
 	registerField("downloadClients", ui->downloadClientsBox);
+	registerField("encryptStorage", ui->encryptStorageBox);
 	ui->advancedGroup->setVisible(ui->advancedBox->isChecked());
 
 	connect(ui->dataButton, SIGNAL(clicked()), SLOT(onPathSelectTriggered()));
@@ -97,6 +98,7 @@ void ProfileCreationPage::initializePage()
 		ui->label_6->hide();
 		ui->cryptoBox->hide();
 		ui->cryptoDescription->hide();
+		ui->encryptStorageBox->hide();
 	}
 	foreach (const ObjectGenerator *gen, ObjectGenerator::module<CryptoService>()) {
 		const ExtensionInfo info = gen->info();
@@ -32,6 +32,7 @@
 #include "profilecreationpage.h"
 #include <qutim/jsonfile.h>
 #include <qutim/config.h>
+#include <qutim/cryptoservice.h>
 #include <qutim/debug.h>
 #include <QMessageBox>
 #include <QTimer>
@@ -184,6 +185,7 @@ void ProfileCreationWizard::done(int result)
 			config.setValue("name", field("name"));
 			config.setValue("id", field("id"));
 			config.setValue("crypto", QLatin1String(page->cryptoName()));
+			config.setValue("encryptStorage", field("encryptStorage"));
 			config.setValue("config", QLatin1String(configBackends.first()->metaObject()->className()));
 			config.setValue("portable", field("portable"));
 			if (field("portable").toBool()) {
@@ -208,6 +210,7 @@ void ProfileCreationWizard::done(int result)
 			config.beginGroup(QLatin1String("plugins/list"));
 			config.setValue(QLatin1String("Updater::UpdaterPlugin"), field(QLatin1String("portable")).toBool());
 		}
+		CryptoService::setStorageEncrypted(field("encryptStorage").toBool());
 		QTimer::singleShot(0, m_manager, SLOT(initExtensions()));
 	} else if (m_singleProfile) {
 		QTimer::singleShot(0, qApp, SLOT(quit()));
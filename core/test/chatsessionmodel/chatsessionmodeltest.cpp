@@ -0,0 +1,213 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+** Copyright © 2013 Roman Tretyakov <roman@trett.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+
+#include "chatsessionmodel.h"
+#include <qutim/protocol.h>
+#include <qutim/account.h>
+#include <qutim/buddy.h>
+#include <QtTest>
+
+using namespace qutim_sdk_0_3;
+using namespace Core::AdiumChat;
+
+class TestProtocol : public Protocol
+{
+	Q_OBJECT
+	Q_CLASSINFO("Protocol", "test")
+public:
+	virtual QList<Account*> accounts() const { return QList<Account*>(); }
+	virtual Account *account(const QString &) const { return 0; }
+private:
+	virtual void loadAccounts() {}
+};
+
+class TestAccount : public Account
+{
+	Q_OBJECT
+public:
+	TestAccount(Protocol *protocol) : Account(QLatin1String("account"), protocol) {}
+	virtual ChatUnit *getUnit(const QString &, bool) { return 0; }
+protected:
+	virtual void doConnectToServer() {}
+	virtual void doDisconnectFromServer() {}
+	virtual void doStatusChange(const Status &) {}
+};
+
+class TestBuddy : public Buddy
+{
+	Q_OBJECT
+	Q_PROPERTY(int priority READ priority NOTIFY priorityChanged)
+public:
+	TestBuddy(const QString &title, Account *account, int priority = 0) :
+		Buddy(account), m_title(title), m_priority(priority) {}
+	virtual QString id() const { return m_title; }
+	virtual QString title() const { return m_title; }
+	virtual bool sendMessage(const Message &) { return true; }
+	int priority() const { return m_priority; }
+	void setTitle(const QString &title)
+	{
+		const QString previous = m_title;
+		m_title = title;
+		emit titleChanged(title, previous);
+	}
+signals:
+	void priorityChanged(int oldPriority, int newPriority);
+private:
+	QString m_title;
+	int m_priority;
+};
+
+class ChatSessionModelTest : public QObject
+{
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanupTestCase();
+	void init();
+	void cleanup();
+	void addToEmpty();
+	void merge();
+	void addContact();
+
+private:
+	TestBuddy *buddy(const QString &title, int priority = 0);
+	QStringList titles() const;
+
+	TestProtocol *m_protocol;
+	TestAccount *m_account;
+	ChatSessionModel *m_model;
+	QList<TestBuddy*> m_buddies;
+};
+
+void ChatSessionModelTest::initTestCase()
+{
+	m_protocol = new TestProtocol;
+	m_account = new TestAccount(m_protocol);
+}
+
+void ChatSessionModelTest::cleanupTestCase()
+{
+	delete m_account;
+	delete m_protocol;
+}
+
+void ChatSessionModelTest::init()
+{
+	m_model = new ChatSessionModel;
+}
+
+void ChatSessionModelTest::cleanup()
+{
+	delete m_model;
+	qDeleteAll(m_buddies);
+	m_buddies.clear();
+}
+
+TestBuddy *ChatSessionModelTest::buddy(const QString &title, int priority)
+{
+	TestBuddy *buddy = new TestBuddy(title, m_account, priority);
+	m_buddies << buddy;
+	return buddy;
+}
+
+QStringList ChatSessionModelTest::titles() const
+{
+	QStringList result;
+	for (int i = 0; i < m_model->rowCount(); ++i)
+		result << m_model->index(i).data().toString();
+	return result;
+}
+
+void ChatSessionModelTest::addToEmpty()
+{
+	TestBuddy *carol = buddy("carol");
+	TestBuddy *alice = buddy("Alice");
+	TestBuddy *bob = buddy("bob");
+	TestBuddy *moderator = buddy("zed", 10);
+	QSignalSpy inserted(m_model, SIGNAL(rowsInserted(QModelIndex,int,int)));
+	QSignalSpy reset(m_model, SIGNAL(modelReset()));
+
+	m_model->addContacts(QList<Buddy*>() << carol << alice << bob << alice << moderator << carol);
+
+	// Higher priority goes first, then titles regardless of the case
+	QCOMPARE(titles(), QStringList() << "zed" << "Alice" << "bob" << "carol");
+	QCOMPARE(inserted.count(), 1);
+	QCOMPARE(inserted.first().at(1).toInt(), 0);
+	QCOMPARE(inserted.first().at(2).toInt(), 3);
+	QCOMPARE(reset.count(), 0);
+
+	// Nothing new, nothing changes
+	m_model->addContacts(QList<Buddy*>() << bob << alice);
+	QCOMPARE(inserted.count(), 1);
+	QCOMPARE(reset.count(), 0);
+	QCOMPARE(m_model->rowCount(), 4);
+}
+
+void ChatSessionModelTest::merge()
+{
+	TestBuddy *bob = buddy("bob");
+	TestBuddy *dave = buddy("dave");
+	m_model->addContact(dave);
+	m_model->addContact(bob);
+	QCOMPARE(titles(), QStringList() << "bob" << "dave");
+
+	TestBuddy *alice = buddy("alice");
+	TestBuddy *carol = buddy("carol");
+	TestBuddy *eve = buddy("eve");
+	TestBuddy *twin = buddy("bob");
+	QSignalSpy inserted(m_model, SIGNAL(rowsInserted(QModelIndex,int,int)));
+	QSignalSpy reset(m_model, SIGNAL(modelReset()));
+	m_model->addContacts(QList<Buddy*>() << eve << dave << carol << alice << twin << eve);
+
+	QCOMPARE(titles(), QStringList() << "alice" << "bob" << "bob" << "carol" << "dave" << "eve");
+	QCOMPARE(reset.count(), 1);
+	QCOMPARE(inserted.count(), 0);
+	// Buddies with the same title keep the order of pointers
+	const int first = bob < twin ? 1 : 2;
+	QCOMPARE(m_model->index(first).data(BuddyRole).value<Buddy*>(), static_cast<Buddy*>(bob));
+	QCOMPARE(m_model->index(3 - first).data(BuddyRole).value<Buddy*>(), static_cast<Buddy*>(twin));
+
+	// Merged buddies are watched as well as the old ones
+	eve->setTitle("aaron");
+	QCOMPARE(titles(), QStringList() << "aaron" << "alice" << "bob" << "bob" << "carol" << "dave");
+	m_buddies.removeOne(carol);
+	delete carol;
+	QCOMPARE(titles(), QStringList() << "aaron" << "alice" << "bob" << "bob" << "dave");
+	m_model->removeContact(dave);
+	QCOMPARE(titles(), QStringList() << "aaron" << "alice" << "bob" << "bob");
+}
+
+void ChatSessionModelTest::addContact()
+{
+	TestBuddy *bob = buddy("bob");
+	m_model->addContacts(QList<Buddy*>() << bob);
+	// Single additions are deduplicated against the batch ones
+	m_model->addContact(bob);
+	m_model->addContact(buddy("alice"));
+	QCOMPARE(titles(), QStringList() << "alice" << "bob");
+}
+
+QTEST_MAIN(ChatSessionModelTest)
+#include "chatsessionmodeltest.moc"
@@ -0,0 +1,188 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "chatspellchecker.h"
+#include <QtTest>
+#include <QTextDocument>
+#include <QTextLayout>
+#include <QCryptographicHash>
+
+using namespace Core;
+
+// Dictionary lookup of a real speller is much slower than the cache lookup,
+// the fake one spends some time per word to make it visible
+class FakeSpellChecker : public SpellChecker
+{
+public:
+	FakeSpellChecker() : checks(0) {}
+
+	bool isCorrect(const QString &word) const
+	{
+		++checks;
+		QByteArray hash = word.toUtf8();
+		for (int i = 0; i < 100; ++i)
+			hash = QCryptographicHash::hash(hash, QCryptographicHash::Md5);
+		return !word.startsWith(QLatin1String("xx"));
+	}
+	QStringList suggest(const QString &) const { return QStringList(); }
+	void store(const QString &) const {}
+	void storeReplacement(const QString &, const QString &) {}
+
+	mutable int checks;
+};
+
+class SpellCheckerBenchmark : public QObject
+{
+	Q_OBJECT
+private slots:
+	void init();
+	void cleanup();
+	void highlight();
+	void wordsOutliveText();
+	void switchLanguage();
+	void coldCache();
+	void warmCache();
+
+private:
+	static QString text(int words);
+	static int underlined(QTextDocument *doc);
+	void finishChecks(const QString &lastWord);
+
+	FakeSpellChecker *m_speller;
+};
+
+QString SpellCheckerBenchmark::text(int words)
+{
+	QString result;
+	for (int i = 0; i < words; ++i) {
+		result += (i % 10 == 0) ? QStringLiteral("xxword%1").arg(i % 500) : QStringLiteral("word%1").arg(i % 500);
+		result += (i % 12 == 11) ? QLatin1Char('\n') : QLatin1Char(' ');
+	}
+	return result;
+}
+
+int SpellCheckerBenchmark::underlined(QTextDocument *doc)
+{
+	int count = 0;
+	for (QTextBlock block = doc->begin(); block.isValid(); block = block.next()) {
+		foreach (const QTextLayout::FormatRange &range, block.layout()->additionalFormats()) {
+			if (range.format.underlineStyle() == QTextCharFormat::SpellCheckUnderline)
+				++count;
+		}
+	}
+	return count;
+}
+
+void SpellCheckerBenchmark::finishChecks(const QString &lastWord)
+{
+	// Words are checked in portions from the event loop in order of appearance
+	QTRY_VERIFY(SpellCache::instance()->check(lastWord) != SpellCache::Unknown);
+}
+
+void SpellCheckerBenchmark::init()
+{
+	m_speller = new FakeSpellChecker;
+	SpellCache::instance()->setSpellChecker(m_speller);
+	SpellCache::instance()->setLanguage(QStringLiteral("en"));
+}
+
+void SpellCheckerBenchmark::cleanup()
+{
+	SpellCache::instance()->setSpellChecker(0);
+	delete m_speller;
+}
+
+void SpellCheckerBenchmark::highlight()
+{
+	QTextDocument doc;
+	new SpellHighlighter(&doc);
+	doc.setPlainText(text(1200));
+	// Nothing is known yet, so nothing is underlined until the checks are done
+	QCOMPARE(underlined(&doc), 0);
+	finishChecks(QStringLiteral("word499"));
+	QTRY_COMPARE(underlined(&doc), 120);
+	QCOMPARE(m_speller->checks, 500);
+}
+
+void SpellCheckerBenchmark::wordsOutliveText()
+{
+	{
+		QTextDocument doc;
+		new SpellHighlighter(&doc);
+		doc.setPlainText(text(100));
+		doc.clear();
+	}
+	// Queued words must not refer to the destroyed text
+	finishChecks(QStringLiteral("word99"));
+	SpellCache *cache = SpellCache::instance();
+	QCOMPARE(cache->check(QStringLiteral("word1")), SpellCache::Correct);
+	QCOMPARE(cache->check(QStringLiteral("xxword10")), SpellCache::Misspelled);
+}
+
+void SpellCheckerBenchmark::switchLanguage()
+{
+	SpellCache *cache = SpellCache::instance();
+	QVERIFY(cache->isCorrect(QStringLiteral("word")));
+	cache->setLanguage(QStringLiteral("de"));
+	QVERIFY(cache->isCorrect(QStringLiteral("word")));
+	QCOMPARE(m_speller->checks, 2);
+	// Results of the previous language are still there
+	cache->setLanguage(QStringLiteral("en"));
+	QVERIFY(cache->isCorrect(QStringLiteral("word")));
+	QCOMPARE(m_speller->checks, 2);
+}
+
+void SpellCheckerBenchmark::coldCache()
+{
+	QTextDocument doc;
+	SpellHighlighter *highlighter = new SpellHighlighter(&doc);
+	doc.setPlainText(text(1200));
+	finishChecks(QStringLiteral("word499"));
+	QBENCHMARK {
+		SpellCache::instance()->clear();
+		foreach (const QString &word, text(1200).split(QRegExp(QStringLiteral("\\s+")), QString::SkipEmptyParts))
+			SpellCache::instance()->isCorrect(word);
+		highlighter->rehighlight();
+	}
+	QCOMPARE(underlined(&doc), 120);
+}
+
+void SpellCheckerBenchmark::warmCache()
+{
+	QTextDocument doc;
+	SpellHighlighter *highlighter = new SpellHighlighter(&doc);
+	doc.setPlainText(text(1200));
+	finishChecks(QStringLiteral("word499"));
+	const int checks = m_speller->checks;
+	QBENCHMARK {
+		highlighter->rehighlight();
+	}
+	QCOMPARE(m_speller->checks, checks);
+	QCOMPARE(underlined(&doc), 120);
+}
+
+QTEST_MAIN(SpellCheckerBenchmark)
+
+#include "spellcheckerbenchmark.moc"
@@ -0,0 +1,231 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <qutim/protocol.h>
+#include <qutim/account.h>
+#include <qutim/buddy.h>
+#include <qutim/statuschangebus.h>
+
+using namespace qutim_sdk_0_3;
+
+// Replays login of a large roster: every buddy comes online at once, then
+// a part of them changes the status text
+
+class FakeProtocol : public Protocol
+{
+	Q_OBJECT
+	Q_CLASSINFO("Protocol", "fake")
+public:
+	QList<Account*> accounts() const { return QList<Account*>(); }
+	Account *account(const QString &) const { return 0; }
+private:
+	void loadAccounts() {}
+};
+
+class FakeAccount : public Account
+{
+	Q_OBJECT
+public:
+	FakeAccount(Protocol *protocol) : Account(QStringLiteral("account"), protocol) {}
+	ChatUnit *getUnit(const QString &, bool) { return 0; }
+protected:
+	void doConnectToServer() {}
+	void doDisconnectFromServer() {}
+	void doStatusChange(const Status &) {}
+};
+
+class FakeBuddy : public Buddy
+{
+	Q_OBJECT
+public:
+	FakeBuddy(const QString &id, Account *account)
+		: Buddy(account), m_id(id), m_status(Status::Offline) {}
+	QString id() const { return m_id; }
+	Status status() const { return m_status; }
+	bool sendMessage(const Message &) { return false; }
+	void setStatus(const Status &status)
+	{
+		const Status previous = m_status;
+		m_status = status;
+		emit statusChanged(m_status, previous);
+	}
+private:
+	QString m_id;
+	Status m_status;
+};
+
+// Keeps the number of online buddies like the contact list model does
+class Receiver : public QObject
+{
+	Q_OBJECT
+public:
+	Receiver() : online(0), calls(0) {}
+	int online;
+	int calls;
+public slots:
+	void onStatusChanged(const qutim_sdk_0_3::Status &current, const qutim_sdk_0_3::Status &previous)
+	{
+		++calls;
+		const bool isOnline = current != Status::Offline;
+		if (isOnline != (previous != Status::Offline))
+			online += isOnline ? 1 : -1;
+	}
+	void onStatusesChanged(const qutim_sdk_0_3::StatusChangeList &changes)
+	{
+		++calls;
+		foreach (const StatusChange &change, changes) {
+			if (change.isOnlineChanged())
+				online += change.type != Status::Offline ? 1 : -1;
+		}
+	}
+};
+
+class StatusBusBenchmark : public QObject
+{
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanupTestCase();
+	void init();
+	void mergedChanges();
+	void destroyedBuddy();
+	void directLogin();
+	void batchedLogin();
+
+private:
+	void replay();
+
+	FakeProtocol *m_protocol;
+	FakeAccount *m_account;
+	QList<FakeBuddy*> m_buddies;
+};
+
+enum { RosterSize = 5000 };
+
+void StatusBusBenchmark::initTestCase()
+{
+	m_protocol = new FakeProtocol;
+	m_account = new FakeAccount(m_protocol);
+	for (int i = 0; i < RosterSize; ++i)
+		m_buddies << new FakeBuddy(QString::number(i), m_account);
+	QVERIFY(StatusChangeBus::instance());
+}
+
+void StatusBusBenchmark::cleanupTestCase()
+{
+	qDeleteAll(m_buddies);
+	delete m_account;
+	delete m_protocol;
+}
+
+void StatusBusBenchmark::init()
+{
+	foreach (FakeBuddy *buddy, m_buddies)
+		buddy->setStatus(Status(Status::Offline));
+	StatusChangeBus::instance()->flush();
+}
+
+void StatusBusBenchmark::replay()
+{
+	foreach (FakeBuddy *buddy, m_buddies)
+		buddy->setStatus(Status(Status::Online));
+	for (int i = 0; i < m_buddies.size(); i += 3) {
+		Status status = m_buddies.at(i)->status();
+		status.setText(QStringLiteral("text %1").arg(i));
+		m_buddies.at(i)->setStatus(status);
+	}
+}
+
+void StatusBusBenchmark::mergedChanges()
+{
+	Receiver receiver;
+	StatusChangeBus *bus = StatusChangeBus::instance();
+	connect(bus, &StatusChangeBus::changed, &receiver, &Receiver::onStatusesChanged);
+	QSignalSpy spy(bus, SIGNAL(changed(qutim_sdk_0_3::StatusChangeList)));
+
+	FakeBuddy *buddy = m_buddies.first();
+	buddy->setStatus(Status(Status::Online));
+	Status away(Status::Away);
+	away.setText(QStringLiteral("away"));
+	buddy->setStatus(away);
+	QTRY_COMPARE(spy.count(), 1);
+
+	const StatusChangeList changes = spy.at(0).at(0).value<StatusChangeList>();
+	QCOMPARE(changes.size(), 1);
+	QCOMPARE(changes.at(0).buddy.data(), static_cast<Buddy*>(buddy));
+	QCOMPARE(changes.at(0).previousType, Status::Offline);
+	QCOMPARE(changes.at(0).type, Status::Away);
+	QVERIFY(changes.at(0).textChanged);
+	QCOMPARE(receiver.online, 1);
+}
+
+void StatusBusBenchmark::destroyedBuddy()
+{
+	StatusChangeBus *bus = StatusChangeBus::instance();
+	QSignalSpy spy(bus, SIGNAL(changed(qutim_sdk_0_3::StatusChangeList)));
+	FakeBuddy *buddy = new FakeBuddy(QStringLiteral("temporary"), m_account);
+	buddy->setStatus(Status(Status::Online));
+	delete buddy;
+	bus->flush();
+	QCOMPARE(spy.count(), 0);
+}
+
+void StatusBusBenchmark::directLogin()
+{
+	Receiver receiver;
+	foreach (FakeBuddy *buddy, m_buddies) {
+		connect(buddy, SIGNAL(statusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)),
+				&receiver, SLOT(onStatusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)));
+	}
+	QBENCHMARK {
+		init();
+		receiver.online = 0;
+		replay();
+	}
+	QCOMPARE(receiver.online, int(RosterSize));
+	foreach (FakeBuddy *buddy, m_buddies)
+		buddy->disconnect(&receiver);
+}
+
+void StatusBusBenchmark::batchedLogin()
+{
+	Receiver receiver;
+	StatusChangeBus *bus = StatusChangeBus::instance();
+	connect(bus, &StatusChangeBus::changed, &receiver, &Receiver::onStatusesChanged);
+	QBENCHMARK {
+		init();
+		receiver.online = 0;
+		receiver.calls = 0;
+		replay();
+		bus->flush();
+	}
+	QCOMPARE(receiver.online, int(RosterSize));
+	QCOMPARE(receiver.calls, 1);
+}
+
+QTEST_MAIN(StatusBusBenchmark)
+
+#include "statusbusbenchmark.moc"
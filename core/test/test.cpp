@@ -22,238 +22,182 @@
 ** $QUTIM_END_LICENSE$
 **
 ****************************************************************************/
-#include <QtCore>
-#include <QDebug>
-#include <QTextCodec>
 
+/*
+  Benchmark of JSON record scanning used by history and config backends.
 
-#include "k8json.h"
-
+  Every input file is split to records both by plain k8json and by
+  qutim_sdk_0_3::Json, which has vectorized fast paths. The records are
+  parsed and generated back, the results must be equal byte for byte,
+  otherwise the benchmark fails with non-zero exit code.
 
-static void testCounter () {
-  do {
+  Usage: test [-n iterations] [file.json ...]
+  By default tc_hist.json and one.json from the current directory are used.
+*/
 
-  QFile fl("tc_hist.json");
-  if (!fl.open(QIODevice::ReadOnly)) {
-	fprintf(stderr, "ERROR: can't open input file!\n");
-	return;
-  }
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QFile>
+#include <QVariant>
+#include <qutim/json.h>
+#include <cstdio>
 
-  const uchar *fmap = (const uchar *)(fl.map(0, fl.size()));
-  int len = fl.size();
-  const uchar *sj = K8JSON::skipBlanks(fmap, &len);
-  if (!sj) {
-	fprintf(stderr, "ERROR: invalid JSON file!\n");
-	break;
-  }
-  if (*sj == '[') sj++;
-  if (len < 1) {
-	fprintf(stderr, "ERROR: empty JSON file!\n");
-	break;
-  }
-  int cnt = 0;
-  QTime st;
-  st.start();
-  while (len > 0) {
-	//int ofs = sj-fmap;
-	//fprintf(stderr, "0x%08x  %i\n", ofs, cnt);
-	sj = K8JSON::skipRec(sj, &len);
-	if (!sj) {
-	  fprintf(stderr, "ERROR: invalid JSON file!\n");
-	  break;
-	}
-	cnt++;
-	switch (*sj) {
-	  case ',': sj++; len--; break;
-	  case ']': case '}': len = 0; break;
-	}
-  }
-  qDebug() << "time taken (ms):" << st.elapsed();
-  fprintf(stdout, "%i messages found.\n", cnt);
+#include "k8json.h"
 
-  } while (0);
-}
+using namespace qutim_sdk_0_3;
 
+struct Scanner
+{
+	const char *name;
+	const uchar *(*skipBlanks)(const uchar *s, int *maxLength);
+	const uchar *(*skipRecord)(const uchar *s, int *maxLength);
+};
 
-static void testReader () {
-  do {
+static const uchar *k8SkipBlanks(const uchar *s, int *maxLength)
+{
+	return K8JSON::skipBlanks(s, maxLength);
+}
 
-  QFile fl("one.json");
-  if (!fl.open(QIODevice::ReadOnly)) {
-	fprintf(stderr, "ERROR: can't open input file!\n");
-	return;
-  }
+static const uchar *k8SkipRecord(const uchar *s, int *maxLength)
+{
+	return K8JSON::skipRec(s, maxLength);
+}
 
-  const uchar *fmap = (const uchar *)(fl.map(0, fl.size()));
-  int len = fl.size();
-  const uchar *sj = K8JSON::skipBlanks(fmap, &len);
-  if (!sj) {
-	fprintf(stderr, "ERROR: invalid JSON file!\n");
-	break;
-  }
-  uchar qch = *sj;
-  if (qch != '[' && qch != '{') {
-	fprintf(stderr, "ERROR: invalid JSON file!\n");
-	break;
-  }
+static const uchar *qutimSkipBlanks(const uchar *s, int *maxLength)
+{
+	return Json::skipBlanks(s, maxLength);
+}
 
-  int cnt = 0;
-  QTime st;
-  st.start();
+static const uchar *qutimSkipRecord(const uchar *s, int *maxLength)
+{
+	return Json::skipRecord(s, maxLength);
+}
 
-  QVariant val;
-  while (sj) {
-	//int ofs = sj-fmap;
-	//fprintf(stderr, "0x%08x  %i\n", ofs, cnt);
-	if (!(sj = K8JSON::skipBlanks(sj, &len))) break;
-	val.clear();
-	sj = K8JSON::parseRecord(val, sj, &len);
-	if (!sj) {
-	  //fprintf(stderr, "ERROR: invalid JSON file!\n");
-	  break;
-	}
-	qDebug() << val;
-	QByteArray bo;
-	if (!K8JSON::generate(bo, val)) {
-	  fprintf(stderr, "ERROR: can't generate JSON!\n");
-	  break;
+static const Scanner scanners[] = {
+	{ "k8json", k8SkipBlanks, k8SkipRecord },
+	{ "qutim", qutimSkipBlanks, qutimSkipRecord }
+};
+
+// Same walk as JsonHistoryScope::findEnd does, offsets of records are stored to starts
+static bool collectRecords(const Scanner &scanner, const QByteArray &data, QList<int> *starts)
+{
+	const uchar *fmap = reinterpret_cast<const uchar *>(data.constData());
+	int len = data.size();
+	const uchar *s = scanner.skipBlanks(fmap, &len);
+	if (!s || (*s != '[' && *s != '{'))
+		return false;
+	const uchar *record = s;
+	int recordLen = len;
+	// History files are lists of records, others are single objects
+	if (*s == '[') {
+		s++;
+		len--;
+		bool first = true;
+		while (s) {
+			s = scanner.skipBlanks(s, &len);
+			if (!s || len < 1)
+				return false;
+			if (*s == ']')
+				return true;
+			if ((!first && *s != ',') || (first && *s == ','))
+				return false;
+			first = false;
+			if (*s == ',') {
+				s++;
+				len--;
+			}
+			s = scanner.skipBlanks(s, &len);
+			if (!s)
+				return false;
+			starts->append(s - fmap);
+			s = scanner.skipRecord(s, &len);
+		}
+		return false;
 	}
-	qDebug() << bo;
-	cnt++;
-  }
-  qDebug() << "time taken (ms):" << st.elapsed();
-  fprintf(stdout, "%i messages found.\n", cnt);
-
-
-  } while (0);
+	starts->append(record - fmap);
+	return scanner.skipRecord(record, &recordLen) != 0;
 }
 
-
-static void testReaderAll () {
-  do {
-
-  QFile fl("tc_hist.json");
-  if (!fl.open(QIODevice::ReadOnly)) {
-	fprintf(stderr, "ERROR: can't open input file!\n");
-	return;
-  }
-
-  const uchar *fmap = (const uchar *)(fl.map(0, fl.size()));
-  int len = fl.size();
-  const uchar *sj = K8JSON::skipBlanks(fmap, &len);
-  if (!sj) {
-	fprintf(stderr, "ERROR: invalid JSON file!\n");
-	break;
-  }
-  uchar qch = *sj;
-  if (qch != '[' && qch != '{') {
-	fprintf(stderr, "ERROR: invalid JSON file!\n");
-	break;
-  }
-  sj++; len--;
-  qch = (qch=='{' ? '}' : ']');
-
-  int cnt = 0;
-  QTime st;
-  st.start();
-
-  QVariant val;
-  while (sj) {
-	//int ofs = sj-fmap;
-	//fprintf(stderr, "0x%08x  %i\n", ofs, cnt);
-	sj = K8JSON::skipBlanks(sj, &len);
-	if (len < 2 || (sj && *sj == qch)) break;
-	if ((cnt && *sj != ',') || (!cnt && *sj == ',')) {
-	  fprintf(stderr, "ERROR: invalid JSON file (delimiter)!\n");
-	  break;
+static QByteArray dumpRecords(const QByteArray &data, const QList<int> &starts)
+{
+	const uchar *fmap = reinterpret_cast<const uchar *>(data.constData());
+	QByteArray result;
+	foreach (int start, starts) {
+		QVariant value;
+		int len = data.size() - start;
+		if (!K8JSON::parseRecord(value, fmap + start, &len))
+			result += "<invalid>";
+		else
+			Json::generate(result, value);
+		result += '\n';
 	}
-	if (*sj == ',') { sj++; len--; }
-	val.clear();
-	sj = K8JSON::parseRecord(val, sj, &len);
-	if (!sj) {
-	  fprintf(stderr, "ERROR: invalid JSON file!\n");
-	  break;
-	}
-	//qDebug() << val;
-	cnt++;
-  }
-  qDebug() << "time taken (ms):" << st.elapsed();
-  fprintf(stdout, "%i messages found.\n", cnt);
-
-  } while (0);
+	return result;
 }
 
-
-static void testReaderAll2 () {
-  do {
-
-  QFile fl("tc_hist.json");
-  if (!fl.open(QIODevice::ReadOnly)) {
-	fprintf(stderr, "ERROR: can't open input file!\n");
-	return;
-  }
-
-  const uchar *fmap = (const uchar *)(fl.map(0, fl.size()));
-  int len = fl.size();
-  const uchar *sj = K8JSON::skipBlanks(fmap, &len);
-  if (!sj) {
-	fprintf(stderr, "ERROR: invalid JSON file!\n");
-	break;
-  }
-  uchar qch = *sj;
-  if (qch != '[' && qch != '{') {
-	fprintf(stderr, "ERROR: invalid JSON file!\n");
-	break;
-  }
-
-  int cnt = 0;
-  QTime st;
-  st.start();
-
-  QVariant val;
-  sj = K8JSON::parseRecord(val, sj, &len);
-  if (!sj) {
-	fprintf(stderr, "ERROR: invalid JSON file!\n");
-	break;
-  }
-  qDebug() << "time taken (ms):" << st.elapsed();
-  //qDebug() << val;
-
-  QByteArray bo;
-  if (!K8JSON::generate(bo, val)) {
-	fprintf(stderr, "ERROR: can't generate JSON file!\n");
-	break;
-  }
-  QFile fo("000.json");
-  if (fo.open(QIODevice::WriteOnly)) {
-	fo.write(bo);
-	fo.write("\n");
-	fo.close();
-  }
-
-  } while (0);
+static qint64 bestOf(int iterations, const Scanner &scanner, const QByteArray &data)
+{
+	qint64 best = -1;
+	for (int i = 0; i < iterations; ++i) {
+		QList<int> starts;
+		QElapsedTimer timer;
+		timer.start();
+		collectRecords(scanner, data, &starts);
+		const qint64 elapsed = timer.nsecsElapsed();
+		if (best < 0 || elapsed < best)
+			best = elapsed;
+	}
+	return best;
 }
 
+static bool benchmark(const QString &fileName, int iterations)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly)) {
+		fprintf(stderr, "%s: can't open file, skipped\n", qPrintable(fileName));
+		return true;
+	}
+	const QByteArray data = file.readAll();
+
+	QByteArray dumps[2];
+	for (int i = 0; i < 2; ++i) {
+		QList<int> starts;
+		if (!collectRecords(scanners[i], data, &starts))
+			fprintf(stderr, "%s: %s failed to scan the file\n", qPrintable(fileName), scanners[i].name);
+		dumps[i] = dumpRecords(data, starts);
+	}
+	if (dumps[0] != dumps[1]) {
+		fprintf(stderr, "%s: MISMATCH, results of k8json and qutim differ\n", qPrintable(fileName));
+		return false;
+	}
 
-int main (/*int argc, char *argv[]*/) {
-  QTextCodec::setCodecForCStrings(QTextCodec::codecForName("koi8-u"));
-  QTextCodec::setCodecForLocale(QTextCodec::codecForName("koi8-u"));
-
-/*
-  const char *str = "\"this is a \\u04e3 test \\x21 string \\120!\\n\"";
-  int bp = 0;
-  qDebug() << "strlen:" << strlen(str);
-  qDebug() << "str:" << str;
-  qDebug() << K8JSON::stringLength(str, strlen(str), &bp);
-  qDebug() << " " << bp;
-//bool parseString (QString &str, const char *s, int charCount, int *bytesProcessed=0);
-*/
+	fprintf(stdout, "%s: %d bytes, %d records\n", qPrintable(fileName),
+			data.size(), dumps[0].count('\n'));
+	for (int i = 0; i < 2; ++i) {
+		const qint64 nsecs = qMax<qint64>(1, bestOf(iterations, scanners[i], data));
+		fprintf(stdout, "  %-8s %10.3f ms %10.1f MB/s\n", scanners[i].name,
+				nsecs / 1e6, data.size() * 1e3 / nsecs);
+	}
+	return true;
+}
 
-  //testCounter();
-  testReader();
-  //testReaderAll();
-  //testReaderAll2();
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QStringList files;
+	int iterations = 10;
+	QStringList arguments = app.arguments();
+	for (int i = 1; i < arguments.size(); ++i) {
+		if (arguments.at(i) == QLatin1String("-n") && i + 1 < arguments.size())
+			iterations = qMax(1, arguments.at(++i).toInt());
+		else
+			files << arguments.at(i);
+	}
+	if (files.isEmpty())
+		files << QLatin1String("tc_hist.json") << QLatin1String("one.json");
 
-  return 0;
+	bool ok = true;
+	foreach (const QString &fileName, files)
+		ok &= benchmark(fileName, iterations);
+	return ok ? 0 : 1;
 }
-
@@ -0,0 +1,353 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2012 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include <qutim/textparser.h>
+#include <qutim/emoticons.h>
+#include <qutim/message.h>
+#include <qutim/utils.h>
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QImage>
+#include <QElapsedTimer>
+#include <QUrl>
+
+using namespace qutim_sdk_0_3;
+
+// Emoticons are added from images in the temporary directory, as provider
+// reads size of every image
+class FakeProvider : public EmoticonsProvider
+{
+public:
+	FakeProvider(const QString &path)
+	{
+		const QStringList codes = QStringList()
+				<< QLatin1String(":) :-)") << QLatin1String(":(") << QLatin1String(";)")
+				<< QLatin1String(":d :-d") << QLatin1String(":p") << QLatin1String("8-)")
+				<< QLatin1String("<3") << QLatin1String(":-*");
+		QImage image(16, 16, QImage::Format_ARGB32);
+		for (int i = 0; i < codes.size(); ++i) {
+			image.fill(qRgb(i * 30, 0, 0));
+			const QString imgPath = path + QString::fromLatin1("/%1.png").arg(i);
+			image.save(imgPath);
+			appendEmoticon(imgPath, codes.at(i).split(QLatin1Char(' ')));
+		}
+	}
+
+	QString themeName() const { return QLatin1String("fake"); }
+};
+
+// Message::html() of plain text before TextParser
+static QString legacyHtml(const QString &text)
+{
+	QString html = text.toHtmlEscaped();
+	html.replace(QLatin1String("\n "), QLatin1String("<br/>&nbsp;"));
+	html.replace(QLatin1Char('\n'), QLatin1String("<br/>"));
+	html.replace(QLatin1Char('\t'), QLatin1String("&nbsp; &nbsp; "));
+	html.replace(QLatin1String("  "), QLatin1String(" &nbsp;"));
+	return html;
+}
+
+// UrlParser::tokenize before TextParser
+static UrlParser::UrlTokenList legacyTokenize(const QString &text, UrlParser::Flags flags)
+{
+	UrlParser::UrlTokenList result;
+	static QRegExp linkRegExp("([a-zA-Z0-9\\-\\_\\.]+@([a-zA-Z0-9\\-\\_]+\\.)+[a-zA-Z]+)|"
+							  "([a-z]+(\\+[a-z]+)?://|www\\.)"
+							  "[\\w-]+(\\.[\\w-]+)*\\.\\w+"
+							  "(:\\d+)?"
+							  "(/[\\w\\+\\.\\[\\]!%\\$/\\(\\),:;@'&=~-]*"
+							  "(\\?[\\w\\+\\.\\[\\]!%\\$/\\(\\),:;@\\'&=~-]*)?"
+							  "(#[\\w\\+\\.\\[\\]!%\\$/\\\\\\(\\)\\|,:;@&=~-]*)?)?",
+							  Qt::CaseInsensitive);
+	QList<QPair<int, int> > tags;
+	int currentTag = 0;
+	if (flags & UrlParser::Html) {
+		enum TagParserState {
+			AtText,
+			AtTag,
+			AtSingleQuote,
+			AtDoubleQuote
+		};
+		TagParserState state = AtText;
+		int start = 0;
+		for (int i = 0; i < text.size(); ++i) {
+			QChar ch = text.at(i);
+			switch (state) {
+			case AtText:
+				if (ch == QLatin1Char('<')) {
+					state = AtTag;
+					start = i;
+				}
+				break;
+			case AtTag:
+				if (ch == QLatin1Char('>')) {
+					tags << qMakePair(start, i);
+					state = AtText;
+				} else if (ch == QLatin1Char('\'')) {
+					state = AtSingleQuote;
+				} else if (ch == QLatin1Char('\"')) {
+					state = AtDoubleQuote;
+				}
+				break;
+			case AtSingleQuote:
+				if (ch == QLatin1Char('\''))
+					state = AtTag;
+				break;
+			case AtDoubleQuote:
+				if (ch == QLatin1Char('\"'))
+					state = AtTag;
+				break;
+			}
+		}
+	}
+	int pos = 0;
+	int lastPos = 0;
+	while (((pos = linkRegExp.indexIn(text, pos)) != -1)) {
+		QString link = linkRegExp.cap(0);
+		while (currentTag < tags.size() && tags.at(currentTag).second < pos)
+			currentTag++;
+		if (currentTag < tags.size()) {
+			const QPair<int, int> &pair = tags.at(currentTag);
+			int left = qBound(pair.first, pos, pair.second);
+			int right = qBound(pair.first, pos + link.size(), pair.second);
+			if (left != right) {
+				pos += link.size();
+				continue;
+			}
+		}
+		UrlParser::UrlToken tok = { text.midRef(lastPos, pos - lastPos), QString() };
+		if (!tok.text.isEmpty()) {
+			if (!result.isEmpty() && result.last().url.isEmpty()) {
+				QStringRef tmp = result.last().text;
+				result.last().text = QStringRef(tmp.string(), tmp.position(), tmp.size() + tok.text.size());
+			} else {
+				result << tok;
+			}
+		}
+		tok.text = text.midRef(pos, link.size());
+		pos += link.size();
+		if (flags & UrlParser::Html)
+			link = unescape(link);
+		if (link.startsWith(QLatin1String("www."), Qt::CaseInsensitive))
+			link.prepend(QLatin1String("http://"));
+		else if(!link.contains(QLatin1String("//")))
+			link.prepend(QLatin1String("mailto:"));
+		tok.url = link;
+		result << tok;
+		lastPos = pos;
+	}
+	if (!result.isEmpty() && result.last().url.isEmpty()) {
+		result.last().text = text.midRef(result.last().text.position());
+	} else {
+		UrlParser::UrlToken tok = { text.midRef(lastPos), QString() };
+		result << tok;
+	}
+	return result;
+}
+
+// UrlParser::parseUrls before TextParser
+static QString legacyParseUrls(const QString &text, UrlParser::Flags flags)
+{
+	const QString hrefTemplate(QLatin1String("<a href='%1' title='%2' target='_blank'>%3</a>"));
+	QString html;
+	foreach (const UrlParser::UrlToken &token, legacyTokenize(text, flags)) {
+		if (token.url.isEmpty()) {
+			html += token.text.toString();
+		} else {
+			QUrl url = QUrl::fromUserInput(token.url);
+			QByteArray urlEncoded = url.toEncoded();
+			html += hrefTemplate.arg(QString::fromLatin1(urlEncoded, urlEncoded.size()),
+									 url.toString(),
+									 token.text.toString());
+		}
+	}
+	return html;
+}
+
+// Message::formattedHtml before TextParser: text was escaped, then html
+// was parsed by regular expression and at last by emoticons theme
+static QString legacyFormattedHtml(const QString &text, EmoticonsTheme &theme)
+{
+	return theme.parseEmoticons(legacyParseUrls(legacyHtml(text), UrlParser::Html));
+}
+
+static QString formattedHtml(const QString &text, const EmoticonsTheme &theme)
+{
+	const TextParser::Flags flags = TextParser::Urls | TextParser::Emoticons;
+	return TextParser::toHtml(TextParser::tokenize(text, flags, theme), flags);
+}
+
+class TextParserBenchmark : public QObject
+{
+	Q_OBJECT
+public:
+	TextParserBenchmark() : m_theme(0) {}
+private slots:
+	void initTestCase();
+	void urls();
+	void equivalence();
+	void formattedHtml_data();
+	void formattedHtml();
+private:
+	QTemporaryDir m_dir;
+	EmoticonsTheme m_theme;
+	QStringList m_messages;
+};
+
+// Chat messages are generated by fixed seed, so every run parses the same
+// corpus. Urls and emoticons are separated from each other by spaces: new
+// parser starts urls only at word boundaries and doesn't look for
+// emoticons inside of links, old one did both.
+void TextParserBenchmark::initTestCase()
+{
+	QVERIFY(m_dir.isValid());
+	m_theme = EmoticonsTheme::fromProvider(new FakeProvider(m_dir.path()));
+	QVERIFY(!m_theme.isNull());
+
+	const QStringList words = QString::fromUtf8(
+				"hi hello yes no ok well the a is it to of and in that "
+				"have you this for not on with he as do at but his by from "
+				"they we say her she or an will my one all would there "
+				"привет да нет как дела что это сегодня завтра посмотри "
+				"ссылка работает спасибо пока "
+				"R&D \"quoted\" a<b x>y 3.14 e.g. -- ... (yes) don't it's").split(QLatin1Char(' '));
+	const QStringList emoticons = QStringList()
+			<< QLatin1String(":)") << QLatin1String(":-)") << QLatin1String(":(")
+			<< QLatin1String(";)") << QLatin1String(":D") << QLatin1String(":p")
+			<< QLatin1String("8-)") << QLatin1String("<3") << QLatin1String(":-*");
+	const QStringList urls = QStringList()
+			<< QLatin1String("http://qutim.org")
+			<< QLatin1String("https://github.com/euroelessar/qutim/issues/123")
+			<< QLatin1String("www.example.com/path/to/page.html")
+			<< QLatin1String("http://example.com:8080/search?q=qutim&lang=ru#results")
+			<< QLatin1String("https://ru.wikipedia.org/wiki/Instant_messaging")
+			<< QLatin1String("ftp://files.example.org/pub/qutim-0.3.tar.gz")
+			<< QLatin1String("http://example.com/a_(b)/c,d;e=f")
+			<< QLatin1String("www.qutim.org");
+	const QStringList emails = QStringList()
+			<< QLatin1String("euroelessar@yandex.ru")
+			<< QLatin1String("john.smith@mail.example.org")
+			<< QLatin1String("support-team_1@qutim.org");
+	const QStringList separators = QStringList()
+			<< QLatin1String(" ") << QLatin1String(" ") << QLatin1String(" ")
+			<< QLatin1String(" ") << QLatin1String(", ") << QLatin1String(". ")
+			<< QLatin1String("! ") << QLatin1String("  ") << QLatin1String("\n")
+			<< QLatin1String("\n  ") << QLatin1String("\t") << QLatin1String("   ");
+
+	quint32 seed = 42;
+	auto random = [&seed] (int max) {
+		seed = seed * 1103515245 + 12345;
+		return int((seed >> 16) % max);
+	};
+	for (int i = 0; i < 5000; ++i) {
+		QString message;
+		bool afterUrl = false;
+		const int count = 1 + random(40);
+		for (int j = 0; j < count; ++j) {
+			if (j > 0) {
+				const QString &separator = separators.at(random(separators.size()));
+				// Old parser looked for urls in escaped html and appended
+				// "&nbsp;" of a tab to the path
+				message += afterUrl && separator == QLatin1String("\t") ? QLatin1String(" ") : separator;
+			}
+			const int kind = random(100);
+			afterUrl = kind < 8;
+			if (kind < 8) {
+				message += urls.at(random(urls.size()));
+				// Punctuation after link is a part of its path
+				if (random(4) == 0)
+					message += QLatin1Char('.');
+			} else if (kind < 10) {
+				message += emails.at(random(emails.size()));
+			} else if (kind < 20) {
+				message += emoticons.at(random(emoticons.size()));
+			} else {
+				message += words.at(random(words.size()));
+				// Emoticons are often attached to the previous word
+				if (random(10) == 0)
+					message += emoticons.at(random(emoticons.size()));
+			}
+		}
+		m_messages << message;
+	}
+}
+
+void TextParserBenchmark::urls()
+{
+	foreach (const QString &message, m_messages) {
+		const UrlParser::UrlTokenList expected = legacyTokenize(message, UrlParser::None);
+		const UrlParser::UrlTokenList actual = UrlParser::tokenize(message);
+		QCOMPARE(actual.size(), expected.size());
+		for (int i = 0; i < actual.size(); ++i) {
+			QCOMPARE(actual.at(i).text.toString(), expected.at(i).text.toString());
+			QCOMPARE(actual.at(i).url, expected.at(i).url);
+		}
+	}
+}
+
+void TextParserBenchmark::equivalence()
+{
+	foreach (const QString &message, m_messages) {
+		const QString expected = legacyFormattedHtml(message, m_theme);
+		const QString actual = ::formattedHtml(message, m_theme);
+		QVERIFY2(actual == expected, qPrintable(QString::fromLatin1("%1\nold: %2\nnew: %3")
+												.arg(message, expected, actual)));
+	}
+}
+
+void TextParserBenchmark::formattedHtml_data()
+{
+	QTest::addColumn<bool>("legacy");
+
+	QTest::newRow("regexp and emoticons") << true;
+	QTest::newRow("text parser") << false;
+}
+
+void TextParserBenchmark::formattedHtml()
+{
+	QFETCH(bool, legacy);
+
+	int size = 0;
+	foreach (const QString &message, m_messages)
+		size += message.size();
+
+	QElapsedTimer timer;
+	timer.start();
+	int runs = 0;
+	QBENCHMARK {
+		foreach (const QString &message, m_messages) {
+			if (legacy)
+				legacyFormattedHtml(message, m_theme);
+			else
+				::formattedHtml(message, m_theme);
+		}
+		++runs;
+	}
+	qDebug("%d messages, %.1f MB/s", m_messages.size(),
+		   size * 2.0 * runs / 1024 / 1024 / qMax<qint64>(1, timer.elapsed()) * 1000);
+}
+
+QTEST_MAIN(TextParserBenchmark)
+#include "textparserbenchmark.moc"
@@ -0,0 +1,256 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "textviewcontroller.h"
+#include <qutim/message.h>
+#include <QTextCursor>
+#include <QTextBlock>
+#include <QElapsedTimer>
+#include <QtTest>
+
+using namespace qutim_sdk_0_3;
+using namespace Core::AdiumChat;
+
+// Same as in textviewcontroller.cpp
+enum { EmoticonObjectType = 0x666 };
+
+class TestTextViewController : public QObject
+{
+	Q_OBJECT
+private slots:
+	void init();
+	void cleanup();
+	void appendBounded();
+	void receiptsAfterTrim();
+	void prependHistory();
+
+private:
+	Message message(int i, bool history = false);
+	void append(int i);
+	bool checkIndexes(QString *error);
+	QList<int> emoticonPositions();
+
+	TextViewController *m_controller;
+	QDateTime m_start;
+	QList<quint64> m_outgoing;
+};
+
+void TestTextViewController::init()
+{
+	m_controller = new TextViewController;
+	m_controller->m_maxBlockCount = 1000;
+	m_controller->m_limit = 1000;
+	m_controller->m_animateEmoticons = true;
+	m_start = QDateTime(QDate(2012, 1, 1), QTime(12, 0));
+	m_outgoing.clear();
+}
+
+void TestTextViewController::cleanup()
+{
+	delete m_controller;
+	m_controller = 0;
+}
+
+Message TestTextViewController::message(int i, bool history)
+{
+	Message msg(QString::fromLatin1("message number %1").arg(i));
+	// Three incoming messages are grouped together, then two outgoing ones
+	msg.setIncoming(i % 5 < 3);
+	msg.setTime(m_start.addSecs(qint64(i) * 60));
+	msg.setProperty("senderName", QString::fromLatin1(msg.isIncoming() ? "Alice" : "Bob"));
+	if (history)
+		msg.setProperty("history", true);
+	return msg;
+}
+
+void TestTextViewController::append(int i)
+{
+	Message msg = message(i);
+	m_controller->appendMessage(msg);
+	if (!msg.isIncoming())
+		m_outgoing << msg.id();
+	if (i % 7 == 0) {
+		QTextCursor cursor(m_controller);
+		cursor.movePosition(QTextCursor::End);
+		m_controller->insertEmoticon(cursor, QLatin1String(i % 2 ? "smile.gif" : "wink.gif"),
+									 QLatin1String(":)"));
+	}
+}
+
+QList<int> TestTextViewController::emoticonPositions()
+{
+	QList<int> positions;
+	for (QTextBlock block = m_controller->begin(); block.isValid(); block = block.next()) {
+		for (QTextBlock::iterator it = block.begin(); !it.atEnd(); ++it) {
+			const QTextFragment fragment = it.fragment();
+			if (fragment.charFormat().objectType() != EmoticonObjectType)
+				continue;
+			for (int i = 0; i < fragment.length(); ++i)
+				positions << fragment.position() + i;
+		}
+	}
+	return positions;
+}
+
+// Every cached bullet and every emoticon index must point to its object
+bool TestTextViewController::checkIndexes(QString *error)
+{
+	foreach (qint64 id, m_controller->m_cache.keys()) {
+		const int pos = *m_controller->m_cache.object(id);
+		QTextCursor cursor(m_controller);
+		cursor.setPosition(pos + 1);
+		const QTextCharFormat format = cursor.charFormat();
+		if (m_controller->characterAt(pos) != QChar::ObjectReplacementCharacter
+				|| !format.isImageFormat()
+				|| format.toImageFormat().name() != QLatin1String("bullet-send")) {
+			*error = QString::fromLatin1("Message %1 is cached at %2, which is not a bullet").arg(id).arg(pos);
+			return false;
+		}
+	}
+	QList<int> indexed;
+	for (int i = 0; i < m_controller->m_emoticons.size(); ++i) {
+		const QVector<int> &indexes = m_controller->m_emoticons.at(i).movie->indexes;
+		for (int j = 0; j < indexes.size(); ++j) {
+			const int pos = indexes.at(j);
+			if (j > 0 && indexes.at(j - 1) >= pos) {
+				*error = QString::fromLatin1("Indexes of emoticon %1 are not sorted").arg(i);
+				return false;
+			}
+			QTextCursor cursor(m_controller);
+			cursor.setPosition(pos + 1);
+			const QTextCharFormat format = cursor.charFormat();
+			if (format.objectType() != EmoticonObjectType
+					|| format.intProperty(QTextFormat::UserProperty) != i) {
+				*error = QString::fromLatin1("Emoticon %1 is indexed at %2, which is not it").arg(i).arg(pos);
+				return false;
+			}
+			indexed << pos;
+		}
+	}
+	std::sort(indexed.begin(), indexed.end());
+	if (indexed != emoticonPositions()) {
+		*error = QString::fromLatin1("%1 emoticons are indexed, but document has %2")
+				.arg(indexed.size()).arg(emoticonPositions().size());
+		return false;
+	}
+	return true;
+}
+
+void TestTextViewController::appendBounded()
+{
+	const int count = 200000;
+	const int limit = m_controller->m_maxBlockCount;
+	// Trim removes blocks by chunks of the tenth of the limit, one message adds two blocks
+	const int bound = limit + limit / 10 + 2;
+	int maxBlockCount = 0;
+	QString error;
+	QElapsedTimer timer;
+	timer.start();
+	for (int i = 0; i < count; ++i) {
+		append(i);
+		maxBlockCount = qMax(maxBlockCount, m_controller->blockCount());
+		if (m_controller->blockCount() > bound)
+			QFAIL(qPrintable(QString::fromLatin1("%1 blocks after %2 messages, limit is %3")
+							 .arg(m_controller->blockCount()).arg(i + 1).arg(bound)));
+		if (i % 10000 == 9999)
+			QVERIFY2(checkIndexes(&error), qPrintable(error));
+	}
+	const qint64 elapsed = qMax<qint64>(timer.elapsed(), 1);
+	qDebug("%d messages in %lld ms, %.0f messages/sec, at most %d blocks",
+		   count, elapsed, count * 1000.0 / elapsed, maxBlockCount);
+	QVERIFY(m_controller->blockCount() >= limit);
+	QVERIFY2(checkIndexes(&error), qPrintable(error));
+	QVERIFY(m_controller->canLoadOlder());
+}
+
+void TestTextViewController::receiptsAfterTrim()
+{
+	for (int i = 0; i < 5000; ++i)
+		append(i);
+	QString error;
+	QVERIFY2(checkIndexes(&error), qPrintable(error));
+
+	// Positions of recent messages survived trims, receipts replace their bullets
+	int checked = 0;
+	for (int i = m_outgoing.size() - 1; i >= 0 && checked < 10; --i, ++checked) {
+		const quint64 id = m_outgoing.at(i);
+		QVERIFY(m_controller->m_cache.contains(id));
+		const int pos = *m_controller->m_cache.object(id);
+		MessageReceiptEvent event(id, checked % 2);
+		QVERIFY(m_controller->eventFilter(m_controller, &event));
+		QVERIFY(!m_controller->m_cache.contains(id));
+		QTextCursor cursor(m_controller);
+		cursor.setPosition(pos + 1);
+		QCOMPARE(cursor.charFormat().toImageFormat().name(),
+				 QString::fromLatin1(checked % 2 ? "bullet-received" : "bullet-error"));
+	}
+	QVERIFY2(checkIndexes(&error), qPrintable(error));
+
+	// Messages removed by trim are not cached anymore
+	QVERIFY(!m_controller->m_cache.contains(m_outgoing.first()));
+}
+
+void TestTextViewController::prependHistory()
+{
+	for (int i = 0; i < 2000; ++i)
+		append(i + 1000);
+	QString error;
+	QVERIFY2(checkIndexes(&error), qPrintable(error));
+	const QList<int> emoticons = emoticonPositions();
+	const int cached = m_controller->m_cache.count();
+	const QString text = m_controller->toPlainText();
+	const int oldLength = m_controller->characterCount();
+	const int oldBlockCount = m_controller->blockCount();
+	const int oldLimit = m_controller->m_limit;
+
+	MessageList page;
+	for (int i = 0; i < 50; ++i)
+		page << message(i, true);
+	m_controller->prependMessages(page);
+
+	// Older page is added at the top and the limit is extended for it
+	QVERIFY(m_controller->toPlainText().endsWith(text));
+	QVERIFY(m_controller->toPlainText().startsWith(QLatin1String("\nAlice")));
+	const int delta = m_controller->characterCount() - oldLength;
+	QCOMPARE(m_controller->m_limit, oldLimit + m_controller->blockCount() - oldBlockCount);
+	QCOMPARE(m_controller->m_cache.count(), cached);
+	QList<int> shifted;
+	foreach (int pos, emoticons)
+		shifted << pos + delta;
+	QCOMPARE(emoticonPositions(), shifted);
+	QVERIFY2(checkIndexes(&error), qPrintable(error));
+
+	// The first new message at the bottom drops the extended limit and trims the history page
+	m_controller->m_limit = m_controller->m_maxBlockCount;
+	for (int i = 0; i < 200; ++i)
+		append(i + 3000);
+	QVERIFY(!m_controller->toPlainText().contains(QLatin1String("message number 0\n")));
+	QVERIFY(m_controller->blockCount() <= m_controller->m_maxBlockCount
+			+ m_controller->m_maxBlockCount / 10 + 2);
+	QVERIFY2(checkIndexes(&error), qPrintable(error));
+}
+
+QTEST_MAIN(TestTextViewController)
+#include "textviewtest.moc"
@@ -0,0 +1,205 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include <qutim/timerservice.h>
+#include <QtTest>
+
+using namespace qutim_sdk_0_3;
+
+class TimerServiceTest : public QObject
+{
+	Q_OBJECT
+private slots:
+	void init();
+	void cleanup();
+	void typicalTimers();
+	void stoppedByHandler();
+	void restartedByHandler();
+	void deletedByHandler();
+	void serviceDestroyed();
+
+private:
+	CoalescingTimer *createTimer(const char *owner, int interval, bool singleShot = false);
+	// Fires all wakeups up to the moment by the simulated clock
+	void run(qint64 until);
+
+	qint64 m_now;
+	QHash<QByteArray, QList<qint64> > m_fired;
+	QList<CoalescingTimer*> m_timers;
+};
+
+void TimerServiceTest::init()
+{
+	m_now = 0;
+	m_fired.clear();
+	TimerService *service = TimerService::instance();
+	QVERIFY(service);
+	service->setClock([this] () { return m_now; });
+	service->resetCounters();
+}
+
+void TimerServiceTest::cleanup()
+{
+	qDeleteAll(m_timers);
+	m_timers.clear();
+	if (TimerService *service = TimerService::instance())
+		service->setClock(TimerService::Clock());
+}
+
+CoalescingTimer *TimerServiceTest::createTimer(const char *owner, int interval, bool singleShot)
+{
+	CoalescingTimer *timer = new CoalescingTimer;
+	timer->setObjectName(QLatin1String(owner));
+	timer->setInterval(interval);
+	timer->setSingleShot(singleShot);
+	connect(timer, &CoalescingTimer::timeout, this, [this, owner] () {
+		m_fired[owner] << m_now;
+	});
+	m_timers << timer;
+	return timer;
+}
+
+void TimerServiceTest::run(qint64 until)
+{
+	TimerService *service = TimerService::instance();
+	for (qint64 next = service->nextWakeup(); next >= 0 && next <= until; next = service->nextWakeup()) {
+		QVERIFY(next >= m_now);
+		m_now = next;
+		QMetaObject::invokeMethod(service, "onTimeout");
+	}
+	m_now = until;
+}
+
+void TimerServiceTest::typicalTimers()
+{
+	// Idle poll, protocol pings and keep-alives of several accounts
+	struct Registration { const char *owner; int interval; };
+	const Registration registrations[] = {
+		{ "idle", 1000 },
+		{ "mrim-ping", 30000 },
+		{ "irc-keepalive", 60000 },
+		{ "jabber-keepalive", 60000 },
+		{ "oscar-keepalive", 45000 },
+		{ "weather", 300000 }
+	};
+	const qint64 duration = 600000;
+	for (const Registration &registration : registrations)
+		createTimer(registration.owner, registration.interval)->start();
+	// Typing notification is restarted by every key press
+	CoalescingTimer *typing = createTimer("typing", 5000, true);
+	for (qint64 time = 0; time < duration; time += 7000) {
+		run(time);
+		typing->start();
+	}
+	run(duration);
+
+	// Idle poll fires 100 ms after its planned moment (end of its slack),
+	// slacks of all other timers include this wakeup, so they join it
+	int timeouts = 0;
+	for (const Registration &registration : registrations) {
+		const QList<qint64> &fired = m_fired.value(registration.owner);
+		QCOMPARE(fired.size(), int((duration - 100) / registration.interval));
+		for (int i = 0; i < fired.size(); ++i)
+			QCOMPARE(fired.at(i), qint64(i + 1) * registration.interval + 100);
+		timeouts += fired.size();
+	}
+	const QList<qint64> &typed = m_fired.value("typing");
+	QCOMPARE(typed.size(), int(duration / 7000));
+	for (int i = 0; i < typed.size(); ++i)
+		QCOMPARE(typed.at(i), qint64(i) * 7000 + 5100);
+	timeouts += typed.size();
+
+	TimerService *service = TimerService::instance();
+	QCOMPARE(service->timeoutCount(), quint64(timeouts));
+	// Only the idle poll wakes the application up, everything else joins it
+	QCOMPARE(service->wakeupCount(), quint64(m_fired.value("idle").size()));
+	QCOMPARE(service->ownerWakeups().value("idle"), service->wakeupCount());
+	QVERIFY(service->wakeupCount() < quint64(timeouts));
+	service->dump();
+}
+
+void TimerServiceTest::stoppedByHandler()
+{
+	CoalescingTimer *first = createTimer("first", 1000);
+	CoalescingTimer *second = createTimer("second", 1000);
+	connect(first, &CoalescingTimer::timeout, second, &CoalescingTimer::stop);
+	first->start();
+	second->start();
+	run(1100);
+	QCOMPARE(m_fired.value("first").size(), 1);
+	QCOMPARE(m_fired.value("second").size(), 0);
+	QVERIFY(!second->isActive());
+	QCOMPARE(TimerService::instance()->timeoutCount(), quint64(1));
+}
+
+void TimerServiceTest::restartedByHandler()
+{
+	CoalescingTimer *first = createTimer("first", 1000, true);
+	CoalescingTimer *second = createTimer("second", 1000, true);
+	connect(first, &CoalescingTimer::timeout, second, static_cast<void (CoalescingTimer::*)()>(&CoalescingTimer::start));
+	first->start();
+	second->start();
+	run(1100);
+	QCOMPARE(m_fired.value("second").size(), 0);
+	QVERIFY(second->isActive());
+	run(3000);
+	QCOMPARE(m_fired.value("second"), QList<qint64>() << 2200);
+}
+
+void TimerServiceTest::deletedByHandler()
+{
+	CoalescingTimer *first = createTimer("first", 1000);
+	CoalescingTimer *second = createTimer("second", 1000);
+	connect(first, &CoalescingTimer::timeout, this, [this, second] () {
+		m_timers.removeOne(second);
+		delete second;
+	});
+	first->start();
+	second->start();
+	run(1100);
+	QCOMPARE(m_fired.value("first").size(), 1);
+	QCOMPARE(m_fired.value("second").size(), 0);
+}
+
+void TimerServiceTest::serviceDestroyed()
+{
+	CoalescingTimer *timer = createTimer("timer", 1000);
+	timer->start();
+	QVERIFY(timer->isActive());
+	delete TimerService::instance();
+	QVERIFY(!timer->isActive());
+	timer->stop();
+
+	// The next one is created on demand
+	TimerService *service = TimerService::instance();
+	QVERIFY(service);
+	service->setClock([this] () { return m_now; });
+	timer->start();
+	QCOMPARE(service->nextWakeup(), m_now + 1100);
+}
+
+QTEST_MAIN(TimerServiceTest)
+
+#include "timerservicetest.moc"
@@ -25,9 +25,31 @@
 #include "aescryptoservice.h"
 #include <QCryptographicHash>
 #include <QtCrypto>
+#include <QtEndian>
 
 namespace AesCrypto
 {
+	// Authenticated format: magic, 96-bit random nonce and a sequence of segments,
+	// each one is 32-bit big endian length, cipher text and 128-bit GCM tag.
+	// Nonce of segment is the base one xored by it's number, the highest bit
+	// is set for the last segment, so truncated data is never accepted.
+	static const char gcmMagic[] = "QCG1";
+	enum {
+		GcmMagicSize = sizeof(gcmMagic) - 1,
+		GcmNonceSize = 12,
+		GcmTagSize = 16,
+		GcmSegmentSize = 64 * 1024
+	};
+
+	static QCA::InitializationVector segmentNonce(const QByteArray &base, quint32 index, bool last)
+	{
+		QByteArray nonce = base;
+		if (last)
+			index |= 0x80000000u;
+		uchar *data = reinterpret_cast<uchar *>(nonce.data()) + GcmNonceSize - 4;
+		qToBigEndian(qFromBigEndian<quint32>(data) ^ index, data);
+		return nonce;
+	}
 
 	AesCryptoService::AesCryptoService()
 	{
@@ -37,45 +59,135 @@ namespace AesCrypto
 		// We use AES-256, so we need vector with length 32
 		m_iv = QByteArray::fromHex("c898e1c1771eb0bc4dc846d5edba0005"
 								   "a54d2bb6f0d24fbfbb3c58a977edc50f");
-		m_cipher_enc = 0;
-		m_cipher_dec = 0;
+		m_hasPassword = false;
+		m_gcmSupported = QCA::isSupported("aes256-gcm");
+	}
+
+	AesCryptoService::~AesCryptoService()
+	{
 	}
 
 	QVariant AesCryptoService::cryptImpl(const QVariant &valueVar) const
 	{
 		QByteArray value = dataFromVariant(valueVar);
-		if(!m_cipher_enc)
+		if(!m_hasPassword)
 			return value;
+		// Config values stay in the old format, so they are readable by previous
+		// versions; authenticated one is used only by the bulk api
+		return legacyCrypt(value);
+	}
+
+	QVariant AesCryptoService::decryptImpl(const QVariant &valueVar) const
+	{
+		if(!m_hasPassword)
+			return variantFromData(valueVar.toByteArray());
+		QByteArray value = valueVar.toByteArray();
+		if(value.startsWith(gcmMagic))
+			return variantFromData(decryptDataImpl(value));
+		return variantFromData(legacyDecrypt(value));
+	}
+
+	QByteArray AesCryptoService::cryptDataImpl(const QByteArray &data) const
+	{
+		if(!m_hasPassword)
+			return data;
+		if(!m_gcmSupported)
+			return legacyCrypt(data);
+		const QByteArray base = QCA::Random::randomArray(GcmNonceSize).toByteArray();
+		QByteArray result;
+		const int segments = qMax(1, (data.size() + GcmSegmentSize - 1) / GcmSegmentSize);
+		result.reserve(GcmMagicSize + GcmNonceSize + data.size() + segments * (4 + GcmTagSize));
+		result.append(gcmMagic, GcmMagicSize);
+		result.append(base);
+		// One cipher per call, history is written from the thread pool
+		QCA::Cipher cipher(QStringLiteral("aes256"), QCA::Cipher::GCM, QCA::Cipher::NoPadding,
+						   QCA::Encode, m_gcmKey, segmentNonce(base, 0, segments == 1));
+		for(int i = 0; i < segments; ++i)
+		{
+			if(i > 0)
+				cipher.setup(QCA::Encode, m_gcmKey, segmentNonce(base, i, i == segments - 1));
+			QCA::SecureArray text = cipher.update(data.mid(i * GcmSegmentSize, GcmSegmentSize));
+			text += cipher.final();
+			if(!cipher.ok())
+				return QByteArray();
+			uchar length[4];
+			qToBigEndian<quint32>(text.size(), length);
+			result.append(reinterpret_cast<const char *>(length), 4);
+			result.append(text.toByteArray());
+			result.append(cipher.tag().toByteArray());
+		}
+		return result;
+	}
+
+	QByteArray AesCryptoService::decryptDataImpl(const QByteArray &data) const
+	{
+		if(!m_hasPassword)
+			return data;
+		if(!data.startsWith(gcmMagic))
+			return legacyDecrypt(data);
+		if(!m_gcmSupported || data.size() < GcmMagicSize + GcmNonceSize)
+			return QByteArray();
+		const QByteArray base = data.mid(GcmMagicSize, GcmNonceSize);
+		const char *s = data.constData() + GcmMagicSize + GcmNonceSize;
+		const char *end = data.constData() + data.size();
+		QByteArray result;
+		result.reserve(data.size());
+		QCA::Cipher cipher(QStringLiteral("aes256"), QCA::Cipher::GCM, QCA::Cipher::NoPadding,
+						   QCA::Decode, m_gcmKey, QCA::InitializationVector());
+		for(quint32 i = 0; s < end; ++i)
+		{
+			if(end - s < 4)
+				return QByteArray();
+			const quint32 length = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(s));
+			s += 4;
+			if(length > GcmSegmentSize || quint32(end - s) < length + GcmTagSize)
+				return QByteArray();
+			const bool last = (end - s) == qint64(length + GcmTagSize);
+			const QCA::AuthTag tag(QByteArray(s + length, GcmTagSize));
+			cipher.setup(QCA::Decode, m_gcmKey, segmentNonce(base, i, last), tag);
+			QCA::SecureArray text = cipher.update(QByteArray::fromRawData(s, length));
+			text += cipher.final();
+			// Tag mismatch, data is corrupted or was tampered with
+			if(!cipher.ok())
+				return QByteArray();
+			result.append(text.toByteArray());
+			s += length + GcmTagSize;
+		}
+		return result;
+	}
+
+	QByteArray AesCryptoService::legacyCrypt(const QByteArray &value) const
+	{
+		QCA::Cipher cipher(QStringLiteral("aes256"), QCA::Cipher::CBC, QCA::Cipher::DefaultPadding,
+						   QCA::Encode, m_key, m_iv);
 		QByteArray result;
 		for(int i = 0x0; i < value.size(); i += 0xf)
 		{
-			m_cipher_enc->clear();
+			cipher.clear();
 			QCA::SecureArray arg = value.mid(i, 0xf);
-			m_cipher_enc->update(arg);
-			if(!m_cipher_enc->ok())
+			cipher.update(arg);
+			if(!cipher.ok())
 				return result;
-			result += m_cipher_enc->final().toByteArray();
+			result += cipher.final().toByteArray();
 		}
 		return result;
 	}
 
-	QVariant AesCryptoService::decryptImpl(const QVariant &valueVar) const
+	QByteArray AesCryptoService::legacyDecrypt(const QByteArray &value) const
 	{
-		if(!m_cipher_dec)
-			return variantFromData(valueVar.toByteArray());
-//		qDebug() << m_cipher_enc->blockSize() << m_cipher_enc->keyLength().minimum() << m_cipher_enc->keyLength().maximum();
-		QByteArray value = valueVar.toByteArray();
+		QCA::Cipher cipher(QStringLiteral("aes256"), QCA::Cipher::CBC, QCA::Cipher::DefaultPadding,
+						   QCA::Decode, m_key, m_iv);
 		QByteArray result;
 		for(int i = 0x0; i < value.size(); i += 0x10)
 		{
-			m_cipher_dec->clear();
+			cipher.clear();
 			QCA::SecureArray arg = value.mid(i, 0x10);
-			m_cipher_dec->update(arg);
-			if(!m_cipher_dec->ok())
+			cipher.update(arg);
+			if(!cipher.ok())
 				return result;
-			result += m_cipher_dec->final().toByteArray();
+			result += cipher.final().toByteArray();
 		}
-		return variantFromData(result);
+		return result;
 	}
 
 	void AesCryptoService::setPassword(const QString &password, const QVariant &data)
@@ -86,12 +198,11 @@ namespace AesCrypto
 		// 64 bit sault
 		pass += QByteArray::fromHex("5b225931d924bb30");
 		m_key = QCA::Hash("sha256").hash(pass).toByteArray();
-		m_cipher_enc = new QCA::Cipher(QString("aes256"),QCA::Cipher::CBC,
-									   QCA::Cipher::DefaultPadding,
-									   QCA::Encode, m_key, m_iv);
-		m_cipher_dec = new QCA::Cipher(QString("aes256"),QCA::Cipher::CBC,
-									   QCA::Cipher::DefaultPadding,
-									   QCA::Decode, m_key, m_iv);
+		// Separate key for authenticated format, stretched to slow down brute force
+		m_gcmKey = QCA::PBKDF2(QStringLiteral("sha1")).makeKey(QCA::SecureArray(password.toUtf8()),
+															   QCA::InitializationVector(QByteArray::fromHex("0c3f2ad47e9168b5")),
+															   32, 10000);
+		m_hasPassword = true;
 	}
 
 	QVariant AesCryptoService::generateData(const QString &profile) const
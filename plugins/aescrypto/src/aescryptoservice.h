@@ -37,16 +37,25 @@ namespace AesCrypto
 		Q_OBJECT
 	public:
 		AesCryptoService();
+		virtual ~AesCryptoService();
+		// Bulk api of CryptoService, may be called from any thread
+		Q_INVOKABLE QByteArray cryptDataImpl(const QByteArray &data) const;
+		Q_INVOKABLE QByteArray decryptDataImpl(const QByteArray &data) const;
+		Q_INVOKABLE bool hasKeyImpl() const { return m_hasPassword; }
 	protected:
 		virtual QVariant cryptImpl(const QVariant &value) const;
 		virtual QVariant decryptImpl(const QVariant &value) const;
 		virtual void setPassword(const QString &password, const QVariant &data);
 		virtual QVariant generateData(const QString &profile) const;
 	private:
+		// Ciphers are created per call, QCA::Cipher keeps the state
+		QByteArray legacyCrypt(const QByteArray &value) const;
+		QByteArray legacyDecrypt(const QByteArray &value) const;
 		QCA::SymmetricKey m_key;
+		QCA::SymmetricKey m_gcmKey;
+		bool m_gcmSupported;
+		bool m_hasPassword;
 		QCA::InitializationVector m_iv;
-		QCA::Cipher *m_cipher_enc;
-		QCA::Cipher *m_cipher_dec;
 	};
 }
 
@@ -0,0 +1,188 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "aescryptoservice.h"
+#include <QtTest>
+#include <QtConcurrent>
+
+using namespace AesCrypto;
+
+class AesCryptoBenchmark : public QObject
+{
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void roundTrip_data();
+	void roundTrip();
+	void tampered();
+	void truncated();
+	void legacyCompatibility();
+	void concurrentLegacy();
+	void concurrentBulk();
+	void bulk_data();
+	void bulk();
+	void legacy();
+
+private:
+	static QByteArray randomData(int size);
+	QByteArray legacyEncrypt(const QByteArray &data) const;
+
+	QScopedPointer<AesCryptoService> m_service;
+	QByteArray m_password;
+};
+
+QByteArray AesCryptoBenchmark::randomData(int size)
+{
+	QByteArray data(size, Qt::Uninitialized);
+	for (int i = 0; i < size; ++i)
+		data[i] = char(qrand());
+	return data;
+}
+
+// Format of values stored by previous versions
+QByteArray AesCryptoBenchmark::legacyEncrypt(const QByteArray &data) const
+{
+	const QCA::SymmetricKey key = QCA::Hash("sha256").hash(m_password + QByteArray::fromHex("5b225931d924bb30")).toByteArray();
+	const QCA::InitializationVector iv(QByteArray::fromHex("c898e1c1771eb0bc4dc846d5edba0005"
+														   "a54d2bb6f0d24fbfbb3c58a977edc50f"));
+	QCA::Cipher cipher(QStringLiteral("aes256"), QCA::Cipher::CBC, QCA::Cipher::DefaultPadding,
+					   QCA::Encode, key, iv);
+	QByteArray result;
+	for (int i = 0; i < data.size(); i += 0xf) {
+		cipher.clear();
+		cipher.update(data.mid(i, 0xf));
+		result += cipher.final().toByteArray();
+	}
+	return result;
+}
+
+void AesCryptoBenchmark::initTestCase()
+{
+	m_service.reset(new AesCryptoService);
+	m_password = "password";
+	CryptoService *service = m_service.data();
+	service->setPassword(QString::fromLatin1(m_password), QVariant());
+}
+
+void AesCryptoBenchmark::roundTrip_data()
+{
+	QTest::addColumn<int>("size");
+	const int sizes[] = { 0, 1, 15, 16, 17, 65535, 65536, 65537, 3 * 65536 + 7 };
+	for (uint i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+		QTest::newRow(QByteArray::number(sizes[i]).constData()) << sizes[i];
+}
+
+void AesCryptoBenchmark::roundTrip()
+{
+	QFETCH(int, size);
+	const QByteArray data = randomData(size);
+	const QByteArray encrypted = CryptoService::cryptData(data);
+	QVERIFY(size == 0 || encrypted != data);
+	QCOMPARE(CryptoService::decryptData(encrypted), data);
+
+	const QVariant value = CryptoService::crypt(QString::fromLatin1(data.toHex()));
+	QCOMPARE(CryptoService::decrypt(value).toString(), QString::fromLatin1(data.toHex()));
+}
+
+void AesCryptoBenchmark::tampered()
+{
+	if (!QCA::isSupported("aes256-gcm"))
+		QSKIP("GCM is not supported by QCA backend");
+	QByteArray encrypted = CryptoService::cryptData(randomData(1000));
+	encrypted[encrypted.size() / 2] = encrypted.at(encrypted.size() / 2) ^ 1;
+	QVERIFY(CryptoService::decryptData(encrypted).isEmpty());
+}
+
+void AesCryptoBenchmark::truncated()
+{
+	if (!QCA::isSupported("aes256-gcm"))
+		QSKIP("GCM is not supported by QCA backend");
+	// Drop the last segment with its length and tag
+	const QByteArray encrypted = CryptoService::cryptData(randomData(2 * 65536));
+	QVERIFY(CryptoService::decryptData(encrypted.left(encrypted.size() - 65536 - 4 - 16)).isEmpty());
+}
+
+void AesCryptoBenchmark::legacyCompatibility()
+{
+	const QByteArray data = randomData(1000);
+	QCOMPARE(CryptoService::decryptData(legacyEncrypt(data)), data);
+}
+
+void AesCryptoBenchmark::concurrentLegacy()
+{
+	// History is written and read from the thread pool
+	QList<QByteArray> inputs;
+	for (int i = 0; i < 64; ++i)
+		inputs << randomData(4096 + i);
+	QList<QByteArray> encrypted;
+	foreach (const QByteArray &data, inputs)
+		encrypted << legacyEncrypt(data);
+	const QList<QByteArray> decrypted = QtConcurrent::blockingMapped(encrypted, &CryptoService::decryptData);
+	QCOMPARE(decrypted, inputs);
+}
+
+void AesCryptoBenchmark::concurrentBulk()
+{
+	QList<QByteArray> inputs;
+	for (int i = 0; i < 64; ++i)
+		inputs << randomData(4096 + i);
+	const QList<QByteArray> encrypted = QtConcurrent::blockingMapped(inputs, &CryptoService::cryptData);
+	const QList<QByteArray> decrypted = QtConcurrent::blockingMapped(encrypted, &CryptoService::decryptData);
+	QCOMPARE(decrypted, inputs);
+}
+
+void AesCryptoBenchmark::bulk_data()
+{
+	QTest::addColumn<int>("size");
+	QTest::newRow("1 KiB") << 1024;
+	QTest::newRow("64 KiB") << 65536;
+	QTest::newRow("4 MiB") << 4 * 1024 * 1024;
+}
+
+void AesCryptoBenchmark::bulk()
+{
+	QFETCH(int, size);
+	const QByteArray data = randomData(size);
+	QByteArray decrypted;
+	QBENCHMARK {
+		decrypted = CryptoService::decryptData(CryptoService::cryptData(data));
+	}
+	QCOMPARE(decrypted, data);
+}
+
+void AesCryptoBenchmark::legacy()
+{
+	const QByteArray data = randomData(65536);
+	const QByteArray encrypted = legacyEncrypt(data);
+	QByteArray decrypted;
+	QBENCHMARK {
+		decrypted = CryptoService::decryptData(encrypted);
+	}
+	QCOMPARE(decrypted, data);
+}
+
+QTEST_GUILESS_MAIN(AesCryptoBenchmark)
+
+#include "aescryptobenchmark.moc"
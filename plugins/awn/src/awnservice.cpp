@@ -154,25 +154,25 @@ void AWNService::onItemRemoved(QDBusObjectPath path)
 
 void AWNService::onSessionCreated(qutim_sdk_0_3::ChatSession *session)
 {
-	connect(session, SIGNAL(unreadChanged(const qutim_sdk_0_3::MessageList&)), SLOT(onUnreadChanged(const qutim_sdk_0_3::MessageList&)));
+	connect(session, SIGNAL(unreadCountChanged(int)), SLOT(onUnreadChanged(int)));
 }
 
-void AWNService::onUnreadChanged(const MessageList &unread)
+void AWNService::onUnreadChanged(int count)
 {
 	ChatSession *session = static_cast<ChatSession*>(sender());
 	Q_ASSERT(session != NULL);
-	if (unread.isEmpty())
+	if (count == 0)
 		m_sessions.removeOne(session);
 	else if (!m_sessions.contains(session))
 	{
 		m_sessions.append(session);
-		if(unread.count()>1)
-			for(QList<Message>::const_iterator it = unread.begin(); it<(unread.end()-1); it++)
-				session->markRead((*it).id());
+		if(count>1)
+			foreach(const Message &message, session->unreadRange(0, count - 1))
+				session->markRead(message.property("unreadId", message.id()));
 	}
 	int i = 0;
 	foreach(ChatSession *s,m_sessions)
-		i += s->unread().count();
+		i += s->unreadCount();
 	if(i!=m_uread)
 	{
 		m_uread = i;
@@ -71,7 +71,7 @@ protected:
 	bool eventFilter(QObject *obj, QEvent *event);
 private slots:
 	void onSessionCreated(qutim_sdk_0_3::ChatSession*);
-	void onUnreadChanged(const qutim_sdk_0_3::MessageList&);
+	void onUnreadChanged(int count);
 	void onStatusChanged(const qutim_sdk_0_3::Status &status);
 	void onItemRemoved(QDBusObjectPath path);
 	void onMenuItemActivated(int);
@@ -37,6 +37,11 @@
 #include <QTextDocument>
 #include <QSslError>
 #include <QSslConfiguration>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QFileInfo>
+#include <QDir>
+#include <QtEndian>
 #include "rostermanager.h"
 
 #define LOGIN_URL (QLatin1String("api/login"))
@@ -48,8 +53,29 @@
 
 #define DO_NOT_CHECK_SERVER_CERTIFICATE
 
+// Number of upload batches which may wait for server's reply at the same time
+#define UPLOAD_WINDOW 4
+// Limits of the single messages batch, size is counted in characters of text
+#define MAX_BATCH_MESSAGES 256
+#define MAX_BATCH_SIZE (256 * 1024)
+
+// Outbox journal: header followed by length prefixed records. Every queued
+// action is appended as it comes, acknowledged ones are marked by ack records
+// and thrown away when the journal is compacted.
+#define OUTBOX_MAGIC 0x51434f42 // "QCOB"
+#define OUTBOX_VERSION 1
+#define OUTBOX_HEADER_SIZE 6
+// Journal is rewritten only when it's larger than this
+#define OUTBOX_COMPACT_SIZE (256 * 1024)
+
 namespace Control {
 
+enum OutboxOperation
+{
+	OutboxPut = 1,
+	OutboxAck = 2
+};
+
 struct Scope
 {
 	typedef QSharedPointer<Scope> Ptr;
@@ -168,6 +194,21 @@ void ActionList::prepend(ActionList &o)
 	o.m_first = o.m_last = 0;
 }
 
+void ActionList::insert(Action *before, Action *action)
+{
+	if (!before) {
+		append(action);
+		return;
+	}
+	action->prev = before->prev;
+	action->next = before;
+	if (before->prev)
+		before->prev->next = action;
+	else
+		m_first = action;
+	before->prev = action;
+}
+
 void ActionList::remove(Action *action)
 {
 	if (action->prev)
@@ -182,7 +223,8 @@ void ActionList::remove(Action *action)
 }
 
 NetworkManager::NetworkManager(QObject *parent) :
-	QNetworkAccessManager(parent), m_answersReply(0), m_currentReply(0)
+	QNetworkAccessManager(parent), m_answersReply(0), m_loginReply(0),
+	m_lastSeq(0), m_pendingCount(0), m_journalAcked(0), m_compressUploads(false)
 {
 	connect(this, SIGNAL(finished(QNetworkReply*)),
 			SLOT(onReplyFinished(QNetworkReply*)));
@@ -242,6 +284,7 @@ void NetworkManager::loadSettings(bool init, bool *changed)
 	QString username = config.value("username", QString());
 	QUrl base = QUrl::fromUserInput(config.value("url", QString()));
 	m_localAnswers = config.value("answers", QStringList());
+	m_compressUploads = config.value("compressUploads", false);
 	rebuildAnswers();
 	if (username != m_username || base != m_base)
 		*changed = true;
@@ -256,8 +299,12 @@ void NetworkManager::loadSettings(bool init, bool *changed)
 void NetworkManager::clearQueue()
 {
 	m_actions.clear();
-	delete m_currentReply;
-	m_currentReply = 0;
+	qDeleteAll(m_uploads);
+	m_uploads.clear();
+	delete m_loginReply;
+	m_loginReply = 0;
+	m_pendingCount = 0;
+	compactJournal();
 }
 
 QStringList NetworkManager::answers() const
@@ -274,8 +321,7 @@ void NetworkManager::addAccount(const QString &protocol, const QString &id)
 {
 	AccountAction *action = new AccountAction(Action::AddAccount);
 	action->account = AccountId(id, protocol);
-	m_actions << action;
-	trySend();
+	appendAction(action);
 }
 
 void NetworkManager::removeAccount(Account *account)
@@ -287,26 +333,22 @@ void NetworkManager::removeAccount(const QString &protocol, const QString &id)
 {
 	AccountAction *action = new AccountAction(Action::RemoveAccount);
 	action->account = AccountId(id, protocol);
-	m_actions << action;
-	trySend();
+	appendAction(action);
 }
 
 void NetworkManager::addContact(qutim_sdk_0_3::Contact *contact)
 {
-	m_actions << new ContactAction(Action::AddContact, contact);
-	trySend();
+	appendAction(new ContactAction(Action::AddContact, contact));
 }
 
 void NetworkManager::removeContact(qutim_sdk_0_3::Contact *contact)
 {
-	m_actions << new ContactAction(Action::RemoveContact, contact);
-	trySend();
+	appendAction(new ContactAction(Action::RemoveContact, contact));
 }
 
 void NetworkManager::updateContact(qutim_sdk_0_3::Contact *contact)
 {
-	m_actions << new ContactAction(Action::UpdateContact, contact);
-	trySend();
+	appendAction(new ContactAction(Action::UpdateContact, contact));
 }
 
 void NetworkManager::sendMessage(const qutim_sdk_0_3::Message &message)
@@ -327,8 +369,7 @@ void NetworkManager::sendMessage(const qutim_sdk_0_3::Message &message)
 	}
 	if (message.property("autoreply", false))
 		action->encryption << QLatin1String("autoreply");
-	m_actions << action;
-	trySend();
+	appendAction(action);
 }
 
 static QByteArray paranoicEscape(const QByteArray &raw)
@@ -362,12 +403,19 @@ void NetworkManager::sendRequest(ChatUnit *contact, const QString &text)
 	reply->setProperty("__control_contact", qVariantFromValue(contact));
 }
 
-QNetworkReply *NetworkManager::post(const QUrl &url, const QByteArray &body)
+QNetworkReply *NetworkManager::post(const QUrl &url, const QByteArray &body, bool compress)
 {
 	QNetworkRequest request(url);
 	request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
 	bool ok = false;
 	QByteArray data = "body=" + paranoicEscape(m_crypter->encode(body, &ok));
+	if (compress) {
+		// Escaped body is three times larger than the encrypted one, so it's
+		// compressed very well. qCompress output is zlib stream prefixed by
+		// four bytes of length, that is exactly "deflate" content coding
+		data = qCompress(data).mid(4);
+		request.setRawHeader("Content-Encoding", "deflate");
+	}
 	return QNetworkAccessManager::post(request, data);
 }
 
@@ -429,10 +477,9 @@ void NetworkManager::onReplyFinished(QNetworkReply *reply)
 		}
 		return;
 	}
-	Q_ASSERT(reply == m_currentReply);
-	m_currentReply = 0;
-	debug() << reply->error() << reply->errorString() << readData;
-	if (reply->request().url().path().endsWith(LOGIN_URL)) {
+	if (reply == m_loginReply) {
+		m_loginReply = 0;
+		debug() << reply->error() << reply->errorString() << readData;
 		if (reply->error() != QNetworkReply::NoError) {
 			NotificationRequest request(Notification::System);
 			request.setTitle(tr("Control plugin"));
@@ -441,36 +488,46 @@ void NetworkManager::onReplyFinished(QNetworkReply *reply)
 		} else {
 			trySend();
 		}
-	} else {
-		Scope::Ptr scope = reply->property("scope").value<Scope::Ptr>();
-		Q_ASSERT(scope);
-		if (reply->error() == QNetworkReply::AuthenticationRequiredError) {
-			m_actions.prepend(scope->actions);
-			if (m_username.isEmpty())
-				return;
-			QVariantMap data;
-			Config config("control");
-			config.beginGroup("general");
-			data.insert("username", m_username);
-			data.insert("password", config.value("password", QString(), Config::Crypted));
-			data.insert("remember", true);
-			QUrl url = m_base.resolved(QUrl(LOGIN_URL));
-			QNetworkReply *reply = post(url, Json::generate(data));
-			m_currentReply = reply;
-		} else if (reply->error() == QNetworkReply::NoError) {
-			QVariantMap data = Json::parse(readData).toMap();
-			debug() << data << data.value("success");
-			if (data.value("success").toBool()) {
-				QVariantMap body = data.value("body").toMap();
-				int accountId = body.value("accountId", -1).toInt();
-				RosterManager::instance()->setAccountId(scope->account.protocol, scope->account.id, accountId);
-			}
-			trySend();
-		} else {
-			if (!m_timer.isActive())
-				m_timer.start(60000, this);
-			m_actions.prepend(scope->actions);
+		return;
+	}
+	if (!m_uploads.removeOne(reply))
+		return;
+	debug() << reply->error() << reply->errorString() << readData;
+	Scope::Ptr scope = reply->property("scope").value<Scope::Ptr>();
+	Q_ASSERT(scope);
+	if (reply->error() == QNetworkReply::AuthenticationRequiredError) {
+		requeueActions(scope->actions);
+		// Other batches of the window will likely fail the same way,
+		// so log in only once
+		if (m_username.isEmpty() || m_loginReply)
+			return;
+		QVariantMap data;
+		Config config("control");
+		config.beginGroup("general");
+		data.insert("username", m_username);
+		data.insert("password", config.value("password", QString(), Config::Crypted));
+		data.insert("remember", true);
+		QUrl url = m_base.resolved(QUrl(LOGIN_URL));
+		m_loginReply = post(url, Json::generate(data));
+	} else if (reply->error() == QNetworkReply::NoError) {
+		QVariantMap data = Json::parse(readData).toMap();
+		debug() << data << data.value("success");
+		if (data.value("success").toBool()) {
+			QVariantMap body = data.value("body").toMap();
+			int accountId = body.value("accountId", -1).toInt();
+			if (RosterManager *roster = RosterManager::instance())
+				roster->setAccountId(scope->account.protocol, scope->account.id, accountId);
 		}
+		QVector<quint64> seqs;
+		for (Action *action = scope->actions.first(); action; action = action->next)
+			seqs << action->seq;
+		scope->actions.clear();
+		acknowledgeActions(seqs);
+		trySend();
+	} else {
+		if (!m_timer.isActive())
+			m_timer.start(60000, this);
+		requeueActions(scope->actions);
 	}
 }
 
@@ -514,40 +571,177 @@ static Action *loadAction(Config &config, int index)
 	return action;
 }
 
-static void storeAction(Config &config, int index, Action *action)
+static QByteArray actionRecord(const Action *action)
 {
-	config.setArrayIndex(index);
-	config.setValue("accountId", action->account.id);
-	config.setValue("protocol", action->account.protocol);
-	config.setValue("type", action->type);
+	QByteArray record;
+	QDataStream out(&record, QIODevice::WriteOnly);
+	out.setVersion(QDataStream::Qt_5_0);
+	out << quint8(OutboxPut) << action->seq << quint8(action->type)
+		<< action->account.id << action->account.protocol;
 	switch (action->type) {
+	case Action::AddContact:
+	case Action::UpdateContact:
+	case Action::RemoveContact: {
+		const ContactAction *contact = static_cast<const ContactAction*>(action);
+		out << contact->id << contact->name << contact->groups;
+		break;
+	}
+	case Action::Message: {
+		const MessageAction *message = static_cast<const MessageAction*>(action);
+		out << message->contact << message->time << message->text
+			<< message->incoming << message->encryption;
+		break;
+	}
+	default:
+		break;
+	}
+	return record;
+}
+
+static Action *readAction(QDataStream &in)
+{
+	quint64 seq;
+	quint8 type;
+	AccountId account;
+	in >> seq >> type >> account.id >> account.protocol;
+	Action *action = NULL;
+	switch (type) {
 	case Action::AddAccount:
 	case Action::RemoveAccount:
+		action = new AccountAction(static_cast<Action::Type>(type));
 		break;
 	case Action::AddContact:
 	case Action::UpdateContact:
-	case Action::RemoveContact:
-		config.setValue("id", static_cast<ContactAction*>(action)->id);
-		config.setValue("name", static_cast<ContactAction*>(action)->name);
-		config.setValue("groups", static_cast<ContactAction*>(action)->groups);
+	case Action::RemoveContact: {
+		ContactAction *contact = new ContactAction(static_cast<Action::Type>(type));
+		in >> contact->id >> contact->name >> contact->groups;
+		action = contact;
 		break;
-	case Action::Message:
-		config.setValue("contact", static_cast<MessageAction*>(action)->contact);
-		config.setValue("time", static_cast<MessageAction*>(action)->time);
-		config.setValue("text", static_cast<MessageAction*>(action)->text);
-		config.setValue("incoming", static_cast<MessageAction*>(action)->incoming);
-		config.setValue("encryption", static_cast<MessageAction*>(action)->encryption);
+	}
+	case Action::Message: {
+		MessageAction *message = new MessageAction();
+		in >> message->contact >> message->time >> message->text
+		   >> message->incoming >> message->encryption;
+		action = message;
 		break;
+	}
 	default:
-		break;
+		return NULL;
+	}
+	if (in.status() != QDataStream::Ok) {
+		delete action;
+		return NULL;
+	}
+	action->seq = seq;
+	action->account = account;
+	return action;
+}
+
+static void appendRecord(QByteArray &data, const QByteArray &record)
+{
+	uchar length[sizeof(quint32)];
+	qToBigEndian<quint32>(record.size(), length);
+	data.append(reinterpret_cast<const char*>(length), sizeof(length));
+	data.append(record);
+}
+
+void NetworkManager::appendAction(Action *action)
+{
+	action->seq = ++m_lastSeq;
+	if (!m_journal.isOpen())
+		compactJournal();
+	QByteArray data;
+	appendRecord(data, actionRecord(action));
+	m_journal.write(data);
+	m_journal.flush();
+	++m_pendingCount;
+	m_actions << action;
+	trySend();
+}
+
+void NetworkManager::acknowledgeActions(const QVector<quint64> &seqs)
+{
+	if (seqs.isEmpty())
+		return;
+	m_pendingCount = qMax(m_pendingCount - seqs.size(), 0);
+	m_journalAcked += seqs.size();
+	// Journal is rewritten when it's grown large and contains mostly
+	// acknowledged records, otherwise just an ack record is appended
+	if (m_journal.size() >= OUTBOX_COMPACT_SIZE && m_journalAcked >= m_pendingCount) {
+		compactJournal();
+		return;
+	}
+	QByteArray record;
+	QDataStream out(&record, QIODevice::WriteOnly);
+	out.setVersion(QDataStream::Qt_5_0);
+	out << quint8(OutboxAck) << seqs;
+	QByteArray data;
+	appendRecord(data, record);
+	m_journal.write(data);
+	m_journal.flush();
+}
+
+QString NetworkManager::journalFileName() const
+{
+	return SystemInfo::getPath(SystemInfo::ConfigDir) + QLatin1String("/control/outbox.journal");
+}
+
+void NetworkManager::compactJournal()
+{
+	m_journal.close();
+	const QString fileName = journalFileName();
+	QDir().mkpath(QFileInfo(fileName).absolutePath());
+	QSaveFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly)) {
+		warning() << "Can not write control outbox to" << fileName;
+		return;
+	}
+	QByteArray data;
+	{
+		QDataStream out(&data, QIODevice::WriteOnly);
+		out << quint32(OUTBOX_MAGIC) << quint16(OUTBOX_VERSION);
+	}
+	// Batches in flight are still not acknowledged, so keep them too
+	foreach (QNetworkReply *reply, m_uploads) {
+		Scope::Ptr scope = reply->property("scope").value<Scope::Ptr>();
+		for (Action *action = scope->actions.first(); action; action = action->next)
+			appendRecord(data, actionRecord(action));
+	}
+	for (Action *action = m_actions.first(); action; action = action->next)
+		appendRecord(data, actionRecord(action));
+	file.write(data);
+	if (file.commit())
+		m_journalAcked = 0;
+	openJournal();
+}
+
+void NetworkManager::openJournal()
+{
+	m_journal.close();
+	m_journal.setFileName(journalFileName());
+	m_journal.open(QIODevice::WriteOnly | QIODevice::Append);
+}
+
+void NetworkManager::requeueActions(ActionList &actions)
+{
+	// Queue is ordered by sequence numbers, batches which are sent in parallel
+	// may fail in any order, so actions are merged back to their places
+	Action *before = m_actions.first();
+	Action *action = actions.first();
+	while (action) {
+		Action *next = action->next;
+		actions.remove(action);
+		while (before && before->seq < action->seq)
+			before = before->next;
+		m_actions.insert(before, action);
+		action = next;
 	}
 }
 
 void NetworkManager::trySend()
 {
-	if (!m_timer.isActive() && !m_currentReply)
+	if (!m_timer.isActive() && m_uploads.size() < UPLOAD_WINDOW)
 		m_timer.start(0, this);
-	storeActions();
 }
 
 void NetworkManager::onMessageEncrypted(quint64 id)
@@ -588,39 +782,114 @@ void NetworkManager::rebuildAnswers()
 
 void NetworkManager::loadActions()
 {
+	bool compact = true;
+	if (!loadJournal(&compact))
+		loadLegacyActions();
+	// Drop acknowledged records and possibly incomplete tail
+	if (compact)
+		compactJournal();
+	else
+		openJournal();
+	trySend();
+}
+
+bool NetworkManager::loadJournal(bool *compact)
+{
+	QFile file(journalFileName());
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+	const QByteArray data = file.readAll();
+	{
+		QDataStream in(data);
+		quint32 magic;
+		quint16 version;
+		in >> magic >> version;
+		if (magic != OUTBOX_MAGIC || version != OUTBOX_VERSION) {
+			warning() << "Unsupported control outbox" << file.fileName();
+			return false;
+		}
+	}
+	QMap<quint64, Action*> actions;
+	int offset = OUTBOX_HEADER_SIZE;
+	while (data.size() - offset >= int(sizeof(quint32))) {
+		const quint32 length = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(data.constData() + offset));
+		offset += sizeof(quint32);
+		// The last record may be incomplete if we have crashed while writing it
+		if (length > quint32(data.size() - offset))
+			break;
+		QDataStream in(QByteArray::fromRawData(data.constData() + offset, length));
+		in.setVersion(QDataStream::Qt_5_0);
+		offset += length;
+		quint8 operation;
+		in >> operation;
+		if (operation == OutboxPut) {
+			if (Action *action = readAction(in)) {
+				delete actions.value(action->seq);
+				actions.insert(action->seq, action);
+			}
+		} else if (operation == OutboxAck) {
+			QVector<quint64> seqs;
+			in >> seqs;
+			foreach (quint64 seq, seqs)
+				delete actions.take(seq);
+			m_journalAcked += seqs.size();
+		}
+	}
+	*compact = offset != data.size() || data.size() >= OUTBOX_COMPACT_SIZE;
+	foreach (Action *action, actions)
+		m_actions.append(action);
+	m_pendingCount = actions.size();
+	m_lastSeq = actions.isEmpty() ? 0 : actions.lastKey();
+	return true;
+}
+
+void NetworkManager::loadLegacyActions()
+{
+	// Previous versions kept the whole queue in controlCache config
 	Config cache("controlCache");
 	int size = cache.beginArray("actions");
 	for (int i = 0; i < size; ++i) {
-		if (Action *action = loadAction(cache, i))
+		if (Action *action = loadAction(cache, i)) {
+			action->seq = ++m_lastSeq;
 			m_actions.append(action);
+			++m_pendingCount;
+		}
 	}
-	trySend();
+	cache.endArray();
+	cache.remove("actions");
 }
 
-void NetworkManager::storeActions()
+// Manager is owned by RosterManager, but may live without it in tests
+static int rosterAccountId(const AccountId &account)
 {
-	Config cache("controlCache");
-	int oldSize = cache.beginArray("actions");
-	int size = 0;
-	if (m_currentReply) {
-		Scope::Ptr scope = m_currentReply->property("scope").value<Scope::Ptr>();
-		if (scope) {
-			Action *action = scope->actions.first();
-			while (action) {
-				storeAction(cache, size, action);
-				++size;
-				action = action->next;
-			}
-		}
+	RosterManager *roster = RosterManager::instance();
+	return roster ? roster->accountId(account.protocol, account.id) : -1;
+}
+
+static bool containsAccount(ActionList &actions, const AccountId &account)
+{
+	for (Action *action = actions.first(); action; action = action->next) {
+		if (action->account == account)
+			return true;
 	}
-	Action *action = m_actions.first();
-	while (action) {
-		storeAction(cache, size, action);
-		++size;
-		action = action->next;
+	return false;
+}
+
+bool NetworkManager::isAccountBusy(const AccountId &account, bool message) const
+{
+	foreach (QNetworkReply *reply, m_uploads) {
+		Scope::Ptr scope = reply->property("scope").value<Scope::Ptr>();
+		if (!scope)
+			continue;
+		// Only roster batches keep the account in the scope
+		if (scope->account == account)
+			return true;
+		// Message batches may follow each other, but a roster change has
+		// to wait for messages of its account sent before it
+		if (!message && containsAccount(scope->actions, account))
+			return true;
 	}
-	for (int i = oldSize - 1; i >= size; --i)
-		cache.remove(i);
+	return false;
 }
 
 void NetworkManager::onTimer()
@@ -628,25 +897,66 @@ void NetworkManager::onTimer()
 	m_timer.stop();
 	if (m_networkAnswers.isEmpty() && !m_answersReply)
 		updateAnswers();
-	if (m_actions.isEmpty() || m_base.isEmpty())
+	if (m_base.isEmpty() || m_loginReply)
 		return;
+	while (m_uploads.size() < UPLOAD_WINDOW && !m_actions.isEmpty()) {
+		if (!sendBatch())
+			break;
+	}
+}
+
+bool NetworkManager::sendBatch()
+{
 	bool messages = false;
+	int batchCount = 0;
+	int batchSize = 0;
 	ActionList actions;
 	AccountId account;
+	// Accounts whose actions have to stay in the queue during this pass
+	QList<AccountId> held;
 	Action *action = m_actions.first();
 	while (action) {
 		Action *next = action->next;
-		if (actions.isEmpty() || (messages && action->type != Action::Message)) {
-			m_actions.prepend(actions);
+		const bool message = (action->type == Action::Message);
+		// Actions of an account are applied in order, so an action waits for
+		// the batches of its account in flight and never passes an action of
+		// its account left in the queue
+		if (held.contains(action->account) || isAccountBusy(action->account, message)) {
+			if (!held.contains(action->account))
+				held << action->account;
+			action = next;
+			continue;
+		}
+		if (actions.isEmpty()
+				|| (messages && !message && !containsAccount(actions, action->account))) {
+			// Returned messages stay ahead of later actions of their accounts
+			for (Action *queued = actions.first(); queued; queued = queued->next) {
+				if (!held.contains(queued->account))
+					held << queued->account;
+			}
+			requeueActions(actions);
 			account = action->account;
-			messages = (action->type == Action::Message);
+			messages = message;
+			batchCount = 0;
+			batchSize = 0;
 		}
-		if (messages || action->account == account) {
+		if (messages && message && batchCount < MAX_BATCH_MESSAGES && batchSize < MAX_BATCH_SIZE) {
+			MessageAction *messageAction = static_cast<MessageAction*>(action);
 			m_actions.remove(action);
 			actions.append(action);
+			++batchCount;
+			batchSize += messageAction->text.size() + messageAction->contact.size();
+		} else if (!messages && !message && action->account == account) {
+			m_actions.remove(action);
+			actions.append(action);
+		} else {
+			held << action->account;
 		}
 		action = next;
 	}
+	if (actions.isEmpty())
+		return false;
+	QVector<quint64> dropped;
 	QVariant body;
 	if (messages) {
 		account.protocol = QString();
@@ -656,8 +966,7 @@ void NetworkManager::onTimer()
 			QVariantMap data;
 			MessageAction *message = static_cast<MessageAction*>(action);
 			const qint64 time = message->time.toMSecsSinceEpoch() / 1000;
-			const int account = RosterManager::instance()
-								->accountId(message->account.protocol, message->account.id);
+			const int account = rosterAccountId(message->account);
 			data.insert("time", time);
 			data.insert("account", account);
 			data.insert("contact", message->contact);
@@ -680,6 +989,7 @@ void NetworkManager::onTimer()
 				if (remove) {
 					actions.remove(remove);
 					actions.remove(action);
+					dropped << remove->seq << action->seq;
 					delete remove;
 					delete action;
 					remove = 0;
@@ -714,7 +1024,9 @@ void NetworkManager::onTimer()
 		} else {
 			if (remove) {
 				actions.remove(remove);
-				m_actions.prepend(remove);
+				ActionList removeList;
+				removeList << remove;
+				requeueActions(removeList);
 				remove = 0;
 			}
 			if (create)
@@ -726,7 +1038,7 @@ void NetworkManager::onTimer()
 		QVariantMap accountData;
 		accountData.insert("id", account.id);
 		accountData.insert("protocol", account.protocol);
-		int pid = RosterManager::instance()->accountId(account.protocol, account.id);
+		int pid = rosterAccountId(account);
 		if (pid >= 0)
 			accountData.insert("pid", pid);
 		data.insert("actions", list);
@@ -734,14 +1046,21 @@ void NetworkManager::onTimer()
 		data.insert("control", control);
 		body = data;
 	}
+	if (actions.isEmpty()) {
+		acknowledgeActions(dropped);
+		return true;
+	}
 	QUrl url = m_base.resolved(QUrl(messages ? APPEND_MESSAGE_URL : MODIFY_ROSTER_URL));
-	QNetworkReply *reply = post(url, Json::generate(body));
+	const QByteArray json = Json::generate(body);
+	QNetworkReply *reply = post(url, json, m_compressUploads);
 	Scope::Ptr scope = Scope::Ptr::create();
 	scope->actions.prepend(actions);
 	scope->account = account;
 	reply->setProperty("scope", qVariantFromValue(scope));
-	debug() << Json::generate(body);
-	m_currentReply = reply;
+	debug() << json;
+	m_uploads << reply;
+	acknowledgeActions(dropped);
+	return true;
 }
 
 } // namespace Control
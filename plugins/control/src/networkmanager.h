@@ -32,6 +32,8 @@
 #include <QSslKey>
 #include <QBasicTimer>
 #include <QSslCertificate>
+#include <QFile>
+#include <QVector>
 #include <qutim/account.h>
 #include <qutim/contact.h>
 #include "crypter.h"
@@ -66,11 +68,13 @@ public:
 		TypesCount
 	} type;
 	AccountId account;
+	// Position of the action in the outbox journal
+	quint64 seq;
 	Action *prev;
 	Action *next;
 
 protected:
-	Action(Type type) : type(type), prev(0), next(0) {}
+	Action(Type type) : type(type), seq(0), prev(0), next(0) {}
 };
 
 class AccountAction : public Action
@@ -123,6 +127,8 @@ public:
 	void append(ActionList &o);
 	void prepend(Action *action);
 	void prepend(ActionList &o);
+	// Inserts action before the other one or to the end if before is null
+	void insert(Action *before, Action *action);
 	void remove(Action *action);
 private:
 	Q_DISABLE_COPY(ActionList)
@@ -154,7 +160,7 @@ public:
 	void sendMessage(const qutim_sdk_0_3::Message &message);
 	void sendRequest(qutim_sdk_0_3::ChatUnit *contact, const QString &text);
 
-	QNetworkReply *post(const QUrl &url, const QByteArray &body);
+	QNetworkReply *post(const QUrl &url, const QByteArray &body, bool compress = false);
 	QNetworkReply *get(const QUrl &url);
 
 public slots:
@@ -168,8 +174,17 @@ protected slots:
 
 protected:
 	void rebuildAnswers();
+	void appendAction(Action *action);
 	void loadActions();
-	void storeActions();
+	bool loadJournal(bool *compact);
+	void loadLegacyActions();
+	void openJournal();
+	void compactJournal();
+	void acknowledgeActions(const QVector<quint64> &seqs);
+	void requeueActions(ActionList &actions);
+	virtual QString journalFileName() const;
+	bool isAccountBusy(const AccountId &account, bool message) const;
+	bool sendBatch();
 	void onTimer();
 
 signals:
@@ -178,6 +193,7 @@ signals:
 public slots:
 
 private:
+	friend class TestNetworkManager;
 	Crypter *m_crypter;
 	QSslCertificate m_localCertificate;
 	QSslCertificate m_remoteCertificate;
@@ -189,8 +205,14 @@ private:
 	QStringList m_networkAnswers;
 	QStringList m_localAnswers;
 	QNetworkReply *m_answersReply;
-	QNetworkReply *m_currentReply;
+	QNetworkReply *m_loginReply;
+	QList<QNetworkReply*> m_uploads;
 	ActionList m_actions;
+	QFile m_journal;
+	quint64 m_lastSeq;
+	int m_pendingCount;
+	int m_journalAcked;
+	bool m_compressUploads;
 };
 
 } // namespace Control
@@ -0,0 +1,326 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2012 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "networkmanager.h"
+#include <QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+
+// Local stand-in for the control server, answers every upload after a delay
+// so several batches are in flight at once
+class HttpServer : public QTcpServer
+{
+	Q_OBJECT
+public:
+	HttpServer() : requests(0), failRequest(-1)
+	{
+		listen(QHostAddress::LocalHost);
+		connect(this, &QTcpServer::newConnection, this, &HttpServer::onNewConnection);
+	}
+
+	QUrl url() const
+	{
+		return QUrl(QStringLiteral("http://127.0.0.1:%1/").arg(serverPort()));
+	}
+
+	int requests;
+	// Number of the request answered by an error
+	int failRequest;
+	QHash<QString, int> paths;
+	// Arrivals and answers of uploads in order, like "> /api/modifyRoster"
+	QStringList events;
+
+private slots:
+	void onNewConnection()
+	{
+		while (QTcpSocket *socket = nextPendingConnection()) {
+			connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+			connect(socket, &QTcpSocket::readyRead, this, [this, socket] () {
+				QByteArray data = socket->property("data").toByteArray() + socket->readAll();
+				socket->setProperty("data", data);
+				const int headerEnd = data.indexOf("\r\n\r\n");
+				if (headerEnd < 0 || socket->property("handled").toBool())
+					return;
+				const QByteArray header = data.left(headerEnd);
+				int length = 0;
+				foreach (const QByteArray &line, header.split('\n')) {
+					if (line.toLower().startsWith("content-length:"))
+						length = line.mid(15).trimmed().toInt();
+				}
+				if (data.size() < headerEnd + 4 + length)
+					return;
+				socket->setProperty("handled", true);
+				const QString path = QString::fromLatin1(header.split(' ').value(1));
+				if (path == QLatin1String("/api/getAnswers")) {
+					socket->write(answers());
+					socket->disconnectFromHost();
+					return;
+				}
+				const bool fail = (requests++ == failRequest);
+				++paths[path];
+				events << QStringLiteral("> ") + path;
+				QTimer::singleShot(20, socket, [this, socket, path, fail] () {
+					events << QStringLiteral("< ") + path;
+					socket->write(response(fail));
+					socket->disconnectFromHost();
+				});
+			});
+		}
+	}
+
+private:
+	// Manager asks for quick answers until it has some
+	static QByteArray answers()
+	{
+		const QByteArray body = "{\"success\": true, \"body\": [\"Hello\"]}";
+		return "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: "
+				+ QByteArray::number(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+	}
+
+	static QByteArray response(bool fail)
+	{
+		if (fail)
+			return "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+		const QByteArray body = "{\"success\": true, \"body\": {}}";
+		return "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: "
+				+ QByteArray::number(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+	}
+};
+
+namespace Control {
+
+class TestNetworkManager : public NetworkManager
+{
+public:
+	TestNetworkManager(const QString &journal) : m_journalName(journal) {}
+
+	void setBase(const QUrl &base) { m_base = base; }
+	void load() { loadActions(); }
+	// Failed batch is retried by the timer after a minute, don't wait for it
+	void retry() { m_timer.stop(); trySend(); }
+	int pendingCount() const { return m_pendingCount; }
+	int uploadsCount() const { return m_uploads.size(); }
+	bool isDrained() const { return m_pendingCount == 0 && m_uploads.isEmpty(); }
+
+	QList<quint64> queuedSeqs()
+	{
+		QList<quint64> seqs;
+		for (Action *action = m_actions.first(); action; action = action->next)
+			seqs << action->seq;
+		return seqs;
+	}
+
+	void queueMessage(const AccountId &account, int index)
+	{
+		MessageAction *action = new MessageAction();
+		action->account = account;
+		action->contact = QStringLiteral("contact%1@example.org").arg(index % 50);
+		action->time = QDateTime(QDate(2014, 1, 1), QTime(12, 0)).addSecs(index);
+		action->text = QStringLiteral("Message number %1 of the outbox benchmark").arg(index);
+		action->incoming = index % 2;
+		appendAction(action);
+	}
+
+	void queueContact(const AccountId &account, const QString &id)
+	{
+		ContactAction *action = new ContactAction(Action::AddContact);
+		action->account = account;
+		action->id = id;
+		action->name = id;
+		appendAction(action);
+	}
+
+protected:
+	QString journalFileName() const { return m_journalName; }
+
+private:
+	QString m_journalName;
+};
+
+}
+
+using namespace Control;
+
+class NetworkManagerTest : public QObject
+{
+	Q_OBJECT
+private slots:
+	void init();
+	void cleanup();
+	void drain_data();
+	void drain();
+	void replayAfterCrash();
+	void requeueBySequence();
+	void accountOrder();
+
+private:
+	QString journal() const { return m_dir->path() + QStringLiteral("/outbox.journal"); }
+	void queueMessages(TestNetworkManager *manager, int count);
+
+	QScopedPointer<QTemporaryDir> m_dir;
+	QScopedPointer<HttpServer> m_server;
+};
+
+static const AccountId firstAccount(QStringLiteral("me@example.org"), QStringLiteral("jabber"));
+static const AccountId secondAccount(QStringLiteral("123456"), QStringLiteral("icq"));
+
+void NetworkManagerTest::init()
+{
+	m_dir.reset(new QTemporaryDir);
+	m_server.reset(new HttpServer);
+	QVERIFY(m_server->isListening());
+}
+
+void NetworkManagerTest::cleanup()
+{
+	m_server.reset();
+	m_dir.reset();
+}
+
+void NetworkManagerTest::queueMessages(TestNetworkManager *manager, int count)
+{
+	for (int i = 0; i < count; ++i)
+		manager->queueMessage(i % 3 ? firstAccount : secondAccount, i);
+}
+
+void NetworkManagerTest::drain_data()
+{
+	QTest::addColumn<int>("count");
+	QTest::newRow("1k") << 1000;
+	QTest::newRow("10k") << 10000;
+}
+
+void NetworkManagerTest::drain()
+{
+	QFETCH(int, count);
+	TestNetworkManager manager(journal());
+	// Nothing is sent until the server is known
+	queueMessages(&manager, count);
+	QCOMPARE(manager.pendingCount(), count);
+
+	QElapsedTimer timer;
+	timer.start();
+	manager.setBase(m_server->url());
+	manager.retry();
+	QTRY_VERIFY_WITH_TIMEOUT(manager.isDrained(), 60000);
+	const qint64 elapsed = qMax<qint64>(1, timer.elapsed());
+	qDebug("%d messages drained in %lld ms, %lld messages/sec, %d requests",
+		   count, elapsed, count * 1000 / elapsed, m_server->requests);
+	QCOMPARE(m_server->paths.value(QStringLiteral("/api/appendMessages")), m_server->requests);
+}
+
+void NetworkManagerTest::replayAfterCrash()
+{
+	const int count = 2000;
+	{
+		TestNetworkManager manager(journal());
+		queueMessages(&manager, count);
+		// Manager is gone without compacting its journal
+	}
+	{
+		// The record being written at the moment of crash is cut
+		QFile file(journal());
+		QVERIFY(file.open(QIODevice::Append));
+		file.write("\x00\x00\x10\x00\x01", 5);
+	}
+
+	TestNetworkManager manager(journal());
+	manager.load();
+	QCOMPARE(manager.pendingCount(), count);
+	const QList<quint64> seqs = manager.queuedSeqs();
+	QCOMPARE(seqs.size(), count);
+	for (int i = 1; i < seqs.size(); ++i)
+		QVERIFY(seqs.at(i - 1) < seqs.at(i));
+
+	QElapsedTimer timer;
+	timer.start();
+	manager.setBase(m_server->url());
+	manager.retry();
+	QTRY_VERIFY_WITH_TIMEOUT(manager.isDrained(), 60000);
+	const qint64 elapsed = qMax<qint64>(1, timer.elapsed());
+	qDebug("%d replayed messages drained in %lld ms, %lld messages/sec",
+		   count, elapsed, count * 1000 / elapsed);
+
+	// Everything is acknowledged, so nothing is replayed again
+	TestNetworkManager restarted(journal());
+	restarted.load();
+	QCOMPARE(restarted.pendingCount(), 0);
+}
+
+void NetworkManagerTest::requeueBySequence()
+{
+	// Four batches are sent at once and the second one fails
+	const int count = 1024;
+	m_server->failRequest = 1;
+	TestNetworkManager manager(journal());
+	queueMessages(&manager, count);
+	manager.setBase(m_server->url());
+	manager.retry();
+	QTRY_COMPARE(m_server->requests, 4);
+	QTRY_COMPARE(manager.uploadsCount(), 0);
+
+	// Failed batch is back in the queue at its place
+	const QList<quint64> seqs = manager.queuedSeqs();
+	QVERIFY(!seqs.isEmpty());
+	QVERIFY(seqs.size() < count);
+	QCOMPARE(manager.pendingCount(), seqs.size());
+	for (int i = 1; i < seqs.size(); ++i)
+		QVERIFY(seqs.at(i - 1) < seqs.at(i));
+
+	manager.retry();
+	QTRY_VERIFY_WITH_TIMEOUT(manager.isDrained(), 60000);
+	QCOMPARE(m_server->requests, 5);
+
+	TestNetworkManager restarted(journal());
+	restarted.load();
+	QCOMPARE(restarted.pendingCount(), 0);
+}
+
+void NetworkManagerTest::accountOrder()
+{
+	TestNetworkManager manager(journal());
+	manager.queueContact(firstAccount, QStringLiteral("friend@example.org"));
+	manager.queueMessage(firstAccount, 0);
+	manager.queueMessage(secondAccount, 1);
+	manager.setBase(m_server->url());
+	manager.retry();
+	QTRY_VERIFY(manager.isDrained());
+
+	// Message of the other account goes along with the roster change, but the
+	// message of the same account waits for its answer
+	const QString roster = QStringLiteral("/api/modifyRoster");
+	const QString messages = QStringLiteral("/api/appendMessages");
+	QCOMPARE(m_server->paths.value(roster), 1);
+	QCOMPARE(m_server->paths.value(messages), 2);
+	const int rosterAnswered = m_server->events.indexOf(QStringLiteral("< ") + roster);
+	QVERIFY(rosterAnswered >= 0);
+	QVERIFY(m_server->events.indexOf(QStringLiteral("> ") + messages) < rosterAnswered);
+	QVERIFY(m_server->events.lastIndexOf(QStringLiteral("> ") + messages) > rosterAnswered);
+}
+
+QTEST_MAIN(NetworkManagerTest)
+
+#include "networkmanagertest.moc"
@@ -26,16 +26,34 @@
 #include "chatlayeradapter.h"
 #include "chatsessionadapter.h"
 #include <qutim/account.h>
+#include <QDBusMessage>
+#include <QDBusServiceWatcher>
+#include <QTimer>
 
-ChatLayerAdapter::ChatLayerAdapter(const QDBusConnection &dbus) :
-		QDBusAbstractAdaptor(ChatLayer::instance()), m_dbus(dbus)
+ChatLayerAdapter::ChatLayerAdapter(const QDBusConnection &dbus, QObject *parent) :
+		QDBusAbstractAdaptor(parent ? parent : ChatLayer::instance()), m_dbus(dbus), m_lastSubscription(0)
 {
+	m_watcher = new QDBusServiceWatcher(this);
+	m_watcher->setConnection(m_dbus);
+	m_watcher->setWatchMode(QDBusServiceWatcher::WatchForUnregistration);
+	connect(m_watcher, SIGNAL(serviceUnregistered(QString)), SLOT(onServiceUnregistered(QString)));
+	ChatLayer *layer = ChatLayer::instance();
+	if (!layer)
+		return;
+	foreach (ChatSession *session, layer->sessions())
+		watch(session);
 	QList<QDBusObjectPath> list = sessions();
 	Q_UNUSED(list);
-	connect(ChatLayer::instance(), SIGNAL(sessionCreated(qutim_sdk_0_3::ChatSession*)),
+	connect(layer, SIGNAL(sessionCreated(qutim_sdk_0_3::ChatSession*)),
 			this, SLOT(onSessionCreated(qutim_sdk_0_3::ChatSession*)));
 }
 
+ChatLayerAdapter::~ChatLayerAdapter()
+{
+	foreach (const MessageSubscription &subscription, m_subscriptions)
+		delete subscription.timer;
+}
+
 QDBusObjectPath ChatLayerAdapter::session(const QDBusObjectPath &chatUnit, bool create)
 {
 	QObject *obj = m_dbus.objectRegisteredAt(chatUnit.path());
@@ -62,9 +80,100 @@ QList<QDBusObjectPath> ChatLayerAdapter::sessions() const
 	return list;
 }
 
+uint ChatLayerAdapter::subscribeMessages(const QString &account, const QString &unit,
+										 int direction, int maxBatch, int latency)
+{
+	if (!calledFromDBus())
+		return 0;
+	const uint id = ++m_lastSubscription;
+	MessageSubscription &subscription = m_subscriptions[id];
+	subscription.service = message().service();
+	subscription.account = account;
+	subscription.unit = unit;
+	subscription.direction = direction;
+	subscription.maxBatch = qMax(1, maxBatch);
+	subscription.timer = new QTimer;
+	subscription.timer->setSingleShot(true);
+	subscription.timer->setInterval(latency > 0 ? latency : 100);
+	connect(subscription.timer, &QTimer::timeout, this, [this, id] () { flush(id); });
+	m_watcher->addWatchedService(subscription.service);
+	return id;
+}
+
+void ChatLayerAdapter::unsubscribeMessages(uint id)
+{
+	// Clients may remove only their own subscriptions
+	if (calledFromDBus() && m_subscriptions.value(id).service == message().service())
+		remove(id);
+}
+
 void ChatLayerAdapter::onSessionCreated(qutim_sdk_0_3::ChatSession *session)
 {
+	watch(session);
 	QDBusObjectPath path = ChatSessionAdapter::ensurePath(m_dbus, session);
 	emit sessionCreated(path);
 }
 
+void ChatLayerAdapter::onMessage(qutim_sdk_0_3::Message *message)
+{
+	if (m_subscriptions.isEmpty())
+		return;
+	const ChatUnit *unit = message->chatUnit();
+	if (!unit)
+		return;
+	const Direction direction = message->isIncoming() ? Incoming : Outgoing;
+	QHash<uint, MessageSubscription>::iterator it = m_subscriptions.begin();
+	for (; it != m_subscriptions.end(); ++it) {
+		MessageSubscription &subscription = it.value();
+		if (subscription.direction != AnyDirection && subscription.direction != direction)
+			continue;
+		if (!subscription.unit.isEmpty() && subscription.unit != unit->id())
+			continue;
+		if (!subscription.account.isEmpty() && subscription.account != unit->account()->id())
+			continue;
+		subscription.pending << *message;
+		if (subscription.pending.size() >= subscription.maxBatch)
+			flush(it.key());
+		else if (!subscription.timer->isActive())
+			subscription.timer->start();
+	}
+}
+
+void ChatLayerAdapter::onServiceUnregistered(const QString &service)
+{
+	foreach (uint id, m_subscriptions.keys()) {
+		if (m_subscriptions.value(id).service == service)
+			remove(id);
+	}
+	m_watcher->removeWatchedService(service);
+}
+
+void ChatLayerAdapter::watch(ChatSession *session)
+{
+	connect(session, SIGNAL(messageReceived(qutim_sdk_0_3::Message*)),
+			this, SLOT(onMessage(qutim_sdk_0_3::Message*)));
+	connect(session, SIGNAL(messageSent(qutim_sdk_0_3::Message*)),
+			this, SLOT(onMessage(qutim_sdk_0_3::Message*)));
+}
+
+void ChatLayerAdapter::flush(uint id)
+{
+	QHash<uint, MessageSubscription>::iterator it = m_subscriptions.find(id);
+	if (it == m_subscriptions.end() || it->pending.isEmpty())
+		return;
+	it->timer->stop();
+	// Targeted signal isn't delivered to the other listeners of the bus
+	QDBusMessage signal = QDBusMessage::createTargetedSignal(it->service, QLatin1String("/ChatLayer"),
+															 QLatin1String("org.qutim.ChatLayer"),
+															 QLatin1String("messagesBatch"));
+	signal << id << qVariantFromValue(it->pending);
+	it->pending.clear();
+	m_dbus.send(signal);
+}
+
+void ChatLayerAdapter::remove(uint id)
+{
+	MessageSubscription subscription = m_subscriptions.take(id);
+	delete subscription.timer;
+}
+
@@ -29,27 +29,69 @@
 #include <QDBusAbstractAdaptor>
 #include <QDBusObjectPath>
 #include <QDBusConnection>
+#include <QDBusContext>
 #include <qutim/chatsession.h>
 
+class QTimer;
+class QDBusServiceWatcher;
+
 using namespace qutim_sdk_0_3;
 
-class ChatLayerAdapter : public QDBusAbstractAdaptor
+// Messages of all sessions which are requested by one of clients
+struct MessageSubscription
+{
+	MessageSubscription() : direction(0), maxBatch(1), timer(0) {}
+	QString service;
+	QString account;
+	QString unit;
+	int direction;
+	int maxBatch;
+	MessageList pending;
+	QTimer *timer;
+};
+
+class ChatLayerAdapter : public QDBusAbstractAdaptor, protected QDBusContext
 {
 	Q_OBJECT
 	Q_CLASSINFO("D-Bus Interface", "org.qutim.ChatLayer")
 public:
-	explicit ChatLayerAdapter(const QDBusConnection &dbus);
+	enum Direction
+	{
+		AnyDirection = 0,
+		Incoming,
+		Outgoing
+	};
+
+	// The adaptor is attached to the chat layer unless other parent is given
+	explicit ChatLayerAdapter(const QDBusConnection &dbus, QObject *parent = 0);
+	virtual ~ChatLayerAdapter();
 public slots:
 	QDBusObjectPath session(const QDBusObjectPath &chatUnit, bool create = true);
 	QDBusObjectPath session(const QDBusObjectPath &account, const QString &id, bool create = true);
 	QList<QDBusObjectPath> sessions() const;
+	// Messages matching the filter are sent to the caller only by messagesBatch
+	// signal, once there are maxBatch of them or latency msecs have passed.
+	// Empty account or unit match any one.
+	uint subscribeMessages(const QString &account, const QString &unit,
+						   int direction, int maxBatch, int latency);
+	void unsubscribeMessages(uint subscription);
 signals:
 	void sessionCreated(const QDBusObjectPath &sessionPath);
+	void messagesBatch(uint subscription, const qutim_sdk_0_3::MessageList &messages);
 private slots:
 	void onSessionCreated(qutim_sdk_0_3::ChatSession *session);
+	void onMessage(qutim_sdk_0_3::Message *message);
+	void onServiceUnregistered(const QString &service);
 private:
+	void watch(ChatSession *session);
+	void flush(uint id);
+	void remove(uint id);
+
 	QDBusConnection m_dbus;
 	int m_lastId;
+	uint m_lastSubscription;
+	QHash<uint, MessageSubscription> m_subscriptions;
+	QDBusServiceWatcher *m_watcher;
 };
 
 #endif // CHATLAYERADAPTER_H
@@ -54,6 +54,8 @@ ChatSessionAdapter::ChatSessionAdapter(const QDBusConnection &dbus, ChatSession
 	connect(session, SIGNAL(activated(bool)), this, SIGNAL(activated(bool)));
 	connect(session, SIGNAL(unreadChanged(qutim_sdk_0_3::MessageList)),
 			this, SIGNAL(unreadChanged(qutim_sdk_0_3::MessageList)));
+	connect(session, SIGNAL(unreadCountChanged(int)),
+			this, SIGNAL(unreadCountChanged(int)));
 	connect(session, SIGNAL(contactAdded(qutim_sdk_0_3::Buddy*)),
 			this, SLOT(onContactAdded(qutim_sdk_0_3::Buddy*)));
 	connect(session, SIGNAL(contactRemoved(qutim_sdk_0_3::Buddy*)),
@@ -42,7 +42,10 @@ class ChatSessionAdapter : public QDBusAbstractAdaptor
 	Q_PROPERTY(QDBusObjectPath chatUnit READ chatUnit WRITE setChatUnit)
 	Q_PROPERTY(bool active READ isActive WRITE setActive NOTIFY activated)
 	Q_PROPERTY(qutim_sdk_0_3::MessageList unread READ unread NOTIFY unreadChanged)
+	Q_PROPERTY(int unreadCount READ unreadCount NOTIFY unreadCountChanged)
 public:
+	enum { UnreadPageSize = 100 };
+
 	static const ChatSessionPathHash &hash();
 	static QDBusObjectPath ensurePath(QDBusConnection dbus, ChatSession *session);
 
@@ -53,7 +56,9 @@ public:
 	void setChatUnit(const QDBusObjectPath &unit);
 	inline bool isActive() { return m_session->isActive(); }
 	inline void setActive(bool active) { m_session->setActive(active); }
-	inline MessageList unread() const { return m_session->unread(); }
+	// Only the first page is sent, unreadRange() returns the rest
+	inline MessageList unread() const { return m_session->unreadRange(0, UnreadPageSize); }
+	inline int unreadCount() const { return m_session->unreadCount(); }
 	inline const QDBusObjectPath &path() const { return m_path; }
 
 public slots:
@@ -63,6 +68,8 @@ public slots:
 	inline qint64 appendMessage(const QString &text);
 	inline void activate() { setActive(true); }
 	inline void markRead(quint64 id) { m_session->markRead(id); }
+	inline qutim_sdk_0_3::MessageList unreadRange(int offset, int count)
+	{ return m_session->unreadRange(offset, count); }
 
 signals:
 	void messageReceived(const qutim_sdk_0_3::Message &message);
@@ -71,6 +78,7 @@ signals:
 	void contactRemoved(const QDBusObjectPath &buddy, const QString &id);
 	void activated(bool active);
 	void unreadChanged(const qutim_sdk_0_3::MessageList &messages);
+	void unreadCountChanged(int count);
 
 private slots:
 	void onMessageReceived(qutim_sdk_0_3::Message *message);
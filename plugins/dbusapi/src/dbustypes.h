@@ -0,0 +1,41 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef DBUSTYPES_H
+#define DBUSTYPES_H
+
+#include <qutim/status.h>
+#include <qutim/message.h>
+#include <QDBusArgument>
+
+using namespace qutim_sdk_0_3;
+
+QDBusArgument &operator<<(QDBusArgument &argument, const Status &status);
+const QDBusArgument &operator>>(const QDBusArgument &argument, Status &status);
+// Message is sent as a{sv}, its chat unit is exported at the session bus
+QDBusArgument &operator<<(QDBusArgument &argument, const Message &msg);
+const QDBusArgument &operator>>(const QDBusArgument &argument, Message &msg);
+
+#endif // DBUSTYPES_H
@@ -0,0 +1,356 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "chatlayeradapter.h"
+#include "dbustypes.h"
+#include <qutim/protocol.h>
+#include <qutim/account.h>
+#include <qutim/chatunit.h>
+#include <QtTest>
+#include <QProcess>
+#include <QDBusMessage>
+#include <QDBusMetaType>
+#include <QDBusPendingReply>
+
+// Defined by the plugin, the test doesn't link it
+quint16 dbus_adaptor_event_id = 0;
+
+class TestProtocol : public Protocol
+{
+	Q_OBJECT
+	Q_CLASSINFO("Protocol", "test")
+public:
+	virtual QList<Account*> accounts() const { return QList<Account*>(); }
+	virtual Account *account(const QString &) const { return 0; }
+private:
+	virtual void loadAccounts() {}
+};
+
+class TestAccount : public Account
+{
+	Q_OBJECT
+public:
+	TestAccount(const QString &id, Protocol *protocol) : Account(id, protocol) {}
+	virtual ChatUnit *getUnit(const QString &, bool) { return 0; }
+protected:
+	virtual void doConnectToServer() {}
+	virtual void doDisconnectFromServer() {}
+	virtual void doStatusChange(const Status &) {}
+};
+
+class TestUnit : public ChatUnit
+{
+	Q_OBJECT
+public:
+	TestUnit(const QString &id, Account *account) : ChatUnit(account), m_id(id) {}
+	virtual QString id() const { return m_id; }
+	virtual bool sendMessage(const Message &) { return true; }
+private:
+	QString m_id;
+};
+
+// Client of the private bus, collects batches of its subscriptions
+class Client : public QObject
+{
+	Q_OBJECT
+public:
+	Client(const QString &address, const QString &name) :
+		bus(QDBusConnection::connectToBus(address, name)), received(0)
+	{
+		bus.connect(QString(), QLatin1String("/ChatLayer"), QLatin1String("org.qutim.ChatLayer"),
+					QLatin1String("messagesBatch"), this, SLOT(onBatch(QDBusMessage)));
+	}
+
+	~Client()
+	{
+		QDBusConnection::disconnectFromBus(bus.name());
+	}
+
+	QDBusPendingCall call(const QString &service, const QString &method, const QVariantList &args)
+	{
+		QDBusMessage message = QDBusMessage::createMethodCall(service, QLatin1String("/ChatLayer"),
+															  QLatin1String("org.qutim.ChatLayer"),
+															  method);
+		message.setArguments(args);
+		return bus.asyncCall(message);
+	}
+
+	QStringList texts() const
+	{
+		QStringList result;
+		foreach (const MessageList &batch, batches) {
+			foreach (const Message &message, batch)
+				result << message.text();
+		}
+		return result;
+	}
+
+	QDBusConnection bus;
+	QList<uint> subscriptions;
+	QList<MessageList> batches;
+	int received;
+
+private slots:
+	void onBatch(const QDBusMessage &message)
+	{
+		MessageList batch;
+		message.arguments().value(1).value<QDBusArgument>() >> batch;
+		subscriptions << message.arguments().value(0).toUInt();
+		batches << batch;
+		received += batch.size();
+	}
+};
+
+class ChatLayerTest : public QObject
+{
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanupTestCase();
+	void init();
+	void cleanup();
+	void batchBySize();
+	void batchByLatency();
+	void filters_data();
+	void filters();
+	void targeted();
+	void throughput_data();
+	void throughput();
+
+private:
+	uint subscribe(Client *client, const QString &account, const QString &unit,
+				   int direction, int maxBatch, int latency);
+	void send(int count, TestUnit *unit = 0, bool incoming = true);
+
+	QProcess m_daemon;
+	QString m_address;
+	QObject *m_layer;
+	ChatLayerAdapter *m_adapter;
+	TestProtocol *m_protocol;
+	QList<TestAccount*> m_accounts;
+	QList<TestUnit*> m_units;
+	Client *m_client;
+	int m_sent;
+};
+
+void ChatLayerTest::initTestCase()
+{
+	m_daemon.start(QLatin1String("dbus-daemon"),
+				   QStringList() << QLatin1String("--session")
+				   << QLatin1String("--nofork") << QLatin1String("--print-address"));
+	if (!m_daemon.waitForStarted())
+		QSKIP("dbus-daemon is not available");
+	QVERIFY(m_daemon.waitForReadyRead(5000));
+	m_address = QString::fromLatin1(m_daemon.readLine().trimmed());
+	QVERIFY(!m_address.isEmpty());
+	// Messages export their chat units at the session bus, so it's the private one too
+	qputenv("DBUS_SESSION_BUS_ADDRESS", m_address.toLatin1());
+	QVERIFY(QDBusConnection::sessionBus().isConnected());
+
+	qDBusRegisterMetaType<Status>();
+	qDBusRegisterMetaType<Message>();
+	qDBusRegisterMetaType<MessageList>();
+
+	m_protocol = new TestProtocol;
+	for (int i = 0; i < 2; ++i)
+		m_accounts << new TestAccount(QString::fromLatin1("account%1").arg(i), m_protocol);
+	for (int i = 0; i < 4; ++i)
+		m_units << new TestUnit(QString::fromLatin1("unit%1").arg(i), m_accounts.at(i / 2));
+}
+
+void ChatLayerTest::cleanupTestCase()
+{
+	qDeleteAll(m_units);
+	qDeleteAll(m_accounts);
+	delete m_protocol;
+	m_daemon.terminate();
+	m_daemon.waitForFinished();
+}
+
+void ChatLayerTest::init()
+{
+	QDBusConnection bus = QDBusConnection::sessionBus();
+	m_layer = new QObject;
+	m_adapter = new ChatLayerAdapter(bus, m_layer);
+	QVERIFY(bus.registerObject(QLatin1String("/ChatLayer"), m_layer, QDBusConnection::ExportAdaptors));
+	m_client = new Client(m_address, QLatin1String("client"));
+	QVERIFY(m_client->bus.isConnected());
+	m_sent = 0;
+}
+
+void ChatLayerTest::cleanup()
+{
+	delete m_client;
+	QDBusConnection::sessionBus().unregisterObject(QLatin1String("/ChatLayer"));
+	delete m_layer;
+}
+
+uint ChatLayerTest::subscribe(Client *client, const QString &account, const QString &unit,
+							  int direction, int maxBatch, int latency)
+{
+	QDBusPendingReply<uint> reply = client->call(QDBusConnection::sessionBus().baseService(),
+												 QLatin1String("subscribeMessages"),
+												 QVariantList() << account << unit << direction
+												 << maxBatch << latency);
+	QTRY_VERIFY_WITH_TIMEOUT(reply.isFinished(), 5000);
+	return reply.isValid() ? reply.value() : 0;
+}
+
+// Messages come the same way as from sessions' messageReceived and messageSent
+void ChatLayerTest::send(int count, TestUnit *unit, bool incoming)
+{
+	for (int i = 0; i < count; ++i, ++m_sent) {
+		Message message(QString::number(m_sent));
+		message.setChatUnit(unit ? unit : m_units.at(m_sent % m_units.size()));
+		message.setIncoming(incoming);
+		QMetaObject::invokeMethod(m_adapter, "onMessage",
+								  Q_ARG(qutim_sdk_0_3::Message*, &message));
+	}
+}
+
+void ChatLayerTest::batchBySize()
+{
+	const uint id = subscribe(m_client, QString(), QString(), ChatLayerAdapter::AnyDirection, 10, 60000);
+	QVERIFY(id);
+	send(25);
+	QTRY_COMPARE(m_client->batches.size(), 2);
+	QCOMPARE(m_client->batches.at(0).size(), 10);
+	QCOMPARE(m_client->batches.at(1).size(), 10);
+	QCOMPARE(m_client->subscriptions, QList<uint>() << id << id);
+	// The rest waits for the latency
+	QTest::qWait(200);
+	QCOMPARE(m_client->received, 20);
+	send(5);
+	QTRY_COMPARE(m_client->received, 30);
+	QCOMPARE(m_client->batches.size(), 3);
+	QCOMPARE(m_client->texts().first(), QString::fromLatin1("0"));
+	QCOMPARE(m_client->texts().last(), QString::fromLatin1("29"));
+}
+
+void ChatLayerTest::batchByLatency()
+{
+	QVERIFY(subscribe(m_client, QString(), QString(), ChatLayerAdapter::AnyDirection, 1000, 100));
+	QElapsedTimer timer;
+	timer.start();
+	send(3);
+	QTRY_COMPARE(m_client->batches.size(), 1);
+	// Coarse timers may fire up to 5% earlier
+	QVERIFY(timer.elapsed() >= 95);
+	QCOMPARE(m_client->texts(), QStringList() << "0" << "1" << "2");
+
+	// Timer is started again by the next message
+	send(2);
+	QTRY_COMPARE(m_client->batches.size(), 2);
+	QCOMPARE(m_client->batches.last().size(), 2);
+}
+
+void ChatLayerTest::filters_data()
+{
+	QTest::addColumn<QString>("account");
+	QTest::addColumn<QString>("unit");
+	QTest::addColumn<int>("direction");
+	QTest::addColumn<QStringList>("expected");
+
+	// Each unit gets one incoming and one outgoing message, units 0 and 1 belong to account0
+	QTest::newRow("any") << QString() << QString() << int(ChatLayerAdapter::AnyDirection)
+						 << (QStringList() << "0" << "1" << "2" << "3" << "4" << "5" << "6" << "7");
+	QTest::newRow("account") << "account1" << QString() << int(ChatLayerAdapter::AnyDirection)
+							 << (QStringList() << "2" << "3" << "6" << "7");
+	QTest::newRow("unit") << QString() << "unit1" << int(ChatLayerAdapter::AnyDirection)
+						  << (QStringList() << "1" << "5");
+	QTest::newRow("account and unit") << "account0" << "unit2" << int(ChatLayerAdapter::AnyDirection)
+									  << QStringList();
+	QTest::newRow("incoming") << QString() << QString() << int(ChatLayerAdapter::Incoming)
+							  << (QStringList() << "0" << "1" << "2" << "3");
+	QTest::newRow("outgoing") << "account0" << QString() << int(ChatLayerAdapter::Outgoing)
+							  << (QStringList() << "4" << "5");
+}
+
+void ChatLayerTest::filters()
+{
+	QFETCH(QString, account);
+	QFETCH(QString, unit);
+	QFETCH(int, direction);
+	QFETCH(QStringList, expected);
+
+	QVERIFY(subscribe(m_client, account, unit, direction, 1, 10));
+	send(4, 0, true);
+	send(4, 0, false);
+	if (expected.isEmpty()) {
+		QTest::qWait(200);
+	} else {
+		QTRY_COMPARE(m_client->received, expected.size());
+		QTest::qWait(50);
+	}
+	QCOMPARE(m_client->texts(), expected);
+}
+
+void ChatLayerTest::targeted()
+{
+	Client other(m_address, QLatin1String("other"));
+	QVERIFY(other.bus.isConnected());
+	const uint id = subscribe(m_client, QString(), QString(), ChatLayerAdapter::AnyDirection, 5, 10);
+	QVERIFY(id);
+
+	// Subscription belongs to its client, others can't remove it
+	QDBusPendingCall call = other.call(QDBusConnection::sessionBus().baseService(),
+									   QLatin1String("unsubscribeMessages"),
+									   QVariantList() << id);
+	QTRY_VERIFY(call.isFinished());
+
+	send(10);
+	QTRY_COMPARE(m_client->received, 10);
+	QTest::qWait(200);
+	QVERIFY(other.batches.isEmpty());
+}
+
+void ChatLayerTest::throughput_data()
+{
+	QTest::addColumn<int>("count");
+	QTest::addColumn<int>("maxBatch");
+
+	QTest::newRow("10k by 1") << 10000 << 1;
+	QTest::newRow("10k by 100") << 10000 << 100;
+	QTest::newRow("100k by 1000") << 100000 << 1000;
+}
+
+void ChatLayerTest::throughput()
+{
+	QFETCH(int, count);
+	QFETCH(int, maxBatch);
+
+	QVERIFY(subscribe(m_client, QString(), QString(), ChatLayerAdapter::AnyDirection, maxBatch, 10));
+	QElapsedTimer timer;
+	timer.start();
+	send(count);
+	QTRY_COMPARE_WITH_TIMEOUT(m_client->received, count, 120000);
+	const qint64 elapsed = qMax<qint64>(timer.elapsed(), 1);
+	qDebug("%d messages in %d batches, %lld ms, %.0f messages/sec",
+		   count, m_client->batches.size(), elapsed, count * 1000.0 / elapsed);
+	QCOMPARE(m_client->texts().last(), QString::number(count - 1));
+}
+
+QTEST_MAIN(ChatLayerTest)
+#include "chatlayertest.moc"
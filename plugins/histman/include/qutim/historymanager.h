@@ -27,6 +27,7 @@
 
 #include <QIcon>
 #include <QString>
+#include <QStringList>
 #include <QDateTime>
 #include <QList>
 #include <QPair>
@@ -73,6 +74,12 @@ namespace HistoryManager
 		inline void setDataBase(DataBaseInterface *data_base) { m_data_base = data_base; }
 		inline void setCharset(const QByteArray &charset) { m_charset = charset; }
 		virtual void loadMessages(const QString &path) = 0;
+		// Importers which keep every contact in a separate file may list them
+		// here. loadSource() is then called for each of them from a thread
+		// pool, so it must only write to the given data base
+		virtual QStringList sources(const QString &path) { Q_UNUSED(path); return QStringList(); }
+		virtual void loadSource(const QString &path, const QString &source, DataBaseInterface *data_base)
+		{ Q_UNUSED(path); Q_UNUSED(source); Q_UNUSED(data_base); }
 		virtual bool validate(const QString &path) = 0;
 		virtual QString name() = 0;
 		virtual QIcon icon() = 0;
@@ -91,6 +98,15 @@ namespace HistoryManager
 		inline ConfigWidget createAccountWidget(const QString &protocol) Q_REQUIRED_RESULT
 		{ return m_data_base->createAccountWidget(protocol); }
 		inline QByteArray charset() { return m_charset; }
+		inline void loadSources(const QString &path)
+		{
+			QStringList list = sources(path);
+			setMaxValue(list.size());
+			for (int i = 0; i < list.size(); i++) {
+				loadSource(path, list.at(i), m_data_base);
+				setValue(i + 1);
+			}
+		}
 	private:
 		friend class DataBaseInterface;
 		DataBaseInterface *m_data_base;
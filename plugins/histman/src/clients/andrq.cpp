@@ -108,14 +108,7 @@ bool andrq::isValidUtf8(const QByteArray &array)
 
 QDateTime andrq::getDateTime(QDataStream &in)
 {
-	static QDateTime zerodate;
-	if(zerodate.isNull())
-	{
-		QDate date(1899, 12, 30);
-		QTime time(0, 0, 0, 0);
-		zerodate.setDate(date);
-		zerodate.setTime(time);
-	}
+	static const QDateTime zerodate(QDate(1899, 12, 30), QTime(0, 0, 0, 0));
 	double time;
 	in >> time;
 	int day = (int)time;
@@ -125,57 +118,63 @@ QDateTime andrq::getDateTime(QDataStream &in)
 }
 
 void andrq::loadMessages(const QString &path)
+{
+	loadSources(path);
+}
+
+QStringList andrq::sources(const QString &path)
 {
 	QDir dir = path;
-	QString account = dir.dirName();
 	if(!dir.cd("history"))
+		return QStringList();
+	QStringList files;
+	foreach(const QFileInfo &info, dir.entryInfoList(QDir::Files))
+		files << info.absoluteFilePath();
+	return files;
+}
+
+void andrq::loadSource(const QString &path, const QString &source, DataBaseInterface *data_base)
+{
+	QFile file(source);
+	if(!file.open(QFile::ReadOnly))
 		return;
-	setProtocol("icq");
-	setAccount(account);
-	QFileInfoList files = dir.entryInfoList(QDir::Files);
-	setMaxValue(files.size());
-	for(int i = 0; i < files.size(); i++)
+	QString uin = QFileInfo(source).fileName();
+	data_base->setProtocol("icq");
+	data_base->setAccount(QDir(path).dirName());
+	data_base->setContact(uin);
+	QDataStream in(&file);
+	in.setByteOrder(QDataStream::LittleEndian);
+	Message message;
+	while(!in.atEnd())
 	{
-		setValue(i + 1);
-		QString uin = files[i].fileName();
-		QFile file(files[i].absoluteFilePath());
-		if(!file.open(QFile::ReadOnly))
-			continue;
-		setContact(uin);
-		QDataStream in(&file);
-		in.setByteOrder(QDataStream::LittleEndian);
-		Message message;
-		while(!in.atEnd())
+		qint32 type;
+		in >> type;
+		switch(type)
 		{
-			qint32 type;
-			in >> type;
-			switch(type)
-			{
-			case -1: {
-				quint8 kind;
-				qint32 who;
-				in >> kind >> who;
-				QString from = QString::number(who);
-				message.setIncoming(from == uin);
-				message.setTime(getDateTime(in));
-				qint32 tmp;
-				in >> tmp;
-				in.skipRawData(tmp);
-				message.setText(getString(in, who));
-				if(kind==1)
-					appendMessage(message);
-				break; }
-			case -2: {
-				qint32 tmp;
-				in >> tmp;
-				in.skipRawData(tmp);
-				break; }
-			case -3:
-				in.skipRawData(5);
-				break;
-			default:
-				break;
-			}
+		case -1: {
+			quint8 kind;
+			qint32 who;
+			in >> kind >> who;
+			QString from = QString::number(who);
+			message.setIncoming(from == uin);
+			message.setTime(getDateTime(in));
+			qint32 tmp;
+			in >> tmp;
+			in.skipRawData(tmp);
+			message.setText(getString(in, who));
+			if(kind==1)
+				data_base->appendMessage(message);
+			break; }
+		case -2: {
+			qint32 tmp;
+			in >> tmp;
+			in.skipRawData(tmp);
+			break; }
+		case -3:
+			in.skipRawData(5);
+			break;
+		default:
+			break;
 		}
 	}
 }
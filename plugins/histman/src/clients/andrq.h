@@ -41,6 +41,8 @@ public:
 	static bool isValidUtf8(const QByteArray &array);
 	static QDateTime getDateTime(QDataStream &in);
 	virtual void loadMessages(const QString &path);
+	virtual QStringList sources(const QString &path);
+	virtual void loadSource(const QString &path, const QString &source, DataBaseInterface *data_base);
 	virtual bool validate(const QString &path);
 	virtual QString name();
 	virtual QIcon icon();
@@ -44,57 +44,63 @@ licq::~licq()
 }
 
 void licq::loadMessages(const QString &path)
+{
+	loadSources(path);
+}
+
+QStringList licq::sources(const QString &path)
 {
 	QDir dir = path;
-	QSettings settings(dir.filePath("owner.Licq"), QSettings::IniFormat);
-	QString account = settings.value("Uin").toString();
 	if(!dir.cd("history"))
-		return;
-	setProtocol("icq");
-	setAccount(account);
-	QFileInfoList files = dir.entryInfoList(QDir::Files|QDir::NoDotAndDotDot);
-	setMaxValue(files.size());
-	for(int i=0;i<files.size();i++)
+		return QStringList();
+	QStringList files;
+	foreach(const QFileInfo &info, dir.entryInfoList(QDir::Files|QDir::NoDotAndDotDot))
+		files << info.absoluteFilePath();
+	return files;
+}
+
+void licq::loadSource(const QString &path, const QString &source, DataBaseInterface *data_base)
+{
+	QSettings settings(QDir(path).filePath("owner.Licq"), QSettings::IniFormat);
+	QString uin = QFileInfo(source).fileName();
+	uin.truncate(uin.indexOf('.'));
+	data_base->setProtocol("icq");
+	data_base->setAccount(settings.value("Uin").toString());
+	data_base->setContact(uin);
+	QFile file(source);
+	if (file.open(QIODevice::ReadOnly | QIODevice::Text))
 	{
-		setValue(i + 1);
-		QString uin = files[i].fileName();
-		uin.truncate(uin.indexOf('.'));
-		setContact(uin);
-		QFile file(files[i].absoluteFilePath());
-		if (file.open(QIODevice::ReadOnly | QIODevice::Text))
+		QTextStream inc(&file);
+		inc.setAutoDetectUnicode(false);
+		inc.setCodec(charset());
+		QStringList lines = inc.readAll().remove('\r').split("\n");
+		bool first=true;
+		Message message;
+		QString text;
+		for (int i = 0; i < lines.size(); ++i)
 		{
-			QTextStream inc(&file);
-			inc.setAutoDetectUnicode(false);
-			inc.setCodec(charset());
-			QStringList lines = inc.readAll().remove('\r').split("\n");
-			bool first=true;
-			Message message;
-			QString text;
-			for (int i = 0; i < lines.size(); ++i)
+			if(lines[i].startsWith("["))
 			{
-				if(lines[i].startsWith("["))
-				{
-					//[ R | 0001 | 0260 | 0000 | 1169984229 ]
-					if(first) {
-						first=!first;
-					} else {
-						text.chop(5);
-						message.setText(text);
-						appendMessage(message);
-					}
-					message.setIncoming(lines[i].section(" ",1,1)=="R");
-					message.setTime(QDateTime::fromTime_t(lines[i].section(" ",9,9).toULongLong()));
-					text.clear();
-				}
-				else {
-					text += lines[i].section(":",1);
-					text += '\n';
+				//[ R | 0001 | 0260 | 0000 | 1169984229 ]
+				if(first) {
+					first=!first;
+				} else {
+					text.chop(5);
+					message.setText(text);
+					data_base->appendMessage(message);
 				}
+				message.setIncoming(lines[i].section(" ",1,1)=="R");
+				message.setTime(QDateTime::fromTime_t(lines[i].section(" ",9,9).toULongLong()));
+				text.clear();
+			}
+			else {
+				text += lines[i].section(":",1);
+				text += '\n';
 			}
-			text.chop(5);
-			message.setText(text);
-			appendMessage(message);
 		}
+		text.chop(5);
+		message.setText(text);
+		data_base->appendMessage(message);
 	}
 }
 
@@ -43,11 +43,16 @@ pidgin::~pidgin()
 }
 
 void pidgin::loadMessages(const QString &path)
+{
+	loadSources(path);
+}
+
+QStringList pidgin::sources(const QString &path)
 {
 	QDir root = path;
 	if(!root.cd("logs"))
-		return;
-	int num = 0;
+		return QStringList();
+	QStringList files;
 	QStringList protocol_dirs = root.entryList(QDir::Dirs|QDir::NoDotAndDotDot);
 	foreach(QString protocol, protocol_dirs)
 	{
@@ -60,15 +65,19 @@ void pidgin::loadMessages(const QString &path)
 			foreach(const QString &contact, contacts)
 			{
 				QDir contact_dir(dir.filePath(contact));
-				QFileInfoList files = contact_dir.entryInfoList(QStringList() << "*.html", QDir::Files|QDir::NoDotAndDotDot);
-				num += files.size();
+				QFileInfoList infos = contact_dir.entryInfoList(QStringList() << "*.html", QDir::Files|QDir::NoDotAndDotDot);
+				foreach(const QFileInfo &info, infos)
+					files << info.absoluteFilePath();
 			}
 		}
 	}
-	setMaxValue(num);
-	num = 0;
-	QTextDocument converter;
-	const QStringList stamps = QStringList()
+	return files;
+}
+
+void pidgin::loadSource(const QString &path, const QString &source, DataBaseInterface *data_base)
+{
+	Q_UNUSED(path);
+	static const QStringList stamps = QStringList()
 							   << "(hh:mm:ss)</font"
 							   << "(yyyy-MM-dd hh:mm:ss)</font"
 							   << "(dd.MM.yyyy hh:mm:ss)</font"
@@ -77,87 +86,72 @@ void pidgin::loadMessages(const QString &path)
 							   << "(hh:mm:ss AP)</font"
 							   << "(hh:mm:ss ap)</font";
 	// "(2009-02-13 20:27:43)</font"
-	foreach(QString protocol_dir_name, protocol_dirs)
+	QFileInfo fileInfo(source);
+	QDir contact_dir = fileInfo.absoluteDir();
+	QDir account_dir = contact_dir;
+	account_dir.cdUp();
+	QDir protocol_dir = account_dir;
+	protocol_dir.cdUp();
+	data_base->setProtocol(protocol_dir.dirName().toLower());
+	data_base->setAccount(account_dir.dirName());
+	data_base->setContact(contact_dir.dirName());
+	QTextDocument converter;
+	QFile file(source);
+	//2008-07-23.163259+0600YEKST.html
+	QString dayString = fileInfo.fileName();
+	dayString = dayString.remove(4,1).remove(6,1);
+	dayString.truncate(8);
+	QDate day = QDate().fromString(dayString,"yyyyMMdd");
+	uint last=0;
+	if (file.open(QIODevice::ReadOnly | QIODevice::Text))
 	{
-		QDir protocol_dir(root.filePath(protocol_dir_name));
-		QStringList account_dirs = protocol_dir.entryList(QDir::Dirs|QDir::NoDotAndDotDot);
-		QString protocol = protocol_dir_name.toUpper();
-		setProtocol(protocol.toLower());
-		foreach(const QString &account, account_dirs)
+		bool mes=true;
+		QTextStream inc(&file);
+		inc.setAutoDetectUnicode(false);
+		inc.setCodec(charset());
+		QStringList lines = inc.readAll().split('\n');
+		for (int i = 1; i < lines.size()-2; ++i)
 		{
-			setAccount(account);
-			QDir dir(protocol_dir.filePath(account));
-			QStringList contacts = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
-			foreach(const QString &contact, contacts)
-			{
-				setContact(contact);
-				QDir contact_dir(dir.filePath(contact));
-				QFileInfoList files = contact_dir.entryInfoList(QStringList() << "*.html", QDir::Files|QDir::NoDotAndDotDot);
-				foreach(QFileInfo fileInfo, files)
-				{
-					setValue(++num);
-					QFile file(fileInfo.absoluteFilePath());
-					//2008-07-23.163259+0600YEKST.html
-					QString dayString = fileInfo.fileName();
-					dayString = dayString.remove(4,1).remove(6,1);
-					dayString.truncate(8);
-					QDate day = QDate().fromString(dayString,"yyyyMMdd");
-					uint last=0;
-					if (file.open(QIODevice::ReadOnly | QIODevice::Text))
-					{
-						bool mes=true;
-						QTextStream inc(&file);
-						inc.setAutoDetectUnicode(false);
-						inc.setCodec(charset());
-						//inc.setAutoDetectUnicode(false);
-						//inc.setCodec("cp1251");
-						QStringList lines = inc.readAll().split('\n');
-						for (int i = 1; i < lines.size()-2; ++i)
-						{
-							Message message;
-	//<font color="#16569E"><font size="2">(16:35:00)</font> <b>EuroElessar:</b></font> gergr<br/>
-							mes=true;
-							if(lines[i].startsWith("<font color=\"#16569E\">"))
-								message.setIncoming(false);
-							else if(lines[i].startsWith("<font color=\"#A82F2F\">"))
-								message.setIncoming(true);
-							else
-								mes=false;
-							if (mes) {
-								QDateTime date;
-								QString date_string = lines[i].section(">",2,2);
-								for(int j=0;j<stamps.size();j++) {
-									if(j==0) {
-										QTime time = QTime::fromString(date_string, stamps[j]);
-										if(!time.isValid())
-											continue;
-										uint cur = time.hour()*3600+time.minute()*60+time.second();
-										if(cur<last)
-											day=day.addDays(1);
-										last=cur;
-										date = QDateTime(day,time);
-										break;
-									} else {
-										date = QDateTime::fromString(date_string, stamps[j]);
-										if(!date.isValid())
-											continue;
-										day = date.date();
-										last = date.time().hour()*3600+date.time().minute()*60+date.time().second();
-										break;
-									}
-								}
-								message.setTime(date);
-								QString text = lines[i].remove(0,lines[i].lastIndexOf("font>")+6);
-								text.chop(5);
-								converter.setHtml(text);
-								message.setText(converter.toPlainText());
-								converter.clearUndoRedoStacks();
-								message.setProperty("html", text);
-								appendMessage(message);
-							}
-						}
+			Message message;
+//<font color="#16569E"><font size="2">(16:35:00)</font> <b>EuroElessar:</b></font> gergr<br/>
+			mes=true;
+			if(lines[i].startsWith("<font color=\"#16569E\">"))
+				message.setIncoming(false);
+			else if(lines[i].startsWith("<font color=\"#A82F2F\">"))
+				message.setIncoming(true);
+			else
+				mes=false;
+			if (mes) {
+				QDateTime date;
+				QString date_string = lines[i].section(">",2,2);
+				for(int j=0;j<stamps.size();j++) {
+					if(j==0) {
+						QTime time = QTime::fromString(date_string, stamps[j]);
+						if(!time.isValid())
+							continue;
+						uint cur = time.hour()*3600+time.minute()*60+time.second();
+						if(cur<last)
+							day=day.addDays(1);
+						last=cur;
+						date = QDateTime(day,time);
+						break;
+					} else {
+						date = QDateTime::fromString(date_string, stamps[j]);
+						if(!date.isValid())
+							continue;
+						day = date.date();
+						last = date.time().hour()*3600+date.time().minute()*60+date.time().second();
+						break;
 					}
 				}
+				message.setTime(date);
+				QString text = lines[i].remove(0,lines[i].lastIndexOf("font>")+6);
+				text.chop(5);
+				converter.setHtml(text);
+				message.setText(converter.toPlainText());
+				converter.clearUndoRedoStacks();
+				message.setProperty("html", text);
+				data_base->appendMessage(message);
 			}
 		}
 	}
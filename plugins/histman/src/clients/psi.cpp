@@ -97,43 +97,51 @@ QString psi::logdecode(const QString &str)
 }
 
 void psi::loadMessages(const QString &path)
+{
+	loadSources(path);
+}
+
+QStringList psi::sources(const QString &path)
 {
 	QDir dir = path;
 	if(!dir.cd("history"))
+		return QStringList();
+	QStringList files;
+	foreach(const QFileInfo &info, dir.entryInfoList(QStringList() << "*.history", QDir::Files))
+		files << info.absoluteFilePath();
+	return files;
+}
+
+void psi::loadSource(const QString &path, const QString &source, DataBaseInterface *data_base)
+{
+	Q_UNUSED(path);
+	QString contact = QFileInfo(source).fileName();
+	contact.chop(4);
+	contact = decode(contact);
+	data_base->setProtocol("jabber");
+	data_base->setAccount(m_account);
+	data_base->setContact(contact);
+	QFile file(source);
+	if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
 		return;
-	QFileInfoList files = dir.entryInfoList(QStringList() << "*.history", QDir::Files);
-	setProtocol("jabber");
-	setAccount(m_account);
-	setMaxValue(files.size());
-	for(int i = 0; i < files.size(); i++)
+	QTextStream in(&file);
+	in.setCodec("utf-8");
+	while(!in.atEnd())
 	{
-		setValue(i + 1);
-		QString contact = files[i].fileName();
-		contact.chop(4);
-		contact = decode(contact);
-		setContact(contact);
-		QFile file(files[i].absoluteFilePath());
-		if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+		static const QChar c('|');
+		QString line = in.readLine();
+		if(line.isEmpty())
 			continue;
-		QTextStream in(&file);
-		in.setCodec("utf-8");
-		while(!in.atEnd())
-		{
-			static const QChar c('|');
-			QString line = in.readLine();
-			if(line.isEmpty())
-				continue;
-			// |2008-07-13T15:27:57|5|from|N3--|Цитата #397796|http://bash.org.ru/quote/397796|Цитата #397796|xxx: cool text
-			Message message;
-			message.setTime(QDateTime::fromString(line.section(c, 1, 1), Qt::ISODate));
-			message.setIncoming(line.section(c, 3, 3) == "from");
-			QString text = line.mid(line.lastIndexOf(c) + 1);
-			int psi_type = line.section(c, 2, 2).toInt();
-			if(psi_type == 2 || psi_type == 3 || psi_type == 6 || psi_type == 7 || psi_type == 8 || text.isEmpty())
-				continue;
-			message.setText(logdecode(text));
-			appendMessage(message);
-		}
+		// |2008-07-13T15:27:57|5|from|N3--|Цитата #397796|http://bash.org.ru/quote/397796|Цитата #397796|xxx: cool text
+		Message message;
+		message.setTime(QDateTime::fromString(line.section(c, 1, 1), Qt::ISODate));
+		message.setIncoming(line.section(c, 3, 3) == "from");
+		QString text = line.mid(line.lastIndexOf(c) + 1);
+		int psi_type = line.section(c, 2, 2).toInt();
+		if(psi_type == 2 || psi_type == 3 || psi_type == 6 || psi_type == 7 || psi_type == 8 || text.isEmpty())
+			continue;
+		message.setText(logdecode(text));
+		data_base->appendMessage(message);
 	}
 }
 
@@ -36,6 +36,8 @@ public:
 	QString decode(const QString &jid);
 	QString logdecode(const QString &str);
 	virtual void loadMessages(const QString &path);
+	virtual QStringList sources(const QString &path);
+	virtual void loadSource(const QString &path, const QString &source, DataBaseInterface *data_base);
 	virtual bool validate(const QString &path);
 	virtual QString name();
 	virtual QIcon icon();
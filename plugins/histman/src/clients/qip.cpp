@@ -26,6 +26,7 @@
 #include "qip.h"
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QTextStream>
 #include <QTextDocument>
 #include <qutim/icon.h>
@@ -43,68 +44,74 @@ qip::~qip()
 }
 
 void qip::loadMessages(const QString &path)
+{
+	loadSources(path);
+}
+
+QStringList qip::sources(const QString &path)
 {
 	QDir dir = path;
-	QString account = dir.dirName();
 	if(!dir.cd("History"))
-		return;
-	setProtocol("icq");
-	setAccount(account);
-	QStringList files = dir.entryList(QStringList() << "*.txt", QDir::Files);
-	setMaxValue(files.size());
-	for(int i = 0; i < files.size(); i++)
-	{
-		setValue(i + 1);
-		if(files[i] == "_srvlog.txt"  || files[i] == "_botlog.txt" || files[i].startsWith("."))
+		return QStringList();
+	QStringList files;
+	foreach(const QString &file, dir.entryList(QStringList() << "*.txt", QDir::Files)) {
+		if(file == "_srvlog.txt"  || file == "_botlog.txt" || file.startsWith("."))
 			continue;
-		QFile file(dir.filePath(files[i]));
-		if (file.open(QIODevice::ReadOnly | QIODevice::Text))
+		files << dir.filePath(file);
+	}
+	return files;
+}
+
+void qip::loadSource(const QString &path, const QString &source, DataBaseInterface *data_base)
+{
+	QString account = QDir(path).dirName();
+	QFile file(source);
+	if (file.open(QIODevice::ReadOnly | QIODevice::Text))
+	{
+		Message message;
+		QTextStream in(&file);
+		in.setAutoDetectUnicode(false);
+		in.setCodec("cp1251");
+		QString uin = QFileInfo(source).fileName();
+		uin.chop(4);
+		data_base->setProtocol("icq");
+		data_base->setAccount(account);
+		data_base->setContact(uin);
+		QString text;
+		bool first = true;
+		bool point = false;
+		while(!in.atEnd())
 		{
-			Message message;
-			QTextStream in(&file);
-			in.setAutoDetectUnicode(false);
-			in.setCodec("cp1251");
-			QString uin = files[i];
-			uin.chop(4);
-			setContact(uin);
-			QString text;
-			bool first = true;
-			bool point = false;
-			while(!in.atEnd())
+			QString line = in.readLine();
+			if(line == "-------------------------------------->-"
+			   || line == "--------------------------------------<-")
 			{
-				QString line = in.readLine();
-				if(line == "-------------------------------------->-"
-				   || line == "--------------------------------------<-")
-				{
-					if(!first)
-					{
-						text.chop(10);
-						message.setText(text);
-						appendMessage(message);
-					}
-					else
-						first=false;
-					message.setIncoming(line[38] == '<');
-					point = true;
-					text.clear();
-				}
-				else if(point)
+				if(!first)
 				{
-					if(account.isEmpty())
-						account = line.section(' ',0,-3);
-					message.setTime(QDateTime().fromString(line.section(' ',-2),"(hh:mm:ss d/MM/yyyy)"));
-					point=false;
+					text.chop(10);
+					message.setText(text);
+					data_base->appendMessage(message);
 				}
 				else
-				{
-					text += line;
-					text += '\n';
-				}
+					first=false;
+				message.setIncoming(line[38] == '<');
+				point = true;
+				text.clear();
+			}
+			else if(point)
+			{
+				message.setTime(QDateTime().fromString(line.section(' ',-2),"(hh:mm:ss d/MM/yyyy)"));
+				point=false;
+			}
+			else
+			{
+				text += line;
+				text += '\n';
 			}
-			text.chop(10);
-			message.setText(text);
-			appendMessage(message);
 		}
+		text.chop(10);
+		message.setText(text);
+		data_base->appendMessage(message);
 	}
 }
 
@@ -35,6 +35,8 @@ public:
 	qip();
 	virtual ~qip();
 	virtual void loadMessages(const QString &path);
+	virtual QStringList sources(const QString &path);
+	virtual void loadSource(const QString &path, const QString &source, DataBaseInterface *data_base);
 	virtual bool validate(const QString &path);
 	virtual QString name();
 	virtual QIcon icon();
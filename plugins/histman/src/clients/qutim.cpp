@@ -94,96 +94,77 @@ bool qutim::guessJson(const QString &path, QFileInfoList &files, int &num)
 	return !files.isEmpty();
 }
 
-void qutim::loadXml(const QFileInfoList &files)
+void qutim::loadXml(const QFileInfo &info, DataBaseInterface *data_base)
 {
 	QTextDocument converter;
-	QDir tmp_dir = files.first().absoluteDir();
+	QDir tmp_dir = info.absoluteDir();
 	tmp_dir.cdUp();
 	QString account = tmp_dir.dirName().section(".", 1);
-	setProtocol("icq");
-	setAccount(account);
-	for(int i=0;i<files.size();i++)
+	data_base->setProtocol("icq");
+	data_base->setAccount(account);
+	QFile file(info.absoluteFilePath());
+	if (file.open(QIODevice::ReadOnly) )
 	{
-		setValue(++m_value);
-		if(!files[i].fileName().startsWith("log.20"))
+		QDomDocument doc;
+		if(doc.setContent(&file))
 		{
-			QFile file(files[i].absoluteFilePath());
-			if (file.open(QIODevice::ReadOnly) )
+			QDomElement rootElement = doc.documentElement();
+			int msgCount = rootElement.elementsByTagName("msg").count();
+			QDomElement dateElement = rootElement.firstChildElement("date");
+			QString otherDate = "/"+dateElement.attribute("month")+"/"+dateElement.attribute("year");
+			QDomElement msg = rootElement.firstChildElement("msg");
+			QString uin = info.fileName();
+			uin.truncate(uin.indexOf('.'));
+			data_base->setContact(uin);
+			for ( int j = 0; j < msgCount ; j++ )
 			{
-				QDomDocument doc;
-				if(doc.setContent(&file))
-				{
-					QDomElement rootElement = doc.documentElement();
-					int msgCount = rootElement.elementsByTagName("msg").count();
-					QDomElement dateElement = rootElement.firstChildElement("date");
-					QString otherDate = "/"+dateElement.attribute("month")+"/"+dateElement.attribute("year");
-					QDomElement msg = rootElement.firstChildElement("msg");
-					QString uin = files[i].fileName();
-					uin.truncate(uin.indexOf('.'));
-					setContact(uin);
-					for ( int j = 0; j < msgCount ; j++ )
-					{
-						Message message;
-						message.setTime(QDateTime().fromString(msg.attribute("time")
-															   % " "
-															   % msg.attribute("day")
-															   % otherDate,"h:m:s d/M/yyyy"));
-						converter.setHtml(msg.text());
-						message.setText(converter.toPlainText());
-						converter.clearUndoRedoStacks();
-						message.setProperty("html", msg.text());
-						message.setIncoming(msg.attribute("in") == "1");
-						appendMessage(message);
-						msg = msg.nextSiblingElement("msg");
-					}
-
-				}
+				Message message;
+				message.setTime(QDateTime().fromString(msg.attribute("time")
+													   % " "
+													   % msg.attribute("day")
+													   % otherDate,"h:m:s d/M/yyyy"));
+				converter.setHtml(msg.text());
+				message.setText(converter.toPlainText());
+				converter.clearUndoRedoStacks();
+				message.setProperty("html", msg.text());
+				message.setIncoming(msg.attribute("in") == "1");
+				data_base->appendMessage(message);
+				msg = msg.nextSiblingElement("msg");
 			}
 		}
 	}
 }
 
-void qutim::loadBin(const QFileInfoList &acc_files)
+void qutim::loadBin(const QFileInfo &info, DataBaseInterface *data_base)
 {
 	QTextDocument converter;
-	foreach(const QFileInfo &info, acc_files)
+	QString acc_dir = info.absoluteDir().dirName();
+	QString protocol = acc_dir.section(".",0,0).toLower();
+	QString account_name = QString().fromUtf8(QByteArray::fromHex(acc_dir.section(".",1,1).toLatin1()));
+	data_base->setProtocol(protocol);
+	data_base->setAccount(account_name);
+	QDateTime time;
+	QString text;
+	qint8 type;
+	bool incoming;
+	QFile file(info.absoluteFilePath());
+	if (file.open(QIODevice::ReadOnly))
 	{
-		QString protocol = info.fileName().section(".",0,0).toLower();
-		QString account_name = QString().fromUtf8(QByteArray::fromHex(info.fileName().section(".",1,1).toLatin1()));
-		setProtocol(protocol);
-		setAccount(account_name);
-		QDir dir(info.absoluteFilePath());
-		QFileInfoList files = dir.entryInfoList(QDir::Readable | QDir::Files | QDir::NoDotAndDotDot,QDir::Name);
-		QDateTime time;
-		QString text;
-		qint8 type;
-		bool incoming;
-		for(int i=0;i<files.size();i++)
+		QString uin = info.fileName().section(".",0,0);
+		uin = QString().fromUtf8(QByteArray::fromHex(uin.toLatin1()));
+		data_base->setContact(uin);
+		QDataStream in(&file);
+		Message msg;
+		while(!file.atEnd())
 		{
-			setValue(++m_value);
-			if(!files[i].fileName().startsWith("sys."))
-			{
-				QFile file(files[i].absoluteFilePath());
-				if (file.open(QIODevice::ReadOnly))
-				{
-					QString uin = files[i].fileName().section(".",0,0);
-					uin = QString().fromUtf8(QByteArray::fromHex(uin.toLatin1()));
-					setContact(uin);
-					QDataStream in(&file);
-					Message msg;
-					while(!file.atEnd())
-					{
-						in >> time >> type >> incoming >> text;
-						msg.setTime(time);
-						msg.setIncoming(incoming);
-						converter.setHtml(text);
-						msg.setText(converter.toPlainText());
-						converter.clearUndoRedoStacks();
-						msg.setProperty("html", text);
-						appendMessage(msg);
-					}
-				}
-			}
+			in >> time >> type >> incoming >> text;
+			msg.setTime(time);
+			msg.setIncoming(incoming);
+			converter.setHtml(text);
+			msg.setText(converter.toPlainText());
+			converter.clearUndoRedoStacks();
+			msg.setProperty("html", text);
+			data_base->appendMessage(msg);
 		}
 	}
 }
@@ -244,110 +225,129 @@ QString qutim::unquote(const QString &str)
 	return result;
 }
 
-void qutim::loadJson(const QFileInfoList &acc_files)
+void qutim::loadJson(const QFileInfo &info, DataBaseInterface *data_base)
 {
 	QTextDocument converter;
-	foreach(const QFileInfo &info, acc_files)
+	QString acc_dir = info.absoluteDir().dirName();
+	QString protocol = acc_dir.section(".",0,0).toLower();
+	QString account = unquote(acc_dir.section(".",1));
+	QString contact = unquote(info.fileName().section(".", 0, -3));
+	data_base->setProtocol(protocol);
+	data_base->setAccount(account);
+	data_base->setContact(contact);
+	QFile file(info.absoluteFilePath());
+	if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+		return;
+	int len = file.size();
+	QByteArray array;
+	const uchar *fmap = file.map(0, file.size());
+	if(!fmap)
 	{
-		QString protocol = info.fileName().section(".",0,0).toLower();
-		QString account = unquote(info.fileName().section(".",1));
-		setProtocol(protocol);
-		setAccount(account);
-		QDir dir(info.absoluteFilePath());
-		QFileInfoList files = dir.entryInfoList(QDir::Readable | QDir::Files | QDir::NoDotAndDotDot,QDir::Name);
-		for(int i=0;i<files.size();i++)
+		array = file.readAll();
+		fmap = (uchar *)array.constData();
+	}
+	const uchar *s = Json::skipBlanks(fmap, &len);
+	QVariant val;
+	uchar qch = s ? *s : '\0';
+	if(!s || (qch != '[' && qch != '{'))
+		return;
+	qch = (qch == '{' ? '}' : ']');
+	s++;
+	len--;
+	bool first = true;
+	while(s)
+	{
+		s = Json::skipBlanks(s, &len);
+		if (len < 2 || (s && *s == qch))
+			break;
+		if(!s)
+			break;
+		if ((!first && *s != ',') || (first && *s == ',')) {
+//			fprintf(stderr, "ERROR: invalid JSON file (delimiter)!\n");
+			break;
+		}
+		first = false;
+		if (*s == ',')
 		{
-			setValue(++m_value);
-			QString contact = unquote(files[i].fileName().section(".", 0, -3));
-			setContact(contact);
-			QFile file(files[i].absoluteFilePath());
-			if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
-				continue;
-			QTime timer;
-			timer.start();
-			int len = file.size();
-			QByteArray array;
-			const uchar *fmap = file.map(0, file.size());
-			if(!fmap)
-			{
-				array = file.readAll();
-				fmap = (uchar *)array.constData();
-			}
-			const uchar *s = Json::skipBlanks(fmap, &len);
-			QVariant val;
-			uchar qch = s ? *s : '\0';
-			if(!s || (qch != '[' && qch != '{'))
-				continue;
-			qch = (qch == '{' ? '}' : ']');
 			s++;
 			len--;
-			bool first = true;
-			while(s)
-			{
-				s = Json::skipBlanks(s, &len);
-				if (len < 2 || (s && *s == qch))
-					break;
-				if(!s)
-					break;
-				if ((!first && *s != ',') || (first && *s == ',')) {
-//					fprintf(stderr, "ERROR: invalid JSON file (delimiter)!\n");
-					break;
-				}
-				first = false;
-				if (*s == ',')
-				{
-					s++;
-					len--;
-				}
-				val.clear();
-				s = Json::parseRecord(val, s, &len);
-				if (!s) {
-//					fprintf(stderr, "ERROR: invalid JSON file!\n");
-					break;
-				}
-				QVariantMap message = val.toMap();
-				Message item;
-				QVariantMap::iterator it = message.begin();
-				for(; it != message.end(); it++)
-				{
-					QString key = it.key();
-					if(key == QLatin1String("datetime")) {
-						item.setTime(QDateTime::fromString(it.value().toString(), Qt::ISODate));
-					} else if (key == QLatin1String("text")) {
-						QString text = it.value().toString();
-						converter.setHtml(text);
-						item.setText(converter.toPlainText());
-						converter.clearUndoRedoStacks();
-						item.setProperty("html", text);
-					} else {
-						item.setProperty(key.toUtf8(), it.value());
-					}
-				}
-				appendMessage(item);
+		}
+		val.clear();
+		s = Json::parseRecord(val, s, &len);
+		if (!s) {
+//			fprintf(stderr, "ERROR: invalid JSON file!\n");
+			break;
+		}
+		QVariantMap message = val.toMap();
+		Message item;
+		QVariantMap::iterator it = message.begin();
+		for(; it != message.end(); it++)
+		{
+			QString key = it.key();
+			if(key == QLatin1String("datetime")) {
+				item.setTime(QDateTime::fromString(it.value().toString(), Qt::ISODate));
+			} else if (key == QLatin1String("text")) {
+				QString text = it.value().toString();
+				converter.setHtml(text);
+				item.setText(converter.toPlainText());
+				converter.clearUndoRedoStacks();
+				item.setProperty("html", text);
+			} else {
+				item.setProperty(key.toUtf8(), it.value());
 			}
 		}
+		data_base->appendMessage(item);
 	}
 }
 
 void qutim::loadMessages(const QString &path)
+{
+	loadSources(path);
+}
+
+QStringList qutim::sources(const QString &path)
 {
 	int num = 0;
-	Types types;
 	QVector<QFileInfoList> lists(3);
-	if(guessXml(path, lists[0], num))
-		types |= Xml;
-	if(guessBin(path, lists[1], num))
-		types |= Bin;
-	if(guessJson(path, lists[2], num))
-		types |= Json;
-	setMaxValue(num);
-	m_value = 0;
-	if(types & Xml)
-		loadXml(lists[0]);
-	if(types & Bin)
-		loadBin(lists[1]);
-	if(types & Json)
-		loadJson(lists[2]);
+	QStringList files;
+	if(guessXml(path, lists[0], num)) {
+		foreach(const QFileInfo &info, lists[0]) {
+			if(!info.fileName().startsWith("log.20"))
+				files << info.absoluteFilePath();
+		}
+	}
+	if(guessBin(path, lists[1], num)) {
+		foreach(const QFileInfo &acc_info, lists[1]) {
+			QDir dir(acc_info.absoluteFilePath());
+			QFileInfoList infos = dir.entryInfoList(QDir::Readable | QDir::Files | QDir::NoDotAndDotDot,QDir::Name);
+			foreach(const QFileInfo &info, infos) {
+				if(!info.fileName().startsWith("sys."))
+					files << info.absoluteFilePath();
+			}
+		}
+	}
+	if(guessJson(path, lists[2], num)) {
+		foreach(const QFileInfo &acc_info, lists[2]) {
+			QDir dir(acc_info.absoluteFilePath());
+			QFileInfoList infos = dir.entryInfoList(QStringList() << "*.json", QDir::Readable | QDir::Files | QDir::NoDotAndDotDot,QDir::Name);
+			foreach(const QFileInfo &info, infos)
+				files << info.absoluteFilePath();
+		}
+	}
+	files.removeDuplicates();
+	return files;
+}
+
+void qutim::loadSource(const QString &path, const QString &source, DataBaseInterface *data_base)
+{
+	Q_UNUSED(path);
+	QFileInfo info(source);
+	if(info.suffix() == QLatin1String("json"))
+		loadJson(info, data_base);
+	else if(info.suffix() == QLatin1String("xml") && info.absoluteDir().dirName() == QLatin1String("history"))
+		loadXml(info, data_base);
+	else
+		loadBin(info, data_base);
 }
 
 bool qutim::validate(const QString &path)
@@ -47,17 +47,17 @@ public:
 	bool guessXml(const QString &path, QFileInfoList &files, int &num);
 	bool guessBin(const QString &path, QFileInfoList &files, int &num);
 	bool guessJson(const QString &path, QFileInfoList &files, int &num);
-	void loadXml(const QFileInfoList &files);
-	void loadBin(const QFileInfoList &files);
+	static void loadXml(const QFileInfo &info, DataBaseInterface *data_base);
+	static void loadBin(const QFileInfo &info, DataBaseInterface *data_base);
 	static QString quote(const QString &str);
 	static QString unquote(const QString &str);
-	void loadJson(const QFileInfoList &files);
+	static void loadJson(const QFileInfo &info, DataBaseInterface *data_base);
 	virtual void loadMessages(const QString &path);
+	virtual QStringList sources(const QString &path);
+	virtual void loadSource(const QString &path, const QString &source, DataBaseInterface *data_base);
 	virtual bool validate(const QString &path);
 	virtual QString name();
 	virtual QIcon icon();
-private:
-	int m_value;
 };
 
 class qutimExporter : public qutim, public HistoryExporter
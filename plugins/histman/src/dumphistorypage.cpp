@@ -42,11 +42,12 @@ void DumpHistoryPageHelper::run()
 {
 	if(m_parent->m_state == DumpHistoryPage::LoadingHistory)
 	{
-		m_parent->m_parent->getQutIM()->loadMessages(SystemInfo::getPath(SystemInfo::HistoryDir));
+		HistoryManagerWindow *window = m_parent->m_parent;
+		window->importMessages(window->getQutIM(), SystemInfo::getPath(SystemInfo::HistoryDir), false);
 	}
 	else if(m_parent->m_state == DumpHistoryPage::SavingHistory)
 	{
-		m_parent->m_parent->saveMessages(m_parent->m_format);
+		m_parent->m_failed = m_parent->m_parent->saveMessages(m_parent->m_format);
 	}
 }
 
@@ -63,6 +64,7 @@ DumpHistoryPage::DumpHistoryPage(HistoryManagerWindow *parent) :
 	connect(m_parent, SIGNAL(saveMaxValueChanged(int)), m_ui->dumpProgressBar, SLOT(setMaximum(int)));
 	connect(m_parent, SIGNAL(saveValueChanged(int)), m_ui->dumpProgressBar, SLOT(setValue(int)));
 	m_format = 0;
+	m_failed = 0;
 	m_helper = new DumpHistoryPageHelper(this);
 	connect(m_helper, SIGNAL(finished()), this, SLOT(completed()));
 	setTitle(tr("Dumping"));
@@ -142,7 +144,10 @@ void DumpHistoryPage::completed()
 	}
 	else if(m_state == SavingHistory)
 	{
-		setSubTitle(tr("History has been successfully imported."));
+		if(m_failed)
+			setSubTitle(tr("%n month(s) of history could not be written. Dump again to retry them.", 0, m_failed));
+		else
+			setSubTitle(tr("History has been successfully imported."));
 		m_state = Finished;
 		m_parent->button(QWizard::BackButton)->setEnabled(true);
 		m_parent->button(QWizard::CancelButton)->setEnabled(true);
@@ -77,6 +77,7 @@ private:
 	HistoryManagerWindow *m_parent;
 	State m_state;
 	char m_format;
+	int m_failed;
 	friend class DumpHistoryPageHelper;
 	DumpHistoryPageHelper *m_helper;
 //	QList<HistoryExporter *> m_clients_list;
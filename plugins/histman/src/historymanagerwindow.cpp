@@ -29,6 +29,7 @@
 #include "importhistorypage.h"
 #include "dumphistorypage.h"
 #include "chooseordumppage.h"
+#include "importpipeline.h"
 #include <qutim/icon.h>
 #include <qutim/iconloader.h>
 #include <qutim/account.h>
@@ -37,6 +38,12 @@
 #include <QLabel>
 #include <QTextDocument>
 #include <QComboBox>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QCryptographicHash>
+#include <QSet>
+#include <algorithm>
 
 using namespace qutim_sdk_0_3;
 
@@ -54,6 +61,13 @@ int inline compare_datetime_helper(const QDateTime &dt1, const QDateTime &dt2)
 		return d2.daysTo(d1);
 }
 
+static inline bool equal_message_helper(const Message &msg1, const Message &msg2)
+{
+	return msg1.time() == msg2.time()
+			&& msg1.isIncoming() == msg2.isIncoming()
+			&& msg1.text() == msg2.text();
+}
+
 bool compare_message_helper(const Message &msg1, const Message &msg2)
 {
 	int cmp_d = compare_datetime_helper(msg1.time(), msg2.time());
@@ -76,7 +90,9 @@ HistoryManagerWindow::HistoryManagerWindow(QWidget *parent) :
 	m_account = 0;
 	m_contact = 0;
 	m_current_client = 0;
-	m_message_num = 0;
+	m_message_num.store(0);
+	m_saved_num = 0;
+	m_failed_num.store(0);
 	m_qutim = new qutim();
 	setPixmap(WatermarkPixmap, QPixmap(":/pictures/wizard.png"));
 #ifndef Q_OS_MAC
@@ -104,17 +120,155 @@ void HistoryManagerWindow::appendMessage(const Message &message)
 {
 	m_is_dumping = false;
 	Q_ASSERT(m_contact);
-	QDate date = message.time().date();
-	qint64 month_id = date.year() * 100 + date.month();
-	qutim_sdk_0_3::MessageList &month = m_contact->operator [](month_id);
-	int position = qLowerBound(month.begin(), month.end(), message, compare_message_helper) - month.begin();
-	if(month.size() != position
-	   && month[position].time() == message.time()
-	   && month[position].isIncoming() == message.isIncoming()
-	   && month[position].text() == message.text())
+	// Messages are sorted and deduplicated once per month by normalizeMessages,
+	// sorted insertion of every message is quadratic for long histories
+	m_contact->operator [](monthId(message)).append(message);
+	m_message_num.fetchAndAddRelaxed(1);
+}
+
+class NormalizeJob : public QRunnable
+{
+public:
+	NormalizeJob(MessageList *month, QAtomicInteger<quint64> *removed)
+		: m_month(month), m_removed(removed) {}
+	void run()
+	{
+		std::stable_sort(m_month->begin(), m_month->end(), compare_message_helper);
+		MessageList::iterator end = std::unique(m_month->begin(), m_month->end(), equal_message_helper);
+		const int removed = m_month->end() - end;
+		m_month->erase(end, m_month->end());
+		m_removed->fetchAndAddRelaxed(removed);
+	}
+private:
+	MessageList *m_month;
+	QAtomicInteger<quint64> *m_removed;
+};
+
+void HistoryManagerWindow::normalizeMessages()
+{
+	QAtomicInteger<quint64> removed(0);
+	QThreadPool pool;
+	for (QHash<QString, Protocol>::iterator protocol = m_protocols.begin(); protocol != m_protocols.end(); ++protocol) {
+		for (Protocol::iterator account = protocol->begin(); account != protocol->end(); ++account) {
+			for (Account::iterator contact = account->begin(); contact != account->end(); ++contact) {
+				for (Contact::iterator month = contact->begin(); month != contact->end(); ++month)
+					pool.start(new NormalizeJob(&month.value(), &removed));
+			}
+		}
+	}
+	pool.waitForDone();
+	m_message_num.fetchAndSubRelaxed(removed.load());
+}
+
+static QString importCheckpointPath(const QString &client, const QString &path)
+{
+	QByteArray id = QCryptographicHash::hash((client + QLatin1Char(':') + path).toUtf8(),
+											 QCryptographicHash::Sha1).toHex();
+	QDir dir = SystemInfo::getDir(SystemInfo::HistoryDir);
+	return dir.filePath(QLatin1String("histman.") + QLatin1String(id) + QLatin1String(".import"));
+}
+
+void HistoryManagerWindow::importMessages(HistoryImporter *client, const QString &path, bool resumable)
+{
+	const QStringList sources = client->sources(path);
+	if(sources.isEmpty())
+	{
+		// History is kept in one data base, it is neither split nor resumed
+		client->setDataBase(this);
+		client->loadMessages(path);
+		normalizeMessages();
 		return;
-	m_message_num++;
-	month.insert(position, message);
+	}
+	emit maxValueChanged(sources.size());
+
+	QSet<QString> done;
+	QFile checkpoint;
+	if(resumable)
+	{
+		QDir dir = SystemInfo::getDir(SystemInfo::HistoryDir);
+		if(!dir.exists())
+			dir.mkpath(dir.absolutePath());
+		checkpoint.setFileName(importCheckpointPath(client->name(), path));
+		if(checkpoint.open(QIODevice::ReadWrite))
+		{
+			m_import_checkpoints << checkpoint.fileName();
+			QDataStream in(&checkpoint);
+			in.setVersion(QDataStream::Qt_5_0);
+			qint64 valid = 0;
+			while(!in.atEnd())
+			{
+				ImportBatch *batch = ImportBatch::load(in);
+				if(!batch)
+					break;
+				valid = checkpoint.pos();
+				done.insert(batch->source());
+				mergeBatch(*batch);
+				delete batch;
+			}
+			// Drop the record cut by a crash, new ones are appended after the last valid one
+			checkpoint.resize(valid);
+			checkpoint.seek(valid);
+		}
+	}
+
+	ImportQueue queue(sources.size());
+	QThreadPool pool;
+	const int ahead = qMax(1, pool.maxThreadCount()) * 2;
+	int started = 0;
+	for(int i = 0; i < sources.size(); i++)
+	{
+		// Parsed batches wait in memory for their turn, so only a few sources
+		// are parsed ahead of the merged one
+		for(; started < sources.size() && started < i + ahead; started++)
+		{
+			if(done.contains(sources.at(started)))
+				queue.put(started, 0);
+			else
+				pool.start(new ImportJob(client, path, sources.at(started), started, &queue));
+		}
+		if(ImportBatch *batch = queue.take(i))
+		{
+			mergeBatch(*batch);
+			if(checkpoint.isOpen())
+			{
+				batch->save(&checkpoint);
+				checkpoint.flush();
+			}
+			delete batch;
+		}
+		emit valueChanged(i + 1);
+	}
+	pool.waitForDone();
+	checkpoint.close();
+	normalizeMessages();
+}
+
+void HistoryManagerWindow::mergeBatch(const ImportBatch &batch)
+{
+	QHash<QString, Protocol>::const_iterator protocol = batch.protocols().constBegin();
+	for(; protocol != batch.protocols().constEnd(); protocol++)
+	{
+		Protocol &protocol_to = m_protocols[protocol.key()];
+		Protocol::const_iterator account = protocol->constBegin();
+		for(; account != protocol->constEnd(); account++)
+		{
+			Account &account_to = protocol_to[account.key()];
+			Account::const_iterator contact = account->constBegin();
+			for(; contact != account->constEnd(); contact++)
+			{
+				Contact &contact_to = account_to[contact.key()];
+				Contact::const_iterator month = contact->constBegin();
+				for(; month != contact->constEnd(); month++)
+					contact_to[month.key()] += month.value();
+			}
+		}
+	}
+	m_message_num.fetchAndAddRelaxed(batch.count());
+}
+
+void HistoryManagerWindow::addSource(const QString &client, const QString &path)
+{
+	m_sources << client + QLatin1Char(':') + path;
 }
 
 void HistoryManagerWindow::setProtocol(const QString &protocol)
@@ -186,12 +340,96 @@ QString quoteByFormat(const QString &text, char format)
 	return text;
 }
 
-void HistoryManagerWindow::saveMessages(char format)
+static void writeMonth(QIODevice *file, const MessageList &messages)
+{
+	file->write("[\n");
+	bool first = true;
+	foreach(const Message &message, messages)
+	{
+		if(first)
+			first = false;
+		else
+			file->write(",\n");
+		file->write(" {\n");
+		foreach(const QByteArray &name, message.dynamicPropertyNames())
+		{
+			QByteArray data;
+			if(!Json::generate(data, message.property(name), 2))
+				continue;
+			file->write("  ");
+			file->write(Json::quote(QString::fromUtf8(name)).toUtf8());
+			file->write(": ");
+			file->write(data);
+			file->write(",\n");
+		}
+		file->write("  \"datetime\": \"");
+		QDateTime time = message.time();
+		if(!time.isValid())
+			time = QDateTime::currentDateTime();
+		file->write(time.toString(Qt::ISODate).toLatin1());
+		file->write("\",\n  \"in\": ");
+		file->write(message.isIncoming() ? "true" : "false");
+		file->write(",\n  \"text\": ");
+		file->write(Json::quote(message.text()).toUtf8());
+		file->write("\n }");
+	}
+	file->write("\n]");
+}
+
+class SaveJob : public QRunnable
+{
+public:
+	SaveJob(HistoryManagerWindow *window, const QDir &dir, const QString &fileName, const MessageList *messages)
+		: m_window(window), m_dir(dir), m_fileName(fileName), m_messages(messages) {}
+	void run()
+	{
+		// Whole month is written at once, so crashed dump never leaves half of file
+		const QString path = m_dir.dirName() + QLatin1Char('/') + m_fileName;
+		QSaveFile file(m_dir.filePath(m_fileName));
+		if(!file.open(QIODevice::WriteOnly | QIODevice::Text))
+		{
+			m_window->monthFailed(path);
+			return;
+		}
+		writeMonth(&file, *m_messages);
+		if(file.commit())
+			m_window->monthSaved(path);
+		else
+			m_window->monthFailed(path);
+	}
+private:
+	HistoryManagerWindow *m_window;
+	QDir m_dir;
+	QString m_fileName;
+	const MessageList *m_messages;
+};
+
+void HistoryManagerWindow::monthSaved(const QString &path)
+{
+	QMutexLocker locker(&m_checkpoint_lock);
+	emit saveValueChanged(++m_saved_num);
+	if(m_checkpoint.isOpen())
+	{
+		m_checkpoint.write(path.toUtf8());
+		m_checkpoint.write("\n");
+		m_checkpoint.flush();
+	}
+}
+
+void HistoryManagerWindow::monthFailed(const QString &path)
+{
+	Q_UNUSED(path);
+	m_failed_num.fetchAndAddRelaxed(1);
+}
+
+int HistoryManagerWindow::saveMessages(char format)
 {
 	if(format != 'b' && format != 'j')
-		return;
+		return 0;
+	normalizeMessages();
 	int total_count = 0;
-	int num = 0;
+	m_saved_num = 0;
+	m_failed_num.store(0);
 	foreach(const Protocol &protocol, m_protocols)
 		foreach(const Account &account, protocol)
 			foreach(const Contact &contact, account)
@@ -201,6 +439,36 @@ void HistoryManagerWindow::saveMessages(char format)
 	if(!dir.exists())
 		dir.mkpath(dir.absolutePath());
 
+	// Checkpoint keeps list of already written months, so the dump interrupted
+	// by a crash is resumed for the same set of imported sources
+	QByteArray fingerprint = QCryptographicHash::hash(m_sources.join(QLatin1String("\n")).toUtf8(),
+													  QCryptographicHash::Sha1).toHex();
+	QSet<QString> done;
+	m_checkpoint.setFileName(dir.filePath(QLatin1String("histman.checkpoint")));
+	if(m_checkpoint.open(QIODevice::ReadOnly | QIODevice::Text))
+	{
+		if(m_checkpoint.readLine().trimmed() == fingerprint)
+		{
+			while(!m_checkpoint.atEnd())
+				done.insert(QString::fromUtf8(m_checkpoint.readLine().trimmed()));
+		}
+		m_checkpoint.close();
+	}
+	if(done.isEmpty())
+	{
+		if(m_checkpoint.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+		{
+			m_checkpoint.write(fingerprint);
+			m_checkpoint.write("\n");
+			m_checkpoint.flush();
+		}
+	}
+	else
+	{
+		m_checkpoint.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text);
+	}
+
+	QThreadPool pool;
 	QHash<QString, Protocol>::const_iterator protocol = m_protocols.constBegin();
 	for(; protocol != m_protocols.constEnd(); protocol++)
 	{
@@ -219,64 +487,33 @@ void HistoryManagerWindow::saveMessages(char format)
 				QMap<qint64,MessageList>::const_iterator month = contact.value().constBegin();
 				for(; month != contact.value().constEnd(); month++)
 				{
-					emit saveValueChanged(++num);
 					QString filename = quoteByFormat(contact.key(), format);
 					filename += ".";
 					filename += QString::number(month.key());
-//					if(format == 'j')
-						filename += ".json";
-//					else
-//						filename += ".log";
-					QFile file(account_dir.filePath(filename));
-//					if(format == 'j')
+					filename += ".json";
+					if(done.contains(account_path + QLatin1Char('/') + filename))
 					{
-						if(!file.open(QIODevice::WriteOnly | QIODevice::Text))
-							continue;
-						file.write("[\n");
-						bool first = true;
-						foreach(const Message &message, month.value())
-						{
-							if(first)
-								first = false;
-							else
-								file.write(",\n");
-							file.write(" {\n");
-							foreach(const QByteArray &name, message.dynamicPropertyNames())
-							{
-								QByteArray data;
-								if(!Json::generate(data, message.property(name), 2))
-									continue;
-								file.write("  ");
-								file.write(Json::quote(QString::fromUtf8(name)).toUtf8());
-								file.write(": ");
-								file.write(data);
-								file.write(",\n");
-							}
-							file.write("  \"datetime\": \"");
-							QDateTime time = message.time();
-							if(!time.isValid())
-								time = QDateTime::currentDateTime();
-							file.write(time.toString(Qt::ISODate).toLatin1());
-							file.write("\",\n  \"in\": ");
-							file.write(message.isIncoming() ? "true" : "false");
-							file.write(",\n  \"text\": ");
-							file.write(Json::quote(message.text()).toUtf8());
-							file.write("\n }");
-						}
-						file.write("\n]");
+						QMutexLocker locker(&m_checkpoint_lock);
+						emit saveValueChanged(++m_saved_num);
+						continue;
 					}
-//					else if(format == 'b')
-//					{
-//						if(!file.open(QIODevice::WriteOnly))
-//							continue;
-//						QDataStream out(&file);
-//						foreach(const Message &msg, month.value())
-//							out << msg.time << msg.type << msg.in << msg.text;
-//					}
+					pool.start(new SaveJob(this, account_dir, filename, &month.value()));
 				}
 			}
 		}
 	}
+	pool.waitForDone();
+	m_checkpoint.close();
+	const int failed = m_failed_num.load();
+	// Failed months are written again by the next dump, which starts from
+	// the same checkpoints
+	if(failed)
+		return failed;
+	m_checkpoint.remove();
+	foreach(const QString &path, m_import_checkpoints)
+		QFile::remove(path);
+	m_import_checkpoints.clear();
+	return 0;
 }
 
 void HistoryManagerWindow::changeEvent(QEvent *e)
@@ -30,11 +30,17 @@
 #include <QMap>
 #include <QHash>
 #include <QEvent>
+#include <QFile>
+#include <QMutex>
+#include <QAtomicInteger>
+#include <QStringList>
 #include "clients/qutim.h"
 #include "../include/qutim/historymanager.h"
 
 namespace HistoryManager {
 
+class ImportBatch;
+
 class HistoryManagerWindow : public QWizard, public DataBaseInterface {
 	Q_OBJECT
 	Q_DISABLE_COPY(HistoryManagerWindow)
@@ -60,8 +66,20 @@ public:
 	inline void setCurrentClient(HistoryImporter *client) { m_current_client = client; }
 	inline HistoryImporter *getCurrentClient() const { return m_current_client; }
 	inline qutim *getQutIM() const { return m_qutim; }
-	inline quint64 getMessageNum() const { return m_message_num; }
-	void saveMessages(char format);
+	inline quint64 getMessageNum() const { return m_message_num.load(); }
+	// Sources of the client are parsed by a thread pool and merged in their
+	// order by the calling thread. Merged sources are appended to a checkpoint,
+	// so an interrupted import skips them next time
+	void importMessages(HistoryImporter *client, const QString &path, bool resumable);
+	// Sorts messages of every month and removes duplicates, months are processed in parallel
+	void normalizeMessages();
+	// Imported sources identify the checkpoint of interrupted dump
+	void addSource(const QString &client, const QString &path);
+	// Returns number of months which failed to be written, checkpoints are kept
+	// unless all of them were saved
+	int saveMessages(char format);
+	void monthSaved(const QString &path);
+	void monthFailed(const QString &path);
 	QString finishStr() { if(m_finish.isEmpty()) m_finish = buttonText(QWizard::FinishButton); return m_finish; }
 	QString nextStr() { if(m_next.isEmpty()) m_next = buttonText(QWizard::NextButton); return m_next; }
 	QString dumpStr() { return m_dump; }
@@ -78,11 +96,18 @@ signals:
 	void saveValueChanged(int value);
 
 private:
+	void mergeBatch(const ImportBatch &batch);
 	QHash<QString, Protocol> m_protocols;
 	Protocol *m_protocol;
 	Account  *m_account;
 	Contact  *m_contact;
-	quint64 m_message_num;
+	QAtomicInteger<quint64> m_message_num;
+	int m_saved_num;
+	QStringList m_sources;
+	QStringList m_import_checkpoints;
+	QAtomicInt m_failed_num;
+	QFile m_checkpoint;
+	QMutex m_checkpoint_lock;
 	HistoryImporter *m_current_client;
 	qutim *m_qutim;
 	QString m_finish;
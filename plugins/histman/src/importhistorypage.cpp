@@ -41,7 +41,8 @@ void ImportHistoryPageHepler::run()
 {
 	QTime t;
 	t.start();
-	m_parent->m_parent->getCurrentClient()->loadMessages(m_path);
+	HistoryManagerWindow *window = m_parent->m_parent;
+	window->importMessages(window->getCurrentClient(), m_path, true);
 	m_time = t.elapsed();
 }
 
@@ -56,6 +57,9 @@ ImportHistoryPage::ImportHistoryPage(HistoryManagerWindow *parent) :
 	connect(m_parent, SIGNAL(valueChanged(int)), m_ui->progressBar, SLOT(setValue(int)));
 	m_helper = new ImportHistoryPageHepler(this);
 	connect(m_helper, SIGNAL(finished()), this, SLOT(completed()));
+	m_progressTimer = new QTimer(this);
+	m_progressTimer->setInterval(1000);
+	connect(m_progressTimer, SIGNAL(timeout()), this, SLOT(updateProgress()));
 	setCommitPage(true);
 	setButtonText(QWizard::CommitButton, m_parent->nextStr());
 }
@@ -70,9 +74,14 @@ void ImportHistoryPage::initializePage()
 	m_completed = false;
 	setSubTitle(tr("Manager loads all history to memory, it may take several minutes."));
 	m_parent->getCurrentClient()->setCharset(m_parent->charset());
-	m_helper->setPath(ClientConfigPage::getAppropriateFilePath(field("historypath").toString()));
+	const QString path = ClientConfigPage::getAppropriateFilePath(field("historypath").toString());
+	m_parent->addSource(m_parent->getCurrentClient()->name(), path);
+	m_helper->setPath(path);
 	m_ui->progressBar->setValue(0);
 	QTimer::singleShot(100, m_helper, SLOT(start()));
+	m_startNum = m_parent->getMessageNum();
+	m_elapsed.start();
+	m_progressTimer->start();
 	m_parent->button(QWizard::BackButton)->setEnabled(false);
 	m_parent->button(QWizard::CancelButton)->setEnabled(false);
 }
@@ -92,8 +101,18 @@ int ImportHistoryPage::nextId() const
 	return HistoryManagerWindow::ChooseOrDump;
 }
 
+void ImportHistoryPage::updateProgress()
+{
+	const quint64 num = m_parent->getMessageNum();
+	const quint64 loaded = num > m_startNum ? num - m_startNum : 0;
+	const qint64 elapsed = qMax<qint64>(1, m_elapsed.elapsed());
+	setSubTitle(tr("%n message(s) have been loaded", 0, int(loaded))
+				+ " " + tr("(%1 messages per second).").arg(loaded * 1000 / elapsed));
+}
+
 void ImportHistoryPage::completed()
 {
+	m_progressTimer->stop();
 	setSubTitle(tr("%n message(s) have been successfully loaded to memory.", 0, m_parent->getMessageNum())
 				+ " " + tr("It has taken %n ms.", 0, m_helper->getTime()));
 	m_completed = true;
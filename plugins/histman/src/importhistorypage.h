@@ -29,6 +29,8 @@
 #include <QWizardPage>
 #include "historymanagerwindow.h"
 #include <QThread>
+#include <QTimer>
+#include <QElapsedTimer>
 
 namespace Ui {
 	class ImportHistoryPage;
@@ -67,10 +69,15 @@ protected:
 	virtual int nextId() const;
 public slots:
 	void completed();
+private slots:
+	void updateProgress();
 
 private:
 	friend class ImportHistoryPageHepler;
 	ImportHistoryPageHepler *m_helper;
+	QTimer *m_progressTimer;
+	QElapsedTimer m_elapsed;
+	quint64 m_startNum;
 	HistoryManagerWindow *m_parent;
 	Ui::ImportHistoryPage *m_ui;
 	bool m_completed;
@@ -0,0 +1,184 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "importpipeline.h"
+#include <QVariantMap>
+
+using namespace qutim_sdk_0_3;
+
+namespace HistoryManager {
+
+ImportBatch::ImportBatch(const QString &source)
+	: m_source(source), m_protocol(0), m_account(0), m_contact(0), m_count(0)
+{
+}
+
+void ImportBatch::appendMessage(const Message &message)
+{
+	Q_ASSERT(m_contact);
+	m_contact->operator [](monthId(message)).append(message);
+	m_count++;
+}
+
+void ImportBatch::setProtocol(const QString &protocol)
+{
+	m_protocol = &m_protocols.operator [](protocol);
+}
+
+void ImportBatch::setAccount(const QString &account)
+{
+	Q_ASSERT(m_protocol);
+	m_account = &m_protocol->operator [](account);
+}
+
+void ImportBatch::setContact(const QString &contact)
+{
+	Q_ASSERT(m_account);
+	m_contact = &m_account->operator [](contact);
+}
+
+ConfigWidget ImportBatch::createAccountWidget(const QString &protocol)
+{
+	// Widgets are created by config() in the gui thread only
+	Q_UNUSED(protocol);
+	return ConfigWidget(0, 0);
+}
+
+void ImportBatch::save(QIODevice *device) const
+{
+	QByteArray data;
+	{
+		QDataStream out(&data, QIODevice::WriteOnly);
+		out.setVersion(QDataStream::Qt_5_0);
+		qint32 contacts = 0;
+		foreach (const Protocol &protocol, m_protocols)
+			foreach (const Account &account, protocol)
+				contacts += account.size();
+		out << m_source << contacts;
+		QHash<QString, Protocol>::const_iterator protocol = m_protocols.constBegin();
+		for (; protocol != m_protocols.constEnd(); ++protocol) {
+			Protocol::const_iterator account = protocol->constBegin();
+			for (; account != protocol->constEnd(); ++account) {
+				Account::const_iterator contact = account->constBegin();
+				for (; contact != account->constEnd(); ++contact) {
+					qint32 messages = 0;
+					foreach (const MessageList &month, *contact)
+						messages += month.size();
+					out << protocol.key() << account.key() << contact.key() << messages;
+					foreach (const MessageList &month, *contact) {
+						foreach (const Message &message, month) {
+							QVariantMap properties;
+							foreach (const QByteArray &name, message.dynamicPropertyNames())
+								properties.insert(QString::fromUtf8(name), message.property(name));
+							out << message.time() << message.isIncoming() << message.text() << properties;
+						}
+					}
+				}
+			}
+		}
+	}
+	QDataStream out(device);
+	out.setVersion(QDataStream::Qt_5_0);
+	out << data;
+}
+
+ImportBatch *ImportBatch::load(QDataStream &in)
+{
+	QByteArray data;
+	in >> data;
+	if (in.status() != QDataStream::Ok)
+		return 0;
+	QDataStream record(data);
+	record.setVersion(QDataStream::Qt_5_0);
+	QString source;
+	qint32 contacts;
+	record >> source >> contacts;
+	ImportBatch *batch = new ImportBatch(source);
+	for (qint32 i = 0; i < contacts && record.status() == QDataStream::Ok; i++) {
+		QString protocol, account, contact;
+		qint32 messages;
+		record >> protocol >> account >> contact >> messages;
+		batch->setProtocol(protocol);
+		batch->setAccount(account);
+		batch->setContact(contact);
+		for (qint32 j = 0; j < messages && record.status() == QDataStream::Ok; j++) {
+			QDateTime time;
+			bool incoming;
+			QString text;
+			QVariantMap properties;
+			record >> time >> incoming >> text >> properties;
+			Message message(text);
+			message.setTime(time);
+			message.setIncoming(incoming);
+			QVariantMap::const_iterator it = properties.constBegin();
+			for (; it != properties.constEnd(); ++it)
+				message.setProperty(it.key().toUtf8(), it.value());
+			batch->appendMessage(message);
+		}
+	}
+	if (record.status() != QDataStream::Ok) {
+		delete batch;
+		return 0;
+	}
+	return batch;
+}
+
+ImportQueue::ImportQueue(int size)
+	: m_batches(size, 0), m_done(size, false)
+{
+}
+
+void ImportQueue::put(int index, ImportBatch *batch)
+{
+	QMutexLocker locker(&m_lock);
+	m_batches[index] = batch;
+	m_done[index] = true;
+	m_ready.wakeAll();
+}
+
+ImportBatch *ImportQueue::take(int index)
+{
+	QMutexLocker locker(&m_lock);
+	while (!m_done.at(index))
+		m_ready.wait(&m_lock);
+	ImportBatch *batch = m_batches.at(index);
+	m_batches[index] = 0;
+	return batch;
+}
+
+ImportJob::ImportJob(HistoryImporter *client, const QString &path, const QString &source,
+					 int index, ImportQueue *queue)
+	: m_client(client), m_path(path), m_source(source), m_index(index), m_queue(queue)
+{
+}
+
+void ImportJob::run()
+{
+	ImportBatch *batch = new ImportBatch(m_source);
+	m_client->loadSource(m_path, m_source, batch);
+	m_queue->put(m_index, batch);
+}
+
+}
@@ -0,0 +1,102 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef IMPORTPIPELINE_H
+#define IMPORTPIPELINE_H
+
+#include <QRunnable>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+#include <QDataStream>
+#include "../include/qutim/historymanager.h"
+
+namespace HistoryManager {
+
+inline qint64 monthId(const qutim_sdk_0_3::Message &message)
+{
+	QDate date = message.time().date();
+	return date.year() * 100 + date.month();
+}
+
+// Messages of one source, parsed by a worker thread and merged to the window
+// by the importing thread in order of sources
+class ImportBatch : public DataBaseInterface
+{
+public:
+	explicit ImportBatch(const QString &source);
+	virtual ~ImportBatch() {}
+	virtual void appendMessage(const qutim_sdk_0_3::Message &message);
+	virtual void setProtocol(const QString &protocol);
+	virtual void setAccount(const QString &account);
+	virtual void setContact(const QString &contact);
+	virtual void setMaxValue(int max) { Q_UNUSED(max); }
+	virtual void setValue(int value) { Q_UNUSED(value); }
+	virtual ConfigWidget createAccountWidget(const QString &protocol);
+	inline QString source() const { return m_source; }
+	inline quint64 count() const { return m_count; }
+	inline const QHash<QString, Protocol> &protocols() const { return m_protocols; }
+	// Record is length-prefixed, so the tail cut by a crash is detected on load
+	void save(QIODevice *device) const;
+	static ImportBatch *load(QDataStream &in);
+private:
+	QString m_source;
+	QHash<QString, Protocol> m_protocols;
+	Protocol *m_protocol;
+	Account  *m_account;
+	Contact  *m_contact;
+	quint64 m_count;
+};
+
+class ImportQueue
+{
+public:
+	explicit ImportQueue(int size);
+	void put(int index, ImportBatch *batch);
+	ImportBatch *take(int index);
+private:
+	QMutex m_lock;
+	QWaitCondition m_ready;
+	QVector<ImportBatch *> m_batches;
+	QVector<bool> m_done;
+};
+
+class ImportJob : public QRunnable
+{
+public:
+	ImportJob(HistoryImporter *client, const QString &path, const QString &source,
+			  int index, ImportQueue *queue);
+	void run();
+private:
+	HistoryImporter *m_client;
+	QString m_path;
+	QString m_source;
+	int m_index;
+	ImportQueue *m_queue;
+};
+
+}
+
+#endif // IMPORTPIPELINE_H
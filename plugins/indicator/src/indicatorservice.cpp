@@ -72,13 +72,14 @@ void IndicatorService::onSessionCreated(qutim_sdk_0_3::ChatSession *session)
 	sessionIndicators.insert(session, indicator);
 
 	connect(session, SIGNAL(destroyed(QObject*)), SLOT(onSessionDestroyed(QObject*)));
-	connect(session, SIGNAL(unreadChanged(const qutim_sdk_0_3::MessageList&)),
-			SLOT(onUnreadChanged(const qutim_sdk_0_3::MessageList&)));
+	connect(session, SIGNAL(unreadCountChanged(int)),
+			SLOT(onUnreadChanged(int)));
 	connect(session, SIGNAL(activated(bool)), SLOT(onSessionActivated(bool)));
 
-	indicator->setAttention(!session->unread().isEmpty());
-	indicator->setCount(session->unread().count());
-	if (!session->unread().isEmpty())
+	const int count = session->unreadCount();
+	indicator->setAttention(count > 0);
+	indicator->setCount(count);
+	if (count > 0)
 		indicator->setIcon(qutim_sdk_0_3::Icon("mail-unread-new"));
 }
 
@@ -92,10 +93,10 @@ void IndicatorService::onSessionDestroyed(QObject *session)
 
 }
 
-void IndicatorService::onUnreadChanged(const qutim_sdk_0_3::MessageList &messages)
+void IndicatorService::onUnreadChanged(int count)
 {
 	qDebug() << "onUnreadChanged";
-	if (messages.isEmpty())
+	if (count == 0)
 		return;
 	qDebug() << "Message list isn't empty. Looking for session.";
 	qutim_sdk_0_3::ChatSession* session = qobject_cast<qutim_sdk_0_3::ChatSession*>(sender());
@@ -106,12 +107,11 @@ void IndicatorService::onUnreadChanged(const qutim_sdk_0_3::MessageList &message
 	Source *indicator = sessionIndicators.value(session);
 	if (!indicator)
 		return;
-	QDateTime time = messages.last().time();
-
-	indicator->setTime(time);
+	// Count is changed right after arrival of the message
+	indicator->setTime(QDateTime::currentDateTime());
 	indicator->setAttention(true);
 	indicator->setIcon(qutim_sdk_0_3::Icon("mail-unread-new"));
-	indicator->setCount(session->unread().count());
+	indicator->setCount(count);
 
 }
 
@@ -139,7 +139,7 @@ void IndicatorService::onSessionActivated(bool active)
 
 	indicator->setTime(QDateTime::currentDateTime());
 	indicator->setAttention(false);
-	indicator->setCount(session->unread().count());
+	indicator->setCount(session->unreadCount());
 	indicator->setIcon(QIcon());
 
 }
@@ -52,7 +52,7 @@ protected slots:
 	/* Tray layer slots */
 	void onSessionCreated(qutim_sdk_0_3::ChatSession*);
 	void onSessionDestroyed(QObject* session);
-	void onUnreadChanged(const qutim_sdk_0_3::MessageList&);
+	void onUnreadChanged(int count);
 	////// void onActivated(QSystemTrayIcon::ActivationReason);
 	void onAccountCreated(qutim_sdk_0_3::Account *);
 	void onAccountDestroyed(QObject *obj);
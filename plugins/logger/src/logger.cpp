@@ -26,50 +26,184 @@
 #define _CRT_SECURE_NO_DEPRECATE
 
 #include "logger.h"
+#include "logwriter.h"
 #include <qutim/config.h>
 #include <qutim/systeminfo.h>
 #include <qutim/debug.h>
 #include <cstdio>
 #include <QTime>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QAtomicPointer>
+#include <QRegExp>
 #include <qutim/icon.h>
 #include <QCheckBox>
 
 namespace Logger
 {
 using namespace std;
-static FILE *logfile = NULL;
-//ofstream logfile;
+// Handler may run in any thread, so writer is deleted only after all
+// handlers, which have seen it, have left (see closeWriter)
+static QAtomicPointer<LogWriter> logwriter;
+static QAtomicInt logwriterUsers;
+static bool filterEnabled = false;
+
+// Rules have the syntax of QLoggingCategory::setFilterRules(), i.e.
+// "oscar.debug=false", but they are applied to the log file only
+struct FilterRule
+{
+	enum Match { All, Exact, Prefix, Suffix, Contains };
+	Match match;
+	QByteArray pattern;
+	int types; // mask of 1 << QtMsgType
+	bool enabled;
+
+	bool matches(const QByteArray &name) const
+	{
+		switch (match) {
+		case All:
+			return true;
+		case Exact:
+			return name == pattern;
+		case Prefix:
+			return name.startsWith(pattern);
+		case Suffix:
+			return name.endsWith(pattern);
+		case Contains:
+			return name.contains(pattern);
+		}
+		return false;
+	}
+};
+
+static QList<FilterRule> parseFilterRules(const QString &rules)
+{
+	static const struct
+	{
+		const char *suffix;
+		QtMsgType type;
+	} typeSuffixes[] = {
+		{ ".debug", QtDebugMsg },
+		{ ".warning", QtWarningMsg },
+		{ ".critical", QtCriticalMsg },
+#if QT_VERSION >= QT_VERSION_CHECK(5, 5, 0)
+		{ ".info", QtInfoMsg }
+#endif
+	};
+	QList<FilterRule> result;
+	// Rules are separated by new lines, semicolons allow to keep them in one line of config
+	foreach (const QString &line, rules.split(QRegExp(QLatin1String("[\n;]")), QString::SkipEmptyParts)) {
+		const int separator = line.indexOf(QLatin1Char('='));
+		if (separator < 0)
+			continue;
+		const QString value = line.mid(separator + 1).trimmed();
+		if (value != QLatin1String("true") && value != QLatin1String("false"))
+			continue;
+		FilterRule rule;
+		rule.enabled = value == QLatin1String("true");
+		rule.types = ~0;
+		rule.pattern = line.left(separator).trimmed().toUtf8();
+		for (size_t i = 0; i < sizeof(typeSuffixes) / sizeof(typeSuffixes[0]); ++i) {
+			if (rule.pattern.endsWith(typeSuffixes[i].suffix)) {
+				rule.pattern.chop(qstrlen(typeSuffixes[i].suffix));
+				rule.types = 1 << typeSuffixes[i].type;
+				break;
+			}
+		}
+		const bool starts = rule.pattern.startsWith('*');
+		const bool ends = rule.pattern.size() > 1 && rule.pattern.endsWith('*');
+		rule.pattern = rule.pattern.mid(starts ? 1 : 0, rule.pattern.size() - starts - ends);
+		if (rule.pattern.contains('*'))
+			continue;
+		if (rule.pattern.isEmpty())
+			rule.match = FilterRule::All;
+		else if (starts && ends)
+			rule.match = FilterRule::Contains;
+		else if (starts)
+			rule.match = FilterRule::Suffix;
+		else if (ends)
+			rule.match = FilterRule::Prefix;
+		else
+			rule.match = FilterRule::Exact;
+		result << rule;
+	}
+	return result;
+}
+
+struct CategoryEntry
+{
+	QByteArray name;
+	int enabledTypes; // mask of 1 << QtMsgType
+};
+
+typedef QHash<const char *, CategoryEntry> CategoryHash;
+Q_GLOBAL_STATIC(CategoryHash, categories)
+Q_GLOBAL_STATIC(QList<FilterRule>, categoryRules)
+Q_GLOBAL_STATIC(QReadWriteLock, categoriesLock)
+
+// Categories are passed as string literals (QUTIM_PLUGIN_NAME), so pointer is good enough
+// as a key, name comparison only protects from reused addresses of unloaded plugins.
+// Entries are stored by value and read under the lock, so clearing never frees one in use
+static bool isCategoryEnabled(const char *name, QtMsgType type)
+{
+	if (!name)
+		name = "default";
+	{
+		QReadLocker locker(categoriesLock());
+		CategoryHash::const_iterator it = categories()->constFind(name);
+		if (it != categories()->constEnd() && qstrcmp(it->name.constData(), name) == 0)
+			return it->enabledTypes & (1 << type);
+	}
+	CategoryEntry entry;
+	entry.name = name;
+	entry.enabledTypes = ~0;
+	QWriteLocker locker(categoriesLock());
+	// Later rules override the earlier ones
+	foreach (const FilterRule &rule, *categoryRules()) {
+		if (rule.matches(entry.name)) {
+			if (rule.enabled)
+				entry.enabledTypes |= rule.types;
+			else
+				entry.enabledTypes &= ~rule.types;
+		}
+	}
+	categories()->insert(name, entry);
+	return entry.enabledTypes & (1 << type);
+}
+
+static void setFilterRules(const QList<FilterRule> &rules)
+{
+	QWriteLocker locker(categoriesLock());
+	*categoryRules() = rules;
+	categories()->clear();
+}
 
 void SimpleLoggingHandler(QtMsgType type, const QMessageLogContext &log, const QString &msgData)
 {
-	Q_UNUSED(log)
-	if (!logfile) {
+	logwriterUsers.ref();
+	LogWriter *writer = logwriter.loadAcquire();
+	if (!writer) {
+		logwriterUsers.deref();
 		if (type == QtFatalMsg)
 			abort();
 		return;
 	}
-	QByteArray currentTime = QTime::currentTime().toString().toLatin1();
-	QByteArray msg = msgData.toUtf8();
-	switch (type) {
-	default:
-	case QtDebugMsg:
-		fprintf(logfile, "%s Debug: %s\n", currentTime.constData(), msg.constData());
-//		logfile << QTime::currentTime().toString().toLatin1().data() << " Debug: " << msg << "\n";
-		break;
-	case QtCriticalMsg:
-		fprintf(logfile, "%s Critical: %s\n", currentTime.constData(), msg.constData());
-//		logfile << QTime::currentTime().toString().toLatin1().data() << " Critical: " << msg << "\n";
-		break;
-	case QtWarningMsg:
-		fprintf(logfile, "%s Warning: %s\n", currentTime.constData(), msg.constData());
-//		logfile << QTime::currentTime().toString().toLatin1().data() << " Warning: " << msg << "\n";
-		break;
-	case QtFatalMsg:
-		fprintf(logfile, "%s Fatal: %s\n", currentTime.constData(), msg.constData());
-//		logfile << QTime::currentTime().toString().toLatin1().data() <<  " Fatal: " << msg << "\n";
+	if (filterEnabled && type != QtFatalMsg && !isCategoryEnabled(log.category, type)) {
+		logwriterUsers.deref();
+		return;
+	}
+	// Time formatting and file IO are done by writer thread
+	LogRecord record;
+	record.type = type;
+	record.msecs = QTime::currentTime().msecsSinceStartOfDay();
+	record.category = log.category;
+	record.message = msgData.toUtf8();
+	writer->enqueue(record);
+	if (type == QtFatalMsg) {
+		writer->flush();
 		abort();
 	}
-	fflush(stdin);
+	logwriterUsers.deref();
 }
 
 void LoggerPlugin::init()
@@ -116,34 +250,51 @@ bool LoggerPlugin::load()
 void LoggerPlugin::reloadSettings()
 {
 	Config config = Config().group(QLatin1String("Logger"));
-	int maxFileSize = config.value(QLatin1String("maxFileSize"), 512 * 1024);
-	QString path = config.value(QLatin1String("path"),
+	LogWriter::Options options;
+	options.maxFileSize = config.value(QLatin1String("maxFileSize"), 512 * 1024);
+	options.rotateCount = config.value(QLatin1String("rotateCount"), 3);
+	options.compressRotated = config.value(QLatin1String("compressRotated"), false);
+	options.path = config.value(QLatin1String("path"),
 								SystemInfo::getPath(SystemInfo::ConfigDir).append("/qutim.log"));
+	int bufferSize = config.value(QLatin1String("bufferSize"), 4096);
 	bool enable = config.value(QLatin1String("enable"), true);
-	if (enable && !logfile) {
-		QFileInfo fileInfo(path);
-		if (maxFileSize != -1 && fileInfo.size() > maxFileSize)
-			logfile = fopen(path.toLocal8Bit(), "w");
-//			logfile.open(path.toLocal8Bit(), ios::out | ios::trunc);
+	// See QLoggingCategory for rules syntax, i.e. "oscar.debug=false"
+	QString filterRules = config.value(QLatin1String("filterRules"), QString());
+
+	const QList<FilterRule> rules = parseFilterRules(filterRules);
+	setFilterRules(rules);
+	filterEnabled = !rules.isEmpty();
+
+	if (enable && !logwriter.load()) {
+		LogWriter *writer = new LogWriter(bufferSize, options);
+		if (writer->open())
+			logwriter.storeRelease(writer);
 		else
-			logfile = fopen(path.toLocal8Bit(), "a");
-//			logfile.open(path.toLocal8Bit(), ios::app);
-	} else if (!enable && logfile) {
-		fflush(logfile);
-		fclose(logfile);
-		logfile = NULL;
+			delete writer;
+	} else if (!enable && logwriter.load()) {
+		closeWriter();
 	}
 }
 
+void LoggerPlugin::closeWriter()
+{
+	LogWriter *writer = logwriter.fetchAndStoreOrdered(NULL);
+	if (!writer)
+		return;
+	// New handlers see null now, wait for ones which may still use the writer
+	while (logwriterUsers.loadAcquire())
+		QThread::yieldCurrentThread();
+	writer->stop();
+	delete writer;
+}
+
 bool LoggerPlugin::unload()
 {
 	if (m_settingsItem) {
-		if (logfile) {
-			fflush(logfile);
-			fclose(logfile);
-			logfile = NULL;
-		}
 		qInstallMessageHandler(NULL);
+		closeWriter();
+		filterEnabled = false;
+		setFilterRules(QList<FilterRule>());
 		Settings::removeItem(m_settingsItem);
 		m_settingsItem = 0;
 		return true;
@@ -45,6 +45,7 @@ public:
 protected slots:
 	void reloadSettings();
 private:
+	void closeWriter();
 	SettingsItem *m_settingsItem;
 };
 
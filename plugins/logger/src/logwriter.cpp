@@ -0,0 +1,251 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+#include "logwriter.h"
+#include <QTime>
+#include <QFileInfo>
+
+namespace Logger
+{
+
+static quint32 nextPowerOfTwo(int value)
+{
+	quint32 result = 16;
+	while (result < quint32(value))
+		result <<= 1;
+	return result;
+}
+
+LogRingBuffer::LogRingBuffer(int capacity)
+{
+	quint32 size = nextPowerOfTwo(capacity);
+	m_mask = size - 1;
+	m_cells = new Cell[size];
+	for (quint32 i = 0; i < size; ++i)
+		m_cells[i].sequence.store(i);
+	m_head.store(0);
+	m_tail.store(0);
+	m_dropped.store(0);
+}
+
+LogRingBuffer::~LogRingBuffer()
+{
+	delete [] m_cells;
+}
+
+bool LogRingBuffer::push(LogRecord &record)
+{
+	Cell *cell;
+	quint32 pos = m_tail.load();
+	forever {
+		cell = &m_cells[pos & m_mask];
+		quint32 sequence = cell->sequence.loadAcquire();
+		qint32 diff = qint32(sequence - pos);
+		if (diff == 0) {
+			if (m_tail.testAndSetRelaxed(pos, pos + 1, pos))
+				break;
+		} else if (diff < 0) {
+			m_dropped.fetchAndAddRelaxed(1);
+			return false;
+		} else {
+			pos = m_tail.load();
+		}
+	}
+	qSwap(cell->record, record);
+	cell->sequence.storeRelease(pos + 1);
+	return true;
+}
+
+bool LogRingBuffer::pop(LogRecord &record)
+{
+	quint32 pos = m_head.load();
+	Cell *cell = &m_cells[pos & m_mask];
+	quint32 sequence = cell->sequence.loadAcquire();
+	if (qint32(sequence - (pos + 1)) < 0)
+		return false;
+	m_head.store(pos + 1);
+	qSwap(cell->record, record);
+	cell->record.category.clear();
+	cell->record.message.clear();
+	cell->sequence.storeRelease(pos + m_mask + 1);
+	return true;
+}
+
+int LogRingBuffer::size() const
+{
+	return int(m_tail.load() - m_head.load());
+}
+
+LogWriter::LogWriter(int capacity, const Options &options)
+    : m_buffer(capacity), m_options(options)
+{
+	m_running.store(0);
+	m_wakeRequested.store(0);
+}
+
+LogWriter::~LogWriter()
+{
+	stop();
+}
+
+bool LogWriter::open()
+{
+	QMutexLocker locker(&m_fileLock);
+	m_file.setFileName(m_options.path);
+	if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append))
+		return false;
+	if (m_options.maxFileSize > 0 && m_file.size() > m_options.maxFileSize)
+		rotate();
+	m_running.store(1);
+	start(QThread::LowPriority);
+	return true;
+}
+
+void LogWriter::enqueue(LogRecord &record)
+{
+	m_buffer.push(record);
+	// Wake up the writer only when the buffer is getting full,
+	// otherwise it's drained by the periodic tick
+	if (m_buffer.size() >= m_buffer.capacity() / 2
+	        && m_wakeRequested.testAndSetRelaxed(0, 1)) {
+		m_wait.wakeOne();
+	}
+}
+
+void LogWriter::flush()
+{
+	drain();
+}
+
+void LogWriter::stop()
+{
+	if (!m_running.testAndSetOrdered(1, 0))
+		return;
+	m_waitLock.lock();
+	m_wait.wakeOne();
+	m_waitLock.unlock();
+	wait();
+	drain();
+	QMutexLocker locker(&m_fileLock);
+	m_file.close();
+}
+
+void LogWriter::run()
+{
+	while (m_running.load()) {
+		m_waitLock.lock();
+		if (m_running.load() && m_buffer.size() == 0)
+			m_wait.wait(&m_waitLock, 100);
+		m_waitLock.unlock();
+		m_wakeRequested.store(0);
+		drain();
+	}
+}
+
+void LogWriter::drain()
+{
+	QMutexLocker locker(&m_fileLock);
+	if (!m_file.isOpen())
+		return;
+	LogRecord record;
+	bool written = false;
+	while (m_buffer.pop(record)) {
+		write(record);
+		written = true;
+	}
+	if (quint32 dropped = m_buffer.takeDropped()) {
+		QByteArray line = QTime::currentTime().toString().toLatin1();
+		line += " Warning: [Logger] ";
+		line += QByteArray::number(dropped);
+		line += " records dropped, ring buffer overflow\n";
+		m_file.write(line);
+		written = true;
+	}
+	if (written)
+		m_file.flush();
+}
+
+void LogWriter::write(const LogRecord &record)
+{
+	const char *typeName;
+	switch (record.type) {
+	default:
+	case QtDebugMsg:
+		typeName = " Debug: ";
+		break;
+	case QtWarningMsg:
+		typeName = " Warning: ";
+		break;
+	case QtCriticalMsg:
+		typeName = " Critical: ";
+		break;
+	case QtFatalMsg:
+		typeName = " Fatal: ";
+		break;
+	}
+	QByteArray line;
+	line.reserve(record.message.size() + record.category.size() + 32);
+	line += QTime::fromMSecsSinceStartOfDay(record.msecs).toString().toLatin1();
+	line += typeName;
+	if (!record.category.isEmpty()) {
+		line += '[';
+		line += record.category;
+		line += "] ";
+	}
+	line += record.message;
+	line += '\n';
+	m_file.write(line);
+	if (m_options.maxFileSize > 0 && m_file.pos() > m_options.maxFileSize)
+		rotate();
+}
+
+void LogWriter::rotate()
+{
+	m_file.close();
+	const QString path = m_options.path;
+	const QString suffix = m_options.compressRotated ? QStringLiteral(".z") : QString();
+	if (m_options.rotateCount <= 0) {
+		QFile::remove(path);
+	} else {
+		QFile::remove(path + QLatin1Char('.') + QString::number(m_options.rotateCount) + suffix);
+		for (int i = m_options.rotateCount - 1; i > 0; --i) {
+			QFile::rename(path + QLatin1Char('.') + QString::number(i) + suffix,
+			              path + QLatin1Char('.') + QString::number(i + 1) + suffix);
+		}
+		const QString rotated = path + QStringLiteral(".1");
+		QFile::rename(path, rotated);
+		if (m_options.compressRotated) {
+			// Use zlib format of qCompress, it's all we have without extra dependencies
+			QFile input(rotated);
+			QFile output(rotated + suffix);
+			if (input.open(QIODevice::ReadOnly) && output.open(QIODevice::WriteOnly)) {
+				output.write(qCompress(input.readAll()));
+				input.remove();
+			}
+		}
+	}
+	m_file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+}
+
+}
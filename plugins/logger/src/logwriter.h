@@ -0,0 +1,118 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+#ifndef LOGWRITER_H
+#define LOGWRITER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QVector>
+#include <QFile>
+
+namespace Logger
+{
+
+struct LogRecord
+{
+	QtMsgType type;
+	int msecs;
+	QByteArray category;
+	QByteArray message;
+};
+
+// Bounded multi-producer/single-consumer queue. Producers never block:
+// if there is no free slot the record is dropped and accounted in dropped().
+class LogRingBuffer
+{
+	Q_DISABLE_COPY(LogRingBuffer)
+public:
+	explicit LogRingBuffer(int capacity);
+	~LogRingBuffer();
+
+	bool push(LogRecord &record);
+	bool pop(LogRecord &record);
+	int capacity() const { return m_mask + 1; }
+	int size() const;
+	quint32 dropped() const { return m_dropped.load(); }
+	quint32 takeDropped() { return m_dropped.fetchAndStoreOrdered(0); }
+
+private:
+	struct Cell
+	{
+		QAtomicInteger<quint32> sequence;
+		LogRecord record;
+	};
+	Cell *m_cells;
+	quint32 m_mask;
+	QAtomicInteger<quint32> m_head;
+	QAtomicInteger<quint32> m_tail;
+	QAtomicInteger<quint32> m_dropped;
+};
+
+class LogWriter : public QThread
+{
+	Q_OBJECT
+public:
+	struct Options
+	{
+		Options() : maxFileSize(512 * 1024), rotateCount(3), compressRotated(false) {}
+		QString path;
+		qint64 maxFileSize;
+		int rotateCount;
+		bool compressRotated;
+	};
+
+	LogWriter(int capacity, const Options &options);
+	virtual ~LogWriter();
+
+	bool open();
+	void enqueue(LogRecord &record);
+	// Drains the queue synchronously, is used for fatal messages
+	void flush();
+	void stop();
+
+protected:
+	virtual void run();
+
+private:
+	void drain();
+	void write(const LogRecord &record);
+	void rotate();
+
+	LogRingBuffer m_buffer;
+	Options m_options;
+	QFile m_file;
+	QMutex m_fileLock;
+	QMutex m_waitLock;
+	QWaitCondition m_wait;
+	QAtomicInt m_running;
+	QAtomicInt m_wakeRequested;
+};
+
+}
+
+#endif // LOGWRITER_H
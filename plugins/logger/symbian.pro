@@ -12,8 +12,8 @@ INCLUDEPATH += . \
 			   ../../qutim/libqutim/include
 
 # Input
-HEADERS += src/logger.h
-SOURCES += src/logger.cpp
+HEADERS += src/logger.h src/logwriter.h
+SOURCES += src/logger.cpp src/logwriter.cpp
 
 #Symbian specific definitions
 symbian: {
@@ -38,7 +38,6 @@ class ChatChannel : public qutim_sdk_0_3::ChatSession
 {
 	Q_OBJECT
 	Q_PROPERTY(qutim_sdk_0_3::ChatUnit* unit READ unit WRITE setChatUnit NOTIFY unitChanged)
-	Q_PROPERTY(int unreadCount READ unreadCount NOTIFY unreadCountChanged)
 	Q_PROPERTY(QObject *page READ page WRITE setPage NOTIFY pageChanged)
 	Q_PROPERTY(QObject* model READ model CONSTANT)
 	Q_PROPERTY(QObject* units READ units CONSTANT)
@@ -52,7 +51,6 @@ public:
 	virtual QTextDocument *getInputField();
 	virtual void markRead(quint64 id);
 	virtual qutim_sdk_0_3::MessageList unread() const;
-	int unreadCount() const;
 	virtual void addContact(qutim_sdk_0_3::Buddy *c);
 	virtual void removeContact(qutim_sdk_0_3::Buddy *c);
 	QObject *model() const;
@@ -67,6 +65,7 @@ public:
 	Q_INVOKABLE QVariant evaluateJavaScript(const QString &script);
 
 protected:
+	virtual void virtual_hook(int id, void *data);
 	virtual qint64 doAppendMessage(qutim_sdk_0_3::Message &message);
 	virtual void doSetActive(bool active);
 
@@ -74,7 +73,6 @@ signals:
 	void javaScriptRequest(const QString &javaScript, QVariant *variant);
 	void messageAppended(const qutim_sdk_0_3::Message &message);
 	void unitChanged(qutim_sdk_0_3::ChatUnit *unit);
-	void unreadCountChanged(int);
 	void pageChanged(QObject *page);
 
 private:
@@ -69,7 +69,7 @@ QVariant ChatChannelModel::data(const QModelIndex &index, int role) const
 	case ChannelRole:
 		return qVariantFromValue<QObject*>(session);
 	case UnreadCountRole:
-		return session->unread().count();
+		return session->unreadCount();
 	default:
 		return QVariant();
 	}
@@ -15,6 +15,9 @@ MessageBase {
             left: parent.left
             margins: 4
         }
+        // Continuation of the previous message has no header
+        visible: !root.appending
+        height: visible ? implicitHeight : 0
         textFormat: Text.PlainText
         font.bold: true
         text: message.unitData.title
@@ -47,6 +50,7 @@ MessageBase {
             right: parent.right
             margins: 4
         }
+        visible: !root.appending
         color: "gray"
         text: Qt.formatDateTime(message.time, '(hh:mm:ss)')
         renderType: Text.NativeRendering
@@ -59,6 +63,7 @@ MessageBase {
             right: parent.right
             top: nickItem.bottom
             margins: 4
+            topMargin: root.appending ? 0 : 4
         }
         Repeater {
             model: root.messages.length
@@ -74,7 +79,7 @@ MessageBase {
                 readonly property var message: root.messages[index]
                 readonly property string bulletHtml: {
                     var incoming = message.incoming;
-                    var success = messageReceipts[message.id];
+                    var success = root.delivered;
                     var history = message.property("history", false);
                     var color = undefined;
                     if (history)
@@ -6,15 +6,9 @@ Item {
     id: root
 
     property var messages
-    property var messageReceipts: { return {}; }
+    // Receipt of the message, undefined until it's received
+    property var delivered
+    // Message continues the previous one of the same sender
+    property bool appending: false
     property QtObject session
-
-    function handleReceipt(id, success) {
-        var newMessageReceipts = {};
-        for (var i in messageReceipts)
-            newMessageReceipts[i] = messageReceipts[i];
-        newMessageReceipts[id] = success;
-
-        messageReceipts = newMessageReceipts;
-    }
 }
@@ -1,20 +1,23 @@
 import QtQuick 2.3
 import org.qutim.quickchat 0.4
 
-Item {
+// Delegates exist only for the visible messages of the session model,
+// older ones are paged from the history when the view reaches the top
+ListView {
     id: root
 
     property Component messageComponent
     property Component actionComponent
     property Component serviceComponent
     property QtObject session
-    property var items: []
-    property var itemMessages: []
-    property var messageReceiptes: { return {}; }
-    property var itemById: { return {}; }
     property SelectableMouseArea __selectableMouseArea: mouseArea
-    property bool doNotRelayout: false
     property bool hoverEnabled: mouseArea.hoverEnabled
+    // View follows new messages while it's scrolled to the end
+    property bool keepEnd: true
+    property bool __positioning: false
+
+    model: session ? session.model : null
+    cacheBuffer: height
 
     function updateHover() {
         mouseArea.updateHover();
@@ -24,141 +27,57 @@ Item {
         mouseArea.copy();
     }
 
-    Connections {
-        target: session
-        onReceivedMessageReceipt: {
-            messageReceiptes[id] = success;
-
-            if (!itemById.hasOwnProperty(id))
-                return;
-            var item = itemById[id];
-            if (!item.hasOwnProperty('handleReceipt'))
-                return;
-            item.handleReceipt(id, success);
-        }
-        onClearRequested: {
-            var oldItems = items;
-
-            messageReceiptes = {};
-            itemById = {};
-            itemMessages = [];
-            items = [];
-
-            for (var i = 1; i <= oldItems.length; ++i) {
-                var currentItem = i < oldItems.length ? oldItems[i] : undefined;
-                var previousItem = oldItems[i - 1];
-                if (previousItem !== currentItem) {
-                    previousItem.parent = null;
-                    previousItem.visible = false;
-                    previousItem.destroy();
-                }
-            }
-
-            doLayout();
-        }
+    function isAtEnd() {
+        return contentY + height >= originY + contentHeight - 2;
     }
 
-    function appendMessage(message) {
-        var index = findIndex(itemMessages, message);
-        doNotRelayout = true;
-
-        items.splice(index, 0, undefined);
-        itemMessages.splice(index, 0, message);
-
-        if (index > 0 && isContentSimiliar(itemMessages[index - 1], message)) {
-            items[index] = items[index - 1];
-            insertMessage(items[index], message);
-        } else if (index + 1 < itemMessages.length && isContentSimiliar(message, itemMessages[index + 1])) {
-            items[index] = items[index + 1];
-            insertMessage(items[index], message);
-        } else {
-            items[index] = createItem([message]);
-
-            if (index > 0 && index + 1 < items.length && items[index - 1] === items[index + 1]) {
-                var messages = items[index - 1].messages;
-                var messageIndex = messages.indexOf(itemMessages[index + 1]);
-                var firstMessages = messages.slice(0, messageIndex);
-                var secondMessages = messages.slice(messageIndex);
-                items[index - 1].messages = firstMessages;
-                items[index + 1] = createItem(secondMessages);
-                for (var i = 1; i < secondMessages.length; ++i)
-                    items[index + 1 + i] = items[index + 1];
-            }
-        }
-
-        itemById[message.id] = items[index];
-
-        doNotRelayout = false;
-        doLayout();
+    function moveToEnd() {
+        __positioning = true;
+        positionViewAtEnd();
+        __positioning = false;
     }
 
-    function findIndex(messages, message) {
-        var index = 0;
-        for (index = 0; index < messages.length; ++index) {
-            if (message.time.getTime() < messages[index].time.getTime()) {
-                break;
-            }
-        }
-        return index;
-    }
-
-    function insertMessage(item, message) {
-        var messages = item.messages.slice();
-        var index = findIndex(messages, message);
-        messages.splice(index, 0, message);
-        item.messages = messages;
-    }
-
-    function isContentSimiliar(first, second) {
-        return !first.property("service", false)
-            && !second.property("service", false)
-            && first.isSimiliar(second);
-    }
-
-    function createItem(messages) {
-        var message = messages[0];
-        var properties = {
-            messages: messages,
-            session: Qt.binding(function () { return root.session; }),
-            width: Qt.binding(function () { return root.width; }),
-        };
-        var component = messageComponent;
-        if (message.action && actionComponent)
-            component = actionComponent;
-        if (message.property("service", false) && serviceComponent)
-            component = serviceComponent;
-        var item = component.createObject(root, properties);
-
-        item.heightChanged.connect(function () {
-            root.onItemHeightChanged(item);
-        });
-
-        return item;
-    }
-
-    function doLayout() {
-        if (doNotRelayout)
+    onCountChanged: if (keepEnd) moveToEnd()
+    onContentHeightChanged: if (keepEnd) moveToEnd()
+    onHeightChanged: if (keepEnd) moveToEnd()
+    onContentYChanged: {
+        if (__positioning)
             return;
-
-        var y = 0;
-        for (var i = 0; i < items.length; ++i) {
-            var item = items[i];
-            if (i > 0 && item === items[i - 1])
-                continue;
-
-            item.y = y;
-            y += item.height;
-        }
-        root.height = y;
+        keepEnd = isAtEnd();
+        if (!keepEnd && model && model.canLoadOlder && contentY - originY < height)
+            model.loadOlder();
     }
-
-    function onItemHeightChanged(item) {
-        doLayout();
+    // Paged messages are not needed anymore
+    onKeepEndChanged: if (keepEnd && model) model.releaseOlder()
+
+    delegate: Item {
+        id: delegate
+        width: root.width
+        height: item ? item.height : 0
+
+        property Item item
+
+        Component.onCompleted: {
+            var component = root.messageComponent;
+            if (model.action && root.actionComponent)
+                component = root.actionComponent;
+            if (model.service && root.serviceComponent)
+                component = root.serviceComponent;
+            item = component.createObject(delegate, {
+                messages: Qt.binding(function () { return [ model.message ]; }),
+                delivered: Qt.binding(function () { return model.delivered; }),
+                appending: Qt.binding(function () { return model.appending; }),
+                session: Qt.binding(function () { return root.session; }),
+                width: Qt.binding(function () { return delegate.width; })
+            });
+        }
     }
 
     SelectableMouseArea {
         id: mouseArea
-        anchors.fill: root
+        // Covers the viewport, not the content
+        parent: root
+        anchors.fill: parent
         z: 10
         hoverEnabled: true
         onLinkActivated: Qt.openUrlExternally(link)
@@ -1,6 +1,7 @@
 import QtQuick 2.3
 import QtQuick.Controls 1.2
 import org.qutim 0.4 as Base
+import "../default" as Default
 
 Rectangle {
     id: root
@@ -20,7 +21,10 @@ Rectangle {
 
     Connections {
         target: session
-        onMessageAppended: root.appendMessage(message)
+        onMessageAppended: {
+            if (message.property("topic", false))
+                root.topic = message.html;
+        }
         onAppendTextRequested: root.appendTextRequested(text)
         onAppendNickRequested: root.appendNickRequested(nick)
     }
@@ -29,53 +33,21 @@ Rectangle {
         id: menu
     }
 
-    function appendMessage(message) {
-        if (message.property("topic", false)) {
-            root.topic = message.html;
-            return;
-        }
-
-        var keepEnd = flickable.shouldKeepEnd();
-
-        layout.appendMessage(message);
-
-        if (keepEnd)
-            flickable.moveToEnd();
-    }
-
     ScrollView {
         id: scrollView
         anchors.fill: parent
         frameVisible: false
 
-        Flickable {
-            id: flickable
-            contentWidth: layout.width
-            contentHeight: layout.height
+        Default.QuickMessagesLayout {
+            id: layout
+            session: root.session
 
-            function shouldKeepEnd() {
-                return Math.abs((contentY + height - contentHeight) / height) < 0.25;
-            }
-
-            function moveToEnd() {
-                var newContentY = Math.max(0, contentHeight - height);
-                if (contentY !== newContentY)
-                    contentY = newContentY;
-            }
+            messageComponent: Message {}
+            actionComponent: ActionMessage {}
+            serviceComponent: ServiceMessage {}
 
-            onContentHeightChanged: if (shouldKeepEnd()) moveToEnd()
             onContentYChanged: hoverDelay.restart()
 
-            QuickMessagesLayout {
-                id: layout
-                width: scrollView.viewport.width
-                session: root.session
-
-                messageComponent: Message {}
-                actionComponent: ActionMessage {}
-                serviceComponent: ServiceMessage {}
-            }
-
             Timer {
                 id: hoverDelay
                 interval: 200
@@ -25,7 +25,7 @@ MessageBase {
         readonly property string timeText: Qt.formatDateTime(message.time, '[hh:mm:ss]')
         readonly property string timeColor: {
             var incoming = message.incoming;
-            var success = messageReceipts[message.id];
+            var success = root.delivered;
             var history = message.property("history", false);
             var color = undefined;
             if (history)
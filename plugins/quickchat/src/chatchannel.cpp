@@ -84,6 +84,7 @@ void ChatChannel::markRead(quint64 id)
 		m_unread.clear();
 		emit unreadChanged(m_unread);
 		emit unreadCountChanged(m_unread.count());
+		emit unreadMarked(id);
 		return;
 	}
 	for (int i = 0; i < m_unread.size(); ++i) {
@@ -91,6 +92,7 @@ void ChatChannel::markRead(quint64 id)
 			m_unread.removeAt(i);
 			emit unreadChanged(m_unread);
 			emit unreadCountChanged(m_unread.count());
+			emit unreadMarked(id);
 			return;
 		}
 	}
@@ -101,9 +103,20 @@ qutim_sdk_0_3::MessageList ChatChannel::unread() const
 	return m_unread;
 }
 
-int ChatChannel::unreadCount() const
+void ChatChannel::virtual_hook(int id, void *data)
 {
-	return m_unread.count();
+	switch (id) {
+	case UnreadCountHook:
+		*reinterpret_cast<int*>(data) = m_unread.count();
+		break;
+	case UnreadRangeHook: {
+		UnreadRangeArgument &argument = *reinterpret_cast<UnreadRangeArgument*>(data);
+		argument.messages = m_unread.mid(argument.offset, argument.count);
+		break;
+	}
+	default:
+		ChatSession::virtual_hook(id, data);
+	}
 }
 
 void ChatChannel::addContact(qutim_sdk_0_3::Buddy *c)
@@ -146,6 +159,7 @@ void ChatChannel::close()
 
 void ChatChannel::clear()
 {
+	m_model->clear();
 	emit clearRequested();
 }
 
@@ -276,6 +290,9 @@ void ChatChannel::doAppendMessage(qutim_sdk_0_3::Message &message)
 	if (!message.property("silent", false) && !isActive())
 		Notification::send(message);
 
+	// Topic is shown by the view separately from the messages
+	if (!message.property("topic", false))
+		m_model->append(message);
 	emit messageAppended(message);
 	return;
 }
@@ -38,7 +38,6 @@ class ChatChannel : public qutim_sdk_0_3::ChatSession
 {
 	Q_OBJECT
 	Q_PROPERTY(qutim_sdk_0_3::ChatUnit* unit READ unit WRITE setChatUnit NOTIFY unitChanged)
-	Q_PROPERTY(int unreadCount READ unreadCount NOTIFY unreadCountChanged)
 	Q_PROPERTY(QObject *page READ page WRITE setPage NOTIFY pageChanged)
 	Q_PROPERTY(QObject* model READ model CONSTANT)
 	Q_PROPERTY(QObject* units READ units CONSTANT)
@@ -52,7 +51,6 @@ public:
 	virtual QTextDocument *getInputField();
 	virtual void markRead(quint64 id);
 	virtual qutim_sdk_0_3::MessageList unread() const;
-	int unreadCount() const;
 	virtual void addContact(qutim_sdk_0_3::Buddy *c);
 	virtual void removeContact(qutim_sdk_0_3::Buddy *c);
 	QObject *model() const;
@@ -87,12 +85,12 @@ protected:
 	virtual void doSetActive(bool active);
 	void connectNotify(const QMetaMethod &signal);
 	void disconnectNotify(const QMetaMethod &signal);
+	virtual void virtual_hook(int id, void *data);
 
 signals:
 	void javaScriptRequest(const QString &script);
 	void messageAppended(const qutim_sdk_0_3::Message &message);
 	void unitChanged(qutim_sdk_0_3::ChatUnit *unit);
-	void unreadCountChanged(int);
 	void pageChanged(QObject *page);
 	void appendTextRequested(const QString &text);
 	void appendNickRequested(const QString &nick);
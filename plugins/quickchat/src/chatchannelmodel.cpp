@@ -62,7 +62,7 @@ QVariant ChatChannelModel::data(const QModelIndex &index, int role) const
 	case ChannelRole:
 		return qVariantFromValue<QObject*>(session);
 	case UnreadCountRole:
-		return session->unread().count();
+		return session->unreadCount();
 	default:
 		return QVariant();
 	}
@@ -82,6 +82,8 @@ void ChatChannelModel::onSessionCreated(qutim_sdk_0_3::ChatSession *session)
 {
 	connect(session, SIGNAL(destroyed(QObject*)),
 			SLOT(onSessionDeath(QObject*)));
+	connect(session, SIGNAL(unreadCountChanged(int)),
+			SLOT(onSessionUnreadChanged()));
 	beginInsertRows(QModelIndex(), m_sessions.size(), m_sessions.size());
 	m_sessions << session;
 	endInsertRows();
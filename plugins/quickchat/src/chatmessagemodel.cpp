@@ -29,7 +29,10 @@
 #include <qutim/chatunit.h>
 #include <qutim/chatsession.h>
 #include <qutim/conference.h>
+#include <qutim/history.h>
+#include <qutim/config.h>
 #include <QDateTime>
+#include <QLocale>
 
 namespace QuickChat
 {
@@ -47,82 +50,252 @@ enum {
 	HtmlRole,
 	ActionRole,
 	ServiceRole,
-	AppendingRole
+	AppendingRole,
+	TimeStringRole,
+	SenderColorRole,
+	MessageRole
 };
 
 ChatMessageModel::ChatMessageModel(QObject *parent) :
-	QAbstractListModel(parent)
+	QAbstractListModel(parent), m_memory(0), m_canLoadOlder(true), m_loading(false)
 {
 	parent->installEventFilter(this);
+	Config config(QStringLiteral("appearance"));
+	config.beginGroup(QStringLiteral("chat/history"));
+	m_capacity = qMax(1, config.value(QStringLiteral("maxModelRows"), 500));
+	m_pageSize = qMax(1, config.value(QStringLiteral("pageSize"), 50));
+	m_limit = m_capacity;
 }
 
 void ChatMessageModel::append(qutim_sdk_0_3::Message &msg)
 {
-	beginInsertRows(QModelIndex(), m_messages.size(), m_messages.size());
-	m_messages << msg;
+	Item item = createItem(msg);
+	if (!m_items.isEmpty())
+		item.appending = isAppending(m_items.last(), item);
+	beginInsertRows(QModelIndex(), m_items.size(), m_items.size());
+	m_items << item;
+	m_memory += itemSize(item);
 	endInsertRows();
+	if (m_items.size() > m_limit) {
+		trim(m_limit);
+		setCanLoadOlder(true);
+	}
+	emit memoryUsageChanged(m_memory);
+}
+
+void ChatMessageModel::clear()
+{
+	beginResetModel();
+	m_items.clear();
+	m_memory = 0;
+	m_limit = m_capacity;
+	endResetModel();
+	setCanLoadOlder(true);
+	emit memoryUsageChanged(m_memory);
 }
 
 bool ChatMessageModel::eventFilter(QObject *obj, QEvent *ev)
 {
 	if (ev->type() == MessageReceiptEvent::eventType()) {
 		MessageReceiptEvent *event = static_cast<MessageReceiptEvent*>(ev);
+		// Receipts come for recent messages, so look from the end
+		for (int i = m_items.size() - 1; i >= 0; --i) {
+			if (m_items.at(i).id == event->id()) {
+				m_items[i].delivered = event->success() ? 1 : 0;
+				const QModelIndex index = createIndex(i, 0);
+				emit dataChanged(index, index, QVector<int>() << DeliveredRole);
+				break;
+			}
+		}
 	}
 	return QAbstractListModel::eventFilter(obj, ev);
 }
 
+bool ChatMessageModel::canLoadOlder() const
+{
+	return m_canLoadOlder;
+}
+
+qint64 ChatMessageModel::memoryUsage() const
+{
+	return m_memory;
+}
+
+void ChatMessageModel::loadOlder()
+{
+	ChatSession *session = qobject_cast<ChatSession*>(QObject::parent());
+	QPointer<ChatUnit> unit = session ? session->unit() : 0;
+	if (m_loading || !m_canLoadOlder || !unit || !History::instance())
+		return;
+	const QDateTime to = m_items.isEmpty() ? QDateTime::currentDateTime() : m_items.first().time;
+	m_loading = true;
+	History::instance()->read(unit, to, m_pageSize).connect(this, [this, unit] (const MessageList &messages) {
+		m_loading = false;
+		if (messages.size() < m_pageSize)
+			setCanLoadOlder(false);
+		if (messages.isEmpty())
+			return;
+		QList<Item> items;
+		items.reserve(messages.size());
+		qint64 memory = 0;
+		foreach (Message message, messages) {
+			if (!message.chatUnit())
+				message.setChatUnit(unit);
+			if (!message.chatUnit())
+				continue;
+			Item item = createItem(message);
+			if (!items.isEmpty())
+				item.appending = isAppending(items.last(), item);
+			memory += itemSize(item);
+			items << item;
+		}
+		if (items.isEmpty())
+			return;
+		const int boundary = items.size();
+		beginInsertRows(QModelIndex(), 0, boundary - 1);
+		items += m_items;
+		m_items.swap(items);
+		m_memory += memory;
+		m_limit += boundary;
+		endInsertRows();
+		if (boundary < m_items.size()) {
+			Item &first = m_items[boundary];
+			first.appending = isAppending(m_items.at(boundary - 1), first);
+			const QModelIndex index = createIndex(boundary, 0);
+			emit dataChanged(index, index, QVector<int>() << AppendingRole);
+		}
+		emit memoryUsageChanged(m_memory);
+	});
+}
+
+void ChatMessageModel::releaseOlder()
+{
+	m_limit = m_capacity;
+	if (m_items.size() > m_limit) {
+		trim(m_limit);
+		setCanLoadOlder(true);
+		emit memoryUsageChanged(m_memory);
+	}
+}
+
+void ChatMessageModel::trim(int limit)
+{
+	const int count = m_items.size() - limit;
+	if (count <= 0)
+		return;
+	beginRemoveRows(QModelIndex(), 0, count - 1);
+	for (int i = 0; i < count; ++i)
+		m_memory -= itemSize(m_items.takeFirst());
+	endRemoveRows();
+	if (!m_items.isEmpty() && m_items.first().appending) {
+		m_items.first().appending = false;
+		const QModelIndex index = createIndex(0, 0);
+		emit dataChanged(index, index, QVector<int>() << AppendingRole);
+	}
+}
+
+void ChatMessageModel::setCanLoadOlder(bool canLoadOlder)
+{
+	if (m_canLoadOlder != canLoadOlder) {
+		m_canLoadOlder = canLoadOlder;
+		emit canLoadOlderChanged(canLoadOlder);
+	}
+}
+
+ChatMessageModel::Item ChatMessageModel::createItem(const Message &msg) const
+{
+	Item item;
+	item.id = msg.id();
+	item.time = msg.time();
+	if (item.time.date() == QDate::currentDate())
+		item.timeString = QLocale().toString(item.time.time(), QLocale::ShortFormat);
+	else
+		item.timeString = QLocale().toString(item.time, QLocale::ShortFormat);
+	item.text = msg.text();
+	item.html = msg.html();
+	item.senderName = createSenderName(msg);
+	item.senderColor = QColor::fromHsv(qHash(item.senderName) % 360, 160, 180);
+	item.unit = msg.chatUnit();
+	item.message = msg;
+	item.incoming = msg.isIncoming();
+	item.action = msg.property("action", false);
+	item.service = msg.property("service", false);
+	item.delivered = -1;
+	item.appending = false;
+	return item;
+}
+
+bool ChatMessageModel::isAppending(const Item &prev, const Item &item)
+{
+	// Same rule as grouping of messages by the chat styles
+	return !prev.service && !item.service
+			&& prev.message.isSimiliar(item.message);
+}
+
+qint64 ChatMessageModel::itemSize(const Item &item)
+{
+	return sizeof(Item) + sizeof(QChar) * (item.timeString.size() + item.text.size()
+										   + item.html.size() + item.senderName.size());
+}
+
 int ChatMessageModel::rowCount(const QModelIndex &parent) const
 {
 	Q_UNUSED(parent);
-	return m_messages.size();
+	return m_items.size();
 }
 
 QVariant ChatMessageModel::data(const QModelIndex &index, int role) const
 {
-	if (index.row() < 0 || index.row() >= m_messages.size())
+	if (index.row() < 0 || index.row() >= m_items.size())
 		return QVariant();
-	const Message &msg = m_messages[index.row()];
+	const Item &item = m_items.at(index.row());
 	switch (role) {
 	case IdRole:
-		return msg.id();
+		return item.id;
 	case TitleRole:
 	case Qt::DisplayRole:
-		return msg.text();
+		return item.text;
 	case AccountAvatarRole: {
-		QString avatar = msg.chatUnit()->account()->property("avatar").toString();
+		if (!item.unit)
+			return QString();
+		QString avatar = item.unit->account()->property("avatar").toString();
 		if (!avatar.isEmpty())
 			return QUrl::fromLocalFile(avatar);
 		return QString();
 	}
 	case SenderAvatarRole:
 	case Qt::DecorationRole: {
-		QString avatar = msg.chatUnit()->property("avatar").toString();
+		if (!item.unit)
+			return QString();
+		QString avatar = item.unit->property("avatar").toString();
 		if (!avatar.isEmpty())
 			return QUrl::fromLocalFile(avatar);
 		return QString();
 	}
 	case TimeRole:
-		return msg.time();
+		return item.time;
+	case TimeStringRole:
+		return item.timeString;
+	case IncomingRole:
+		return item.incoming;
 	case UnitRole:
-		return qVariantFromValue<QObject*>(msg.chatUnit());
+		return qVariantFromValue<QObject*>(item.unit.data());
 	case SenderNameRole:
-		return createSenderName(msg);
+		return item.senderName;
+	case SenderColorRole:
+		return item.senderColor;
 	case DeliveredRole:
-		return false;
+		return item.delivered < 0 ? QVariant() : QVariant(item.delivered > 0);
 	case HtmlRole:
-		return msg.property("html");
+		return item.html;
 	case ActionRole:
-		return msg.property("action", false);
+		return item.action;
 	case ServiceRole:
-		return msg.property("service", false);
+		return item.service;
 	case AppendingRole:
-		if (index.row() > 0) {
-			const Message &prev = m_messages[index.row() - 1];
-			return prev.isIncoming() == msg.isIncoming()
-					&& prev.time().date() == msg.time().date()
-					&& createSenderName(prev) == createSenderName(msg);
-		}
-		return false;
+		return item.appending;
+	case MessageRole:
+		return qVariantFromValue(item.message);
 	default:
 		return QVariant();
 	}
@@ -133,12 +306,14 @@ QHash<int, QByteArray> ChatMessageModel::roleNames() const
 	QHash<int, QByteArray> roleNames;
 	roleNames.insert(IdRole, "messageId");
 	roleNames.insert(SenderNameRole, "senderName");
+	roleNames.insert(SenderColorRole, "senderColor");
 	roleNames.insert(SenderAvatarRole, "senderAvatar");
 	roleNames.insert(AccountAvatarRole, "accountAvatar");
 	roleNames.insert(TitleRole, "title");
 	roleNames.insert(Qt::DisplayRole, "text");
 	roleNames.insert(Qt::DecorationRole, "iconSource");
 	roleNames.insert(TimeRole, "time");
+	roleNames.insert(TimeStringRole, "timeString");
 	roleNames.insert(IncomingRole, "incoming");
 	roleNames.insert(UnitRole, "contact");
 	roleNames.insert(DeliveredRole, "delivered");
@@ -146,13 +321,14 @@ QHash<int, QByteArray> ChatMessageModel::roleNames() const
 	roleNames.insert(ActionRole, "action");
 	roleNames.insert(ServiceRole, "service");
 	roleNames.insert(AppendingRole, "appending");
+	roleNames.insert(MessageRole, "message");
 	return roleNames;
 }
 
 QString ChatMessageModel::createSenderName(const Message &msg) const
 {
 	QString senderName = msg.property("senderName",QString());
-	if (senderName.isEmpty()) {
+	if (senderName.isEmpty() && msg.chatUnit()) {
 		if (!msg.isIncoming()) {
 			const Conference *conf = qobject_cast<const Conference*>(msg.chatUnit());
 			if (conf && conf->me())
@@ -166,4 +342,3 @@ QString ChatMessageModel::createSenderName(const Message &msg) const
 	return senderName;
 }
 }
-
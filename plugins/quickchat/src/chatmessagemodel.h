@@ -27,40 +27,81 @@
 #define CHATMESSAGEMODEL_H
 
 #include <QAbstractListModel>
+#include <QPointer>
+#include <QColor>
 #include <qutim/message.h>
 
 namespace QuickChat
 {
+// Keeps only a window of the latest messages of the session, older ones are
+// paged from the history on demand. Everything delegates ask for is computed
+// once per message, so roles are cheap to query.
 class ChatMessageModel : public QAbstractListModel
 {
 	Q_OBJECT
+	Q_PROPERTY(bool canLoadOlder READ canLoadOlder NOTIFY canLoadOlderChanged)
+	Q_PROPERTY(qint64 memoryUsage READ memoryUsage NOTIFY memoryUsageChanged)
 public:
 	explicit ChatMessageModel(QObject *parent = 0);
 
 	void append(qutim_sdk_0_3::Message &msg);
+	void clear();
 	bool eventFilter(QObject *, QEvent *);
 
+	bool canLoadOlder() const;
+	// Approximate size of the cached rows in bytes
+	qint64 memoryUsage() const;
+
 	// QAbstractListModel
 	virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
 	virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
 	QHash<int, QByteArray> roleNames() const;
 
 signals:
+	void canLoadOlderChanged(bool canLoadOlder);
+	void memoryUsageChanged(qint64 memoryUsage);
 
 public slots:
+	// Prepends the page of messages older than the first row
+	void loadOlder();
+	// Drops paged rows, is called when view returns to the latest messages
+	void releaseOlder();
 
 private:
-	QString createSenderName(const qutim_sdk_0_3::Message &msg) const;
 	struct Item
 	{
-		QString plainText;
-		QString richText;
+		quint64 id;
+		QDateTime time;
+		QString timeString;
+		QString text;
+		QString html;
+		QString senderName;
+		QColor senderColor;
+		QPointer<qutim_sdk_0_3::ChatUnit> unit;
+		// Delegates format the message by themselves
+		qutim_sdk_0_3::Message message;
+		// Receipt of outgoing message, -1 until it's received
+		qint8 delivered;
+		bool incoming;
+		bool action;
+		bool service;
+		bool appending;
 	};
-	QList<Item> m_items;
+	Item createItem(const qutim_sdk_0_3::Message &msg) const;
+	static bool isAppending(const Item &prev, const Item &item);
+	static qint64 itemSize(const Item &item);
+	void trim(int limit);
+	void setCanLoadOlder(bool canLoadOlder);
+	QString createSenderName(const qutim_sdk_0_3::Message &msg) const;
 
-	QList<qutim_sdk_0_3::Message> m_messages;
+	QList<Item> m_items;
+	int m_capacity;
+	int m_pageSize;
+	int m_limit;
+	qint64 m_memory;
+	bool m_canLoadOlder;
+	bool m_loading;
 };
 }
 
 #endif // CHATMESSAGEMODEL_H
-
@@ -25,19 +25,157 @@
 #include <QItemSelection>
 #include <QQmlProperty>
 #include <QElapsedTimer>
+#include <QVarLengthArray>
+#include <algorithm>
 
 namespace QuickChat
 {
 
 
+/*
+	Every node keeps its children's subtree sizes in a Fenwick tree, so offset
+	of any child inside the flat list and the child at some offset are found in
+	O(log n). Mapping of an index is O(depth * log n) instead of linear search,
+	and changes of the source model touch only the affected nodes.
+*/
+struct FlatProxyModel::Node
+{
+	Node() : parent(0), total(0) {}
+	~Node() { qDeleteAll(children); }
+
+	// Node itself and all its descendants
+	int size() const { return total + 1; }
+
+	// Sum of subtree sizes of the first count children
+	int prefix(int count) const
+	{
+		int sum = 0;
+		for (int i = count; i > 0; i -= i & -i)
+			sum += tree.at(i);
+		return sum;
+	}
+
+	void add(int position, int delta)
+	{
+		total += delta;
+		for (int i = position + 1; i < tree.size(); i += i & -i)
+			tree[i] += delta;
+	}
+
+	void rebuild()
+	{
+		const int count = children.size();
+		tree.fill(0, count + 1);
+		total = 0;
+		for (int i = 1; i <= count; ++i) {
+			// Empty slots are left only while children are reordered
+			const Node *child = children.at(i - 1);
+			const int size = child ? child->size() : 0;
+			total += size;
+			tree[i] += size;
+			const int j = i + (i & -i);
+			if (j <= count)
+				tree[j] += tree[i];
+		}
+	}
+
+	// Returns the child whose subtree contains offset, base is its own offset
+	int find(int offset, int *base) const
+	{
+		int position = 0;
+		int sum = 0;
+		int mask = 1;
+		while (mask * 2 < tree.size())
+			mask *= 2;
+		for (; mask > 0; mask /= 2) {
+			const int next = position + mask;
+			if (next < tree.size() && sum + tree.at(next) <= offset) {
+				position = next;
+				sum += tree.at(next);
+			}
+		}
+		*base = sum;
+		return position;
+	}
+
+	Node *parent;
+	QPersistentModelIndex index;
+	QVector<Node*> children;
+	QVector<int> tree;
+	int total;
+};
+
 FlatProxyModel::FlatProxyModel(QObject *parent)
-	: QAbstractProxyModel(parent)
+	: QAbstractProxyModel(parent), m_root(new Node), m_pendingParent(0), m_pendingDestination(0),
+	  m_pendingStart(0), m_pendingEnd(0), m_pendingDestinationStart(0), m_pendingReset(false)
+{
+}
+
+FlatProxyModel::~FlatProxyModel()
 {
+	delete m_root;
 }
 
 void FlatProxyModel::onSourceModelDestroyed()
 {
-	m_sourceIndexList.clear();
+	delete m_root;
+	m_root = new Node;
+}
+
+FlatProxyModel::Node *FlatProxyModel::nodeFor(const QModelIndex &sourceIndex) const
+{
+	if (!sourceIndex.isValid())
+		return m_root;
+	Node *parent = nodeFor(sourceIndex.parent());
+	if (!parent || sourceIndex.row() >= parent->children.size())
+		return 0;
+	return parent->children.at(sourceIndex.row());
+}
+
+FlatProxyModel::Node *FlatProxyModel::createNode(const QModelIndex &sourceIndex, Node *parent)
+{
+	Node *node = new Node;
+	node->parent = parent;
+	node->index = sourceIndex;
+	QAbstractItemModel *m = sourceModel();
+	const int count = m->rowCount(sourceIndex);
+	node->children.reserve(count);
+	for (int row = 0; row < count; ++row) {
+		QModelIndex idx = m->index(row, 0, sourceIndex);
+		if (idx.isValid()) // fail safe
+			node->children.append(createNode(idx, node));
+	}
+	node->rebuild();
+	return node;
+}
+
+int FlatProxyModel::positionOf(const Node *node) const
+{
+	const QVector<Node*> &siblings = node->parent->children;
+	// Source row is right unless the source is in the middle of a change
+	const int row = node->index.row();
+	if (row >= 0 && row < siblings.size() && siblings.at(row) == node)
+		return row;
+	return siblings.indexOf(const_cast<Node*>(node));
+}
+
+int FlatProxyModel::flatRow(const Node *node) const
+{
+	int row = -1;
+	for (; node->parent; node = node->parent)
+		row += 1 + node->parent->prefix(positionOf(node));
+	return row;
+}
+
+int FlatProxyModel::flatEnd(const Node *node) const
+{
+	return flatRow(node) + node->size();
+}
+
+void FlatProxyModel::updateSize(Node *node, int delta)
+{
+	for (; node->parent; node = node->parent)
+		node->parent->add(positionOf(node), delta);
 }
 
 void FlatProxyModel::onSourceDataChanged(const QModelIndex &source_top_left,
@@ -61,13 +199,207 @@ void FlatProxyModel::onSourceReset()
 
 void FlatProxyModel::onSourceLayoutAboutToBeChanged()
 {
-	emit layoutAboutToBeChanged();
+	// Nodes keep persistent indexes, so they follow the items by themselves
+}
+
+bool FlatProxyModel::isConsistent(const Node *node) const
+{
+	if (sourceModel()->rowCount(node->index) != node->children.size())
+		return false;
+	foreach (const Node *child, node->children) {
+		if (!child->index.isValid() || child->index.parent() != node->index)
+			return false;
+		if (!isConsistent(child))
+			return false;
+	}
+	return true;
+}
+
+void FlatProxyModel::applyLayout(Node *node)
+{
+	const int count = node->children.size();
+	QVector<int> targets(count);
+	bool sorted = true;
+	for (int i = 0; i < count; ++i) {
+		targets[i] = node->children.at(i)->index.row();
+		if (i > 0 && targets[i] < targets[i - 1])
+			sorted = false;
+	}
+
+	if (!sorted)
+		reorderChildren(node, targets);
+
+	foreach (Node *child, node->children)
+		applyLayout(child);
+}
+
+void FlatProxyModel::reorderChildren(Node *node, const QVector<int> &targets)
+{
+	// Children of the longest increasing subsequence stay in place,
+	// all others are moved, which is the minimal set of moves
+	const int count = targets.size();
+	QVector<int> tails;
+	QVector<int> previous(count, -1);
+	for (int i = 0; i < count; ++i) {
+		const int index = std::lower_bound(tails.constBegin(), tails.constEnd(), targets.at(i),
+										   [&targets] (int tail, int target) {
+			return targets.at(tail) < target;
+		}) - tails.constBegin();
+		if (index > 0)
+			previous[i] = tails.at(index - 1);
+		if (index == tails.size())
+			tails.append(i);
+		else
+			tails[index] = i;
+	}
+	QVector<int> placed;
+	for (int i = tails.isEmpty() ? -1 : tails.last(); i >= 0; i = previous.at(i))
+		placed.append(i);
+	std::reverse(placed.begin(), placed.end());
+
+	// Moved child is inserted before the first placed child with greater
+	// target. Every child gets both its old slot (position, 1) and the new one
+	// (successor, 0, target) in a single order, so the Fenwick tree over the
+	// slots gives flat rows of every intermediate state and the children
+	// vector is rebuilt only once.
+	struct Slot
+	{
+		int position;
+		int kind;
+		int target;
+		bool operator <(const Slot &o) const
+		{
+			if (position != o.position)
+				return position < o.position;
+			if (kind != o.kind)
+				return kind < o.kind;
+			return target < o.target;
+		}
+	};
+	QVector<int> moving;
+	QVector<int> successors;
+	QVector<Slot> slots;
+	slots.reserve(2 * count);
+	for (int i = 0, next = 0; i < count; ++i) {
+		if (next < placed.size() && placed.at(next) == i) {
+			++next;
+		} else {
+			const int successor = std::upper_bound(placed.constBegin(), placed.constEnd(), targets.at(i),
+												   [&targets] (int target, int position) {
+				return target < targets.at(position);
+			}) - placed.constBegin();
+			moving.append(i);
+			successors.append(successor < placed.size() ? placed.at(successor) : count);
+			slots.append(Slot { successors.last(), 0, targets.at(i) });
+		}
+		slots.append(Slot { i, 1, 0 });
+	}
+	std::sort(slots.begin(), slots.end());
+	QVector<int> oldSlots(count);
+	QVector<int> newSlots(count);
+	for (int i = 0; i < slots.size(); ++i) {
+		if (slots.at(i).kind == 1)
+			oldSlots[slots.at(i).position] = i;
+	}
+	for (int i = 0; i < moving.size(); ++i) {
+		const Slot slot = { successors.at(i), 0, targets.at(moving.at(i)) };
+		newSlots[moving.at(i)] = std::lower_bound(slots.constBegin(), slots.constEnd(), slot) - slots.constBegin();
+	}
+
+	QVector<Node*> children(slots.size(), 0);
+	for (int i = 0; i < count; ++i)
+		children[oldSlots.at(i)] = node->children.at(i);
+	node->children.swap(children);
+	node->rebuild();
+
+	std::sort(moving.begin(), moving.end(), [&targets] (int a, int b) {
+		return targets.at(a) < targets.at(b);
+	});
+	const int base = flatRow(node) + 1;
+	for (int first = 0; first < moving.size(); ) {
+		// Adjacent children going to adjacent slots are moved at once
+		int last = first;
+		while (last + 1 < moving.size()
+			   && newSlots.at(moving.at(last + 1)) == newSlots.at(moving.at(last)) + 1
+			   && oldSlots.at(moving.at(last + 1)) > oldSlots.at(moving.at(last))
+			   && node->prefix(oldSlots.at(moving.at(last + 1)))
+			   == node->prefix(oldSlots.at(moving.at(last)) + 1)) {
+			++last;
+		}
+		const int from = oldSlots.at(moving.at(first));
+		const int to = oldSlots.at(moving.at(last)) + 1;
+		const int destination = newSlots.at(moving.at(first));
+		const int between = destination > from
+				? node->prefix(destination) - node->prefix(to)
+				: node->prefix(from) - node->prefix(destination);
+		if (between > 0) {
+			beginMoveRows(QModelIndex(), base + node->prefix(from), base + node->prefix(to) - 1,
+						  QModelIndex(), base + node->prefix(destination));
+		}
+		for (int i = first; i <= last; ++i) {
+			const int child = moving.at(i);
+			Node *moved = node->children.at(oldSlots.at(child));
+			node->add(oldSlots.at(child), -moved->size());
+			node->children[oldSlots.at(child)] = 0;
+			node->children[newSlots.at(child)] = moved;
+			node->add(newSlots.at(child), moved->size());
+		}
+		if (between > 0)
+			endMoveRows();
+		first = last + 1;
+	}
+
+	node->children.removeAll(0);
+	node->rebuild();
+}
+
+void FlatProxyModel::onSourceLayoutChanged(const QList<QPersistentModelIndex> &parents,
+										   QAbstractItemModel::LayoutChangeHint hint)
+{
+	// Columns are not reordered by the proxy
+	if (hint == QAbstractItemModel::HorizontalSortHint)
+		return;
+	// Sorting only reorders siblings, their number and parents are the same
+	const bool sorting = hint == QAbstractItemModel::VerticalSortHint;
+
+	if (parents.isEmpty()) {
+		if (!sorting && !isConsistent(m_root))
+			resetLayout();
+		else
+			applyLayout(m_root);
+		return;
+	}
+
+	// Only subtrees of the parents were changed (QStandardItem sorts
+	// grandchildren too, but lists only the top parent). Nodes are looked up
+	// by source rows, so upper parents are rearranged before the lower ones
+	QVector<QPair<int, QModelIndex> > nodes;
+	foreach (const QPersistentModelIndex &parent, parents) {
+		int depth = 0;
+		for (QModelIndex index = parent; index.isValid(); index = index.parent())
+			++depth;
+		nodes.append(qMakePair(depth, QModelIndex(parent)));
+	}
+	std::stable_sort(nodes.begin(), nodes.end(), [] (const QPair<int, QModelIndex> &a,
+													 const QPair<int, QModelIndex> &b) {
+		return a.first < b.first;
+	});
+	for (int i = 0; i < nodes.size(); ++i) {
+		Node *node = nodeFor(nodes.at(i).second);
+		if (!node || (!sorting && !isConsistent(node))) {
+			resetLayout();
+			return;
+		}
+		applyLayout(node);
+	}
 }
 
-void FlatProxyModel::onSourceLayoutChanged()
+void FlatProxyModel::resetLayout()
 {
+	// Items have changed their parents, there is no cheap way to describe it
+	beginResetModel();
 	initiateMaps();
-	emit layoutChanged();
+	endResetModel();
 }
 
 void FlatProxyModel::onSourceRowsAboutToBeInserted(const QModelIndex &source_parent, int start, int end)
@@ -79,42 +411,46 @@ void FlatProxyModel::onSourceRowsAboutToBeInserted(const QModelIndex &source_par
 
 void FlatProxyModel::onSourceRowsInserted(const QModelIndex &source_parent, int start, int end)
 {
-	Q_UNUSED(source_parent);
-	Q_UNUSED(start);
-	Q_UNUSED(end);
+	Node *parent = nodeFor(source_parent);
+	if (!parent || start > parent->children.size()) {
+		onSourceReset();
+		return;
+	}
 
-	QVector<QPersistentModelIndex> sourceIndexList = m_sourceIndexList;
-	initiateMaps();
-	qSwap(m_sourceIndexList, sourceIndexList);
-
-	auto firstMismatch = std::mismatch(
-		m_sourceIndexList.begin(),
-		m_sourceIndexList.end(),
-		sourceIndexList.begin()
-	).first;
-	int localStart = firstMismatch - m_sourceIndexList.begin();
-	int localEnd = sourceIndexList.size() - 1;
-	if (firstMismatch != m_sourceIndexList.end()) {
-		localEnd = sourceIndexList.indexOf(*firstMismatch) - 1;
-		Q_ASSERT(localEnd >= 0);
-		Q_ASSERT(localStart <= localEnd);
-	}
-
-	beginInsertRows(QModelIndex(), localStart, localEnd);
-	m_sourceIndexList = sourceIndexList;
+	QVector<Node*> nodes;
+	int count = 0;
+	for (int row = start; row <= end; ++row) {
+		Node *node = createNode(sourceModel()->index(row, 0, source_parent), parent);
+		count += node->size();
+		nodes.append(node);
+	}
+
+	const int localStart = start < parent->children.size()
+			? flatRow(parent->children.at(start))
+			: flatEnd(parent);
+	beginInsertRows(QModelIndex(), localStart, localStart + count - 1);
+	parent->children.insert(start, nodes.size(), 0);
+	for (int i = 0; i < nodes.size(); ++i)
+		parent->children[start + i] = nodes.at(i);
+	parent->rebuild();
+	updateSize(parent, count);
 	endInsertRows();
 }
 
 void FlatProxyModel::onSourceRowsAboutToBeRemoved(const QModelIndex &sourceParent, int start, int end)
 {
-	QModelIndex startIndex = sourceModel()->index(start, 0, sourceParent);
-	QModelIndex endIndex = sourceModel()->index(end, 0, sourceParent);
-	while (sourceModel()->hasChildren(endIndex)) {
-		int count = sourceModel()->rowCount(endIndex);
-		endIndex = sourceModel()->index(count - 1, 0, endIndex);
+	Node *parent = nodeFor(sourceParent);
+	m_pendingReset = !parent || end >= parent->children.size();
+	if (m_pendingReset) {
+		beginResetModel();
+		return;
 	}
-
-	beginRemoveRows(QModelIndex(), mapFromSource(startIndex).row(), mapFromSource(endIndex).row());
+	m_pendingParent = parent;
+	m_pendingStart = start;
+	m_pendingEnd = end;
+	const int localStart = flatRow(parent->children.at(start));
+	const int localEnd = flatEnd(parent->children.at(end)) - 1;
+	beginRemoveRows(QModelIndex(), localStart, localEnd);
 }
 
 void FlatProxyModel::onSourceRowsRemoved(const QModelIndex &source_parent, int start, int end)
@@ -123,18 +459,46 @@ void FlatProxyModel::onSourceRowsRemoved(const QModelIndex &source_parent, int s
 	Q_UNUSED(start);
 	Q_UNUSED(end);
 
-	initiateMaps();
+	if (m_pendingReset) {
+		m_pendingReset = false;
+		initiateMaps();
+		endResetModel();
+		return;
+	}
+	Node *parent = m_pendingParent;
+	const int count = m_pendingEnd - m_pendingStart + 1;
+	const int total = parent->total;
+	qDeleteAll(parent->children.begin() + m_pendingStart, parent->children.begin() + m_pendingStart + count);
+	parent->children.remove(m_pendingStart, count);
+	parent->rebuild();
+	updateSize(parent, parent->total - total);
+	m_pendingParent = 0;
 	endRemoveRows();
 }
 
 void FlatProxyModel::onSourceRowsAboutToBeMoved(const QModelIndex &source_parent, int start, int end, const QModelIndex &destParent, int destStart)
 {
-	Q_UNUSED(source_parent);
-	Q_UNUSED(start);
-	Q_UNUSED(end);
-	Q_UNUSED(destParent);
-	Q_UNUSED(destStart);
-	beginResetModel();
+	Node *parent = nodeFor(source_parent);
+	Node *destination = nodeFor(destParent);
+	m_pendingReset = !parent || !destination || end >= parent->children.size()
+			|| destStart > destination->children.size();
+	if (!m_pendingReset) {
+		const int localStart = flatRow(parent->children.at(start));
+		const int localEnd = flatEnd(parent->children.at(end)) - 1;
+		const int localDestination = destStart < destination->children.size()
+				? flatRow(destination->children.at(destStart))
+				: flatEnd(destination);
+		m_pendingReset = !beginMoveRows(QModelIndex(), localStart, localEnd, QModelIndex(), localDestination);
+	}
+	if (m_pendingReset) {
+		beginResetModel();
+		return;
+	}
+	m_pendingParent = parent;
+	m_pendingDestination = destination;
+	m_pendingStart = start;
+	m_pendingEnd = end;
+	m_pendingDestinationStart = destStart;
 }
 
 void FlatProxyModel::onSourceRowsMoved(const QModelIndex &source_parent, int start, int end, const QModelIndex &destParent, int destStart)
@@ -144,8 +508,38 @@ void FlatProxyModel::onSourceRowsMoved(const QModelIndex &source_parent, int sta
 	Q_UNUSED(end);
 	Q_UNUSED(destParent);
 	Q_UNUSED(destStart);
-	initiateMaps();
-	endResetModel();
+
+	if (m_pendingReset) {
+		m_pendingReset = false;
+		initiateMaps();
+		endResetModel();
+		return;
+	}
+	Node *parent = m_pendingParent;
+	Node *destination = m_pendingDestination;
+	const int count = m_pendingEnd - m_pendingStart + 1;
+	QVector<Node*> nodes = parent->children.mid(m_pendingStart, count);
+	int size = 0;
+	foreach (const Node *node, nodes)
+		size += node->size();
+
+	parent->children.remove(m_pendingStart, count);
+	parent->rebuild();
+	updateSize(parent, -size);
+
+	int position = m_pendingDestinationStart;
+	if (parent == destination && position > m_pendingStart)
+		position -= count;
+	destination->children.insert(position, count, 0);
+	for (int i = 0; i < count; ++i) {
+		nodes.at(i)->parent = destination;
+		destination->children[position + i] = nodes.at(i);
+	}
+	destination->rebuild();
+	updateSize(destination, size);
+	m_pendingParent = 0;
+	m_pendingDestination = 0;
+	endMoveRows();
 }
 
 void FlatProxyModel::setSourceModel(QAbstractItemModel *model)
@@ -240,7 +634,7 @@ QModelIndex FlatProxyModel::parent(const QModelIndex &child) const
 
 int FlatProxyModel::rowCount(const QModelIndex &parent) const
 {
-	return parent.isValid() ? 0 : m_sourceIndexList.count();
+	return parent.isValid() ? 0 : m_root->total;
 }
 
 int FlatProxyModel::columnCount(const QModelIndex &parent) const
@@ -398,11 +792,11 @@ bool FlatProxyModel::removeRows(int row, int count, const QModelIndex &parent)
 
 QVariantMap FlatProxyModel::rowData(int row)
 {
-	if (row < 0 || row >= m_sourceIndexList.size())
+	if (row < 0 || row >= m_root->total)
 		return QVariantMap();
 
 	QVariantMap data;
-	const QModelIndex index = m_sourceIndexList[row];
+	const QModelIndex index = mapToSource(this->index(row, 0));
 	for (auto it = m_roleNames.constBegin(); it != m_roleNames.constEnd(); ++it) {
 		data.insert(it.value(), index.data(it.key()));
 	}
@@ -432,8 +826,20 @@ QModelIndex FlatProxyModel::mapToSource(const QModelIndex &proxyIndex) const
 	if (! proxyIndex.isValid()) {
 		return QModelIndex();
 	}
-	QModelIndex source_index = m_sourceIndexList.value(proxyIndex.row());
-	if (proxyIndex.column() != 0) {
+	QModelIndex source_index;
+	const Node *node = m_root;
+	int offset = proxyIndex.row();
+	while (offset >= 0 && offset < node->total) {
+		int base;
+		node = node->children.at(node->find(offset, &base));
+		offset -= base;
+		if (offset == 0) {
+			source_index = node->index;
+			break;
+		}
+		--offset;
+	}
+	if (source_index.isValid() && proxyIndex.column() != 0) {
 		source_index = sourceModel()->index(source_index.row(), proxyIndex.column(), source_index.parent());
 	}
 	//qDebug()<<proxyIndex<<"->"<<source_index;
@@ -451,12 +857,18 @@ QModelIndex FlatProxyModel::mapFromSource(const QModelIndex &sourceIndex) const
 	if (! sourceIndex.isValid()) {
 		return QModelIndex();
 	}
-	QPersistentModelIndex idx = sourceIndex;
-	if (idx.column() != 0) {
-		// we only map indices with column 0
-		idx = sourceModel()->index(idx.row(), 0, idx.parent());
+	QVarLengthArray<int, 8> rows;
+	for (QModelIndex idx = sourceIndex; idx.isValid(); idx = idx.parent())
+		rows.append(idx.row());
+	int row = -1;
+	const Node *node = m_root;
+	for (int i = rows.size() - 1; i >= 0; --i) {
+		if (rows.at(i) >= node->children.size())
+			return QModelIndex();
+		row += 1 + node->prefix(rows.at(i));
+		node = node->children.at(rows.at(i));
 	}
-	QModelIndex proxy_index = index(m_sourceIndexList.indexOf(idx), sourceIndex.column());
+	QModelIndex proxy_index = index(row, sourceIndex.column());
 	//qDebug()<<sourceIndex<<"->"<<proxy_index;
 	return proxy_index;
 }
@@ -478,25 +890,28 @@ void FlatProxyModel::initiateMaps()
 
 void FlatProxyModel::initiateMaps(const QModelIndex &sourceParent)
 {
-	if (! sourceParent.isValid()) {
-		m_sourceIndexList.clear();
+	Node *node = nodeFor(sourceParent);
+	if (!node || node == m_root) {
+		delete m_root;
+		m_root = new Node;
+		node = m_root;
+	} else {
+		qDeleteAll(node->children);
+		node->children.clear();
 	}
 	QAbstractItemModel *m = sourceModel();
 	if (m == 0) {
 		qDebug() << "No source model";
 		return;
 	}
-	int count = m->rowCount(sourceParent);
-	for (int row = 0; row < count; ++row) {
-		QPersistentModelIndex idx = m->index(row, 0, sourceParent);
-		//qDebug()<<"map:"<<sourceParent<<row<<idx;
-		if (idx.isValid()) { // fail safe
-			m_sourceIndexList.append(idx);
-
-			initiateMaps(idx);
-		}
-	}
-	//qDebug()<<"source index list="<<m_sourceIndexList;
+	const int total = node->total;
+	Node *built = createNode(node->index, node->parent);
+	node->children.swap(built->children);
+	foreach (Node *child, node->children)
+		child->parent = node;
+	node->rebuild();
+	delete built;
+	updateSize(node, node->total - total);
 }
 
 } // namespace QuickChat
@@ -51,6 +51,7 @@ class FlatProxyModel : public QAbstractProxyModel
 	Q_OBJECT
 public:
 	explicit FlatProxyModel(QObject *parent = 0);
+	~FlatProxyModel();
 
 	virtual QModelIndex mapFromSource(const QModelIndex &sourceIndex)const;
 	virtual QItemSelection mapSelectionFromSource(const QItemSelection &sourceSelection)const;
@@ -90,7 +91,8 @@ public slots:
 	void onSourceReset();
 
 	void onSourceLayoutAboutToBeChanged();
-	void onSourceLayoutChanged();
+	void onSourceLayoutChanged(const QList<QPersistentModelIndex> &parents,
+							   QAbstractItemModel::LayoutChangeHint hint);
 
 	void onSourceRowsAboutToBeInserted(const QModelIndex &source_parent,
 										int start, int end);
@@ -118,9 +120,27 @@ private slots:
 	void onSourceModelDestroyed();
 
 private:
+	struct Node;
+	Node *nodeFor(const QModelIndex &sourceIndex) const;
+	Node *createNode(const QModelIndex &sourceIndex, Node *parent);
+	int positionOf(const Node *node) const;
+	int flatRow(const Node *node) const;
+	int flatEnd(const Node *node) const;
+	void updateSize(Node *node, int delta);
+	bool isConsistent(const Node *node) const;
+	void applyLayout(Node *node);
+	void reorderChildren(Node *node, const QVector<int> &targets);
+	void resetLayout();
+
 	friend class FlatProxyModelData;
-	/// List of sourceIndexes
-	QVector<QPersistentModelIndex> m_sourceIndexList;
+	/// Tree of sourceIndexes, every node knows sizes of its children's subtrees
+	Node *m_root;
+	Node *m_pendingParent;
+	Node *m_pendingDestination;
+	int m_pendingStart;
+	int m_pendingEnd;
+	int m_pendingDestinationStart;
+	bool m_pendingReset;
 	QHash<int, QByteArray> m_roleNames;
 };
 
@@ -0,0 +1,266 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "flatmodel.h"
+#include <QtTest>
+#include <QStandardItemModel>
+#include <QSortFilterProxyModel>
+
+using namespace QuickChat;
+
+enum { StatusRole = Qt::UserRole + 1 };
+
+// Follows the flat model through its signals only, so it shows whether
+// the emitted moves describe the new layout
+class FlatMirror : public QObject
+{
+	Q_OBJECT
+public:
+	FlatMirror(QAbstractItemModel *model) : m_model(model), moves(0), resets(0)
+	{
+		connect(model, &QAbstractItemModel::rowsInserted, this, &FlatMirror::onRowsInserted);
+		connect(model, &QAbstractItemModel::rowsRemoved, this, &FlatMirror::onRowsRemoved);
+		connect(model, &QAbstractItemModel::rowsMoved, this, &FlatMirror::onRowsMoved);
+		connect(model, &QAbstractItemModel::modelReset, this, &FlatMirror::onReset);
+		onReset();
+		resets = 0;
+	}
+
+	QStringList rows;
+	int moves;
+	int resets;
+
+private slots:
+	void onRowsInserted(const QModelIndex &, int first, int last)
+	{
+		for (int row = first; row <= last; ++row)
+			rows.insert(row, m_model->index(row, 0).data().toString());
+	}
+
+	void onRowsRemoved(const QModelIndex &, int first, int last)
+	{
+		rows.erase(rows.begin() + first, rows.begin() + last + 1);
+	}
+
+	void onRowsMoved(const QModelIndex &, int start, int end, const QModelIndex &, int destination)
+	{
+		const QStringList moved = rows.mid(start, end - start + 1);
+		rows.erase(rows.begin() + start, rows.begin() + end + 1);
+		if (destination > end)
+			destination -= moved.size();
+		for (int i = 0; i < moved.size(); ++i)
+			rows.insert(destination + i, moved.at(i));
+		++moves;
+	}
+
+	void onReset()
+	{
+		rows.clear();
+		for (int row = 0; row < m_model->rowCount(); ++row)
+			rows << m_model->index(row, 0).data().toString();
+		++resets;
+	}
+
+private:
+	QAbstractItemModel *m_model;
+};
+
+class FlatModelTest : public QObject
+{
+	Q_OBJECT
+private slots:
+	void sortedProxy();
+	void sortedChildren();
+	void minimalMoves();
+	void statusChurn_data();
+	void statusChurn();
+
+private:
+	static void fill(QStandardItemModel *model, int groups, int contacts);
+	static void churn(QStandardItemModel *model, int count);
+	static QStringList flatten(const QAbstractItemModel *model, const QModelIndex &parent = QModelIndex());
+	static void verify(FlatProxyModel *flat, const FlatMirror &mirror);
+};
+
+void FlatModelTest::fill(QStandardItemModel *model, int groups, int contacts)
+{
+	model->setSortRole(StatusRole);
+	for (int i = 0; i < groups; ++i) {
+		QStandardItem *group = new QStandardItem(QString::fromLatin1("group %1").arg(i));
+		for (int j = 0; j < contacts; ++j) {
+			QStandardItem *contact = new QStandardItem(QString::fromLatin1("contact %1.%2").arg(i).arg(j));
+			contact->setData(qrand() % 6, StatusRole);
+			group->appendRow(contact);
+		}
+		model->appendRow(group);
+	}
+}
+
+void FlatModelTest::churn(QStandardItemModel *model, int count)
+{
+	for (int i = 0; i < count; ++i) {
+		QStandardItem *group = model->item(qrand() % model->rowCount());
+		QStandardItem *contact = group->child(qrand() % group->rowCount());
+		contact->setData(qrand() % 6, StatusRole);
+	}
+}
+
+QStringList FlatModelTest::flatten(const QAbstractItemModel *model, const QModelIndex &parent)
+{
+	QStringList rows;
+	for (int row = 0; row < model->rowCount(parent); ++row) {
+		const QModelIndex index = model->index(row, 0, parent);
+		rows << index.data().toString();
+		rows << flatten(model, index);
+	}
+	return rows;
+}
+
+void FlatModelTest::verify(FlatProxyModel *flat, const FlatMirror &mirror)
+{
+	const QStringList expected = flatten(flat->sourceModel());
+	QCOMPARE(mirror.resets, 0);
+	QCOMPARE(mirror.rows, expected);
+	QCOMPARE(flat->rowCount(), expected.size());
+	for (int row = 0; row < expected.size(); ++row) {
+		const QModelIndex index = flat->index(row, 0);
+		QCOMPARE(index.data().toString(), expected.at(row));
+		QCOMPARE(flat->mapFromSource(flat->mapToSource(index)), index);
+	}
+}
+
+void FlatModelTest::sortedProxy()
+{
+	qsrand(1);
+	QStandardItemModel source;
+	fill(&source, 5, 40);
+	QSortFilterProxyModel sorter;
+	sorter.setDynamicSortFilter(false);
+	sorter.setSortRole(StatusRole);
+	sorter.setSourceModel(&source);
+	sorter.sort(0);
+	FlatProxyModel flat;
+	flat.setSourceModel(&sorter);
+	FlatMirror mirror(&flat);
+
+	for (int i = 0; i < 50; ++i) {
+		churn(&source, 1 + i % 20);
+		sorter.sort(0);
+		verify(&flat, mirror);
+	}
+}
+
+void FlatModelTest::sortedChildren()
+{
+	qsrand(2);
+	QStandardItemModel source;
+	fill(&source, 5, 40);
+	FlatProxyModel flat;
+	flat.setSourceModel(&source);
+	FlatMirror mirror(&flat);
+
+	// QStandardItem reports only the sorted parent
+	for (int i = 0; i < 50; ++i) {
+		churn(&source, 1 + i % 20);
+		source.item(i % source.rowCount())->sortChildren(0);
+		verify(&flat, mirror);
+	}
+	source.sort(0);
+	verify(&flat, mirror);
+}
+
+void FlatModelTest::minimalMoves()
+{
+	QStandardItemModel source;
+	source.setSortRole(StatusRole);
+	QStandardItem *group = new QStandardItem(QLatin1String("group"));
+	for (int i = 0; i < 100; ++i) {
+		QStandardItem *contact = new QStandardItem(QString::number(i));
+		contact->setData(i, StatusRole);
+		group->appendRow(contact);
+	}
+	source.appendRow(group);
+	FlatProxyModel flat;
+	flat.setSourceModel(&source);
+	FlatMirror mirror(&flat);
+
+	group->child(10)->setData(90, StatusRole);
+	group->sortChildren(0);
+	QCOMPARE(mirror.moves, 1);
+	verify(&flat, mirror);
+
+	// Neighbours going to the same place are moved by one signal
+	group->child(20)->setData(-2, StatusRole);
+	group->child(21)->setData(-1, StatusRole);
+	group->sortChildren(0);
+	QCOMPARE(mirror.moves, 2);
+	verify(&flat, mirror);
+}
+
+void FlatModelTest::statusChurn_data()
+{
+	QTest::addColumn<int>("changes");
+	QTest::addColumn<bool>("proxy");
+	QTest::newRow("1 change, sort proxy") << 1 << true;
+	QTest::newRow("100 changes, sort proxy") << 100 << true;
+	QTest::newRow("1 change, sort group") << 1 << false;
+	QTest::newRow("100 changes, sort group") << 100 << false;
+}
+
+void FlatModelTest::statusChurn()
+{
+	QFETCH(int, changes);
+	QFETCH(bool, proxy);
+
+	// 10k contacts in 50 groups
+	qsrand(3);
+	QStandardItemModel source;
+	fill(&source, 50, 200);
+	QSortFilterProxyModel sorter;
+	sorter.setDynamicSortFilter(false);
+	sorter.setSortRole(StatusRole);
+	sorter.setSourceModel(&source);
+	sorter.sort(0);
+	FlatProxyModel flat;
+	flat.setSourceModel(proxy ? static_cast<QAbstractItemModel*>(&sorter) : &source);
+	QCOMPARE(flat.rowCount(), 50 * 201);
+
+	QBENCHMARK {
+		if (proxy) {
+			churn(&source, changes);
+			sorter.sort(0);
+		} else {
+			QStandardItem *group = source.item(qrand() % source.rowCount());
+			for (int i = 0; i < changes; ++i)
+				group->child(qrand() % group->rowCount())->setData(qrand() % 6, StatusRole);
+			group->sortChildren(0);
+		}
+	}
+	QCOMPARE(flat.rowCount(), 50 * 201);
+}
+
+QTEST_MAIN(FlatModelTest)
+
+#include "flatmodeltest.moc"
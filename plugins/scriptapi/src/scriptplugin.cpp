@@ -59,6 +59,13 @@ ScriptMessageHandler::ScriptMessageHandler(ScriptPlugin *parent)
 	m_engine->importExtension(QLatin1String("qt.core"));
 	m_engine->importExtension(QLatin1String("qt.gui"));
 	m_engine->importExtension(QLatin1String("qutim"));
+	m_programs.setMaxCost(100);
+}
+
+ScriptMessageHandler::~ScriptMessageHandler()
+{
+	foreach (const Wrapper &wrapper, m_wrappers)
+		QObject::disconnect(wrapper.connection);
 }
 
 MessageHandler::Result ScriptMessageHandler::doHandle(Message &message, QString *reason)
@@ -71,6 +78,9 @@ MessageHandler::Result ScriptMessageHandler::doHandle(Message &message, QString
 	if (text.size() < command.size() + 2
 			|| !text.startsWith(QLatin1String(command.data()))
 			|| !text.at(command.size()).isSpace()) {
+		// Most of messages have no scripts at all, don't run the regexp for them
+		if (!text.contains(QLatin1String("[[")))
+			return MessageHandler::Accept;
 		static QRegExp regexp("\\[\\[(.*)\\]\\]", Qt::CaseInsensitive);
 		Q_ASSERT(regexp.isValid());
 		int pos = 0;
@@ -80,7 +90,7 @@ MessageHandler::Result ScriptMessageHandler::doHandle(Message &message, QString
 				first = false;
 				openContext(message.chatUnit());
 			}
-			QString result = m_engine->evaluate(regexp.cap(1)).toString();
+			QString result = evaluate(regexp.cap(1)).toString();
 			debug() << regexp.cap(1) << result;
 			text.replace(pos, regexp.matchedLength(), result);
 			pos += result.length();
@@ -97,13 +107,36 @@ MessageHandler::Result ScriptMessageHandler::doHandle(Message &message, QString
 	return MessageHandler::Reject;
 }
 
+QScriptValue ScriptMessageHandler::evaluate(const QString &source)
+{
+	QScriptProgram *program = m_programs.object(source);
+	if (!program) {
+		program = new QScriptProgram(source);
+		m_programs.insert(source, program);
+	}
+	return m_engine->evaluate(*program);
+}
+
+QScriptValue ScriptMessageHandler::wrapper(QObject *object)
+{
+	QHash<QObject*, Wrapper>::iterator it = m_wrappers.find(object);
+	if (it == m_wrappers.end()) {
+		it = m_wrappers.insert(object, Wrapper());
+		it->value = m_engine->newQObject(object);
+		it->connection = QObject::connect(object, &QObject::destroyed, [this, object] () {
+			m_wrappers.remove(object);
+		});
+	}
+	return it->value;
+}
+
 void ScriptMessageHandler::openContext(ChatUnit *unit)
 {
 	QScriptContext *context = m_engine->pushContext();
 	QScriptValue object = context->activationObject();
 	if (ChatSession *session = ChatLayer::get(unit, false))
-		object.setProperty(QLatin1String("session"), m_engine->newQObject(session));
-	object.setProperty(QLatin1String("unit"), m_engine->newQObject(unit));
+		object.setProperty(QLatin1String("session"), wrapper(session));
+	object.setProperty(QLatin1String("unit"), wrapper(unit));
 }
 
 void ScriptMessageHandler::closeContext()
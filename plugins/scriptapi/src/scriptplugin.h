@@ -32,6 +32,8 @@
 #include <QPlainTextEdit>
 #include <QPushButton>
 #include <QScriptEngine>
+#include <QScriptProgram>
+#include <QCache>
 
 using namespace qutim_sdk_0_3;
 
@@ -41,13 +43,26 @@ class ScriptMessageHandler : public qutim_sdk_0_3::MessageHandler
 {
 public:
 	ScriptMessageHandler(ScriptPlugin *parent);
+	~ScriptMessageHandler();
 	virtual Result doHandle(qutim_sdk_0_3::Message &message, QString *reason);
 
 	void openContext(ChatUnit *unit);
 	void closeContext();
 	void handleException();
 private:
+	QScriptValue evaluate(const QString &source);
+	QScriptValue wrapper(QObject *object);
+
+	struct Wrapper
+	{
+		QScriptValue value;
+		QMetaObject::Connection connection;
+	};
+
 	QScriptEngine *m_engine;
+	// Parsed snippets by their source
+	QCache<QString, QScriptProgram> m_programs;
+	QHash<QObject*, Wrapper> m_wrappers;
 };
 
 class ScriptPlugin : public Plugin, public qutim_sdk_0_3::PluginFactory
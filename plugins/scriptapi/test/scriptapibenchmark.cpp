@@ -0,0 +1,164 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "scriptplugin.h"
+#include <qutim/protocol.h>
+#include <qutim/account.h>
+#include <qutim/buddy.h>
+#include <qutim/message.h>
+#include <QtTest>
+
+using namespace qutim_sdk_0_3;
+
+// Sends outgoing messages through the script handler like the chat layer does
+
+class FakeProtocol : public Protocol
+{
+	Q_OBJECT
+	Q_CLASSINFO("Protocol", "fake")
+public:
+	QList<Account*> accounts() const { return QList<Account*>(); }
+	Account *account(const QString &) const { return 0; }
+private:
+	void loadAccounts() {}
+};
+
+class FakeAccount : public Account
+{
+	Q_OBJECT
+public:
+	FakeAccount(Protocol *protocol) : Account(QStringLiteral("account"), protocol) {}
+	ChatUnit *getUnit(const QString &, bool) { return 0; }
+protected:
+	void doConnectToServer() {}
+	void doDisconnectFromServer() {}
+	void doStatusChange(const Status &) {}
+};
+
+class FakeBuddy : public Buddy
+{
+	Q_OBJECT
+public:
+	FakeBuddy(const QString &id, Account *account) : Buddy(account), m_id(id) {}
+	QString id() const { return m_id; }
+	bool sendMessage(const Message &) { return true; }
+private:
+	QString m_id;
+};
+
+class ScriptApiBenchmark : public QObject
+{
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanupTestCase();
+	void messages_data();
+	void messages();
+
+private:
+	FakeProtocol *m_protocol;
+	FakeAccount *m_account;
+	QList<FakeBuddy*> m_buddies;
+	ScriptPlugin *m_plugin;
+	ScriptMessageHandler *m_handler;
+};
+
+enum { MessagesCount = 10000, BuddiesCount = 20 };
+
+void ScriptApiBenchmark::initTestCase()
+{
+	m_protocol = new FakeProtocol;
+	m_account = new FakeAccount(m_protocol);
+	for (int i = 0; i < BuddiesCount; ++i)
+		m_buddies << new FakeBuddy(QStringLiteral("buddy%1").arg(i), m_account);
+	m_plugin = new ScriptPlugin;
+	m_handler = new ScriptMessageHandler(m_plugin);
+}
+
+void ScriptApiBenchmark::cleanupTestCase()
+{
+	delete m_handler;
+	delete m_plugin;
+	qDeleteAll(m_buddies);
+	delete m_account;
+	delete m_protocol;
+}
+
+void ScriptApiBenchmark::messages_data()
+{
+	QTest::addColumn<QString>("text");
+	QTest::addColumn<bool>("incoming");
+	QTest::addColumn<QString>("expected");
+
+	// %1 is the number of the message, %2 is the id of the buddy
+	QTest::newRow("incoming") << "sum is [[1 + 2]]" << true << "sum is [[1 + 2]]";
+	QTest::newRow("plain") << "message %1 without scripts" << false << "message %1 without scripts";
+	QTest::newRow("brackets") << "array [0] and [1]" << false << "array [0] and [1]";
+	QTest::newRow("inline") << "sum is [[1 + 2]]" << false << "sum is 3";
+	QTest::newRow("inline unit") << "hello, [[unit.id]]" << false << "hello, %2";
+	// More distinct snippets than the cache keeps
+	QTest::newRow("inline distinct") << "value [[%1 % 1000]]" << false << "value %3";
+}
+
+void ScriptApiBenchmark::messages()
+{
+	QFETCH(QString, text);
+	QFETCH(bool, incoming);
+	QFETCH(QString, expected);
+
+	QList<Message> messages;
+	QStringList results;
+	for (int i = 0; i < MessagesCount; ++i) {
+		FakeBuddy *buddy = m_buddies.at(i % m_buddies.size());
+		Message message(text.contains(QLatin1String("%1")) ? text.arg(i) : text);
+		message.setIncoming(incoming);
+		message.setChatUnit(buddy);
+		messages << message;
+		QString result = expected;
+		result.replace(QLatin1String("%1"), QString::number(i));
+		result.replace(QLatin1String("%2"), buddy->id());
+		result.replace(QLatin1String("%3"), QString::number(i % 1000));
+		results << result;
+	}
+
+	QList<Message> handled;
+	QBENCHMARK {
+		handled.clear();
+		foreach (const Message &original, messages) {
+			Message message(original.text());
+			message.setIncoming(original.isIncoming());
+			message.setChatUnit(original.chatUnit());
+			QCOMPARE(m_handler->doHandle(message, 0), MessageHandler::Accept);
+			handled << message;
+		}
+	}
+
+	QCOMPARE(handled.size(), int(MessagesCount));
+	for (int i = 0; i < handled.size(); ++i)
+		QCOMPARE(handled.at(i).text(), results.at(i));
+}
+
+QTEST_MAIN(ScriptApiBenchmark)
+#include "scriptapibenchmark.moc"
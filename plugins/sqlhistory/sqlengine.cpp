@@ -24,225 +24,506 @@
 ****************************************************************************/
 
 #include "sqlengine.h"
-#include "historywindow.h"
-#include "historysettings.h"
-#include <qutim/iconmanagerinterface.h>
+#include <qutim/json.h>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariant>
+#include <QSet>
+#include <QDebug>
+#include <limits>
+#include <algorithm>
 
 namespace SqlHistoryNamespace {
 
-SqlEngine::SqlEngine()
+static const qint64 minTime = std::numeric_limits<qint64>::min();
+static const qint64 maxTime = std::numeric_limits<qint64>::max();
+
+// Accounts and contacts are looked up by indexes of UNIQUE constraints.
+// Messages of a contact are found by range of messages_contact_time, it
+// covers months and dates queries, which need only the time. Reading and
+// searching fetch text and other columns from the table by rowid.
+static const char * const schema[] = {
+	"CREATE TABLE IF NOT EXISTS accounts ("
+	" id INTEGER PRIMARY KEY,"
+	" protocol TEXT NOT NULL,"
+	" account TEXT NOT NULL,"
+	" UNIQUE (protocol, account))",
+	"CREATE TABLE IF NOT EXISTS contacts ("
+	" id INTEGER PRIMARY KEY,"
+	" account_id INTEGER NOT NULL REFERENCES accounts (id),"
+	" contact TEXT NOT NULL,"
+	" UNIQUE (account_id, contact))",
+	"CREATE TABLE IF NOT EXISTS messages ("
+	" id INTEGER PRIMARY KEY,"
+	" contact_id INTEGER NOT NULL REFERENCES contacts (id),"
+	" time INTEGER NOT NULL,"
+	" incoming INTEGER NOT NULL,"
+	" text TEXT NOT NULL,"
+	" html TEXT,"
+	" properties TEXT)",
+	"CREATE INDEX IF NOT EXISTS messages_contact_time ON messages (contact_id, time)"
+};
+
+struct SqlEngine::Statements
 {
-	m_settings_widget = 0;
-	m_save_history = m_show_recent_messages = true;
-	m_max_num = 4;
-}
+	Statements(const QSqlDatabase &db)
+		: selectAccount(db), insertAccount(db), selectContact(db), insertContact(db),
+		  insertMessage(db), insertText(db), read(db), accounts(db), contacts(db),
+		  months(db), dates(db), scan(db), match(db)
+	{
+	}
 
-bool SqlEngine::init(PluginSystemInterface *)
+	// Disables full text search if its statements can't be prepared
+	bool prepare(bool &fts)
+	{
+		bool ok = selectAccount.prepare(QStringLiteral("SELECT id FROM accounts WHERE protocol = ? AND account = ?"))
+				&& insertAccount.prepare(QStringLiteral("INSERT INTO accounts (protocol, account) VALUES (?, ?)"))
+				&& selectContact.prepare(QStringLiteral("SELECT id FROM contacts WHERE account_id = ? AND contact = ?"))
+				&& insertContact.prepare(QStringLiteral("INSERT INTO contacts (account_id, contact) VALUES (?, ?)"))
+				&& insertMessage.prepare(QStringLiteral("INSERT INTO messages (contact_id, time, incoming, text, html, properties)"
+														" VALUES (?, ?, ?, ?, ?, ?)"))
+				&& read.prepare(QStringLiteral("SELECT time, incoming, text, html, properties FROM messages"
+											   " WHERE contact_id = ? AND time >= ? AND time < ?"
+											   " ORDER BY time DESC LIMIT ?"))
+				&& accounts.prepare(QStringLiteral("SELECT protocol, account FROM accounts"
+												   " WHERE EXISTS (SELECT 1 FROM contacts WHERE account_id = accounts.id)"
+												   " ORDER BY protocol, account"))
+				&& contacts.prepare(QStringLiteral("SELECT contact FROM contacts WHERE account_id = ? ORDER BY contact"))
+				&& months.prepare(QStringLiteral("SELECT DISTINCT strftime('%Y-%m', time / 1000, 'unixepoch', 'localtime')"
+												 " FROM messages WHERE contact_id = ?"))
+				&& dates.prepare(QStringLiteral("SELECT DISTINCT strftime('%Y-%m-%d', time / 1000, 'unixepoch', 'localtime')"
+												" FROM messages WHERE contact_id = ? AND time >= ? AND time < ?"))
+				&& scan.prepare(QStringLiteral("SELECT time, text FROM messages"
+											   " WHERE contact_id = ? AND time >= ? AND time < ?"));
+		if (ok && fts) {
+			fts = insertText.prepare(QStringLiteral("INSERT INTO messages_fts (rowid, text) VALUES (?, ?)"))
+					&& match.prepare(QStringLiteral("SELECT time, text FROM messages"
+													" WHERE contact_id = ? AND time >= ? AND time < ?"
+													" AND id IN (SELECT rowid FROM messages_fts WHERE messages_fts MATCH ?)"));
+		}
+		return ok;
+	}
+
+	QSqlQuery selectAccount;
+	QSqlQuery insertAccount;
+	QSqlQuery selectContact;
+	QSqlQuery insertContact;
+	QSqlQuery insertMessage;
+	QSqlQuery insertText;
+	QSqlQuery read;
+	QSqlQuery accounts;
+	QSqlQuery contacts;
+	QSqlQuery months;
+	QSqlQuery dates;
+	QSqlQuery scan;
+	QSqlQuery match;
+};
+
+static bool exec(QSqlQuery &query)
 {
-	m_name = "sql";
-	m_version = "0.1.0";
-	return true;
+	if (query.exec())
+		return true;
+	qWarning() << "SqlHistory: query failed" << query.lastQuery() << query.lastError().text();
+	return false;
 }
 
-void SqlEngine::release()
+static bool isSearch(const QRegularExpression &regex)
 {
-	m_history_hash.clear();
-	db.close();
+	return regex.isValid() && !regex.pattern().isEmpty();
 }
 
-void SqlEngine::setProfileName(const QString &profile_name)
+// History window searches for escaped words like "(word)", only such plain
+// patterns can be passed to the full text index, others are checked by scan
+static QString ftsLiteral(const QRegularExpression &regex)
 {
-	SystemsCity::instance().setProfileName(profile_name);
-
-	QSettings settings(QSettings::defaultFormat(), QSettings::UserScope, "qutim/qutim."+SystemsCity::ProfileName(), "sqlhistory");
-	m_save_history = settings.value("save", true).toBool();
-	m_show_recent_messages = settings.value("showrecent", true).toBool();
-	m_max_num = settings.value("recentcount", 4).toUInt();
-
-	QString createtable_query;
-	if (settings.value("sqlengine").toString()=="sqlite") {
-		QString dbpath = SystemsCity::PluginSystem()->getProfilePath();
-		if(dbpath.endsWith(QDir::separator())) dbpath.chop(1);
-		dbpath += QDir::separator();
-		dbpath += "history.db";
-
-		db = QSqlDatabase::addDatabase("QSQLITE");
-		db.setDatabaseName(dbpath);
-		createtable_query = "create table history (id integer primary key autoincrement,"
-			   "datetime int(16),"
-			   "protocol varchar(16),"
-			   "account varchar(64),"
-			   "type int(1),"
-			   "direction int(1),"
-			   "itemname varchar(64),"
-			   "text text )";
-	}
-	else if (settings.value("sqlengine").toString()=="mysql") {
-		settings.beginGroup("mysql");
-		db = QSqlDatabase::addDatabase("QMYSQL");
-		db.setHostName(settings.value("host", "localhost").toString());
-		db.setPort(settings.value("port", "3306").toInt());
-		db.setUserName(settings.value("login").toString());
-		db.setPassword(settings.value("password").toString());
-		db.setDatabaseName(settings.value("dbname").toString());
-		settings.endGroup();
-		createtable_query = "create table if not exists `history` (`id` int(9) PRIMARY KEY auto_increment,"
-			   "datetime int(16),"
-			   "protocol varchar(16),"
-			   "account varchar(64),"
-			   "type int(1),"
-			   "direction int(1),"
-			   "itemname varchar(64),"
-			   "text text );";
-	}
-
-	if (!db.open()) qDebug()<<"SQL History"<<"Database open error";
-
-	if (!createtable_query.isEmpty()) {
-		QSqlQuery query;
-		query.exec(createtable_query);
+	if (regex.patternOptions() & QRegularExpression::ExtendedPatternSyntaxOption)
+		return QString();
+	QString pattern = regex.pattern();
+	if (pattern.startsWith(QLatin1Char('(')) && pattern.endsWith(QLatin1Char(')')))
+		pattern = pattern.mid(1, pattern.size() - 2);
+	const QString special = QStringLiteral(".^$|?*+()[]{}");
+	QString literal;
+	for (int i = 0; i < pattern.size(); ++i) {
+		QChar ch = pattern.at(i);
+		if (ch == QLatin1Char('\\')) {
+			// Escapes like \d or \w are character classes
+			if (++i == pattern.size() || pattern.at(i).isLetterOrNumber())
+				return QString();
+			ch = pattern.at(i);
+		} else if (special.contains(ch)) {
+			return QString();
+		}
+		literal += ch;
 	}
+	// Trigram tokenizer can't find anything shorter
+	if (literal.size() < 3)
+		return QString();
+	literal.replace(QLatin1Char('"'), QStringLiteral("\"\""));
+	return QLatin1Char('"') + literal + QLatin1Char('"');
+}
 
+SqlEngine::SqlEngine(const Options &options)
+	: m_options(options), m_fts(false), m_running(true)
+{
 }
 
-void SqlEngine::loadSettings()
+SqlEngine::~SqlEngine()
 {
+	stop();
 }
 
-void SqlEngine::setLayerInterface( LayerType type, LayerInterface *layer_interface)
+void SqlEngine::stop()
 {
-	LayersCity::instance().setLayerInterface(type, layer_interface);
+	m_lock.lock();
+	m_running = false;
+	m_wait.wakeOne();
+	m_lock.unlock();
+	wait();
 }
 
-void SqlEngine::saveLayerSettings()
+void SqlEngine::store(const StoredMessage &message)
 {
-	if ( m_settings_widget )
-		m_settings_widget->saveSettings();
-	loadSettings();
+	QMutexLocker locker(&m_lock);
+	if (m_pending.isEmpty())
+		m_age.start();
+	m_pending.append(message);
+	// The first message starts the latency timer, the full batch is written at once
+	if (m_pending.size() == 1 || m_pending.size() >= m_options.batchSize)
+		m_wait.wakeOne();
 }
 
-QList<SettingsStructure> SqlEngine::getLayerSettingsList()
+void SqlEngine::enqueue(const std::function<void ()> &job)
 {
-	m_settings.clear();
-	if ( !m_settings_widget )
-	{
-		m_settings_widget = new SqlHistorySettings(SystemsCity::ProfileName());
-		m_settings_item = new QTreeWidgetItem;
-		m_settings_item->setText(0,QObject::tr("History"));
-		m_settings_item->setIcon(0,Icon("history"));
-		SettingsStructure tmp_struct;
-		tmp_struct.settings_item = m_settings_item;
-		tmp_struct.settings_widget = m_settings_widget;
-		m_settings.append(tmp_struct);
-	}
-	return m_settings;
+	QMutexLocker locker(&m_lock);
+	m_jobs.enqueue(job);
+	m_wait.wakeOne();
 }
 
-void SqlEngine::removeLayerSettings()
+void SqlEngine::run()
 {
-	if ( m_settings_widget )
-	{
-		delete m_settings_widget;
-		m_settings_widget = 0;
-		delete m_settings_item;
-		m_settings_item = 0;
+	open();
+
+	QMutexLocker locker(&m_lock);
+	forever {
+		while (m_running && m_jobs.isEmpty()
+			   && (m_pending.isEmpty()
+				   || (m_pending.size() < m_options.batchSize && m_age.elapsed() < m_options.batchLatency))) {
+			if (m_pending.isEmpty())
+				m_wait.wait(&m_lock);
+			else
+				m_wait.wait(&m_lock, qMax<qint64>(1, m_options.batchLatency - m_age.elapsed()));
+		}
+		QVector<StoredMessage> messages;
+		messages.swap(m_pending);
+		QQueue<std::function<void ()> > jobs;
+		jobs.swap(m_jobs);
+		const bool running = m_running;
+		locker.unlock();
+
+		flush(messages);
+		while (!jobs.isEmpty())
+			jobs.dequeue()();
+
+		locker.relock();
+		if (!running && m_pending.isEmpty() && m_jobs.isEmpty())
+			break;
 	}
+	locker.unlock();
+	close();
 }
 
-void SqlEngine::openWindow(const TreeModelItem &item)
+bool SqlEngine::open()
 {
-	QString identification = QString("%1.%2.%3").arg(item.m_protocol_name).arg(item.m_account_name).arg(item.m_item_name);
-	if(!m_history_windows.value(identification))
-	{
-		TreeModelItem tmp = item;
-		tmp.m_item_name = m_history_hash.value(identification, item.m_item_name);
-		m_history_windows.insert(identification, QPointer<HistoryWindow>(new HistoryWindow(tmp, this)));
+	m_connectionName = QStringLiteral("sqlhistory-%1").arg(quintptr(this), 0, 16);
+	m_db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), m_connectionName);
+	m_db.setDatabaseName(m_options.path);
+	if (!m_db.open()) {
+		qWarning() << "SqlHistory: can't open" << m_options.path << m_db.lastError().text();
+		return false;
+	}
+
+	QSqlQuery query(m_db);
+	// Readers don't block the writer and vice versa, and commits are cheap
+	query.exec(QStringLiteral("PRAGMA journal_mode = WAL"));
+	query.exec(QStringLiteral("PRAGMA synchronous = NORMAL"));
+	for (size_t i = 0; i < sizeof(schema) / sizeof(schema[0]); ++i) {
+		if (!query.exec(QLatin1String(schema[i]))) {
+			qWarning() << "SqlHistory: can't create schema" << query.lastError().text();
+			return false;
+		}
 	}
+
+	query.exec(QStringLiteral("SELECT 1 FROM sqlite_master WHERE name = 'messages_fts'"));
+	const bool hasIndex = query.next();
+	query.finish();
+	m_fts = query.exec(QStringLiteral("CREATE VIRTUAL TABLE IF NOT EXISTS messages_fts USING fts5"
+									  "(text, content = 'messages', content_rowid = 'id', tokenize = 'trigram')"));
+	if (m_fts && !hasIndex)
+		m_fts = query.exec(QStringLiteral("INSERT INTO messages_fts (messages_fts) VALUES ('rebuild')"));
+	if (!m_fts)
+		qDebug() << "SqlHistory: FTS5 trigram index is unavailable, search will scan messages";
+
+	m_statements.reset(new Statements(m_db));
+	if (!m_statements->prepare(m_fts)) {
+		qWarning() << "SqlHistory: can't prepare statements" << m_db.lastError().text();
+		m_statements.reset();
+		return false;
+	}
+	return true;
 }
 
-uint SqlEngine::findEnd(QFile &file)
+void SqlEngine::close()
 {
-	return 0;
+	m_statements.reset();
+	m_accounts.clear();
+	m_contacts.clear();
+	m_db.close();
+	m_db = QSqlDatabase();
+	QSqlDatabase::removeDatabase(m_connectionName);
 }
 
-bool SqlEngine::storeMessage(const HistoryItem &item)
+void SqlEngine::flush(const QVector<StoredMessage> &messages)
 {
-	if (!m_save_history) return false;
-
-	QSqlQuery query;
-	query.prepare("insert into history (datetime, protocol, account, type, direction, itemname, text) "
-				  "values (?, ?, ?, ?, ?, ?, ?);");
-
-	query.addBindValue(item.m_time.toTime_t());
-	query.addBindValue(item.m_user.m_protocol_name);
-	query.addBindValue(item.m_user.m_account_name);
-	query.addBindValue(item.m_type);
-	query.addBindValue(item.m_in ? 1 : 0);
-	query.addBindValue(item.m_from);
-	query.addBindValue(item.m_message);
-
-	if (query.exec()) return true;
-	else {
-		qDebug()<<"SQL History"<<"insert error";
+	if (messages.isEmpty() || !m_statements)
+		return;
+	Statements &s = *m_statements;
+	bool ok = m_db.transaction();
+	for (int i = 0; ok && i < messages.size(); ++i) {
+		const StoredMessage &message = messages.at(i);
+		const qint64 contact = contactId(message.contact, true);
+		if (contact < 0) {
+			ok = false;
+			break;
+		}
+		s.insertMessage.bindValue(0, contact);
+		s.insertMessage.bindValue(1, message.time);
+		s.insertMessage.bindValue(2, message.incoming);
+		s.insertMessage.bindValue(3, message.text);
+		s.insertMessage.bindValue(4, message.html);
+		s.insertMessage.bindValue(5, message.properties.isEmpty() ? QVariant() : QString::fromUtf8(message.properties));
+		ok = exec(s.insertMessage);
+		if (ok && m_fts) {
+			s.insertText.bindValue(0, s.insertMessage.lastInsertId());
+			s.insertText.bindValue(1, message.text);
+			ok = exec(s.insertText);
+		}
 	}
-
-	return false;
+	if (ok && m_db.commit())
+		return;
+	qWarning() << "SqlHistory: failed to write" << messages.size() << "messages" << m_db.lastError().text();
+	m_db.rollback();
+	// Identifiers inserted by this transaction are not valid anymore
+	m_accounts.clear();
+	m_contacts.clear();
 }
 
-QList<HistoryItem> SqlEngine::getMessages(const TreeModelItem &item, const QDateTime &last_time)
+qint64 SqlEngine::accountId(const History::AccountInfo &info, bool create)
 {
-	QList<HistoryItem> items;
-	if (!m_show_recent_messages) return items;
+	QMap<History::AccountInfo, qint64>::const_iterator it = m_accounts.constFind(info);
+	if (it != m_accounts.constEnd())
+		return it.value();
+	if (!m_statements)
+		return -1;
+
+	QSqlQuery &select = m_statements->selectAccount;
+	select.bindValue(0, info.protocol);
+	select.bindValue(1, info.account);
+	qint64 id = -1;
+	if (exec(select) && select.next())
+		id = select.value(0).toLongLong();
+	select.finish();
+
+	if (id < 0 && create) {
+		QSqlQuery &insert = m_statements->insertAccount;
+		insert.bindValue(0, info.protocol);
+		insert.bindValue(1, info.account);
+		if (exec(insert))
+			id = insert.lastInsertId().toLongLong();
+	}
+	if (id >= 0)
+		m_accounts.insert(info, id);
+	return id;
+}
 
-	QString strquery ="select datetime, protocol, account, type, direction, itemname, text from history";
-			strquery += " where datetime < "+QString::number(last_time.toTime_t());
-			strquery += " and protocol='"+item.m_protocol_name+"'";
-			strquery += " and account='"+item.m_account_name+"'";
-			strquery += " and itemname='"+item.m_item_name+"'";
-			strquery += " order by datetime desc limit "+QString::number(m_max_num);
-	QSqlQuery query(strquery);
+qint64 SqlEngine::contactId(const History::ContactInfo &info, bool create)
+{
+	QMap<History::ContactInfo, qint64>::const_iterator it = m_contacts.constFind(info);
+	if (it != m_contacts.constEnd())
+		return it.value();
+	const qint64 account = accountId(info, create);
+	if (account < 0)
+		return -1;
+
+	QSqlQuery &select = m_statements->selectContact;
+	select.bindValue(0, account);
+	select.bindValue(1, info.contact);
+	qint64 id = -1;
+	if (exec(select) && select.next())
+		id = select.value(0).toLongLong();
+	select.finish();
+
+	if (id < 0 && create) {
+		QSqlQuery &insert = m_statements->insertContact;
+		insert.bindValue(0, account);
+		insert.bindValue(1, info.contact);
+		if (exec(insert))
+			id = insert.lastInsertId().toLongLong();
+	}
+	if (id >= 0)
+		m_contacts.insert(info, id);
+	return id;
+}
 
+MessageList SqlEngine::read(const History::ContactInfo &contact, const QDateTime &from, const QDateTime &to, int max_num)
+{
+	MessageList items;
+	const qint64 id = contactId(contact, false);
+	if (id < 0)
+		return items;
+
+	QSqlQuery &query = m_statements->read;
+	query.bindValue(0, id);
+	query.bindValue(1, from.isValid() ? from.toMSecsSinceEpoch() : minTime);
+	query.bindValue(2, to.isValid() ? to.toMSecsSinceEpoch() : maxTime);
+	// Negative limit means no limit at all both for us and SQLite
+	query.bindValue(3, max_num);
+	if (!exec(query))
+		return items;
 	while (query.next()) {
-		HistoryItem hitem;
-		hitem.m_user = item;
-		hitem.m_time = QDateTime::fromTime_t(query.value(0).toUInt());
-		hitem.m_from = query.value(5).toString();
-		hitem.m_in = (query.value(4).toUInt()==0) ? false : true;
-		hitem.m_message =  query.value(6).toString();
-		items.prepend(hitem);
+		Message item;
+		const QByteArray properties = query.value(4).toByteArray();
+		if (!properties.isEmpty()) {
+			const QVariantMap map = Json::parse(properties).toMap();
+			for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it)
+				item.setProperty(it.key().toUtf8(), it.value());
+		}
+		item.setTime(QDateTime::fromMSecsSinceEpoch(query.value(0).toLongLong()));
+		item.setIncoming(query.value(1).toBool());
+		item.setText(query.value(2).toString());
+		item.setHtml(query.value(3).toString());
+		items.prepend(item);
 	}
-
+	query.finish();
 	return items;
 }
 
-QString SqlEngine::quote(const QString &str)
+QVector<History::AccountInfo> SqlEngine::accounts()
 {
-	QString result = str;
-	result.replace("'", "\\'");
+	QVector<History::AccountInfo> result;
+	if (!m_statements)
+		return result;
+	QSqlQuery &query = m_statements->accounts;
+	if (!exec(query))
+		return result;
+	while (query.next()) {
+		History::AccountInfo info;
+		info.protocol = query.value(0).toString();
+		info.account = query.value(1).toString();
+		result << info;
+	}
+	query.finish();
 	return result;
 }
 
-QString SqlEngine::unquote(const QString &str)
+QVector<History::ContactInfo> SqlEngine::contacts(const History::AccountInfo &account)
 {
-	QString result;
+	QVector<History::ContactInfo> result;
+	const qint64 id = accountId(account, false);
+	if (id < 0)
+		return result;
+	QSqlQuery &query = m_statements->contacts;
+	query.bindValue(0, id);
+	if (!exec(query))
+		return result;
+	while (query.next()) {
+		History::ContactInfo info;
+		info.protocol = account.protocol;
+		info.account = account.account;
+		info.contact = query.value(0).toString();
+		result << info;
+	}
+	query.finish();
 	return result;
 }
 
-QString SqlEngine::getFileName(const HistoryItem &item) const
+QList<QDate> SqlEngine::months(const History::ContactInfo &contact, const QRegularExpression &regex)
 {
-	QString file;
-	return file;
+	QList<QDate> result;
+	const qint64 id = contactId(contact, false);
+	if (id < 0)
+		return result;
+	if (isSearch(regex))
+		return search(id, minTime, maxTime, regex, true);
+
+	QSqlQuery &query = m_statements->months;
+	query.bindValue(0, id);
+	if (!exec(query))
+		return result;
+	while (query.next()) {
+		const QDate date = QDate::fromString(query.value(0).toString() + QStringLiteral("-01"),
+											 QStringLiteral("yyyy-MM-dd"));
+		if (date.isValid())
+			result << date;
+	}
+	query.finish();
+	std::sort(result.begin(), result.end());
+	return result;
 }
 
-QDir SqlEngine::getAccountDir(const TreeModelItem &item) const
+QList<QDate> SqlEngine::dates(const History::ContactInfo &contact, const QDate &month, const QRegularExpression &regex)
 {
-	return QDir();
+	QList<QDate> result;
+	const qint64 id = contactId(contact, false);
+	if (id < 0 || !month.isValid())
+		return result;
+	const QDateTime begin(QDate(month.year(), month.month(), 1));
+	const qint64 from = begin.toMSecsSinceEpoch();
+	const qint64 to = begin.addMonths(1).toMSecsSinceEpoch();
+	if (isSearch(regex))
+		return search(id, from, to, regex, false);
+
+	QSqlQuery &query = m_statements->dates;
+	query.bindValue(0, id);
+	query.bindValue(1, from);
+	query.bindValue(2, to);
+	if (!exec(query))
+		return result;
+	while (query.next()) {
+		const QDate date = QDate::fromString(query.value(0).toString(), QStringLiteral("yyyy-MM-dd"));
+		if (date.isValid())
+			result << date;
+	}
+	query.finish();
+	std::sort(result.begin(), result.end());
+	return result;
 }
 
-void SqlEngine::setHistory(const TreeModelItem &item)
+QList<QDate> SqlEngine::search(qint64 contact, qint64 from, qint64 to, const QRegularExpression &regex, bool monthly)
 {
-
+	// Index only narrows the candidates, the regular expression has the last word
+	const QString literal = m_fts ? ftsLiteral(regex) : QString();
+	QSqlQuery &query = literal.isEmpty() ? m_statements->scan : m_statements->match;
+	query.bindValue(0, contact);
+	query.bindValue(1, from);
+	query.bindValue(2, to);
+	if (!literal.isEmpty())
+		query.bindValue(3, literal);
+
+	QSet<QDate> dates;
+	if (exec(query)) {
+		while (query.next()) {
+			if (!query.value(1).toString().contains(regex))
+				continue;
+			QDate date = QDateTime::fromMSecsSinceEpoch(query.value(0).toLongLong()).date();
+			if (monthly)
+				date = QDate(date.year(), date.month(), 1);
+			dates.insert(date);
+		}
+		query.finish();
+	}
+	QList<QDate> result = dates.toList();
+	std::sort(result.begin(), result.end());
+	return result;
 }
 
 }
-
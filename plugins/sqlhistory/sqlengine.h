@@ -24,58 +24,94 @@
 ****************************************************************************/
 
 #ifndef SQLENGINE_H
-#define SQLNENGINE_H
+#define SQLENGINE_H
 
-#include <qutim/plugininterface.h>
-#include <qutim/layerinterface.h>
-#include <qutim/layerscity.h>
-#include <QDir>
+#include <qutim/history.h>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
 #include <QSqlDatabase>
-#include <QSqlQuery>
-
-using namespace qutim_sdk_0_2;
+#include <QQueue>
+#include <QElapsedTimer>
+#include <QMap>
+#include <functional>
 
 namespace SqlHistoryNamespace {
 
-class HistoryWindow;
-class SqlHistorySettings;
+using namespace qutim_sdk_0_3;
+
+// Plain copy of the message, it's safe to pass it to the engine's thread
+struct StoredMessage
+{
+	History::ContactInfo contact;
+	qint64 time;
+	bool incoming;
+	QString text;
+	QString html;
+	QByteArray properties;
+};
 
-class SqlEngine : public HistoryLayerInterface
+/*
+  Owns the database connection and serves all requests in its own thread.
+  Messages are written in batches, one transaction per batch, either when
+  batchSize messages are collected or after batchLatency milliseconds.
+  Read jobs flush pending messages first, so they always see them.
+*/
+class SqlEngine : public QThread
 {
+	Q_OBJECT
 public:
-	SqlEngine();
-	virtual bool init(PluginSystemInterface *plugin_system);
-	virtual void release();
-	virtual void setProfileName(const QString &profile_name);
-	void loadSettings();
-	virtual void setLayerInterface( LayerType type, LayerInterface *layer_interface);
-	virtual void saveLayerSettings();
-	virtual QList<SettingsStructure> getLayerSettingsList();
-	virtual void removeLayerSettings();
-	virtual void saveGuiSettingsPressed() {}
-	virtual void removeGuiLayerSettings() {}
-	virtual void openWindow(const TreeModelItem &item);
-	uint findEnd(QFile &file);
-	virtual bool storeMessage(const HistoryItem &item);
-	virtual QList<HistoryItem> getMessages(const TreeModelItem &item, const QDateTime &last_time);
-	QString getFileName(const HistoryItem &item) const;
-	QDir getAccountDir(const TreeModelItem &item) const;
-	static QString quote(const QString &str);
-	static QString unquote(const QString &str);
-	void setHistory(const TreeModelItem &item);
-  inline const QString &getHistoryPath() const { return NULL; }
+	struct Options
+	{
+		Options() : batchSize(64), batchLatency(1000) {}
+		QString path;
+		int batchSize;
+		int batchLatency;
+	};
+
+	explicit SqlEngine(const Options &options);
+	virtual ~SqlEngine();
+
+	void stop();
+	void store(const StoredMessage &message);
+	void enqueue(const std::function<void ()> &job);
+
+	// These ones are allowed to be called only from jobs
+	MessageList read(const History::ContactInfo &contact, const QDateTime &from, const QDateTime &to, int max_num);
+	QVector<History::AccountInfo> accounts();
+	QVector<History::ContactInfo> contacts(const History::AccountInfo &account);
+	QList<QDate> months(const History::ContactInfo &contact, const QRegularExpression &regex);
+	QList<QDate> dates(const History::ContactInfo &contact, const QDate &month, const QRegularExpression &regex);
+
+protected:
+	virtual void run();
+
 private:
-	QHash<QString, QString> m_history_hash;
-	QHash<QString, QPointer<HistoryWindow> > m_history_windows;
-	SqlHistorySettings *m_settings_widget;
-	QTreeWidgetItem *m_settings_item;
-	bool m_save_history;
-	bool m_show_recent_messages;
-	quint16 m_max_num;
-	QSqlDatabase db;
+	struct Statements;
+
+	bool open();
+	void close();
+	void flush(const QVector<StoredMessage> &messages);
+	qint64 accountId(const History::AccountInfo &info, bool create);
+	qint64 contactId(const History::ContactInfo &info, bool create);
+	QList<QDate> search(qint64 contact, qint64 from, qint64 to, const QRegularExpression &regex, bool monthly);
+
+	Options m_options;
+	QString m_connectionName;
+	QSqlDatabase m_db;
+	QScopedPointer<Statements> m_statements;
+	QMap<History::AccountInfo, qint64> m_accounts;
+	QMap<History::ContactInfo, qint64> m_contacts;
+	bool m_fts;
+
+	QMutex m_lock;
+	QWaitCondition m_wait;
+	QVector<StoredMessage> m_pending;
+	QElapsedTimer m_age;
+	QQueue<std::function<void ()> > m_jobs;
+	bool m_running;
 };
 
 }
 
 #endif // SQLENGINE_H
-
@@ -24,61 +24,143 @@
 ****************************************************************************/
 
 #include "sqlhistory.h"
-#include <qutim/iconmanagerinterface.h>
+#include "historywindow.h"
+#include <qutim/chatunit.h>
+#include <qutim/config.h>
+#include <qutim/systeminfo.h>
+#include <qutim/json.h>
+#include <qutim/icon.h>
+#include <qutim/menucontroller.h>
 
-SqlHistory::SqlHistory(QObject *parent) :
-	QObject(parent)
+namespace SqlHistoryNamespace {
+
+SqlHistory::SqlHistory()
+{
+	static bool inited = false;
+	if (!inited) {
+		inited = true;
+		ActionGenerator *gen = new ActionGenerator(Icon("view-history"),
+												   QT_TRANSLATE_NOOP("Chat", "View History"),
+												   this,
+												   SLOT(onHistoryActionTriggered(QObject*)));
+		gen->setType(ActionTypeChatButton|ActionTypeContactList);
+		gen->setPriority(512);
+		MenuController::addAction<ChatUnit>(gen);
+	}
+
+	const QDir historyDir = SystemInfo::getDir(SystemInfo::HistoryDir);
+	historyDir.mkpath(QStringLiteral("."));
+
+	Config cfg = Config().group(QStringLiteral("sqlhistory"));
+	SqlEngine::Options options;
+	options.path = cfg.value(QStringLiteral("path"), historyDir.filePath(QStringLiteral("history.sqlite")));
+	options.batchSize = qMax(1, cfg.value(QStringLiteral("batchSize"), options.batchSize));
+	options.batchLatency = cfg.value(QStringLiteral("batchLatency"), options.batchLatency);
+	m_engine.reset(new SqlEngine(options));
+	m_engine->start(QThread::LowPriority);
+}
+
+SqlHistory::~SqlHistory()
 {
-	m_engine = 0;
-	m_icon = 0;
+	// Pending messages are written and jobs are finished before return
+	m_engine->stop();
 }
 
-bool SqlHistory::init(PluginSystemInterface *plugin_system)
+void SqlHistory::store(const Message &message)
 {
-	PluginInterface::init(plugin_system);
-	m_engine = new SqlHistoryNamespace::SqlEngine;
-	if(!plugin_system->setLayerInterface(HistoryLayer, m_engine))
-	{
-		delete m_engine;
-		m_engine = 0;
-		return false;
+	if (!message.chatUnit())
+		return;
+
+	StoredMessage stored;
+	stored.contact = info(message.chatUnit());
+	QDateTime time = message.time();
+	if (!time.isValid())
+		time = QDateTime::currentDateTime();
+	stored.time = time.toMSecsSinceEpoch();
+	stored.incoming = message.isIncoming();
+	stored.text = message.text();
+	stored.html = message.html();
+
+	QVariantMap properties;
+	foreach (const QByteArray &name, message.dynamicPropertyNames()) {
+		const QVariant value = message.property(name);
+		// Skip values which can't be represented by JSON
+		QByteArray data;
+		if (Json::generate(data, value))
+			properties.insert(QString::fromUtf8(name), value);
 	}
-	plugin_system->registerEventHandler("Core/ContactList/ItemAdded", this, SLOT(itemAdded(TreeModelItem,QString)));
-	return true;
+	if (!properties.isEmpty())
+		stored.properties = Json::generate(properties);
+
+	m_engine->store(stored);
 }
 
-void SqlHistory::release()
+AsyncResult<MessageList> SqlHistory::read(const ContactInfo &contact, const QDateTime &from, const QDateTime &to, int max_num)
 {
-	delete m_engine;
-	m_engine = 0;
+	AsyncResultHandler<MessageList> handler;
+	SqlEngine *engine = m_engine.data();
+	engine->enqueue([engine, handler, contact, from, to, max_num] () {
+		handler.handle(engine->read(contact, from, to, max_num));
+	});
+	return handler.result();
 }
 
-QString SqlHistory::name()
+AsyncResult<QVector<History::AccountInfo>> SqlHistory::accounts()
 {
-	return "SqlHistory";
+	AsyncResultHandler<QVector<AccountInfo>> handler;
+	SqlEngine *engine = m_engine.data();
+	engine->enqueue([engine, handler] () {
+		handler.handle(engine->accounts());
+	});
+	return handler.result();
 }
 
-QString SqlHistory::description()
+AsyncResult<QVector<History::ContactInfo>> SqlHistory::contacts(const AccountInfo &account)
 {
-	return "SQL History engine";
+	AsyncResultHandler<QVector<ContactInfo>> handler;
+	SqlEngine *engine = m_engine.data();
+	engine->enqueue([engine, handler, account] () {
+		handler.handle(engine->contacts(account));
+	});
+	return handler.result();
 }
 
-QIcon *SqlHistory::icon()
+AsyncResult<QList<QDate>> SqlHistory::months(const ContactInfo &contact, const QRegularExpression &regex)
 {
-	return m_icon;
+	AsyncResultHandler<QList<QDate>> handler;
+	SqlEngine *engine = m_engine.data();
+	engine->enqueue([engine, handler, contact, regex] () {
+		handler.handle(engine->months(contact, regex));
+	});
+	return handler.result();
 }
 
-void SqlHistory::setProfileName(const QString &profile_name)
+AsyncResult<QList<QDate>> SqlHistory::dates(const ContactInfo &contact, const QDate &month, const QRegularExpression &regex)
 {
-	SystemsCity::instance().setProfileName(profile_name);
-	m_icon = new Icon("history");
+	AsyncResultHandler<QList<QDate>> handler;
+	SqlEngine *engine = m_engine.data();
+	engine->enqueue([engine, handler, contact, month, regex] () {
+		handler.handle(engine->dates(contact, month, regex));
+	});
+	return handler.result();
 }
 
-void SqlHistory::itemAdded(const TreeModelItem &item, const QString &)
+void SqlHistory::showHistory(const ChatUnit *unit)
 {
-	if(m_engine)
-		m_engine->setHistory(item);
+	unit = unit->getHistoryUnit();
+	if (m_historyWindow) {
+		m_historyWindow.data()->setUnit(unit);
+		m_historyWindow.data()->raise();
+	} else {
+		m_historyWindow = new Core::HistoryWindow(unit);
+		m_historyWindow.data()->show();
+	}
 }
 
-Q_EXPORT_PLUGIN2(sqlhistory, SqlHistory)
+void SqlHistory::onHistoryActionTriggered(QObject *object)
+{
+	ChatUnit *unit = qobject_cast<ChatUnit*>(object);
+	showHistory(unit);
+}
 
+}
@@ -27,27 +27,41 @@
 #define SQLHISTORY_H
 
 #include "sqlengine.h"
+#include <QPointer>
 
-using namespace qutim_sdk_0_2;
+namespace Core {
+class HistoryWindow;
+}
 
-class SqlHistory : public QObject, public LayerPluginInterface {
+namespace SqlHistoryNamespace {
+
+/*
+  History service, which keeps messages in SQLite database.
+  Settings are stored in "sqlhistory" group of the config: "path" of the
+  database (":memory:" is allowed), "batchSize" and "batchLatency" of writes.
+*/
+class SqlHistory : public History
+{
 	Q_OBJECT
-	Q_DISABLE_COPY(SqlHistory)
-	Q_INTERFACES(qutim_sdk_0_2::PluginInterface qutim_sdk_0_2::LayerPluginInterface)
 public:
-	SqlHistory(QObject *parent = 0);
-	virtual bool init(PluginSystemInterface *plugin_system);
-	virtual void release();
-	virtual QString name();
-	virtual QString description();
-	virtual QIcon *icon();
-	virtual void setProfileName(const QString &profile_name);
-public slots:
-	void itemAdded(const TreeModelItem &item, const QString &name);
+	SqlHistory();
+	virtual ~SqlHistory();
+
+	void store(const Message &message) override;
+	AsyncResult<MessageList> read(const ContactInfo &contact, const QDateTime &from, const QDateTime &to, int max_num) override;
+	AsyncResult<QVector<AccountInfo>> accounts() override;
+	AsyncResult<QVector<ContactInfo>> contacts(const AccountInfo &account) override;
+	AsyncResult<QList<QDate>> months(const ContactInfo &contact, const QRegularExpression &regex) override;
+	AsyncResult<QList<QDate>> dates(const ContactInfo &contact, const QDate &month, const QRegularExpression &regex) override;
+	void showHistory(const ChatUnit *unit) override;
+
+private slots:
+	void onHistoryActionTriggered(QObject *object);
 private:
-	SqlHistoryNamespace::SqlEngine *m_engine;
-	QIcon *m_icon;
+	QScopedPointer<SqlEngine> m_engine;
+	QPointer<Core::HistoryWindow> m_historyWindow;
 };
 
-#endif // SQLHISTORY_H
+}
 
+#endif // SQLHISTORY_H
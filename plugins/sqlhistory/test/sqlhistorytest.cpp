@@ -0,0 +1,306 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "sqlengine.h"
+#include <QtTest>
+#include <QSemaphore>
+#include <QSqlQuery>
+#include <QRegularExpression>
+
+using namespace SqlHistoryNamespace;
+
+class SqlHistoryTest : public QObject
+{
+	Q_OBJECT
+private slots:
+	void init();
+	void cleanup();
+	void readOrder();
+	void readRange();
+	void properties();
+	void accountsAndContacts();
+	void monthsAndDates();
+	void search();
+	void pendingBatch();
+	void queryPlan();
+
+private:
+	// Runs the function as an engine's job and waits for it
+	template <typename T>
+	T call(const std::function<T ()> &function);
+	void store(const QString &contact, const QDateTime &time, const QString &text,
+			   const QByteArray &properties = QByteArray());
+	QStringList texts(const MessageList &messages);
+	History::ContactInfo contact(const QString &id) const;
+
+	QScopedPointer<SqlEngine> m_engine;
+};
+
+template <typename T>
+T SqlHistoryTest::call(const std::function<T ()> &function)
+{
+	T result;
+	QSemaphore done;
+	m_engine->enqueue([&result, &done, &function] () {
+		result = function();
+		done.release();
+	});
+	done.acquire();
+	return result;
+}
+
+History::ContactInfo SqlHistoryTest::contact(const QString &id) const
+{
+	History::ContactInfo info;
+	info.protocol = QStringLiteral("jabber");
+	info.account = QStringLiteral("me@example.org");
+	info.contact = id;
+	return info;
+}
+
+void SqlHistoryTest::store(const QString &id, const QDateTime &time, const QString &text,
+						   const QByteArray &properties)
+{
+	StoredMessage message;
+	message.contact = contact(id);
+	message.time = time.toMSecsSinceEpoch();
+	message.incoming = true;
+	message.text = text;
+	message.html = text.toHtmlEscaped();
+	message.properties = properties;
+	m_engine->store(message);
+}
+
+QStringList SqlHistoryTest::texts(const MessageList &messages)
+{
+	QStringList result;
+	foreach (const Message &message, messages)
+		result << message.text();
+	return result;
+}
+
+void SqlHistoryTest::init()
+{
+	SqlEngine::Options options;
+	options.path = QStringLiteral(":memory:");
+	m_engine.reset(new SqlEngine(options));
+	m_engine->start();
+}
+
+void SqlHistoryTest::cleanup()
+{
+	m_engine->stop();
+	m_engine.reset();
+}
+
+static QDateTime at(int month, int day, int hour = 12)
+{
+	return QDateTime(QDate(2014, month, day), QTime(hour, 0));
+}
+
+void SqlHistoryTest::readOrder()
+{
+	for (int i = 0; i < 10; ++i)
+		store(QStringLiteral("friend"), at(1, 1 + i), QString::number(i));
+	SqlEngine *engine = m_engine.data();
+	const History::ContactInfo info = contact(QStringLiteral("friend"));
+
+	// Latest messages in chronological order
+	const MessageList last = call<MessageList>([engine, info] () {
+		return engine->read(info, QDateTime(), QDateTime(), 3);
+	});
+	QCOMPARE(texts(last), QStringList() << "7" << "8" << "9");
+	QCOMPARE(last.first().time(), at(1, 8));
+	QVERIFY(last.first().isIncoming());
+
+	const MessageList all = call<MessageList>([engine, info] () {
+		return engine->read(info, QDateTime(), QDateTime(), -1);
+	});
+	QCOMPARE(all.size(), 10);
+	QCOMPARE(all.first().text(), QStringLiteral("0"));
+}
+
+void SqlHistoryTest::readRange()
+{
+	for (int i = 0; i < 10; ++i)
+		store(QStringLiteral("friend"), at(1, 1 + i), QString::number(i));
+	store(QStringLiteral("other"), at(1, 5, 13), QStringLiteral("other"));
+	SqlEngine *engine = m_engine.data();
+	const History::ContactInfo info = contact(QStringLiteral("friend"));
+
+	// From is inclusive, to is exclusive
+	const MessageList range = call<MessageList>([engine, info] () {
+		return engine->read(info, at(1, 3), at(1, 6), -1);
+	});
+	QCOMPARE(texts(range), QStringList() << "2" << "3" << "4");
+
+	const MessageList unknown = call<MessageList>([engine, this] () {
+		return engine->read(contact(QStringLiteral("nobody")), QDateTime(), QDateTime(), -1);
+	});
+	QVERIFY(unknown.isEmpty());
+}
+
+void SqlHistoryTest::properties()
+{
+	store(QStringLiteral("friend"), at(2, 1), QStringLiteral("text"), "{\"service\":true,\"senderName\":\"Friend\"}");
+	SqlEngine *engine = m_engine.data();
+	const History::ContactInfo info = contact(QStringLiteral("friend"));
+	const MessageList messages = call<MessageList>([engine, info] () {
+		return engine->read(info, QDateTime(), QDateTime(), -1);
+	});
+	QCOMPARE(messages.size(), 1);
+	QCOMPARE(messages.first().property("service", false), true);
+	QCOMPARE(messages.first().property("senderName", QString()), QStringLiteral("Friend"));
+	QCOMPARE(messages.first().html(), QStringLiteral("text"));
+}
+
+void SqlHistoryTest::accountsAndContacts()
+{
+	store(QStringLiteral("b"), at(1, 1), QStringLiteral("1"));
+	store(QStringLiteral("a"), at(1, 2), QStringLiteral("2"));
+	store(QStringLiteral("b"), at(1, 3), QStringLiteral("3"));
+	SqlEngine *engine = m_engine.data();
+
+	const QVector<History::AccountInfo> accounts = call<QVector<History::AccountInfo> >([engine] () {
+		return engine->accounts();
+	});
+	QCOMPARE(accounts.size(), 1);
+	QCOMPARE(accounts.first().protocol, QStringLiteral("jabber"));
+	QCOMPARE(accounts.first().account, QStringLiteral("me@example.org"));
+
+	const History::AccountInfo account = accounts.first();
+	const QVector<History::ContactInfo> contacts = call<QVector<History::ContactInfo> >([engine, account] () {
+		return engine->contacts(account);
+	});
+	QCOMPARE(contacts.size(), 2);
+	QCOMPARE(contacts.at(0).contact, QStringLiteral("a"));
+	QCOMPARE(contacts.at(1).contact, QStringLiteral("b"));
+}
+
+void SqlHistoryTest::monthsAndDates()
+{
+	store(QStringLiteral("friend"), at(1, 10), QStringLiteral("1"));
+	store(QStringLiteral("friend"), at(1, 10, 15), QStringLiteral("2"));
+	store(QStringLiteral("friend"), at(1, 20), QStringLiteral("3"));
+	store(QStringLiteral("friend"), at(3, 5), QStringLiteral("4"));
+	SqlEngine *engine = m_engine.data();
+	const History::ContactInfo info = contact(QStringLiteral("friend"));
+
+	const QList<QDate> months = call<QList<QDate> >([engine, info] () {
+		return engine->months(info, QRegularExpression());
+	});
+	QCOMPARE(months, QList<QDate>() << QDate(2014, 1, 1) << QDate(2014, 3, 1));
+
+	const QList<QDate> dates = call<QList<QDate> >([engine, info] () {
+		return engine->dates(info, QDate(2014, 1, 1), QRegularExpression());
+	});
+	QCOMPARE(dates, QList<QDate>() << QDate(2014, 1, 10) << QDate(2014, 1, 20));
+}
+
+void SqlHistoryTest::search()
+{
+	store(QStringLiteral("friend"), at(1, 10), QStringLiteral("Hello there"));
+	store(QStringLiteral("friend"), at(1, 12), QStringLiteral("nothing"));
+	store(QStringLiteral("friend"), at(2, 3), QStringLiteral("say hello"));
+	store(QStringLiteral("friend"), at(3, 3), QStringLiteral("hallo"));
+	SqlEngine *engine = m_engine.data();
+	const History::ContactInfo info = contact(QStringLiteral("friend"));
+
+	// Plain word, as the history window asks, goes through the text index if it's available
+	const QRegularExpression word(QStringLiteral("(hello)"), QRegularExpression::CaseInsensitiveOption);
+	const QList<QDate> months = call<QList<QDate> >([engine, info, word] () {
+		return engine->months(info, word);
+	});
+	QCOMPARE(months, QList<QDate>() << QDate(2014, 1, 1) << QDate(2014, 2, 1));
+	const QList<QDate> dates = call<QList<QDate> >([engine, info, word] () {
+		return engine->dates(info, QDate(2014, 1, 1), word);
+	});
+	QCOMPARE(dates, QList<QDate>() << QDate(2014, 1, 10));
+
+	// Index can't answer this one, so messages are scanned
+	const QRegularExpression pattern(QStringLiteral("h.llo$"));
+	const QList<QDate> scanned = call<QList<QDate> >([engine, info, pattern] () {
+		return engine->months(info, pattern);
+	});
+	QCOMPARE(scanned, QList<QDate>() << QDate(2014, 2, 1) << QDate(2014, 3, 1));
+}
+
+void SqlHistoryTest::pendingBatch()
+{
+	SqlEngine::Options options;
+	options.path = QStringLiteral(":memory:");
+	options.batchSize = 100;
+	options.batchLatency = 60 * 60 * 1000;
+	m_engine->stop();
+	m_engine.reset(new SqlEngine(options));
+	m_engine->start();
+
+	// Neither size nor latency is reached, read flushes them anyway
+	store(QStringLiteral("friend"), at(1, 1), QStringLiteral("1"));
+	store(QStringLiteral("friend"), at(1, 2), QStringLiteral("2"));
+	SqlEngine *engine = m_engine.data();
+	const History::ContactInfo info = contact(QStringLiteral("friend"));
+	const MessageList messages = call<MessageList>([engine, info] () {
+		return engine->read(info, QDateTime(), QDateTime(), -1);
+	});
+	QCOMPARE(texts(messages), QStringList() << "1" << "2");
+}
+
+void SqlHistoryTest::queryPlan()
+{
+	store(QStringLiteral("friend"), at(1, 1), QStringLiteral("1"));
+	SqlEngine *engine = m_engine.data();
+	// Ask the engine's connection from its own thread
+	const QString connection = QStringLiteral("sqlhistory-%1").arg(quintptr(engine), 0, 16);
+	const QStringList plans = call<QStringList>([connection] () {
+		const char * const queries[] = {
+			"SELECT time, incoming, text, html, properties FROM messages"
+			" WHERE contact_id = 1 AND time >= 0 AND time < 1 ORDER BY time DESC LIMIT 10",
+			"SELECT DISTINCT strftime('%Y-%m', time / 1000, 'unixepoch', 'localtime')"
+			" FROM messages WHERE contact_id = 1",
+			"SELECT DISTINCT strftime('%Y-%m-%d', time / 1000, 'unixepoch', 'localtime')"
+			" FROM messages WHERE contact_id = 1 AND time >= 0 AND time < 1"
+		};
+		QStringList result;
+		QSqlQuery query(QSqlDatabase::database(connection, false));
+		for (const char *text : queries) {
+			QString plan;
+			query.exec(QLatin1String("EXPLAIN QUERY PLAN ") + QLatin1String(text));
+			while (query.next())
+				plan += query.value(3).toString() + QLatin1Char('\n');
+			result << plan;
+		}
+		return result;
+	});
+	QCOMPARE(plans.size(), 3);
+	// Reading has to visit the rows, months and dates are answered by the index alone
+	QVERIFY2(plans.at(0).contains(QLatin1String("USING INDEX messages_contact_time")), qPrintable(plans.at(0)));
+	QVERIFY2(plans.at(1).contains(QLatin1String("USING COVERING INDEX messages_contact_time")), qPrintable(plans.at(1)));
+	QVERIFY2(plans.at(2).contains(QLatin1String("USING COVERING INDEX messages_contact_time")), qPrintable(plans.at(2)));
+}
+
+QTEST_MAIN(SqlHistoryTest)
+
+#include "sqlhistorytest.moc"
@@ -41,6 +41,10 @@ void UnreadMessagesKeeper::init()
 
 bool UnreadMessagesKeeper::load()
 {
+	m_flushTimer.setSingleShot(true);
+	m_flushTimer.setInterval(2000);
+	connect(&m_flushTimer, SIGNAL(timeout()), SLOT(flush()));
+
 	ChatLayer *layer = ChatLayer::instance();
 	connect(layer,SIGNAL(sessionCreated(qutim_sdk_0_3::ChatSession*)),
 			SLOT(sessionCreated(qutim_sdk_0_3::ChatSession*))
@@ -81,25 +85,58 @@ bool UnreadMessagesKeeper::load()
 
 bool UnreadMessagesKeeper::unload()
 {
+	flush();
 	return true;
 }
 
 void UnreadMessagesKeeper::sessionCreated(qutim_sdk_0_3::ChatSession* session)
 {
-	connect(session,SIGNAL(unreadChanged(qutim_sdk_0_3::MessageList)),SLOT(onUnreadChanged(qutim_sdk_0_3::MessageList)));
+	ChatUnit *u = session->getUnit();
+	Account *a = u->account();
+	m_keys.insert(session, QStringList() << a->protocol()->id() << a->id() << u->id());
+	connect(session,SIGNAL(unreadCountChanged(int)),SLOT(onUnreadCountChanged(int)));
+	connect(session,SIGNAL(destroyed(QObject*)),SLOT(onSessionDestroyed(QObject*)));
 }
 
-void UnreadMessagesKeeper::onUnreadChanged(const qutim_sdk_0_3::MessageList &list)
+void UnreadMessagesKeeper::onUnreadCountChanged(int count)
 {
-	ChatSession *s = qobject_cast<ChatSession*>(sender());
-	ChatUnit *u = s->getUnit();
-	Account *a = u->account();
+	// Count is changed on every message, so it's written to config in batches
+	m_pending.insert(sender(), count);
+	if (!m_flushTimer.isActive())
+		m_flushTimer.start();
+}
+
+void UnreadMessagesKeeper::onSessionDestroyed(QObject *session)
+{
+	QHash<QObject*, int>::iterator it = m_pending.find(session);
+	if (it != m_pending.end()) {
+		Config cfg("unreadmessages");
+		write(cfg, m_keys.value(session), it.value());
+		m_pending.erase(it);
+	}
+	m_keys.remove(session);
+}
+
+void UnreadMessagesKeeper::flush()
+{
+	m_flushTimer.stop();
+	if (m_pending.isEmpty())
+		return;
 	Config cfg("unreadmessages");
+	QHash<QObject*, int>::const_iterator it = m_pending.constBegin();
+	for (; it != m_pending.constEnd(); ++it)
+		write(cfg, m_keys.value(it.key()), it.value());
+	m_pending.clear();
+}
 
-	cfg.beginGroup(a->protocol()->id());
-	cfg.beginGroup(a->id());
+void UnreadMessagesKeeper::write(Config &cfg, const QStringList &key, int count)
+{
+	if (key.size() != 3)
+		return;
+	cfg.beginGroup(key.at(0));
+	cfg.beginGroup(key.at(1));
 
-	cfg.setValue(u->id(),list.count());
+	cfg.setValue(key.at(2),count);
 
 	cfg.endGroup();
 	cfg.endGroup();
@@ -28,6 +28,8 @@
 #define urlpreviewPLUGIN_H
 #include <qutim/plugin.h>
 #include <qutim/chatsession.h>
+#include <qutim/config.h>
+#include <QTimer>
 
 namespace qutim_sdk_0_3 {
 class ChatSession;
@@ -48,8 +50,15 @@ public:
 	virtual bool unload();
 private slots:
 	void sessionCreated(qutim_sdk_0_3::ChatSession*);
-	void onUnreadChanged(const qutim_sdk_0_3::MessageList &list);
+	void onUnreadCountChanged(int count);
+	void onSessionDestroyed(QObject *session);
+	void flush();
 private:
+	void write(Config &cfg, const QStringList &key, int count);
+	// Protocol, account and unit ids of every session
+	QHash<QObject*, QStringList> m_keys;
+	QHash<QObject*, int> m_pending;
+	QTimer m_flushTimer;
 };
 
 #endif
@@ -31,13 +31,10 @@
 #include <qutim/config.h>
 #include <qutim/chatsession.h>
 #include <qutim/utils.h>
-#include <qutim/json.h>
 
-#include <QNetworkAccessManager>
-#include <QNetworkReply>
-#include <QNetworkRequest>
 #include <QTextDocument>
 #include <QStringBuilder>
+#include <QCoreApplication>
 
 #include <QUrlQuery>
 
@@ -46,18 +43,25 @@ namespace UrlPreview {
 using namespace qutim_sdk_0_3;
 
 UrlHandler::UrlHandler() :
-	m_netman(new QNetworkAccessManager(this))
+	m_fetcher(new UrlFetcher(this))
 {
-	connect(m_netman, SIGNAL(authenticationRequired(QNetworkReply*,QAuthenticator*)),
-			SLOT(authenticationRequired(QNetworkReply*,QAuthenticator*))
-			);
-	connect(m_netman, SIGNAL(finished(QNetworkReply*)),
-			SLOT(netmanFinished(QNetworkReply*))
-			);
-	connect(m_netman, SIGNAL(sslErrors(QNetworkReply*,QList<QSslError>)),
-			SLOT(netmanSslErrors(QNetworkReply*,QList<QSslError>))
-			);
+	connect(m_fetcher, &UrlFetcher::metadataReady, this, &UrlHandler::onMetadataReady);
+	connect(m_fetcher, &UrlFetcher::richContentReady, this, &UrlHandler::onRichContentReady);
+	connect(qApp, SIGNAL(aboutToQuit()), SLOT(saveCache()));
 	loadSettings();
+	m_fetcher->cache().load();
+}
+
+UrlHandler::~UrlHandler()
+{
+	saveCache();
+}
+
+void UrlHandler::saveCache()
+{
+	UrlCache &cache = m_fetcher->cache();
+	debug() << "Url preview cache hits:" << cache.hits() << "misses:" << cache.misses();
+	cache.save();
 }
 
 void UrlHandler::loadSettings()
@@ -92,6 +96,10 @@ void UrlHandler::loadSettings()
 	m_enableHTML5Video = cfg.value("HTML5Video", true);
 	m_enableYandexRichContent = cfg.value("yandexRichContent", true);
 	m_exceptionList = cfg.value("exceptionList", QStringList());
+	m_fetcher->cache().setMaxSize(cfg.value("cacheSize", 1000));
+	m_fetcher->cache().setTimeToLive(cfg.value("cacheTimeToLive", 24 * 60 * 60),
+						  cfg.value("cacheFailedTimeToLive", 5 * 60));
+	m_fetcher->setMaxHostRequests(cfg.value("maxRequestsPerHost", 2));
 	cfg.endGroup();
 }
 
@@ -162,14 +170,17 @@ void UrlHandler::checkLink(const QStringRef &originalLink, QString &link, ChatUn
 		}
 	}
 
-	const QString uid = QString::number(id);
+	PendingPreview preview;
+	preview.unit = from;
+	preview.uid = QString::number(id);
 
-	QNetworkRequest request;
-	request.setUrl(QUrl(link));
-	request.setRawHeader("Ranges", "bytes=0-0");
-	QNetworkReply *reply = m_netman->head(request);
-	reply->setProperty("uid", uid);
-	reply->setProperty("unit", qVariantFromValue<ChatUnit *>(from));
+	// Links which are already known are previewed in place, the same link
+	// in history or in a crowded conference costs no network requests
+	QString html;
+	if (const UrlMetadata *data = m_fetcher->cache().find(link))
+		html = cachedPreview(link, *data, preview);
+	else
+		m_fetcher->requestMetadata(link, preview);
 
 	ChatSession *session = ChatLayer::get(from);
 
@@ -177,66 +188,77 @@ void UrlHandler::checkLink(const QStringRef &originalLink, QString &link, ChatUn
 	QMetaObject::invokeMethod(session, "evaluateJavaScript", Q_RETURN_ARG(QVariant, val), Q_ARG(QString, "nearBottom();"));
 	qDebug() << val;
 
-	link = QString::fromLatin1("%1 <span class='urlpreview' id='urlpreview%2' data-wasnearbottom='%3'></span> ")
-		   .arg(originalLink.toString(), uid, val.toString());
+	link = QString::fromLatin1("%1 <span class='urlpreview' id='urlpreview%2' data-wasnearbottom='%3'>%4</span> ")
+		   .arg(originalLink.toString(), preview.uid, val.toString(), html);
 }
 
-void UrlHandler::netmanFinished(QNetworkReply *reply)
+QString UrlHandler::cachedPreview(const QString &url, const UrlMetadata &data, const PendingPreview &preview)
 {
-	reply->deleteLater();
-
-	if (reply->property("yandexRCA").toBool()) {
-		QVariantMap data = Json::parse(reply->readAll()).toMap();
-
-		if (data.contains("title") || data.contains("content")) {
-			QString html = m_yandexRichContentTemplate;
-			html.replace("%URL%", data.value("finalurl").toString());
-			html.replace("%IMAGE%", data.value("img").toList().value(0).toString());
-			html.replace("%TITLE%", data.value("title").toString().replace("\n", "<br/>"));
-			html.replace("%CONTENT%", data.value("content").toString().replace("\n", "<br/>"));
-
-			updateData(reply->property("unit").value<ChatUnit *>(),
-					   reply->property("uid").toString(),
-					   html);
+	if (!data.isValid())
+		return QString();
+	if (needsRichContent(data)) {
+		if (data.richContent) {
+			// Rich content service may know nothing about the page
+			const QString html = richContentHtml(data);
+			if (!html.isEmpty())
+				return html;
+		} else {
+			m_fetcher->requestRichContent(url, data, QList<PendingPreview>() << preview);
 		}
-		return;
 	}
+	return previewHtml(url, data, preview.uid);
+}
 
-	QString url = reply->url().toString();
-	QByteArray typeheader;
-	QString type;
-	QByteArray sizeheader;
-	quint64 size = 0;
-	QRegExp hrx; hrx.setCaseSensitivity(Qt::CaseInsensitive);
-	foreach (QString header, reply->rawHeaderList()) {
-		if (type.isEmpty()) {
-			hrx.setPattern("^content-type$");
-			if (hrx.indexIn(header)==0) typeheader = header.toLatin1();
-		}
-		if (sizeheader.isEmpty()) {
-			hrx.setPattern("^content-range$");
-			if (hrx.indexIn(header)==0) sizeheader = header.toLatin1();
-		}
-		if (sizeheader.isEmpty()) {
-			hrx.setPattern("^content-length$");
-			if (hrx.indexIn(header)==0) sizeheader = header.toLatin1();
-		}
-	}
-	if (!typeheader.isEmpty()) {
-		hrx.setPattern("^([^\\;]+)");
-		if (hrx.indexIn(reply->rawHeader(typeheader))>=0)
-			type = hrx.cap(1);
-	}
-	if (!sizeheader.isEmpty()) {
-		hrx.setPattern("(\\d+)");
-		if (hrx.indexIn(reply->rawHeader(sizeheader))>=0)
-			size = hrx.cap(1).toInt();
-	}
+void UrlHandler::onRichContentReady(const QString &url, const UrlMetadata &data,
+									const QList<PendingPreview> &previews)
+{
+	Q_UNUSED(url);
+	const QString html = richContentHtml(data);
+	if (html.isEmpty())
+		return;
+	foreach (const PendingPreview &preview, previews)
+		updateData(preview.unit, preview.uid, html);
+}
 
-	if (type.isNull())
+void UrlHandler::onMetadataReady(const QString &url, const UrlMetadata &data,
+								 const QList<PendingPreview> &previews)
+{
+	if (!data.isValid())
 		return;
 
-	QString uid = reply->property("uid").toString();
+	if (needsRichContent(data))
+		m_fetcher->requestRichContent(url, data, previews);
+
+	foreach (const PendingPreview &preview, previews)
+		updateData(preview.unit, preview.uid, previewHtml(url, data, preview.uid));
+}
+
+bool UrlHandler::needsRichContent(const UrlMetadata &data) const
+{
+	const QString &type = data.type;
+	return m_enableYandexRichContent &&
+			(type == QLatin1String("text/html")
+			 || type == QLatin1String("text/xhtml")
+			 || type == QLatin1String("application/xhtml")
+			 || type == QLatin1String("application/xhtml+xml"));
+}
+
+QString UrlHandler::richContentHtml(const UrlMetadata &data) const
+{
+	if (data.title.isEmpty() && data.content.isEmpty())
+		return QString();
+	QString html = m_yandexRichContentTemplate;
+	html.replace("%URL%", data.finalUrl);
+	html.replace("%IMAGE%", data.thumbnail);
+	html.replace("%TITLE%", QString(data.title).replace("\n", "<br/>"));
+	html.replace("%CONTENT%", QString(data.content).replace("\n", "<br/>"));
+	return html;
+}
+
+QString UrlHandler::previewHtml(const QString &url, const UrlMetadata &data, const QString &uid) const
+{
+	const QString &type = data.type;
+	const quint64 size = data.size;
 
 	QString pstr;
 	bool showPreviewHead = true;
@@ -276,25 +298,6 @@ void UrlHandler::netmanFinished(QNetworkReply *reply)
 		pstr.replace("%SIZE%", QString::number(size));
 	}
 
-	if (m_enableYandexRichContent &&
-			(type == QLatin1String("text/html")
-			 || type == QLatin1String("text/xhtml")
-			 || type == QLatin1String("application/xhtml")
-			 || type == QLatin1String("application/xhtml+xml"))) {
-		QUrl rcaUrl(QLatin1String("http://rca.yandex.com/"));
-		QUrlQuery yaquery;
-		yaquery.addQueryItem("key", "svV1bfH1");
-		yaquery.addQueryItem("url", url.toUtf8().toPercentEncoding("", "+"));
-		rcaUrl.setQuery(yaquery);
-		//rcaUrl.addEncodedQueryItem("key", "svV1bfH1");
-		//rcaUrl.addEncodedQueryItem("url", url.toUtf8().toPercentEncoding("", "+"));
-		QNetworkRequest request(rcaUrl);
-		QNetworkReply *rcaReply = m_netman->get(request);
-		rcaReply->setProperty("yandexRCA", true);
-		rcaReply->setProperty("uid", reply->property("uid"));
-		rcaReply->setProperty("unit", reply->property("unit"));
-	}
-
 	if (showPreviewHead) {
 		QString sizestr = size ? QString::number(size) : tr("Unknown");
 		pstr = m_template;
@@ -312,9 +315,7 @@ void UrlHandler::netmanFinished(QNetworkReply *reply)
 		pstr += amsg;
 	}
 
-	updateData(reply->property("unit").value<ChatUnit *>(),
-			   uid,
-			   pstr);
+	return pstr;
 }
 
 void UrlHandler::updateData(ChatUnit *unit, const QString &uid, const QString &html)
@@ -325,19 +326,11 @@ void UrlHandler::updateData(ChatUnit *unit, const QString &uid, const QString &h
 				 % QString(html).replace("\"", "\\\"")
 				 % QLatin1Literal("\";")
 				 % QLatin1Literal("if(nearBottom() || urlpreview") % uid % QLatin1Literal(".getAttribute('data-wasnearbottom') == 'true'){scrollToBottom();}");
+	if (!unit)
+		return;
 	ChatSession *session = ChatLayer::get(unit);
 
 	QMetaObject::invokeMethod(session, "evaluateJavaScript", Q_ARG(QString, js));
 }
 
-void UrlHandler::authenticationRequired(QNetworkReply *, QAuthenticator *)
-{
-
-}
-
-void UrlHandler::netmanSslErrors(QNetworkReply *, const QList<QSslError> &)
-{
-
-}
-
 } // namespace UrlPreview
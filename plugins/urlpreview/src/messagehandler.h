@@ -28,14 +28,12 @@
 #ifndef URLPREVIEW_MESSAGEHANDLER_H
 #define URLPREVIEW_MESSAGEHANDLER_H
 #include <qutim/messagehandler.h>
-#include <QSslError>
+#include <qutim/chatunit.h>
 #include <QSize>
 #include <QStringList>
+#include "urlfetcher.h"
 
 
-class QNetworkAccessManager;
-class QNetworkReply;
-class QAuthenticator;
 namespace UrlPreview {
 
 enum PreviewFlag
@@ -52,6 +50,7 @@ class UrlHandler : public QObject, public qutim_sdk_0_3::MessageHandler
 	Q_OBJECT
 public:
 	explicit UrlHandler();
+	~UrlHandler();
 
 protected:
 	qutim_sdk_0_3::MessageHandlerAsyncResult doHandle(qutim_sdk_0_3::Message &message) override;
@@ -60,15 +59,21 @@ public slots:
 	void loadSettings();
 
 private slots:
-	void netmanFinished(QNetworkReply *);
-	void authenticationRequired(QNetworkReply *, QAuthenticator *);
-	void netmanSslErrors(QNetworkReply *, const QList<QSslError> &);
+	void onMetadataReady(const QString &url, const UrlPreview::UrlMetadata &data,
+						 const QList<UrlPreview::PendingPreview> &previews);
+	void onRichContentReady(const QString &url, const UrlPreview::UrlMetadata &data,
+							const QList<UrlPreview::PendingPreview> &previews);
+	void saveCache();
 
 private:
 	void checkLink(const QStringRef &originalLink, QString &url, qutim_sdk_0_3::ChatUnit *from, qint64 id);
 	void updateData(qutim_sdk_0_3::ChatUnit *unit, const QString &uid, const QString &html);
+	QString cachedPreview(const QString &url, const UrlMetadata &data, const PendingPreview &preview);
+	QString previewHtml(const QString &url, const UrlMetadata &data, const QString &uid) const;
+	QString richContentHtml(const UrlMetadata &data) const;
+	bool needsRichContent(const UrlMetadata &data) const;
 
-	QNetworkAccessManager *m_netman;
+	UrlFetcher *m_fetcher;
 	PreviewFlags m_flags;
 	QString m_template;
 	QString m_imageTemplate;
@@ -0,0 +1,164 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Aleksey Sidorov <gorthauer87@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "urlcache.h"
+#include <qutim/systeminfo.h>
+#include <qutim/debug.h>
+#include <QDateTime>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QDir>
+
+namespace UrlPreview {
+
+using namespace qutim_sdk_0_3;
+
+const quint32 URL_CACHE_MAGIC = 0x51555043; // "QUPC"
+const quint16 URL_CACHE_VERSION = 1;
+
+UrlCache::UrlCache()
+	: m_cache(1000), m_timeToLive(24 * 60 * 60), m_failedTimeToLive(5 * 60),
+	  m_hits(0), m_misses(0), m_changed(false)
+{
+}
+
+UrlCache::~UrlCache()
+{
+	save();
+}
+
+void UrlCache::setMaxSize(int size)
+{
+	m_cache.setMaxCost(size);
+}
+
+void UrlCache::setTimeToLive(int seconds, int failedSeconds)
+{
+	m_timeToLive = seconds;
+	m_failedTimeToLive = failedSeconds;
+}
+
+const UrlMetadata *UrlCache::find(const QString &url)
+{
+	// QCache::object moves the entry to the head of LRU list
+	UrlMetadata *data = m_cache.object(url);
+	if (data && data->expires < QDateTime::currentMSecsSinceEpoch() / 1000) {
+		m_cache.remove(url);
+		data = 0;
+	}
+	if (data)
+		++m_hits;
+	else
+		++m_misses;
+	return data;
+}
+
+void UrlCache::insert(const QString &url, const UrlMetadata &data)
+{
+	UrlMetadata *entry = new UrlMetadata(data);
+	// Failures may be temporary, so don't remember them for long
+	entry->expires = QDateTime::currentMSecsSinceEpoch() / 1000
+			+ (data.isValid() ? m_timeToLive : m_failedTimeToLive);
+	m_cache.insert(url, entry);
+	m_changed = true;
+}
+
+void UrlCache::update(const QString &url, const UrlMetadata &data)
+{
+	if (UrlMetadata *entry = m_cache.object(url)) {
+		qint64 expires = entry->expires;
+		*entry = data;
+		entry->expires = expires;
+		m_changed = true;
+	} else {
+		insert(url, data);
+	}
+}
+
+void UrlCache::updateFailed(const QString &url, const UrlMetadata &data)
+{
+	update(url, data);
+	if (UrlMetadata *entry = m_cache.object(url))
+		entry->expires = qMin(entry->expires, QDateTime::currentMSecsSinceEpoch() / 1000 + m_failedTimeToLive);
+}
+
+QString UrlCache::fileName() const
+{
+	if (!m_fileName.isEmpty())
+		return m_fileName;
+	return SystemInfo::getPath(SystemInfo::ConfigDir) + QLatin1String("/urlpreview/cache");
+}
+
+void UrlCache::load()
+{
+	QFile file(fileName());
+	if (!file.open(QIODevice::ReadOnly))
+		return;
+	QDataStream in(&file);
+	in.setVersion(QDataStream::Qt_5_0);
+	quint32 magic;
+	quint16 version;
+	in >> magic >> version;
+	if (magic != URL_CACHE_MAGIC || version != URL_CACHE_VERSION)
+		return;
+	const qint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
+	while (!in.atEnd() && in.status() == QDataStream::Ok) {
+		QString url;
+		UrlMetadata *data = new UrlMetadata;
+		in >> url >> data->type >> data->size >> data->expires >> data->richContent
+		   >> data->title >> data->content >> data->thumbnail >> data->finalUrl;
+		if (in.status() != QDataStream::Ok || data->expires < now)
+			delete data;
+		else
+			m_cache.insert(url, data);
+	}
+	m_changed = false;
+}
+
+void UrlCache::save()
+{
+	if (!m_changed)
+		return;
+	const QString name = fileName();
+	QDir().mkpath(QFileInfo(name).absolutePath());
+	QSaveFile file(name);
+	if (!file.open(QIODevice::WriteOnly)) {
+		warning() << "Can not write url preview cache to" << name;
+		return;
+	}
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_5_0);
+	out << URL_CACHE_MAGIC << URL_CACHE_VERSION;
+	foreach (const QString &url, m_cache.keys()) {
+		const UrlMetadata *data = m_cache.object(url);
+		out << url << data->type << data->size << data->expires << data->richContent
+			<< data->title << data->content << data->thumbnail << data->finalUrl;
+	}
+	if (file.commit())
+		m_changed = false;
+}
+
+} // namespace UrlPreview
@@ -0,0 +1,91 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Aleksey Sidorov <gorthauer87@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef URLPREVIEW_URLCACHE_H
+#define URLPREVIEW_URLCACHE_H
+
+#include <QCache>
+#include <QString>
+
+namespace UrlPreview {
+
+struct UrlMetadata
+{
+	UrlMetadata() : size(0), expires(0), richContent(false) {}
+
+	bool isValid() const { return !type.isEmpty(); }
+
+	QString type;
+	quint64 size;
+	// Time in seconds since epoch
+	qint64 expires;
+	// Result of Yandex rich content request, makes sense only for html pages
+	bool richContent;
+	QString title;
+	QString content;
+	QString thumbnail;
+	QString finalUrl;
+};
+
+// LRU cache of url metadata, the entries are persistent between sessions
+// and are forgotten after their expiration time
+class UrlCache
+{
+	Q_DISABLE_COPY(UrlCache)
+public:
+	UrlCache();
+	~UrlCache();
+
+	void setMaxSize(int size);
+	void setTimeToLive(int seconds, int failedSeconds);
+
+	const UrlMetadata *find(const QString &url);
+	void insert(const QString &url, const UrlMetadata &data);
+	void update(const QString &url, const UrlMetadata &data);
+	// Entry with failed update expires soon, so the url is requested again
+	void updateFailed(const QString &url, const UrlMetadata &data);
+
+	// Cache is stored in the profile by default
+	void setFileName(const QString &fileName) { m_fileName = fileName; }
+	QString fileName() const;
+	void load();
+	void save();
+
+	int hits() const { return m_hits; }
+	int misses() const { return m_misses; }
+
+private:
+	QString m_fileName;
+	QCache<QString, UrlMetadata> m_cache;
+	int m_timeToLive;
+	int m_failedTimeToLive;
+	int m_hits;
+	int m_misses;
+	bool m_changed;
+};
+
+} // namespace UrlPreview
+
+#endif // URLPREVIEW_URLCACHE_H
@@ -0,0 +1,186 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Aleksey Sidorov <gorthauer87@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "urlfetcher.h"
+#include <qutim/json.h>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QUrlQuery>
+#include <QRegExp>
+
+namespace UrlPreview {
+
+using namespace qutim_sdk_0_3;
+
+const QNetworkRequest::Attribute UrlKeyAttribute = QNetworkRequest::Attribute(QNetworkRequest::User);
+const QNetworkRequest::Attribute RichContentAttribute = QNetworkRequest::Attribute(QNetworkRequest::User + 1);
+
+UrlFetcher::UrlFetcher(QObject *parent)
+	: QObject(parent), m_netman(new QNetworkAccessManager(this)),
+	  m_richContentService(QLatin1String("http://rca.yandex.com/")), m_maxHostRequests(2)
+{
+	connect(m_netman, SIGNAL(finished(QNetworkReply*)), SLOT(onFinished(QNetworkReply*)));
+}
+
+UrlFetcher::~UrlFetcher()
+{
+}
+
+void UrlFetcher::requestMetadata(const QString &url, const PendingPreview &preview)
+{
+	QHash<QString, PendingRequest>::iterator it = m_pending.find(url);
+	if (it != m_pending.end()) {
+		it->previews << preview;
+		return;
+	}
+	m_pending[url].previews << preview;
+
+	QNetworkRequest request;
+	request.setUrl(QUrl(url));
+	request.setRawHeader("Ranges", "bytes=0-0");
+	request.setAttribute(UrlKeyAttribute, url);
+	sendRequest(request);
+}
+
+void UrlFetcher::requestRichContent(const QString &url, const UrlMetadata &data,
+									const QList<PendingPreview> &previews)
+{
+	QHash<QString, PendingRequest>::iterator it = m_pendingRichContent.find(url);
+	if (it != m_pendingRichContent.end()) {
+		it->previews << previews;
+		return;
+	}
+	PendingRequest &pending = m_pendingRichContent[url];
+	pending.data = data;
+	pending.previews = previews;
+
+	QUrl rcaUrl(m_richContentService);
+	QUrlQuery yaquery;
+	yaquery.addQueryItem("key", "svV1bfH1");
+	yaquery.addQueryItem("url", url.toUtf8().toPercentEncoding("", "+"));
+	rcaUrl.setQuery(yaquery);
+	QNetworkRequest request(rcaUrl);
+	request.setAttribute(UrlKeyAttribute, url);
+	request.setAttribute(RichContentAttribute, true);
+	sendRequest(request);
+}
+
+void UrlFetcher::sendRequest(const QNetworkRequest &request)
+{
+	const QString host = request.url().host();
+	int &active = m_hostRequests[host];
+	if (active >= m_maxHostRequests) {
+		m_hostQueues[host].enqueue(request);
+		return;
+	}
+	++active;
+	if (request.attribute(RichContentAttribute).toBool())
+		m_netman->get(request);
+	else
+		m_netman->head(request);
+}
+
+void UrlFetcher::finishRequest(const QUrl &url)
+{
+	const QString host = url.host();
+	QHash<QString, int>::iterator it = m_hostRequests.find(host);
+	if (it == m_hostRequests.end())
+		return;
+	if (--it.value() <= 0)
+		m_hostRequests.erase(it);
+	QHash<QString, QQueue<QNetworkRequest> >::iterator queue = m_hostQueues.find(host);
+	if (queue != m_hostQueues.end()) {
+		QNetworkRequest request = queue->dequeue();
+		if (queue->isEmpty())
+			m_hostQueues.erase(queue);
+		sendRequest(request);
+	}
+}
+
+void UrlFetcher::onFinished(QNetworkReply *reply)
+{
+	reply->deleteLater();
+	finishRequest(reply->request().url());
+	const QString key = reply->request().attribute(UrlKeyAttribute).toString();
+
+	if (reply->request().attribute(RichContentAttribute).toBool()) {
+		PendingRequest pending = m_pendingRichContent.take(key);
+		UrlMetadata &metadata = pending.data;
+		metadata.richContent = true;
+		// Remember the failure for a while, waiting previews keep the plain content
+		if (reply->error() != QNetworkReply::NoError) {
+			m_cache.updateFailed(key, metadata);
+			emit richContentReady(key, metadata, pending.previews);
+			return;
+		}
+		QVariantMap data = Json::parse(reply->readAll()).toMap();
+
+		if (data.contains("title") || data.contains("content")) {
+			metadata.finalUrl = data.value("finalurl").toString();
+			metadata.thumbnail = data.value("img").toList().value(0).toString();
+			metadata.title = data.value("title").toString();
+			metadata.content = data.value("content").toString();
+		}
+		m_cache.update(key, metadata);
+		emit richContentReady(key, metadata, pending.previews);
+		return;
+	}
+
+	PendingRequest pending = m_pending.take(key);
+	UrlMetadata &metadata = pending.data;
+	QByteArray typeheader;
+	QByteArray sizeheader;
+	QRegExp hrx; hrx.setCaseSensitivity(Qt::CaseInsensitive);
+	foreach (QString header, reply->rawHeaderList()) {
+		if (typeheader.isEmpty()) {
+			hrx.setPattern("^content-type$");
+			if (hrx.indexIn(header)==0) typeheader = header.toLatin1();
+		}
+		if (sizeheader.isEmpty()) {
+			hrx.setPattern("^content-range$");
+			if (hrx.indexIn(header)==0) sizeheader = header.toLatin1();
+		}
+		if (sizeheader.isEmpty()) {
+			hrx.setPattern("^content-length$");
+			if (hrx.indexIn(header)==0) sizeheader = header.toLatin1();
+		}
+	}
+	if (!typeheader.isEmpty()) {
+		hrx.setPattern("^([^\\;]+)");
+		if (hrx.indexIn(reply->rawHeader(typeheader))>=0)
+			metadata.type = hrx.cap(1);
+	}
+	if (!sizeheader.isEmpty()) {
+		hrx.setPattern("(\\d+)");
+		if (hrx.indexIn(reply->rawHeader(sizeheader))>=0)
+			metadata.size = hrx.cap(1).toInt();
+	}
+
+	// Remember failures too, so broken links are not requested by every message
+	m_cache.insert(key, metadata);
+	emit metadataReady(key, metadata, pending.previews);
+}
+
+} // namespace UrlPreview
@@ -0,0 +1,96 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Aleksey Sidorov <gorthauer87@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef URLPREVIEW_URLFETCHER_H
+#define URLPREVIEW_URLFETCHER_H
+
+#include <QObject>
+#include <QHash>
+#include <QQueue>
+#include <QPointer>
+#include <QNetworkRequest>
+#include <qutim/chatunit.h>
+#include "urlcache.h"
+
+class QNetworkAccessManager;
+class QNetworkReply;
+
+namespace UrlPreview {
+
+struct PendingPreview
+{
+	QPointer<qutim_sdk_0_3::ChatUnit> unit;
+	QString uid;
+};
+
+// Request shared by all previews of the same url
+struct PendingRequest
+{
+	UrlMetadata data;
+	QList<PendingPreview> previews;
+};
+
+// Resolves metadata of urls through the cache, concurrent lookups of the
+// same url share one request and every host has a limit of active requests
+class UrlFetcher : public QObject
+{
+	Q_OBJECT
+public:
+	explicit UrlFetcher(QObject *parent = 0);
+	~UrlFetcher();
+
+	UrlCache &cache() { return m_cache; }
+	void setMaxHostRequests(int count) { m_maxHostRequests = qMax(count, 1); }
+	void setRichContentService(const QUrl &url) { m_richContentService = url; }
+
+	void requestMetadata(const QString &url, const PendingPreview &preview);
+	void requestRichContent(const QString &url, const UrlMetadata &data, const QList<PendingPreview> &previews);
+
+signals:
+	void metadataReady(const QString &url, const UrlPreview::UrlMetadata &data,
+					   const QList<UrlPreview::PendingPreview> &previews);
+	void richContentReady(const QString &url, const UrlPreview::UrlMetadata &data,
+						  const QList<UrlPreview::PendingPreview> &previews);
+
+private slots:
+	void onFinished(QNetworkReply *reply);
+
+private:
+	void sendRequest(const QNetworkRequest &request);
+	void finishRequest(const QUrl &url);
+
+	QNetworkAccessManager *m_netman;
+	UrlCache m_cache;
+	QUrl m_richContentService;
+	QHash<QString, PendingRequest> m_pending;
+	QHash<QString, PendingRequest> m_pendingRichContent;
+	QHash<QString, int> m_hostRequests;
+	QHash<QString, QQueue<QNetworkRequest> > m_hostQueues;
+	int m_maxHostRequests;
+};
+
+} // namespace UrlPreview
+
+#endif // URLPREVIEW_URLFETCHER_H
@@ -0,0 +1,263 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Aleksey Sidorov <gorthauer87@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "urlfetcher.h"
+#include <QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+
+using namespace UrlPreview;
+
+Q_DECLARE_METATYPE(UrlPreview::UrlMetadata)
+Q_DECLARE_METATYPE(QList<UrlPreview::PendingPreview>)
+
+// Minimal HTTP server, answers after a delay so requests have a chance to overlap
+class HttpServer : public QTcpServer
+{
+	Q_OBJECT
+public:
+	HttpServer() : active(0), maxActive(0), requests(0)
+	{
+		listen(QHostAddress::LocalHost);
+		connect(this, &QTcpServer::newConnection, this, &HttpServer::onNewConnection);
+	}
+
+	QString url(const QString &path) const
+	{
+		return QStringLiteral("http://127.0.0.1:%1%2").arg(serverPort()).arg(path);
+	}
+
+	int active;
+	int maxActive;
+	int requests;
+	QHash<QString, int> paths;
+
+private slots:
+	void onNewConnection()
+	{
+		while (QTcpSocket *socket = nextPendingConnection()) {
+			connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+			connect(socket, &QTcpSocket::readyRead, this, [this, socket] () {
+				if (!socket->canReadLine() || socket->property("handled").toBool())
+					return;
+				socket->setProperty("handled", true);
+				const QList<QByteArray> line = socket->readLine().split(' ');
+				const QString path = QString::fromLatin1(line.value(1));
+				++requests;
+				++paths[QUrl(path).path()];
+				maxActive = qMax(maxActive, ++active);
+				QTimer::singleShot(50, socket, [this, socket, path] () {
+					--active;
+					socket->write(response(path));
+					socket->disconnectFromHost();
+				});
+			});
+		}
+	}
+
+private:
+	QByteArray response(const QString &path)
+	{
+		if (path.startsWith(QLatin1String("/missing")))
+			return "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+		if (path.startsWith(QLatin1String("/rca"))) {
+			const QByteArray body = "{\"title\": \"Page title\", \"content\": \"Page content\"}";
+			return "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: "
+					+ QByteArray::number(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+		}
+		if (path.startsWith(QLatin1String("/page")))
+			return "HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=utf-8\r\nContent-Length: 100\r\nConnection: close\r\n\r\n";
+		return "HTTP/1.1 200 OK\r\nContent-Type: image/png\r\nContent-Length: 1234\r\nConnection: close\r\n\r\n";
+	}
+};
+
+class UrlPreviewTest : public QObject
+{
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void init();
+	void cleanup();
+	void sharedRequest();
+	void hostLimit();
+	void hitRatio();
+	void failedLookup();
+	void richContent();
+	void failedRichContent();
+	void persistence();
+
+private:
+	QScopedPointer<QTemporaryDir> m_dir;
+	QScopedPointer<HttpServer> m_server;
+	QScopedPointer<UrlFetcher> m_fetcher;
+};
+
+void UrlPreviewTest::initTestCase()
+{
+	qRegisterMetaType<UrlPreview::UrlMetadata>();
+	qRegisterMetaType<QList<UrlPreview::PendingPreview> >();
+}
+
+void UrlPreviewTest::init()
+{
+	m_dir.reset(new QTemporaryDir);
+	m_server.reset(new HttpServer);
+	QVERIFY(m_server->isListening());
+	m_fetcher.reset(new UrlFetcher);
+	m_fetcher->cache().setFileName(m_dir->path() + QStringLiteral("/cache"));
+}
+
+void UrlPreviewTest::cleanup()
+{
+	m_fetcher.reset();
+	m_server.reset();
+	m_dir.reset();
+}
+
+void UrlPreviewTest::sharedRequest()
+{
+	QSignalSpy spy(m_fetcher.data(), SIGNAL(metadataReady(QString,UrlPreview::UrlMetadata,QList<UrlPreview::PendingPreview>)));
+	const QString url = m_server->url(QStringLiteral("/image.png"));
+	for (int i = 0; i < 10; ++i) {
+		PendingPreview preview;
+		preview.uid = QString::number(i);
+		m_fetcher->requestMetadata(url, preview);
+	}
+	QTRY_COMPARE(spy.count(), 1);
+	QCOMPARE(m_server->requests, 1);
+	QCOMPARE(spy.at(0).at(2).value<QList<PendingPreview> >().size(), 10);
+}
+
+void UrlPreviewTest::hostLimit()
+{
+	m_fetcher->setMaxHostRequests(2);
+	QSignalSpy spy(m_fetcher.data(), SIGNAL(metadataReady(QString,UrlPreview::UrlMetadata,QList<UrlPreview::PendingPreview>)));
+	for (int i = 0; i < 8; ++i)
+		m_fetcher->requestMetadata(m_server->url(QStringLiteral("/image%1.png").arg(i)), PendingPreview());
+	QTRY_COMPARE(spy.count(), 8);
+	QCOMPARE(m_server->requests, 8);
+	QVERIFY(m_server->maxActive <= 2);
+}
+
+void UrlPreviewTest::hitRatio()
+{
+	QSignalSpy spy(m_fetcher.data(), SIGNAL(metadataReady(QString,UrlPreview::UrlMetadata,QList<UrlPreview::PendingPreview>)));
+	const QString url = m_server->url(QStringLiteral("/image.png"));
+	UrlCache &cache = m_fetcher->cache();
+	QVERIFY(!cache.find(url));
+	m_fetcher->requestMetadata(url, PendingPreview());
+	QTRY_COMPARE(spy.count(), 1);
+
+	for (int i = 0; i < 99; ++i) {
+		const UrlMetadata *data = cache.find(url);
+		QVERIFY(data);
+		QCOMPARE(data->type, QStringLiteral("image/png"));
+		QCOMPARE(data->size, quint64(1234));
+	}
+	QCOMPARE(cache.hits(), 99);
+	QCOMPARE(cache.misses(), 1);
+	QCOMPARE(m_server->requests, 1);
+}
+
+void UrlPreviewTest::failedLookup()
+{
+	QSignalSpy spy(m_fetcher.data(), SIGNAL(metadataReady(QString,UrlPreview::UrlMetadata,QList<UrlPreview::PendingPreview>)));
+	const QString url = m_server->url(QStringLiteral("/missing"));
+	m_fetcher->requestMetadata(url, PendingPreview());
+	QTRY_COMPARE(spy.count(), 1);
+	// Failure is remembered, so the link is not requested again by the next message
+	const UrlMetadata *data = m_fetcher->cache().find(url);
+	QVERIFY(data);
+	QVERIFY(!data->isValid());
+}
+
+void UrlPreviewTest::richContent()
+{
+	m_fetcher->setRichContentService(QUrl(m_server->url(QStringLiteral("/rca"))));
+	QSignalSpy metadata(m_fetcher.data(), SIGNAL(metadataReady(QString,UrlPreview::UrlMetadata,QList<UrlPreview::PendingPreview>)));
+	QSignalSpy rich(m_fetcher.data(), SIGNAL(richContentReady(QString,UrlPreview::UrlMetadata,QList<UrlPreview::PendingPreview>)));
+	const QString url = m_server->url(QStringLiteral("/page.html"));
+	m_fetcher->requestMetadata(url, PendingPreview());
+	QTRY_COMPARE(metadata.count(), 1);
+	const UrlMetadata data = metadata.at(0).at(1).value<UrlMetadata>();
+	for (int i = 0; i < 5; ++i)
+		m_fetcher->requestRichContent(url, data, QList<PendingPreview>() << PendingPreview());
+	QTRY_COMPARE(rich.count(), 1);
+	QCOMPARE(m_server->paths.value(QStringLiteral("/rca")), 1);
+	QCOMPARE(rich.at(0).at(2).value<QList<PendingPreview> >().size(), 5);
+
+	const UrlMetadata *cached = m_fetcher->cache().find(url);
+	QVERIFY(cached);
+	QVERIFY(cached->richContent);
+	QCOMPARE(cached->title, QStringLiteral("Page title"));
+	QCOMPARE(cached->content, QStringLiteral("Page content"));
+}
+
+void UrlPreviewTest::failedRichContent()
+{
+	m_fetcher->setRichContentService(QUrl(m_server->url(QStringLiteral("/missing-rca"))));
+	QSignalSpy metadata(m_fetcher.data(), SIGNAL(metadataReady(QString,UrlPreview::UrlMetadata,QList<UrlPreview::PendingPreview>)));
+	QSignalSpy rich(m_fetcher.data(), SIGNAL(richContentReady(QString,UrlPreview::UrlMetadata,QList<UrlPreview::PendingPreview>)));
+	const QString url = m_server->url(QStringLiteral("/page.html"));
+	m_fetcher->requestMetadata(url, PendingPreview());
+	QTRY_COMPARE(metadata.count(), 1);
+	const UrlMetadata data = metadata.at(0).at(1).value<UrlMetadata>();
+	for (int i = 0; i < 3; ++i)
+		m_fetcher->requestRichContent(url, data, QList<PendingPreview>() << PendingPreview());
+	// Waiting previews are resolved by the failure too
+	QTRY_COMPARE(rich.count(), 1);
+	QCOMPARE(rich.at(0).at(2).value<QList<PendingPreview> >().size(), 3);
+	QVERIFY(rich.at(0).at(1).value<UrlMetadata>().title.isEmpty());
+
+	// Rich content is not requested again by the next message for a while
+	const UrlMetadata *cached = m_fetcher->cache().find(url);
+	QVERIFY(cached);
+	QVERIFY(cached->richContent);
+	QCOMPARE(cached->type, QStringLiteral("text/html"));
+	QVERIFY(cached->expires <= QDateTime::currentMSecsSinceEpoch() / 1000 + 5 * 60);
+	QCOMPARE(m_server->paths.value(QStringLiteral("/missing-rca")), 1);
+}
+
+void UrlPreviewTest::persistence()
+{
+	QSignalSpy spy(m_fetcher.data(), SIGNAL(metadataReady(QString,UrlPreview::UrlMetadata,QList<UrlPreview::PendingPreview>)));
+	const QString url = m_server->url(QStringLiteral("/image.png"));
+	m_fetcher->requestMetadata(url, PendingPreview());
+	QTRY_COMPARE(spy.count(), 1);
+	m_fetcher->cache().save();
+
+	UrlCache cache;
+	cache.setFileName(m_fetcher->cache().fileName());
+	cache.load();
+	const UrlMetadata *data = cache.find(url);
+	QVERIFY(data);
+	QCOMPARE(data->type, QStringLiteral("image/png"));
+	QCOMPARE(cache.hits(), 1);
+}
+
+QTEST_MAIN(UrlPreviewTest)
+
+#include "urlpreviewtest.moc"
@@ -126,10 +126,10 @@ QWidget* WinIntegration::oneOfChatWindows()
 
 void WinIntegration::onSessionCreated(qutim_sdk_0_3::ChatSession *s)
 {
-	connect(s, SIGNAL(unreadChanged(qutim_sdk_0_3::MessageList)), SLOT(onUnreadChanged(qutim_sdk_0_3::MessageList)), Qt::UniqueConnection);
+	connect(s, SIGNAL(unreadCountChanged(int)), SLOT(onUnreadChanged()), Qt::UniqueConnection);
 }
 
-void WinIntegration::onUnreadChanged(qutim_sdk_0_3::MessageList)
+void WinIntegration::onUnreadChanged()
 {
 	QList<ChatSession*> sessions = ChatLayer::instance()->sessions();
 	quint32 unreadConfs = 0, unreadChats = 0;
@@ -139,7 +139,7 @@ void WinIntegration::onUnreadChanged(qutim_sdk_0_3::MessageList)
 			continue;
 		}
 		ChatUnit *unit      = s->getUnit();
-		unsigned unreadSize = s->unread().size();
+		unsigned unreadSize = s->unreadCount();
 		if (qobject_cast<Conference*>(unit))
 			unreadConfs += unreadSize;
 		else
@@ -77,7 +77,7 @@ signals:
 
 public slots:
 	void onSessionCreated(qutim_sdk_0_3::ChatSession*);
-	void onUnreadChanged(qutim_sdk_0_3::MessageList);
+	void onUnreadChanged();
 	void onSettingsSaved();
 	void updateAssocs();
 
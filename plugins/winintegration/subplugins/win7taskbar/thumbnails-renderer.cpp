@@ -111,7 +111,7 @@ void WThumbnailsProvider::onUnreadChanged(qutim_sdk_0_3::MessageList list)
 		session = sessions.at(index++);
 		unit    = session->unit();
 		title   = unit->   title();
-		unread  = session->unread().size();
+		unread  = session->unreadCount();
 		if (!unread)
 			continue;
 		else
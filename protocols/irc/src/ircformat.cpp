@@ -0,0 +1,267 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Alexey Prokhin <alexey.prokhin@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "ircformat.h"
+
+namespace qutim_sdk_0_3 {
+
+namespace irc {
+
+const char *IrcFormat::colorByMircCode(int code)
+{
+	static const char * const colors[] = {
+		"white",
+		"black",
+		"blue",
+		"green",
+		"#FA5A5A", //lightred
+		"brown",
+		"purple",
+		"orange",
+		"yellow",
+		"lightgreen",
+		"cyan",
+		"lightcyan",
+		"lightblue",
+		"pink",
+		"grey",
+		"lightgrey"
+	};
+	if (code >= 0 && code < int(sizeof(colors) / sizeof(colors[0])))
+		return colors[code];
+	return 0;
+}
+
+// Reads up to two digits of mIRC colour code, code is -1 if there are no digits
+static const QChar *parseColorCode(const QChar *s, const QChar *end, int *code)
+{
+	*code = -1;
+	bool ok = true;
+	int value = 0;
+	const QChar *digits = s;
+	for (; s != end && s - digits < 2 && s->isDigit(); ++s) {
+		// Other digits are matched too, but QString::toInt() never accepted them
+		ok = ok && s->unicode() <= '9';
+		value = value * 10 + s->digitValue();
+	}
+	if (s != digits && ok)
+		*code = value;
+	return s;
+}
+
+// Parses "\003[fg[,bg]]" sequence, s points right after \003
+static const QChar *parseColors(const QChar *s, const QChar *end, int *fg, int *bg)
+{
+	s = parseColorCode(s, end, fg);
+	*bg = -1;
+	// Comma without digits after it is a plain text
+	if (end - s >= 2 && *s == QLatin1Char(',') && s[1].isDigit())
+		s = parseColorCode(s + 1, end, bg);
+	return s;
+}
+
+namespace {
+
+enum FormatTag
+{
+	BoldTag,
+	UnderlineTag,
+	ItalicTag,
+	ColorTag,
+	FormatTagCount
+};
+
+// Tags to be closed by \017, the most recent one goes first
+class ResettingTags
+{
+public:
+	ResettingTags() : m_size(0) {}
+	void push(FormatTag tag)
+	{
+		Q_ASSERT(m_size < FormatTagCount);
+		for (int i = m_size; i > 0; --i)
+			m_tags[i] = m_tags[i - 1];
+		m_tags[0] = tag;
+		++m_size;
+	}
+	bool remove(FormatTag tag)
+	{
+		for (int i = 0; i < m_size; ++i) {
+			if (m_tags[i] != tag)
+				continue;
+			for (--m_size; i < m_size; ++i)
+				m_tags[i] = m_tags[i + 1];
+			return true;
+		}
+		return false;
+	}
+	void close(QString &result)
+	{
+		static const char * const closingTags[] = { "</b>", "</u>", "</i>", "</font>" };
+		for (int i = 0; i < m_size; ++i)
+			result += QLatin1String(closingTags[m_tags[i]]);
+		m_size = 0;
+	}
+private:
+	FormatTag m_tags[FormatTagCount];
+	int m_size;
+};
+
+}
+
+static inline bool isFormatCode(ushort ch)
+{
+	return ch == '\002' || ch == '\003' || ch == '\017' || ch == '\026' || ch == '\037';
+}
+
+static inline bool isHtmlSpecial(ushort ch)
+{
+	return ch == '<' || ch == '>' || ch == '&' || ch == '"' || isFormatCode(ch);
+}
+
+static void toggleFormat(QString &result, ResettingTags &tags, bool &enabled, FormatTag tag)
+{
+	static const char * const openingTags[] = { "<b>", "<u>", "<i>" };
+	static const char * const closingTags[] = { "</b>", "</u>", "</i>" };
+	if (!enabled) {
+		result += QLatin1String(openingTags[tag]);
+		tags.push(tag);
+	} else {
+		result += QLatin1String(closingTags[tag]);
+		tags.remove(tag);
+	}
+	enabled = !enabled;
+}
+
+QString IrcFormat::toHtml(const QString &msg, bool enableColoring)
+{
+	// \002 bold
+	// \037 underlined
+	// \026 italic
+	// \017 normal
+	// \003xx,xx color
+	QString result;
+	result.reserve(msg.size() + msg.size() / 8 + 32);
+	ResettingTags resettingTags;
+	bool bold = false;
+	bool underlined = false;
+	bool italic = false;
+	const QChar *s = msg.constData();
+	const QChar *end = s + msg.size();
+	const QChar *plain = s;
+	while (s != end) {
+		const ushort ch = s->unicode();
+		// Both format codes and characters to be escaped are below '?'
+		if (ch > '>' || !isHtmlSpecial(ch)) {
+			++s;
+			continue;
+		}
+		result.append(plain, s - plain);
+		++s;
+		switch (ch) {
+		case '<':
+			result += QLatin1String("&lt;");
+			break;
+		case '>':
+			result += QLatin1String("&gt;");
+			break;
+		case '&':
+			result += QLatin1String("&amp;");
+			break;
+		case '"':
+			result += QLatin1String("&quot;");
+			break;
+		case '\002':
+			toggleFormat(result, resettingTags, bold, BoldTag);
+			break;
+		case '\037':
+			toggleFormat(result, resettingTags, underlined, UnderlineTag);
+			break;
+		case '\026':
+			toggleFormat(result, resettingTags, italic, ItalicTag);
+			break;
+		case '\017':
+			resettingTags.close(result);
+			break;
+		case '\003': {
+			int fg, bg;
+			s = parseColors(s, end, &fg, &bg);
+			if (!enableColoring)
+				break;
+			const char *fontColor = colorByMircCode(fg);
+			const char *backgroundColor = colorByMircCode(bg);
+			// Resetting all colors
+			if (resettingTags.remove(ColorTag))
+				result += QLatin1String("</font>");
+			if (fontColor || backgroundColor) {
+				result += QLatin1String("<span style=\"");
+				if (fontColor) {
+					result += QLatin1String("color: ");
+					result += QLatin1String(fontColor);
+					result += QLatin1Char(';');
+				}
+				if (backgroundColor) {
+					result += QLatin1String("background-color: ");
+					result += QLatin1String(backgroundColor);
+					result += QLatin1Char(';');
+				}
+				result += QLatin1String("\">");
+				resettingTags.push(ColorTag);
+			}
+			break;
+		}
+		}
+		plain = s;
+	}
+	result.append(plain, end - plain);
+	return result;
+}
+
+QString IrcFormat::toPlainText(const QString &msg)
+{
+	QString result;
+	result.reserve(msg.size());
+	const QChar *s = msg.constData();
+	const QChar *end = s + msg.size();
+	const QChar *plain = s;
+	while (s != end) {
+		const ushort ch = s->unicode();
+		if (ch > '\037' || !isFormatCode(ch)) {
+			++s;
+			continue;
+		}
+		result.append(plain, s - plain);
+		++s;
+		if (ch == '\003') {
+			int fg, bg;
+			s = parseColors(s, end, &fg, &bg);
+		}
+		plain = s;
+	}
+	result.append(plain, end - plain);
+	return result;
+}
+
+} } // namespace qutim_sdk_0_3::irc
@@ -0,0 +1,46 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Alexey Prokhin <alexey.prokhin@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef IRCFORMAT_H
+#define IRCFORMAT_H
+
+#include <QString>
+
+namespace qutim_sdk_0_3 {
+
+namespace irc {
+
+// Converts messages with mIRC formatting codes
+class IrcFormat
+{
+public:
+	static QString toHtml(const QString &msg, bool enableColoring = true);
+	static QString toPlainText(const QString &msg);
+	static const char *colorByMircCode(int code);
+};
+
+} } // namespace qutim_sdk_0_3::irc
+
+#endif // IRCFORMAT_H
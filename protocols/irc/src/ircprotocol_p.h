@@ -40,7 +40,6 @@ class IrcProtocolPrivate
 public:
 	inline IrcProtocolPrivate() { }
 	inline ~IrcProtocolPrivate() { }
-	static QString getColorByMircCode(const QString &code);
 	QHash<QString, QPointer<IrcAccount> > accounts_hash;
 	QPointer<ChatSession> activeSession;
 	ActionGenerator *autojoinAction;
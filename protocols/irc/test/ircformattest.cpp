@@ -0,0 +1,339 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Alexey Prokhin <alexey.prokhin@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "ircformat.h"
+#include <QtTest>
+#include <QFile>
+#include <QRegExp>
+#include <QStringList>
+
+using namespace qutim_sdk_0_3::irc;
+
+// Regexp based conversion which was used before IrcFormat, output of both
+// must be the same
+namespace reference {
+
+static QRegExp formatRx("(\\002|\\037|\\026|\\017|\\003((\\d{0,2})(,\\d{1,2}|)|))");
+
+static QString getColorByMircCode(const QString &code)
+{
+	static QStringList colors = QStringList()
+								<< "white"
+								<< "black"
+								<< "blue"
+								<< "green"
+								<< "#FA5A5A" //lightred
+								<< "brown"
+								<< "purple"
+								<< "orange"
+								<< "yellow"
+								<< "lightgreen"
+								<< "cyan"
+								<< "lightcyan"
+								<< "lightblue"
+								<< "pink"
+								<< "grey"
+								<< "lightgrey";
+	bool ok;
+	int c = code.toInt(&ok);
+	if (ok)
+		return colors.value(c);
+	else
+		return QString();
+}
+
+static QString ircFormatToHtml(const QString &msg_helper, bool enableColoring)
+{
+	QString msg = msg_helper.toHtmlEscaped();
+	QString result;
+	result.reserve(msg.size() + 20);
+	QStringList resettingTags; // list of tags for resetting format
+	bool bold = false;
+	bool underlined = false;
+	bool italic = false;
+	int pos = 0, oldPos = 0;
+	while ((pos = formatRx.indexIn(msg, pos)) != -1) {
+		QString tmp = msg.mid(oldPos, pos - oldPos);
+		result += tmp;
+		QChar f = formatRx.cap(1).at(0);
+		if (f == '\002') { // bold
+			if (!bold) {
+				result += "<b>";
+				resettingTags.prepend("</b>");
+			} else {
+				result += "</b>";
+				resettingTags.removeOne("</b>");
+			}
+			bold = !bold;
+		} else if (f == '\037') { // underlined
+			if (!underlined) {
+				result += "<u>";
+				resettingTags.prepend("</u>");
+			} else {
+				result += "</u>";
+				resettingTags.removeOne("</u>");
+			}
+			underlined = !underlined;
+		} else if (f == '\026') { // italic
+			if (!italic) {
+				result += "<i>";
+				resettingTags.prepend("</i>");
+			} else {
+				result += "</i>";
+				resettingTags.removeOne("</i>");
+			}
+			italic = !italic;
+		} else if (f == '\017') { // normal
+			result += resettingTags.join("");
+			resettingTags.clear();
+		} else { // color
+			if (enableColoring) {
+				QString fontColor = getColorByMircCode(formatRx.cap(3));
+				QString backgroundColor = getColorByMircCode(formatRx.cap(4).mid(1));
+				// Resetting all colors
+				if (resettingTags.removeOne("</font>"))
+					result += "</font>";
+				if (!fontColor.isEmpty() || !backgroundColor.isEmpty()) {
+					result += "<span style=\"";
+					if (!fontColor.isEmpty())
+						result += "color: " + fontColor + ";";
+					if (!backgroundColor.isEmpty())
+						result += "background-color: " + backgroundColor + ";";
+					result += "\">";
+					resettingTags.prepend("</font>");
+				}
+			}
+		}
+		pos += formatRx.matchedLength();
+		oldPos = pos;
+	}
+	QString tmp = msg.mid(oldPos);
+	result += tmp;
+	return result;
+}
+
+static QString ircFormatToPlainText(const QString &msg)
+{
+	QString result;
+	result.reserve(msg.size());
+	int pos = 0, oldPos = 0;
+	while ((pos = formatRx.indexIn(msg, pos)) != -1) {
+		result += msg.mid(oldPos, pos - oldPos);
+		pos += formatRx.matchedLength();
+		oldPos = pos;
+	}
+	result += msg.mid(oldPos);
+	return result;
+}
+
+} // namespace reference
+
+class IrcFormatTest : public QObject
+{
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void fixed_data();
+	void fixed();
+	void fuzz();
+	void toHtml_data();
+	void toHtml();
+	void toPlainText_data();
+	void toPlainText();
+
+private:
+	void compare(const QString &msg);
+	QStringList m_log;
+};
+
+static QString escaped(const QString &str)
+{
+	QString result;
+	foreach (const QChar &ch, str) {
+		if (ch.unicode() < 0x20 || ch.unicode() > 0x7e)
+			result += QString::fromLatin1("\\u%1").arg(ch.unicode(), 4, 16, QLatin1Char('0'));
+		else
+			result += ch;
+	}
+	return result;
+}
+
+void IrcFormatTest::compare(const QString &msg)
+{
+	for (int coloring = 0; coloring < 2; ++coloring) {
+		const QString expected = reference::ircFormatToHtml(msg, coloring);
+		const QString actual = IrcFormat::toHtml(msg, coloring);
+		if (actual != expected) {
+			QFAIL(qPrintable(QString::fromLatin1("toHtml(\"%1\", %2): \"%3\" != \"%4\"")
+							 .arg(escaped(msg)).arg(coloring).arg(escaped(actual), escaped(expected))));
+		}
+	}
+	const QString expected = reference::ircFormatToPlainText(msg);
+	const QString actual = IrcFormat::toPlainText(msg);
+	if (actual != expected) {
+		QFAIL(qPrintable(QString::fromLatin1("toPlainText(\"%1\"): \"%2\" != \"%3\"")
+						 .arg(escaped(msg), escaped(actual), escaped(expected))));
+	}
+}
+
+void IrcFormatTest::initTestCase()
+{
+	// Real channel log may be given as a plain text file with a message per
+	// line, otherwise a generated one is used
+	const QString logPath = QString::fromLocal8Bit(qgetenv("IRC_FORMAT_LOG"));
+	if (!logPath.isEmpty()) {
+		QFile file(logPath);
+		QVERIFY2(file.open(QIODevice::ReadOnly), qPrintable(file.errorString()));
+		while (!file.atEnd())
+			m_log << QString::fromUtf8(file.readLine()).remove(QLatin1Char('\n'));
+		return;
+	}
+
+	static const char * const words[] = {
+		"hello", "the", "build", "is", "broken", "again", "http://qutim.org/",
+		"<3", "a&b", "\"quoted\"", "ok", "lol", "patch", "merged", "42"
+	};
+	const int wordCount = sizeof(words) / sizeof(words[0]);
+	qsrand(1);
+	for (int i = 0; i < 20000; ++i) {
+		QString line;
+		const int length = 3 + qrand() % 20;
+		for (int j = 0; j < length; ++j) {
+			if (j)
+				line += QLatin1Char(' ');
+			// Most of messages are plain, few have colours and emphasis
+			switch (qrand() % 40) {
+			case 0:
+				line += QString::fromLatin1("\003%1,%2").arg(qrand() % 16).arg(qrand() % 16);
+				break;
+			case 1:
+				line += QString::fromLatin1("\003%1").arg(qrand() % 16, 2, 10, QLatin1Char('0'));
+				break;
+			case 2:
+				line += QLatin1Char('\002');
+				break;
+			case 3:
+				line += QLatin1Char('\037');
+				break;
+			case 4:
+				line += QLatin1Char('\017');
+				break;
+			}
+			line += QString::fromUtf8(words[qrand() % wordCount]);
+		}
+		m_log << line;
+	}
+}
+
+void IrcFormatTest::fixed_data()
+{
+	QTest::addColumn<QString>("msg");
+	QTest::newRow("empty") << QString();
+	QTest::newRow("plain") << QString::fromLatin1("just text");
+	QTest::newRow("escaping") << QString::fromLatin1("<a href=\"x\">&amp;</a>");
+	QTest::newRow("bold") << QString::fromLatin1("\002bold\002 not");
+	QTest::newRow("unclosed") << QString::fromLatin1("\002\037\026all");
+	QTest::newRow("reset") << QString::fromLatin1("\002\0034,5\037x\017y\002z");
+	QTest::newRow("color") << QString::fromLatin1("\0034red \00312,1blue");
+	QTest::newRow("three digits") << QString::fromLatin1("\003123,456");
+	QTest::newRow("comma only") << QString::fromLatin1("\003,5 \0035, \003,");
+	QTest::newRow("unknown color") << QString::fromLatin1("\00399,16x");
+	QTest::newRow("color at end") << QString::fromLatin1("x\0031,");
+	QTest::newRow("non-ascii digits") << QString::fromUtf8("\003\xd9\xa3,\xd9\xa4x \0031,\xd9\xa4");
+	QTest::newRow("surrogates") << QString::fromUtf8("\002\xf0\x9f\x98\x80\002");
+}
+
+void IrcFormatTest::fixed()
+{
+	QFETCH(QString, msg);
+	compare(msg);
+}
+
+void IrcFormatTest::fuzz()
+{
+	// Format codes, digits, commas and characters to be escaped are the most
+	// interesting ones, everything else is a plain text
+	static const ushort alphabet[] = {
+		'\002', '\003', '\017', '\026', '\037', '0', '1', '2', '5', '9', ',',
+		'<', '>', '&', '"', '\'', 'a', ' ', 0x0663, 0x00e9, 0xd83d, 0xde00
+	};
+	const int alphabetSize = sizeof(alphabet) / sizeof(alphabet[0]);
+	qsrand(42);
+	for (int i = 0; i < 200000; ++i) {
+		const int length = qrand() % 24;
+		QString msg(length, Qt::Uninitialized);
+		for (int j = 0; j < length; ++j)
+			msg[j] = QChar(alphabet[qrand() % alphabetSize]);
+		compare(msg);
+		if (QTest::currentTestFailed())
+			return;
+	}
+}
+
+void IrcFormatTest::toHtml_data()
+{
+	QTest::addColumn<bool>("regexp");
+	QTest::newRow("regexp") << true;
+	QTest::newRow("single pass") << false;
+}
+
+void IrcFormatTest::toHtml()
+{
+	QFETCH(bool, regexp);
+	int size = 0;
+	QBENCHMARK {
+		foreach (const QString &msg, m_log) {
+			if (regexp)
+				size += reference::ircFormatToHtml(msg, true).size();
+			else
+				size += IrcFormat::toHtml(msg).size();
+		}
+	}
+	QVERIFY(size > 0);
+}
+
+void IrcFormatTest::toPlainText_data()
+{
+	toHtml_data();
+}
+
+void IrcFormatTest::toPlainText()
+{
+	QFETCH(bool, regexp);
+	int size = 0;
+	QBENCHMARK {
+		foreach (const QString &msg, m_log) {
+			if (regexp)
+				size += reference::ircFormatToPlainText(msg).size();
+			else
+				size += IrcFormat::toPlainText(msg).size();
+		}
+	}
+	QVERIFY(size > 0);
+}
+
+QTEST_APPLESS_MAIN(IrcFormatTest)
+
+#include "ircformattest.moc"
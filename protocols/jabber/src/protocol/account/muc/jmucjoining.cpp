@@ -0,0 +1,55 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+** Copyright © 2011 Aleksey Sidorov <gorthauer87@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "jmucjoining.h"
+
+using namespace qutim_sdk_0_3;
+
+namespace Jabber
+{
+void JMUCJoining::append(Buddy *user)
+{
+	m_users << user;
+}
+
+void JMUCJoining::remove(Buddy *user)
+{
+	m_users.removeOne(user);
+}
+
+QList<Buddy*> JMUCJoining::take()
+{
+	QList<Buddy*> users;
+	users.reserve(m_users.size());
+	foreach (const QPointer<Buddy> &user, m_users) {
+		// Left participants are deleted later, they may be still alive
+		if (user && user->status().type() != Status::Offline)
+			users << user.data();
+	}
+	m_users.clear();
+	return users;
+}
+}
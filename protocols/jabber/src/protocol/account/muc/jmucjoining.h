@@ -2,8 +2,8 @@
 **
 ** qutIM - instant messenger
 **
-** Copyright © 2008 Rustam Chakin <qutim.develop@gmail.com>
-** Copyright © 2011 Alexander Kazarin <boiler@co.ru>
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+** Copyright © 2011 Aleksey Sidorov <gorthauer87@yandex.ru>
 **
 *****************************************************************************
 **
@@ -24,40 +24,27 @@
 **
 ****************************************************************************/
 
-#ifndef SQLHISTORYSETTINGS_H
-#define SQLHISTORYSETTINGS_H
+#ifndef JMUCJOINING_H
+#define JMUCJOINING_H
 
-#include <QtGui/QWidget>
-#include "ui_historysettings.h"
+#include <qutim/buddy.h>
+#include <QPointer>
 
-namespace SqlHistoryNamespace {
-
-class SqlHistorySettings : public QWidget
+namespace Jabber
+{
+// Participants received before our own presence in the room
+class JMUCJoining
 {
-	Q_OBJECT
-
 public:
-	SqlHistorySettings(const QString &profile_name,QWidget *parent = 0);
-	~SqlHistorySettings();
-	void loadSettings();
-	void saveSettings();
-
-private slots:
-	void widgetStateChanged() { changed = true; emit settingsChanged(); }
-	void boxSqlEngineChanged(int);
-
-signals:
-  	void settingsChanged();
-	void settingsSaved();
-
+	void append(qutim_sdk_0_3::Buddy *user);
+	void remove(qutim_sdk_0_3::Buddy *user);
+	void clear() { m_users.clear(); }
+	bool isEmpty() const { return m_users.isEmpty(); }
+	// Returns the ones which are still in the room and forgets all of them
+	QList<qutim_sdk_0_3::Buddy*> take();
 private:
-	Ui::SqlHistorySettingsClass ui;
-	bool changed;
-	QString m_profile_name;
-
+	QList<QPointer<qutim_sdk_0_3::Buddy> > m_users;
 };
-
 }
 
-#endif // SQLHISTORYSETTINGS_H
-
+#endif // JMUCJOINING_H
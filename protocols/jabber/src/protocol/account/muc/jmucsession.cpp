@@ -26,6 +26,7 @@
 
 #include "jmucsession.h"
 #include "jmucuser.h"
+#include "jmucjoining.h"
 #include "../jaccount.h"
 #include "../roster/jmessagesession.h"
 #include "../roster/jmessagehandler.h"
@@ -69,6 +70,7 @@ public:
 	JMUCUser *addUser(JMUCSession *session, const QString &nick);
 	JMUCUser *getUser(const QString &nick);
 	bool containsUser(const QString &nick);
+	void flushJoining(JMUCSession *session);
 
 	QPointer<JAccount> account;
 	QList<Jreen::MessageFilter*> filters;
@@ -79,6 +81,8 @@ public:
 	QString topic;
 	QHash<QString, quint64> messages;
 	QHash<QString, JMUCUser *> users;
+	// Participants received before our own presence, they are added at once
+	JMUCJoining joining;
 	bool isAutoRejoin;
 	Jreen::Bookmark::Conference bookmark;
 	QPointer<JConferenceConfig> config;
@@ -90,6 +94,7 @@ public:
 
 void JMUCSessionPrivate::removeUser(JMUCSession *conference, JMUCUser *user)
 {
+	joining.remove(user);
 	if (ChatSession *session = ChatLayer::get(conference, false))
 		session->removeContact(user);
 
@@ -127,6 +132,15 @@ bool JMUCSessionPrivate::containsUser(const QString &nick)
 	return (user && user->presenceType() != Presence::Unavailable);
 }
 
+void JMUCSessionPrivate::flushJoining(JMUCSession *conference)
+{
+	const QList<Buddy*> users = joining.take();
+	if (users.isEmpty())
+		return;
+	if (ChatSession *session = ChatLayer::get(conference, false))
+		session->addContacts(users);
+}
+
 JMUCSession::JMUCSession(const Jreen::JID &room, const QString &password, JAccount *account) :
 	Conference(account), d_ptr(new JMUCSessionPrivate)
 {
@@ -411,6 +425,12 @@ void JMUCSession::onParticipantPresence(const Jreen::Presence &presence,
 			user->setMUCAffiliationAndRole(participant->affiliation(), participant->role());
 			if (participant->realJID().isValid())
 				user->setRealJid(participant->realJID());
+			// Room sends presences of all participants before ours, nobody
+			// is notified about them, so don't spend time on each one
+			if (!isSelf && !isJoined()) {
+				d->joining.append(user);
+				return;
+			}
 			text = user->realJid().isEmpty()
 					? nick
 					: nick % QLatin1Literal(" (") % user->realJid() % QLatin1Literal(")");
@@ -467,6 +487,8 @@ void JMUCSession::onParticipantPresence(const Jreen::Presence &presence,
 			user->setMUCAffiliationAndRole(participant->affiliation(), participant->role());
 		}
 	}
+	if (isSelf)
+		d->flushJoining(this);
 	if (!text.isEmpty() && (isJoined() || participant->isKicked() || participant->isBanned())) {
 		NotificationRequest request(notificationType);
 		request.setObject(this);
@@ -739,6 +761,10 @@ void JMUCSession::closeConfigDialog()
 void JMUCSession::joinedChanged()
 {
 	Q_D(JMUCSession);
+	if (d->room->isJoined())
+		d->flushJoining(this);
+	else
+		d->joining.clear();
 	if (!d->room->isJoined()) {
 		//remove users
 		const Presence presence(Presence::Unavailable, JID());
@@ -0,0 +1,184 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+** Copyright © 2011 Aleksey Sidorov <gorthauer87@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "jmucjoining.h"
+#include <qutim/protocol.h>
+#include <qutim/account.h>
+#include <QtTest>
+
+using namespace qutim_sdk_0_3;
+using namespace Jabber;
+
+class TestProtocol : public Protocol
+{
+	Q_OBJECT
+	Q_CLASSINFO("Protocol", "jabber")
+public:
+	virtual QList<Account*> accounts() const { return QList<Account*>(); }
+	virtual Account *account(const QString &) const { return 0; }
+private:
+	virtual void loadAccounts() {}
+};
+
+class TestAccount : public Account
+{
+	Q_OBJECT
+public:
+	TestAccount(Protocol *protocol) : Account(QLatin1String("me@example.org"), protocol) {}
+	virtual ChatUnit *getUnit(const QString &, bool) { return 0; }
+protected:
+	virtual void doConnectToServer() {}
+	virtual void doDisconnectFromServer() {}
+	virtual void doStatusChange(const Status &) {}
+};
+
+// Participant of the room, it's offline after unavailable presence like JMUCUser
+class TestUser : public Buddy
+{
+	Q_OBJECT
+public:
+	TestUser(const QString &nick, Account *account) :
+		Buddy(account), m_nick(nick), m_status(Status::Online) {}
+	virtual QString id() const { return m_nick; }
+	virtual Status status() const { return m_status; }
+	virtual bool sendMessage(const Message &) { return true; }
+	void leave() { m_status = Status(Status::Offline); }
+private:
+	QString m_nick;
+	Status m_status;
+};
+
+class MUCJoiningTest : public QObject
+{
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanupTestCase();
+	void cleanup();
+	void order();
+	void leftBeforeSelf();
+	void rejoined();
+
+private:
+	TestUser *user(const QString &nick);
+	QStringList nicks(const QList<Buddy*> &users) const;
+
+	TestProtocol *m_protocol;
+	TestAccount *m_account;
+	QList<QPointer<TestUser> > m_users;
+};
+
+void MUCJoiningTest::initTestCase()
+{
+	m_protocol = new TestProtocol;
+	m_account = new TestAccount(m_protocol);
+}
+
+void MUCJoiningTest::cleanupTestCase()
+{
+	delete m_account;
+	delete m_protocol;
+}
+
+void MUCJoiningTest::cleanup()
+{
+	foreach (const QPointer<TestUser> &user, m_users)
+		delete user.data();
+	m_users.clear();
+}
+
+TestUser *MUCJoiningTest::user(const QString &nick)
+{
+	TestUser *user = new TestUser(nick, m_account);
+	m_users << user;
+	return user;
+}
+
+QStringList MUCJoiningTest::nicks(const QList<Buddy*> &users) const
+{
+	QStringList result;
+	foreach (Buddy *user, users)
+		result << user->id();
+	return result;
+}
+
+void MUCJoiningTest::order()
+{
+	JMUCJoining joining;
+	QVERIFY(joining.isEmpty());
+	QVERIFY(joining.take().isEmpty());
+	joining.append(user("carol"));
+	joining.append(user("alice"));
+	joining.append(user("bob"));
+	QVERIFY(!joining.isEmpty());
+
+	// Session sorts them itself, the presence order is kept
+	QCOMPARE(nicks(joining.take()), QStringList() << "carol" << "alice" << "bob");
+	QVERIFY(joining.isEmpty());
+	QVERIFY(joining.take().isEmpty());
+}
+
+void MUCJoiningTest::leftBeforeSelf()
+{
+	JMUCJoining joining;
+	TestUser *alice = user("alice");
+	TestUser *bob = user("bob");
+	TestUser *carol = user("carol");
+	TestUser *dave = user("dave");
+	joining.append(alice);
+	joining.append(bob);
+	joining.append(carol);
+	joining.append(dave);
+
+	// Unavailable presence removes the user
+	bob->leave();
+	joining.remove(bob);
+	// Offline one which is not removed yet
+	carol->leave();
+	// Deleted one which was never removed
+	delete dave;
+
+	QCOMPARE(nicks(joining.take()), QStringList() << "alice");
+}
+
+void MUCJoiningTest::rejoined()
+{
+	JMUCJoining joining;
+	TestUser *alice = user("alice");
+	joining.append(alice);
+	joining.remove(alice);
+	// Same user object is reused by the next available presence
+	joining.append(alice);
+	QCOMPARE(nicks(joining.take()), QStringList() << "alice");
+
+	// Leaving the room drops everyone who is not added yet
+	joining.append(user("bob"));
+	joining.clear();
+	QVERIFY(joining.take().isEmpty());
+}
+
+QTEST_MAIN(MUCJoiningTest)
+#include "mucjoiningtest.moc"
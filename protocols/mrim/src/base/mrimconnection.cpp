@@ -33,6 +33,7 @@
 
 #include <qutim/notification.h>
 #include <qutim/systemintegration.h>
+#include <qutim/timerservice.h>
 
 #include "proto.h"
 #include "utils.h"
@@ -51,10 +52,11 @@ struct MrimConnectionPrivate
 {
 	MrimConnectionPrivate(MrimAccount *acc)
 		: account(acc), imSocket(new QTcpSocket), srvReqSocket(new QTcpSocket), readyReadTimer(new QTimer),
-		  pingTimer(new QTimer)
+		  pingTimer(new CoalescingTimer)
 	{
 		readyReadTimer->setSingleShot(true);
 		readyReadTimer->setInterval(0);
+		pingTimer->setObjectName(QLatin1String("MrimPing"));
 
 	}
 
@@ -72,7 +74,7 @@ struct MrimConnectionPrivate
 	QScopedPointer<QTcpSocket> imSocket;
 	QScopedPointer<QTcpSocket> srvReqSocket;
 	QScopedPointer<QTimer> readyReadTimer;
-	QScopedPointer<QTimer> pingTimer;
+	QScopedPointer<CoalescingTimer> pingTimer;
 	QHandlersMap handlers;
 	QList<quint32> handledTypes;
 	MrimMessages *messages;
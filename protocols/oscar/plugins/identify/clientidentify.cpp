@@ -106,6 +106,7 @@ const oscar::Capability ClientIdentify::ICQ_CAPABILITY_SIMxVER      ('S',  'I',
 
 ClientIdentify::ClientIdentify()
 {
+	m_cache.setMaxCost(1000);
 }
 
 ClientIdentify::~ClientIdentify()
@@ -113,43 +114,68 @@ ClientIdentify::~ClientIdentify()
 }
 
 void ClientIdentify::identify(IcqContact *contact)
+{
+	identify(contact->capabilities(), contact->dcInfo());
+}
+
+void ClientIdentify::identify(const Capabilities &capabilities, const DirectConnectionInfo &info)
 {
 	m_client_id.clear();
-	m_contact = contact;
-	m_client_caps = contact->capabilities();
-	m_client_proto = contact->dcInfo().protocol_version;
-	m_info = contact->dcInfo().info_utime;
-	m_ext_info = contact->dcInfo().extinfo_utime;
-	m_ext_status_info = contact->dcInfo().extstatus_utime;
+	m_client_caps = capabilities;
+	m_client_proto = info.protocol_version;
+	m_info = info.info_utime;
+	m_ext_info = info.extinfo_utime;
+	m_ext_status_info = info.extstatus_utime;
+	m_port = info.port;
+	m_auth_cookie = info.auth_cookie;
 	m_flags = 0;
 
-	foreach(const oscar::Capability &capability, m_client_caps)
-	{
-		if (capability.match(ICQ_CAPABILITY_RTFxMSGS))
-			m_flags |= rtf_support;
-		else if (capability.match(ICQ_CAPABILITY_TYPING))
-			m_flags |= typing_support;
-		else if (capability.match(ICQ_CAPABILITY_AIMCHAT))
-			m_flags |= aim_chat_support;
-		else if (capability.match(ICQ_CAPABILITY_AIMIMAGE))
-			m_flags |= aim_image_support;
-		else if (capability.match(ICQ_CAPABILITY_XTRAZ))
-			m_flags |= xtraz_support;
-		else if (capability.match(ICQ_CAPABILITY_UTF8))
-			m_flags |= utf8_support;
-		else if (capability.match(ICQ_CAPABILITY_AIMSENDFILE))
-			m_flags |= sendfile_support;
-		else if (capability.match(ICQ_CAPABILITY_DIRECT))
-			m_flags |= direct_support;
-		else if (capability.match(ICQ_CAPABILITY_AIMICON))
-			m_flags |= icon_support;
-		else if (capability.match(ICQ_CAPABILITY_AIMGETFILE))
-			m_flags |= getfile_support;
-		else if (capability.match(ICQ_CAPABILITY_SRVxRELAY))
-			m_flags |= srvrelay_support;
-		else if (capability.match(ICQ_CAPABILITY_AVATAR))
-			m_flags |= avatar_support;
+	m_caps_data.clear();
+	m_caps_data.reserve(m_client_caps.size());
+	m_caps_index.clear();
+	QByteArray fingerprint;
+	fingerprint.reserve(m_client_caps.size() * oscar::Capability::Size + 18);
+	foreach (const oscar::Capability &capability, m_client_caps) {
+		m_caps_data << capability.data();
+		fingerprint += m_caps_data.last();
+	}
+	// Only presence of port and cookie is checked
+	const quint32 values[] = { m_client_proto, m_info, m_ext_info, m_ext_status_info,
+							   quint32((m_port ? 1 : 0) | (m_auth_cookie ? 2 : 0)) };
+	fingerprint.append(reinterpret_cast<const char*>(values), sizeof(values));
+	if (ClientData *data = m_cache.object(fingerprint)) {
+		m_client_id = data->id;
+		m_client_icon = data->icon;
+		return;
+	}
+
+	static QHash<oscar::Capability, CapabilityFlag> flags;
+	if (flags.isEmpty()) {
+		flags.insert(ICQ_CAPABILITY_RTFxMSGS, rtf_support);
+		flags.insert(ICQ_CAPABILITY_TYPING, typing_support);
+		flags.insert(ICQ_CAPABILITY_AIMCHAT, aim_chat_support);
+		flags.insert(ICQ_CAPABILITY_AIMIMAGE, aim_image_support);
+		flags.insert(ICQ_CAPABILITY_XTRAZ, xtraz_support);
+		flags.insert(ICQ_CAPABILITY_UTF8, utf8_support);
+		flags.insert(ICQ_CAPABILITY_AIMSENDFILE, sendfile_support);
+		flags.insert(ICQ_CAPABILITY_DIRECT, direct_support);
+		flags.insert(ICQ_CAPABILITY_AIMICON, icon_support);
+		flags.insert(ICQ_CAPABILITY_AIMGETFILE, getfile_support);
+		flags.insert(ICQ_CAPABILITY_SRVxRELAY, srvrelay_support);
+		flags.insert(ICQ_CAPABILITY_AVATAR, avatar_support);
 	}
+	foreach (const oscar::Capability &capability, m_client_caps)
+		m_flags |= flags.value(capability);
+
+	identifyClient();
+	ClientData *data = new ClientData;
+	data->id = m_client_id;
+	data->icon = m_client_icon;
+	m_cache.insert(fingerprint, data);
+}
+
+void ClientIdentify::identifyClient()
+{
 
 	// There may be some x-statuses info here.. remove all of them.
 	// TODO:
@@ -196,6 +222,27 @@ void ClientIdentify::identify(IcqContact *contact)
 	setClientData("-", "unknown");
 }
 
+oscar::Capabilities::const_iterator ClientIdentify::findCapability(const oscar::Capability &capability,
+																   quint8 len)
+{
+	const QByteArray data = capability.data();
+	if (len == oscar::Capabilities::UpToFirstZero) {
+		len = data.size();
+		while (len > 0 && !data.at(len - 1))
+			--len;
+	}
+	len = qMin<quint8>(len, oscar::Capability::Size);
+	// Capabilities are scanned only once for every length of prefix
+	QHash<int, QHash<QByteArray, int> >::iterator it = m_caps_index.find(len);
+	if (it == m_caps_index.end()) {
+		it = m_caps_index.insert(len, QHash<QByteArray, int>());
+		for (int i = m_caps_data.size() - 1; i >= 0; --i)
+			it->insert(m_caps_data.at(i).left(len), i);
+	}
+	const int index = it->value(data.left(len), -1);
+	return index < 0 ? m_client_caps.constEnd() : m_client_caps.constBegin() + index;
+}
+
 void ClientIdentify::statusChanged(IcqContact *contact, Status &status, const TLVMap &tlvs)
 {
 	Q_UNUSED(tlvs);
@@ -367,25 +414,25 @@ void ClientIdentify::identify_by_ProtoVersion()
 	// VERSION = 0
 	if (m_client_proto == 0) {
 		if (!m_info && !m_ext_info && !m_ext_status_info &&
-			!(m_contact->dcInfo().port) && !(m_contact->dcInfo().auth_cookie))
+			!m_port && !m_auth_cookie)
 		{
 			if (TypingSupport() &&
-				m_client_caps.match(ICQ_CAPABILITY_IS2001) &&
-				m_client_caps.match(ICQ_CAPABILITY_IS2002) &&
-				m_client_caps.match(ICQ_CAPABILITY_COMM20012))
+				matchCapability(ICQ_CAPABILITY_IS2001) &&
+				matchCapability(ICQ_CAPABILITY_IS2002) &&
+				matchCapability(ICQ_CAPABILITY_COMM20012))
 			{
 				setClientData("Spam Bot", "bot");
 			}
 			else if (IconSupport()) {
 				if ((TypingSupport() && XtrazSupport() && SrvRelaySupport() && Utf8Support()) ||
 					(Utf8Support() && (m_client_caps.size() == 2)) ||
-					(m_client_caps.match(ICQ_CAPABILITY_ICQLITExVER) && XtrazSupport()))
+					(matchCapability(ICQ_CAPABILITY_ICQLITExVER) && XtrazSupport()))
 				{
 					setClientData("PyICQ-t Jabber Transport", "pyicq");
 				}
 				else if (Utf8Support() && SrvRelaySupport() && SendFileSupport() &&
-						m_client_caps.match(ICQ_CAPABILITY_BUDDY_LIST) &&
-						m_client_caps.match(ICQ_CAPABILITY_DIGSBY))
+						matchCapability(ICQ_CAPABILITY_BUDDY_LIST) &&
+						matchCapability(ICQ_CAPABILITY_DIGSBY))
 				{
 					setClientData("Digsby", "digsby");
 				}
@@ -446,15 +493,15 @@ void ClientIdentify::identify_by_ProtoVersion()
 		{
 			if (DirectSupport() && Utf8Support() && SrvRelaySupport() && AvatarSupport()) {
 				setClientData("IM Gate", "imgate");
-			} else if (m_client_caps.match(ICQ_CAPABILITY_IMSECKEY1) &&
-					m_client_caps.match(ICQ_CAPABILITY_IMSECKEY2))
+			} else if (matchCapability(ICQ_CAPABILITY_IMSECKEY1) &&
+					matchCapability(ICQ_CAPABILITY_IMSECKEY2))
 			{
 				m_client_proto = 9;
 				return identify_by_ProtoVersion();
 			}
 		}
-		else if (m_client_caps.match(ICQ_CAPABILITY_COMM20012) || SrvRelaySupport()) {
-			if (m_client_caps.match(ICQ_CAPABILITY_IS2001)) {
+		else if (matchCapability(ICQ_CAPABILITY_COMM20012) || SrvRelaySupport()) {
+			if (matchCapability(ICQ_CAPABILITY_IS2001)) {
 				if (!m_info && !m_ext_info && !m_ext_status_info) {
 					if (RtfSupport()) {
 						setClientData("TICQClient", "unknown"); // possibly also older GnomeICU
@@ -464,14 +511,14 @@ void ClientIdentify::identify_by_ProtoVersion()
 				} else {
 					setClientData("ICQ 2001", "icq-2001");
 				}
-			} else if (m_client_caps.match(ICQ_CAPABILITY_IS2002)) {
+			} else if (matchCapability(ICQ_CAPABILITY_IS2002)) {
 				setClientData("ICQ 2002", "icq-2002");
 			} else if (SrvRelaySupport() && Utf8Support() && RtfSupport() &&
-					(!m_client_caps.match(ICQ_CAPABILITY_ICQJS7xVER)) &&
-					(!m_client_caps.match(ICQ_CAPABILITY_ICQJSINxVER)))
+					(!matchCapability(ICQ_CAPABILITY_ICQJS7xVER)) &&
+					(!matchCapability(ICQ_CAPABILITY_ICQJSINxVER)))
 			{
 				if (!m_info && !m_ext_info && !m_ext_status_info) {
-					if (!(m_contact->dcInfo().port)) {
+					if (!m_port) {
 						setClientData("GnomeICU 0.99.5+", "unknown");
 					} else {
 						setClientData("IC@", "unknown");
@@ -492,11 +539,11 @@ void ClientIdentify::identify_by_ProtoVersion()
 		if (XtrazSupport()) {
 			if (SendFileSupport()) {
 				QString icon;
-				if (m_client_caps.match(ICQ_CAPABILITY_ICQLITENEW)) {
+				if (matchCapability(ICQ_CAPABILITY_ICQLITENEW)) {
 					m_client_id = "ICQ 7";
 					icon = "icq-70";
-				} else if (m_client_caps.match(ICQ_CAPABILITY_TZERS)) {
-					if (m_client_caps.match(ICQ_CAPABILITY_HTMLMSGS)) {
+				} else if (matchCapability(ICQ_CAPABILITY_TZERS)) {
+					if (matchCapability(ICQ_CAPABILITY_HTMLMSGS)) {
 						if (RtfSupport()) {
 							m_client_id = "MDC";
 							icon = "mdc";
@@ -512,11 +559,11 @@ void ClientIdentify::identify_by_ProtoVersion()
 					m_client_id = "ICQ 5";
 					icon = "icq-50";
 				}
-				if (m_client_caps.match(ICQ_CAPABILITY_RAMBLER))
+				if (matchCapability(ICQ_CAPABILITY_RAMBLER))
 					m_client_id += " (Rambler)";
-				else if (m_client_caps.match(ICQ_CAPABILITY_ABV))
+				else if (matchCapability(ICQ_CAPABILITY_ABV))
 					m_client_id += " (Abv)";
-				else if (m_client_caps.match(ICQ_CAPABILITY_NETVIGATOR))
+				else if (matchCapability(ICQ_CAPABILITY_NETVIGATOR))
 					m_client_id += " (Netvigator)";
 				setClientIcon(icon);
 			} else if (!DirectSupport()) {
@@ -524,7 +571,7 @@ void ClientIdentify::identify_by_ProtoVersion()
 					m_client_id = "QNext";
 					setClientIcon("unknown");
 				}
-				else if(m_client_caps.match(ICQ_CAPABILITY_TZERS)) {
+				else if(matchCapability(ICQ_CAPABILITY_TZERS)) {
 					m_client_id = "Mail.Ru Agent";
 					setClientIcon("mrim");
 				}
@@ -537,7 +584,7 @@ void ClientIdentify::identify_by_ProtoVersion()
 				setClientIcon("icq-4lite");
 			}
 		} else if(Utf8Support() && SendFileSupport() && IconSupport() && AimChatSupport()
-				&& m_contact->capabilities().match(ICQ_CAPABILITY_BUDDY_LIST))
+				&& matchCapability(ICQ_CAPABILITY_BUDDY_LIST))
 		{
 			m_client_id = "ICQ Lite";
 			setClientIcon("icq-4lite");
@@ -566,7 +613,7 @@ void ClientIdentify::identify_qutIM()
 															 0x00,  0x00,  0x00,  0x00,  0x00,
 															 0x00, 0x00, 0x00, 0x00, 0x00);
 
-	oscar::Capabilities::const_iterator capit = m_client_caps.find(ICQ_CAPABILITY_QUTIMxVER);
+	oscar::Capabilities::const_iterator capit = findCapability(ICQ_CAPABILITY_QUTIMxVER);
 	if (capit != m_client_caps.constEnd()) {
 		const oscar::Capability &cap = *capit;
 		QByteArray data = cap.data();
@@ -618,9 +665,10 @@ void ClientIdentify::identify_k8qutIM()
 																0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 																0x00, 0x00, 0x00);
 
-	oscar::Capabilities::const_iterator cap = m_client_caps.find(ICQ_CAPABILITY_K8QUTIMxVER);
+	oscar::Capabilities::const_iterator cap = findCapability(ICQ_CAPABILITY_K8QUTIMxVER);
 	if (cap != m_client_caps.constEnd()) {
-		const char *cap_str = cap->data().data() + 7;
+		const QByteArray cap_data = cap->data();
+		const char *cap_str = cap_data.constData() + 7;
 		QString os("");
 		if(cap_str[0] != 'l')
 			os = QString(" (%1)").arg(cap_str[0]);
@@ -670,12 +718,13 @@ void ClientIdentify::identify_Miranda()
 	oscar::Capabilities::const_iterator cap;
 	oscar::Capabilities::const_iterator end_itr = m_client_caps.constEnd();
 
-	if (((cap = m_client_caps.find(ICQ_CAPABILITY_ICQJSINxVER)) != end_itr) ||
-		((cap = m_client_caps.find(ICQ_CAPABILITY_ICQJS7xVER)) != end_itr) ||
-		((cap = m_client_caps.find(ICQ_CAPABILITY_ICQJPxVER)) != end_itr) ||
-		((cap = m_client_caps.find(ICQ_CAPABILITY_ICQJENxVER)) != end_itr))
+	if (((cap = findCapability(ICQ_CAPABILITY_ICQJSINxVER)) != end_itr) ||
+		((cap = findCapability(ICQ_CAPABILITY_ICQJS7xVER)) != end_itr) ||
+		((cap = findCapability(ICQ_CAPABILITY_ICQJPxVER)) != end_itr) ||
+		((cap = findCapability(ICQ_CAPABILITY_ICQJENxVER)) != end_itr))
 	{
-		const char *cap_str = cap->data().data();
+		const QByteArray cap_data = cap->data();
+		const char *cap_str = cap_data.constData();
 		unsigned mver0   = cap_str[0x4] & 0xff;
 		unsigned mver1   = cap_str[0x5] & 0xff;
 		unsigned mver2   = cap_str[0x6] & 0xff;
@@ -721,15 +770,16 @@ void ClientIdentify::identify_Miranda()
 
 			if (((secure != 0) && (secure != 20)) || (m_ext_status_info == 0x5AFEC0DE))
 				m_client_id += " (SecureIM)";
-			else if (m_client_caps.match(ICQ_CAPABILITY_ICQJS7SxVER, 0x10))
+			else if (matchCapability(ICQ_CAPABILITY_ICQJS7SxVER, 0x10))
 				m_client_id += "Miranda IM (ICQ SSS & S7)(SecureIM)";
-			else if (m_client_caps.match(ICQ_CAPABILITY_ICQJS7OxVER, 0x10))
+			else if (matchCapability(ICQ_CAPABILITY_ICQJS7OxVER, 0x10))
 				m_client_id += "Miranda IM (ICQ SSS & S7)";
 		}
 	}
-	else if ((cap = m_client_caps.find(ICQ_CAPABILITY_MIRANDAxVER)) != end_itr)
+	else if ((cap = findCapability(ICQ_CAPABILITY_MIRANDAxVER)) != end_itr)
 	{
-		const char *cap_str = cap->data().data();
+		const QByteArray cap_data = cap->data();
+		const char *cap_str = cap_data.constData();
 		unsigned mver0 = cap_str[0x8] & 0xff;
 		unsigned mver1 = cap_str[0x9] & 0xff;
 		unsigned mver2 = cap_str[0xA] & 0xff;
@@ -739,7 +789,7 @@ void ClientIdentify::identify_Miranda()
 		unsigned iver2 = cap_str[0xE] & 0xff;
 		unsigned iver3 = cap_str[0xF] & 0xff;
 		m_client_id += "Miranda IM ";
-		if (m_client_caps.match(ICQ_CAPABILITY_MIRMOBxVER))
+		if (matchCapability(ICQ_CAPABILITY_MIRMOBxVER))
 			m_client_id += "Mobile ";
 		if (mver0 == 0x80) {
 			if (mver2 == 0x00)
@@ -757,7 +807,7 @@ void ClientIdentify::identify_Miranda()
 		if ((m_info == 0x7fffffff) || ((unsigned)((m_ext_status_info >> 24) & 0xFF) == 0x80))
 			m_client_id += " Unicode";
 		m_client_id += " (ICQ ";
-		if (m_client_caps.match(ICQ_CAPABILITY_ICQJS7OxVER, 0x10) || m_client_caps.match(ICQ_CAPABILITY_ICQJS7SxVER, 0x10))
+		if (matchCapability(ICQ_CAPABILITY_ICQJS7OxVER, 0x10) || matchCapability(ICQ_CAPABILITY_ICQJS7SxVER, 0x10))
 			m_client_id += " S7 & SSS (old)";
 		else
 		{
@@ -792,7 +842,7 @@ void ClientIdentify::identify_Miranda()
 			m_client_id += QString("%1.%2.%3.%4)").arg(iver0).arg(iver1).arg(iver2).arg(iver3);
 			break;
 		}
-		if ((m_ext_status_info == 0x5AFEC0DE) || m_client_caps.match(ICQ_CAPABILITY_ICQJS7SxVER, 0x10))
+		if ((m_ext_status_info == 0x5AFEC0DE) || matchCapability(ICQ_CAPABILITY_ICQJS7SxVER, 0x10))
 			m_client_id += " (SecureIM)";
 	}
 	if(!m_client_id.isEmpty())
@@ -806,7 +856,7 @@ void ClientIdentify::identify_Qip()
 																0x00, 0x00, 0x00);
 
 	oscar::Capabilities::const_iterator cap;
-	if ((cap = m_client_caps.find(ICQ_CAPABILITY_QIPxVER)) != m_client_caps.constEnd()) {
+	if ((cap = findCapability(ICQ_CAPABILITY_QIPxVER)) != m_client_caps.constEnd()) {
 		const QByteArray &cap_data = cap->data();
 		m_client_id = "QIP ";
 		if (m_ext_status_info == 0x0F)
@@ -839,9 +889,9 @@ void ClientIdentify::identify_QipInfium()
 																0x0a, 0x03, 0x0b, 0x04, 0x01, 0x53,
 																0x13, 0x43, 0x1e, 0x1a);
 
-	bool qipInfium = m_client_caps.match(ICQ_CAPABILITY_QIPINFxVER);
-	bool qip2010 = m_client_caps.match(ICQ_CAPABILITY_QIP2010xVER);
-	bool qip2012 = m_client_caps.match(ICQ_CAPABILITY_QIP2012xVER);
+	bool qipInfium = matchCapability(ICQ_CAPABILITY_QIPINFxVER);
+	bool qip2010 = matchCapability(ICQ_CAPABILITY_QIP2010xVER);
+	bool qip2012 = matchCapability(ICQ_CAPABILITY_QIP2012xVER);
 
 	if (qip2012 || qip2010 || qipInfium) {
 		QString icon = "qip";
@@ -869,7 +919,7 @@ void ClientIdentify::identify_QipPDA()
 														 0x41, 'Q', 'I', 'P', ' ', ' ', ' ',
 														 ' ', ' ', '!');
 
-	if (m_client_caps.match(ICQ_CAPABILITY_QIPPDAxVER))
+	if (matchCapability(ICQ_CAPABILITY_QIPPDAxVER))
 		setClientData("QIP PDA (Windows)", "qip-pda");
 }
 
@@ -883,9 +933,9 @@ void ClientIdentify::identify_QipMobile()
 																0x47, 0x3d, 0xa1, 0xa1, 0x49, 0xf4,
 																0xa3, 0x97, 0xa4, 0x1f);
 
-	if (m_client_caps.match(ICQ_CAPABILITY_QIPMOBxVER, 0x10))
+	if (matchCapability(ICQ_CAPABILITY_QIPMOBxVER, 0x10))
 		m_client_id = "QIP Mobile (Java)";
-	else if (m_client_caps.match(ICQ_CAPABILITY_QIPSYMBxVER, 0x10))
+	else if (matchCapability(ICQ_CAPABILITY_QIPSYMBxVER, 0x10))
 		m_client_id = "QIP Mobile (Symbian)";
 	if(!m_client_id.isEmpty())
 		setClientIcon("qip-symbian");
@@ -906,9 +956,10 @@ void ClientIdentify::identify_Sim()
 													   0xf7, 0x3f, 0x14, 0x00);
 	*/
 	oscar::Capabilities::const_iterator cap;
-	if ((cap = m_client_caps.find(ICQ_CAPABILITY_SIMxVER)) != m_client_caps.constEnd()) {
+	if ((cap = findCapability(ICQ_CAPABILITY_SIMxVER)) != m_client_caps.constEnd()) {
 		QString clientId = "SIM v";
-		const char *cap_str = cap->data().data() + 12;
+		const QByteArray cap_data = cap->data();
+		const char *cap_str = cap_data.constData() + 12;
 		unsigned ver1 = cap_str[0];
 		unsigned ver2 = cap_str[1];
 		unsigned ver3 = cap_str[2];
@@ -919,9 +970,9 @@ void ClientIdentify::identify_Sim()
 			clientId += QString("%1.%2.%3").arg(ver1).arg(ver2).arg(ver3);
 		else
 			clientId += QString("%1.%2").arg(ver1).arg(ver2);
-		if (cap_str[14] & 0x80)
+		if (cap_str[3] & 0x80)
 			clientId += "/Win32";
-		else if (cap_str[14] & 0x40)
+		else if (cap_str[3] & 0x40)
 			clientId += "/MacOS X";
 		setClientIcon("sim");
 	}
@@ -930,12 +981,13 @@ void ClientIdentify::identify_Sim()
 void ClientIdentify::identify_SimRnQ()
 {
 	oscar::Capabilities::const_iterator cap;
-	if ((cap = m_client_caps.find(ICQ_CAPABILITY_SIMxVER)) != m_client_caps.constEnd()) {
-		const char *cap_str = cap->data().data() + 12;
+	if ((cap = findCapability(ICQ_CAPABILITY_SIMxVER)) != m_client_caps.constEnd()) {
+		const QByteArray cap_data = cap->data();
+		const char *cap_str = cap_data.constData() + 12;
 		if (cap_str[0] || cap_str[1] || cap_str[2] || (cap_str[3] & 0x0f))
 			return;
 	}
-	else if(!m_client_caps.match(ICQ_CAPABILITY_SIMxVER, 10))
+	else if(!matchCapability(ICQ_CAPABILITY_SIMxVER, 10))
 		return;
 	setClientData("R&Q-masked (SIM)", "rnq");
 }
@@ -947,8 +999,9 @@ void ClientIdentify::identify_Licq()
 															 0x00, 0x00, 0x00, 0x00);
 
 	oscar::Capabilities::const_iterator cap;
-	if ((cap = m_client_caps.find(ICQ_CAPABILITY_LICQxVER)) != m_client_caps.constEnd()) {
-		const char *cap_str = cap->data().data() + 12;
+	if ((cap = findCapability(ICQ_CAPABILITY_LICQxVER)) != m_client_caps.constEnd()) {
+		const QByteArray cap_data = cap->data();
+		const char *cap_str = cap_data.constData() + 12;
 		unsigned ver1 = cap_str[0];
 		unsigned ver2 = cap_str[1]%100;
 		unsigned ver3 = cap_str[2];
@@ -966,8 +1019,9 @@ void ClientIdentify::identify_Kopete()
 																0x00, 0x00, 0x00, 0x00);
 
 	oscar::Capabilities::const_iterator cap;
-	if ((cap = m_client_caps.find(ICQ_CAPABILITY_KOPETExVER)) != m_client_caps.constEnd()) {
-		const char *cap_str = cap->data().data() + 12;
+	if ((cap = findCapability(ICQ_CAPABILITY_KOPETExVER)) != m_client_caps.constEnd()) {
+		const QByteArray cap_data = cap->data();
+		const char *cap_str = cap_data.constData() + 12;
 		unsigned ver1 = cap_str[0];
 		unsigned ver2 = cap_str[1];
 		unsigned ver3 = cap_str[2]*100;
@@ -984,9 +1038,10 @@ void ClientIdentify::identify_Micq()
 															0x00, 0x00, 0x00, 0x00);
 
 	oscar::Capabilities::const_iterator cap;
-	if ((cap = m_client_caps.find(ICQ_CAPABILITY_MICQxVER)) != m_client_caps.constEnd()) {
+	if ((cap = findCapability(ICQ_CAPABILITY_MICQxVER)) != m_client_caps.constEnd()) {
 		m_client_id = "mICQ v";
-		const char *cap_str = cap->data().data() + 12;
+		const QByteArray cap_data = cap->data();
+		const char *cap_str = cap_data.constData() + 12;
 		unsigned ver1 = cap_str[0];
 		unsigned ver2 = cap_str[1];
 		unsigned ver3 = cap_str[2];
@@ -1032,7 +1087,7 @@ void ClientIdentify::identify_Jimm()
 															0x00, 0x00, 0x00, 0x00);
 
 	oscar::Capabilities::const_iterator cap;
-	if ((cap = m_client_caps.find(ICQ_CAPABILITY_JIMMxVER)) != m_client_caps.constEnd()) {
+	if ((cap = findCapability(ICQ_CAPABILITY_JIMMxVER)) != m_client_caps.constEnd()) {
 		m_client_id = "Jimm ";
 		m_client_id += QString::fromUtf8(cap->data().mid(5, 11));
 		setClientIcon("jimm");
@@ -1046,9 +1101,10 @@ void ClientIdentify::identify_Mip()
 															 0x00, 0x00, 0x00, 0x00);
 
 	oscar::Capabilities::const_iterator cap;
-	if ((cap = m_client_caps.find(ICQ_CAPABILITY_MIPCLIENT, 12)) != m_client_caps.constEnd()) {
+	if ((cap = findCapability(ICQ_CAPABILITY_MIPCLIENT, 12)) != m_client_caps.constEnd()) {
 		m_client_id = "MIP ";
-		const char *cap_str = cap->data().data() + 12;
+		const QByteArray cap_data = cap->data();
+		const char *cap_str = cap_data.constData() + 12;
 		unsigned ver1 = cap_str[0];
 
 		if (ver1 < 30) {
@@ -1059,7 +1115,7 @@ void ClientIdentify::identify_Mip()
 		}
 		else
 			m_client_id += QString::fromUtf8(cap->data().mid(11, 5));
-	} else if ((cap = m_client_caps.find(ICQ_CAPABILITY_MIPCLIENT)) != m_client_caps.constEnd()) {
+	} else if ((cap = findCapability(ICQ_CAPABILITY_MIPCLIENT)) != m_client_caps.constEnd()) {
 		m_client_id = "MIP ";
 		m_client_id += QString::fromUtf8(cap->data().mid(4, 12));
 	}
@@ -1075,8 +1131,8 @@ void ClientIdentify::identify_Jasmine()
 	static const oscar::Capability ICQ_CAPABILITY_JASMINExVER (0x4a, 0x61, 0x73, 0x6d, 0x69, 0x6e,
 															   0x65, 0x20, 0x76, 0x65, 0x72, 0xff,
 															   0x00, 0x00, 0x00, 0x00 );
-	if (m_client_caps.match(ICQ_CAPABILITY_JASMINExID)) {
-		oscar::Capabilities::const_iterator cap = m_client_caps.find(ICQ_CAPABILITY_JASMINExVER);
+	if (matchCapability(ICQ_CAPABILITY_JASMINExID)) {
+		oscar::Capabilities::const_iterator cap = findCapability(ICQ_CAPABILITY_JASMINExVER);
 		if (cap != m_client_caps.constEnd()) {
 			QByteArray data = cap->data();
 			const char *cap_str = data.constData() + 12;
@@ -1100,8 +1156,8 @@ void ClientIdentify::identify_Trillian()
 																0x4d, 0xfb, 0xb2, 0x35, 0x36, 0x79,
 																0x8b, 0xdf, 0x00, 0x00 );
 
-	if (m_client_caps.match(ICQ_CAPABILITY_TRILLIANxVER) ||
-		m_client_caps.match(ICQ_CAPABILITY_TRILCRPTxVER))
+	if (matchCapability(ICQ_CAPABILITY_TRILLIANxVER) ||
+		matchCapability(ICQ_CAPABILITY_TRILCRPTxVER))
 	{
 		m_client_id = "Trillian";
 		if (RtfSupport()) {
@@ -1121,8 +1177,9 @@ void ClientIdentify::identify_Climm()
 															 0x00, 0x00, 0x00);
 
 	oscar::Capabilities::const_iterator cap;
-	if ((cap = m_client_caps.find(ICQ_CAPABILITY_CLIMMxVER)) != m_client_caps.constEnd()) {
-		const char *cap_str = cap->data().data() + 12;
+	if ((cap = findCapability(ICQ_CAPABILITY_CLIMMxVER)) != m_client_caps.constEnd()) {
+		const QByteArray cap_data = cap->data();
+		const char *cap_str = cap_data.constData() + 12;
 		unsigned ver1 = cap_str[0];
 		unsigned ver2 = cap_str[1];
 		unsigned ver3 = cap_str[2];
@@ -1145,7 +1202,7 @@ void ClientIdentify::identify_Im2()
 														   0x48, 0x5B, 0x8B, 0x1C, 0x67, 0x1A,
 														   0x1F, 0x86, 0x09, 0x9F);
 
-	if (m_client_caps.match(ICQ_CAPABILITY_IM2xVER))
+	if (matchCapability(ICQ_CAPABILITY_IM2xVER))
 		setClientData("IM2", "im2");
 }
 
@@ -1156,8 +1213,9 @@ void ClientIdentify::identify_AndRQ()
 														 0x00, 0x00, 0x00);
 
 	oscar::Capabilities::const_iterator cap;
-	if ((cap = m_client_caps.find(ICQ_CAPABILITY_ANDRQxVER)) != m_client_caps.constEnd()) {
-		const char *cap_str = cap->data().data();
+	if ((cap = findCapability(ICQ_CAPABILITY_ANDRQxVER)) != m_client_caps.constEnd()) {
+		const QByteArray cap_data = cap->data();
+		const char *cap_str = cap_data.constData();
 		unsigned ver1 = cap_str[0xC];
 		unsigned ver2 = cap_str[0xB];
 		unsigned ver3 = cap_str[0xA];
@@ -1174,8 +1232,9 @@ void ClientIdentify::identify_RandQ()
 															 0x00, 0x00, 0x00);
 
 	oscar::Capabilities::const_iterator cap;
-	if ((cap = m_client_caps.find(ICQ_CAPABILITY_RANDQxVER)) != m_client_caps.constEnd()) {
-		const char *cap_str = cap->data().data();
+	if ((cap = findCapability(ICQ_CAPABILITY_RANDQxVER)) != m_client_caps.constEnd()) {
+		const QByteArray cap_data = cap->data();
+		const char *cap_str = cap_data.constData();
 		unsigned ver1 = cap_str[0xC];
 		unsigned ver2 = cap_str[0xB];
 		unsigned ver3 = cap_str[0xA];
@@ -1191,7 +1250,7 @@ void ClientIdentify::identify_Imadering()
 															  'n', 'g', ' ', 'C', 'l', 'i', 'e',
 															  'n', 't');
 
-	if (m_client_caps.match(ICQ_CAPABILITY_IMADERING, 0x10))
+	if (matchCapability(ICQ_CAPABILITY_IMADERING, 0x10))
 		setClientData("IMadering", "unknown"); // icon ???
 }
 
@@ -1203,7 +1262,7 @@ void ClientIdentify::identify_Mchat()
 														 0x00, 0x00, 0x00);
 
 	oscar::Capabilities::const_iterator cap;
-	if ((cap = m_client_caps.find(ICQ_CAPABILITY_MCHATxVER)) != m_client_caps.constEnd()) {
+	if ((cap = findCapability(ICQ_CAPABILITY_MCHATxVER)) != m_client_caps.constEnd()) {
 		m_client_id = "mChat ";
 		m_client_id += QString::fromUtf8(cap->data().mid(10, 6));
 		setClientIcon("mchat");
@@ -1217,7 +1276,7 @@ void ClientIdentify::identify_CorePager()
 															   0x00, 0x00, 0x00);
 
 	oscar::Capabilities::const_iterator cap;
-	if ((cap = m_client_caps.find(ICQ_CAPABILITY_COREPGRxVER)) != m_client_caps.constEnd()) {
+	if ((cap = findCapability(ICQ_CAPABILITY_COREPGRxVER)) != m_client_caps.constEnd()) {
 		m_client_id += "CORE Pager";
 		if ((m_ext_info == 0x0FFFF0011) &&
 				(m_ext_status_info == 0x1100FFFF) &&
@@ -1238,7 +1297,7 @@ void ClientIdentify::identify_DiChat()
 															  0x00, 0x00, 0x00);
 
 	oscar::Capabilities::const_iterator cap;
-	if ((cap = m_client_caps.find(ICQ_CAPABILITY_DICHATxVER)) != m_client_caps.constEnd()) {
+	if ((cap = findCapability(ICQ_CAPABILITY_DICHATxVER)) != m_client_caps.constEnd()) {
 		m_client_id += "D[i]Chat ";
 		m_client_id += QString::fromUtf8(cap->data().mid(8, 8));
 		setClientIcon("dichat");
@@ -1251,7 +1310,7 @@ void ClientIdentify::identify_Macicq()
 															  0x11, 0xd4, 0x90, 0xdb, 0x00, 0x10,
 															  0x4b, 0x9b, 0x4b, 0x7d);
 
-	if (m_client_caps.match(ICQ_CAPABILITY_MACICQxVER, 0x10))
+	if (matchCapability(ICQ_CAPABILITY_MACICQxVER, 0x10))
 		setClientData("ICQ for Mac", "icq-mac");
 }
 
@@ -1261,7 +1320,7 @@ void ClientIdentify::identify_Anastasia()
 															0xE5, 0x47, 0xBD, 0x65, 0xEF, 0xD6,
 															0xA3, 0x7E, 0x36, 0x02);
 
-	if (m_client_caps.match(ICQ_CAPABILITY_ANSTxVER))
+	if (matchCapability(ICQ_CAPABILITY_ANSTxVER))
 		setClientData("Anastasia", "anastasia");
 }
 
@@ -1273,8 +1332,9 @@ void ClientIdentify::identify_Jicq()
 															0x00, 0x00, 0x00, 0x00);
 
 	oscar::Capabilities::const_iterator cap;
-	if ((cap = m_client_caps.find(ICQ_CAPABILITY_PALMJICQ, 0xc)) != m_client_caps.constEnd()) {
-		const char *cap_str = cap->data().data();
+	if ((cap = findCapability(ICQ_CAPABILITY_PALMJICQ, 0xc)) != m_client_caps.constEnd()) {
+		const QByteArray cap_data = cap->data();
+		const char *cap_str = cap_data.constData();
 		unsigned ver1 = cap_str[0xC];
 		unsigned ver2 = cap_str[0xD];
 		unsigned ver3 = cap_str[0xE];
@@ -1290,7 +1350,7 @@ void ClientIdentify::identify_Inlux()
 															 0x47, 0x9A, 0xB8, 0x45, 0xC9, 0xE4,
 															 0x67, 0xC5, 0x6B, 0x1F);
 
-	if (m_client_caps.match(ICQ_CAPABILITY_INLUXMSGR, 0x10))
+	if (matchCapability(ICQ_CAPABILITY_INLUXMSGR, 0x10))
 		setClientData("Inlux Messenger", "inlux");
 }
 
@@ -1301,7 +1361,7 @@ void ClientIdentify::identify_Vmicq()
 															 0x00, 0x00, 0x00, 0x00);
 
 	oscar::Capabilities::const_iterator cap;
-	if ((cap = m_client_caps.find(ICQ_CAPABILITY_VMICQxVER)) != m_client_caps.constEnd()) {
+	if ((cap = findCapability(ICQ_CAPABILITY_VMICQxVER)) != m_client_caps.constEnd()) {
 		m_client_id += "VmICQ ";
 		m_client_id += QString::fromUtf8(cap->data().mid(5, 11));
 		setClientIcon("vmicq");
@@ -1315,7 +1375,7 @@ void ClientIdentify::identify_Smaper()
 															  0x00, 0x00, 0x00);
 
 	oscar::Capabilities::const_iterator cap;
-	if ((cap = m_client_caps.find(ICQ_CAPABILITY_SMAPERxVER)) != m_client_caps.constEnd()) {
+	if ((cap = findCapability(ICQ_CAPABILITY_SMAPERxVER)) != m_client_caps.constEnd()) {
 		m_client_id += "SmapeR ";
 		m_client_id += QString::fromUtf8(cap->data().mid(6, 10));
 		setClientIcon("smaper");
@@ -1328,7 +1388,7 @@ void ClientIdentify::identify_Yapp()
 															0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 															0x00, 0x00, 0x00, 0x00);
 	oscar::Capabilities::const_iterator cap;
-	if ((cap = m_client_caps.find(ICQ_CAPABILITY_YAPPxVER)) != m_client_caps.constEnd()) {
+	if ((cap = findCapability(ICQ_CAPABILITY_YAPPxVER)) != m_client_caps.constEnd()) {
 		m_client_id = "Yapp! v";
 		m_client_id += QString::fromUtf8(cap->data().mid(8, 5));
 		setClientIcon("yapp");
@@ -1341,7 +1401,7 @@ void ClientIdentify::identify_Pigeon()
 															  0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 															  0x00, 0x00, 0x00);
 
-	if (m_client_caps.match(ICQ_CAPABILITY_PIGEONxVER))
+	if (matchCapability(ICQ_CAPABILITY_PIGEONxVER))
 		setClientData("Pigeon", "pigeon");
 }
 
@@ -1352,7 +1412,7 @@ void ClientIdentify::identify_NatIcq()
 															  0x00, 0x00, 0x00, 0x00);
 
 	oscar::Capabilities::const_iterator cap;
-	if ((cap = m_client_caps.find(ICQ_CAPABILITY_NATICQxVER)) != m_client_caps.constEnd()) {
+	if ((cap = findCapability(ICQ_CAPABILITY_NATICQxVER)) != m_client_caps.constEnd()) {
 		m_client_id = QString("NatICQ Siemens (revision %s)").arg(QString::fromUtf8(cap->data().mid(0xc, 4)));
 		setClientIcon("naticq");
 	}
@@ -1365,8 +1425,9 @@ void ClientIdentify::identify_WebIcqPro()
 															 0x00, 0x00, 0x00);
 
 	oscar::Capabilities::const_iterator cap;
-	if ((cap = m_client_caps.find(ICQ_CAPABILITY_WEBICQPRO)) != m_client_caps.constEnd()) {
-		const char *cap_str = cap->data().data();
+	if ((cap = findCapability(ICQ_CAPABILITY_WEBICQPRO)) != m_client_caps.constEnd()) {
+		const QByteArray cap_data = cap->data();
+		const char *cap_str = cap_data.constData();
 		unsigned ver1 = cap_str[0xA];
 		unsigned ver2 = cap_str[0xB];
 		unsigned ver3 = cap_str[0xC];
@@ -1384,7 +1445,7 @@ void ClientIdentify::identify_BayanIcq()
 																0x00, 0x00, 0x00);
 
 	oscar::Capabilities::const_iterator cap;
-	if ((cap = m_client_caps.find(ICQ_CAPABILITY_BAYANICQxVER)) != m_client_caps.constEnd()) {
+	if ((cap = findCapability(ICQ_CAPABILITY_BAYANICQxVER)) != m_client_caps.constEnd()) {
 		m_client_id = "bayanICQ v";
 		m_client_id += QString::fromUtf8(cap->data().mid(8, 8));
 		setClientIcon("bayanicq");
@@ -29,6 +29,7 @@
 
 #include <QList>
 #include <QByteArray>
+#include <QCache>
 #include "../../src/capability.h"
 #include "../../src/oscarroster.h"
 #include <qutim/plugin.h>
@@ -41,6 +42,7 @@ class Contact;
 namespace oscar {
 
 class IcqContact;
+struct DirectConnectionInfo;
 
 enum CapabilityFlag
 {
@@ -70,6 +72,10 @@ public:
 	ClientIdentify();
 	~ClientIdentify();
 	void identify(IcqContact *contact);
+	void identify(const Capabilities &capabilities, const DirectConnectionInfo &info);
+	// Result of the last identification
+	QString clientId() const { return m_client_id; }
+	ExtensionIcon clientIcon() const { return m_client_icon; }
 	virtual void statusChanged(IcqContact *contact, Status &status, const TLVMap &tlvs);
 	virtual void virtual_hook(int type, void *data);
 	virtual void init();
@@ -92,6 +98,12 @@ private:
 	bool SrvRelaySupport() const;
 	bool AvatarSupport() const;
 private:
+	void identifyClient();
+	oscar::Capabilities::const_iterator findCapability(const oscar::Capability &capability,
+													   quint8 len = oscar::Capabilities::UpToFirstZero);
+	inline bool matchCapability(const oscar::Capability &capability,
+								quint8 len = oscar::Capabilities::UpToFirstZero)
+	{ return findCapability(capability, len) != m_client_caps.constEnd(); }
 	void setClientData(const QString &clientId, const QString &icon);
 	void setClientIcon(const QString &icon);
 	void identify_by_DCInfo();
@@ -139,16 +151,28 @@ private:
 	void identify_StrIcq();
 	void identify_NaimIcq();
 private:
-	IcqContact *m_contact;
 	oscar::Capabilities m_client_caps;
 	quint16 m_client_proto;
 	quint32 m_info;
 	quint32 m_ext_info;
 	quint32 m_ext_status_info;
+	quint32 m_port;
+	quint32 m_auth_cookie;
 	QString m_client_id;
 	ExtensionIcon m_client_icon;
 	CapabilityFlags m_flags;
 	QString m_client;
+	// Capabilities of the contact by their prefixes of every requested length
+	QVector<QByteArray> m_caps_data;
+	QHash<int, QHash<QByteArray, int> > m_caps_index;
+
+	struct ClientData
+	{
+		QString id;
+		ExtensionIcon icon;
+	};
+	// Results by fingerprint of everything used for identification
+	QCache<QByteArray, ClientData> m_cache;
 
 private:
 	static const oscar::Capability ICQ_CAPABILITY_ICQJSINxVER;
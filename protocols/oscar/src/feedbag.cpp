@@ -25,11 +25,13 @@
 
 
 #include "feedbag.h"
+#include "feedbagcache.h"
 #include "snac.h"
 #include "oscarconnection.h"
 #include "icqaccount.h"
 #include <qutim/protocol.h>
 #include <qutim/debug.h>
+#include <qutim/systeminfo.h>
 #include <QCoreApplication>
 #include <QQueue>
 #include <QDateTime>
@@ -83,7 +85,6 @@ public:
 	inline void remove(FeedbagItem item);
 	bool isSendingAllowed(const FeedbagItem &item, Feedbag::ModifyType operation);
 	quint16 id() const { return itemType == SsiGroup ? groupId : itemId; }
-	QString configId() const { return QString::number(quint64(quint64(itemType) << 16 | id()) << 32 | groupId); }
 
 	QString recordName;
 	quint16 groupId;
@@ -114,7 +115,6 @@ struct FeedbagGroup
 	ItemsNameHash hashByName;
 };
 
-typedef QHash<QPair<quint16, quint16>, FeedbagItem> AllItemsHash;
 typedef QHash<quint16, FeedbagGroup> GroupHash;
 
 
@@ -138,6 +138,12 @@ public:
 	FeedbagItemPrivate *getFeedbagItemPrivate(const SNAC &snac);
 	void updateList();
 	void updateFeedbagList();
+	QString cacheFileName() const;
+	bool loadCache();
+	void loadLegacyCache();
+	void buildIndexes();
+	void saveCache();
+	void journalItem(const FeedbagItem &item, Feedbag::ModifyType type);
 
 	AllItemsHash itemsById;
 	QHash<quint16, QSet<quint16> > itemsByType;
@@ -153,6 +159,7 @@ public:
 	uint lastUpdateTime;
 	bool firstPacket;
 	QList<quint16> limits;
+	FeedbagCache cache;
 	Feedbag *q_ptr;
 };
 
@@ -616,15 +623,8 @@ void FeedbagPrivate::handleItem(FeedbagItem &item, Feedbag::ModifyType type, Fee
 //		}
 //		// Update the feedbag config.
 		Status::Type status = account->status().type();
-		if (status != Status::Connecting && status != Status::Offline) {
-			Config cfg = q->config("feedbag/cache");
-			if (type == Feedbag::Remove)
-				cfg.remove(item.d->configId());
-			else
-				cfg.setValue(item.d->configId(), QVariant::fromValue(item));
-			//lastUpdateTime = QDateTime::currentDateTime().toTime_t();
-			//cfg.setValue("lastUpdateTime", lastUpdateTime);
-		}
+		if (status != Status::Connecting && status != Status::Offline)
+			journalItem(item, type);
 	}
 }
 
@@ -742,6 +742,68 @@ void FeedbagPrivate::updateFeedbagList()
 	}
 }
 
+QString FeedbagPrivate::cacheFileName() const
+{
+	return QString("%1/feedbag/%2.%3.cache")
+			.arg(SystemInfo::getPath(SystemInfo::ConfigDir))
+			.arg(account->protocol()->id())
+			.arg(account->id());
+}
+
+bool FeedbagPrivate::loadCache()
+{
+	Q_Q(Feedbag);
+	if (!cache.load(q, itemsById, lastUpdateTime))
+		return false;
+	buildIndexes();
+	return true;
+}
+
+void FeedbagPrivate::loadLegacyCache()
+{
+	Q_Q(Feedbag);
+	Config cfg = q->config("feedbag");
+	cfg.beginGroup("cache");
+	foreach (const QString &itemIdStr, cfg.childKeys()) {
+		FeedbagItem item = cfg.value<FeedbagItem>(itemIdStr);
+		if (item.isNull())
+			continue;
+		item.d->feedbag = q;
+		itemsById.insert(item.pairId(), item);
+	}
+	cfg.endGroup();
+	buildIndexes();
+}
+
+void FeedbagPrivate::buildIndexes()
+{
+	itemsByType.clear();
+	root.hashByName.clear();
+	root.regulars.clear();
+	for (AllItemsHash::Iterator it = itemsById.begin(); it != itemsById.end(); ++it) {
+		FeedbagItem &item = it.value();
+		itemsByType[item.type()].insert(item.d->id());
+		FeedbagGroup *group = findGroup(item.groupId());
+		if (item.type() == SsiGroup) {
+			group->item = item;
+			root.hashByName.insert(item.pairName(), item.groupId());
+		} else {
+			group->hashByName.insert(item.pairName(), item.itemId());
+		}
+	}
+}
+
+void FeedbagPrivate::saveCache()
+{
+	cache.save(itemsById, lastUpdateTime);
+}
+
+void FeedbagPrivate::journalItem(const FeedbagItem &item, Feedbag::ModifyType type)
+{
+	if (!cache.append(item, type == Feedbag::Remove, itemsById.size()))
+		saveCache();
+}
+
 Feedbag::Feedbag(IcqAccount *acc):
 	QObject(acc), d(new FeedbagPrivate(acc, this))
 {
@@ -764,23 +826,15 @@ Feedbag::Feedbag(IcqAccount *acc):
 	acc->connection()->registerInitializationSnacs(m_initSnacs);
 	Config cfg = config("feedbag");
 	d->lastUpdateTime = cfg.value("lastUpdateTime", 0);
-	cfg.beginGroup("cache");
-	foreach (const QString &itemIdStr, cfg.childKeys()) {
-		FeedbagItem item = cfg.value<FeedbagItem>(itemIdStr);
-		if (item.isNull())
-			continue;
-		item.d->feedbag = this;
-		d->itemsById.insert(item.pairId(), item);
-		d->itemsByType[item.type()].insert(item.d->id());
-		FeedbagGroup *group = d->findGroup(item.groupId());
-		if (item.type() == SsiGroup) {
-			group->item = item;
-			d->root.hashByName.insert(item.pairName(), item.groupId());
-		} else {
-			group->hashByName.insert(item.pairName(), item.itemId());
+	d->cache.setFileName(d->cacheFileName());
+	if (!d->loadCache()) {
+		d->loadLegacyCache();
+		// Move items cached by previous versions to the binary cache
+		if (!d->itemsById.isEmpty()) {
+			d->saveCache();
+			cfg.remove("cache");
 		}
 	}
-	cfg.endGroup();
 	connect(acc, SIGNAL(statusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)),
 			SLOT(statusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)));
 }
@@ -1096,11 +1150,7 @@ void Feedbag::handleSNAC(AbstractConnection *conn, const SNAC &sn)
 			cfg.remove("feedbag");
 			cfg = cfg.group("feedbag");
 			cfg.setValue("lastUpdateTime", d->lastUpdateTime);
-			cfg.beginGroup("cache");
-			foreach (const FeedbagItem &item, d->itemsById) {
-				cfg.setValue(item.d->configId(), QVariant::fromValue(item));
-			}
-			cfg.endGroup();
+			d->saveCache();
 			d->finishLoading();
 		}
 		break;
@@ -0,0 +1,167 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Alexey Prokhin <alexey.prokhin@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "feedbagcache.h"
+#include "util.h"
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QDir>
+#include <qutim/debug.h>
+
+namespace qutim_sdk_0_3 {
+
+namespace oscar {
+
+const quint32 FEEDBAG_CACHE_MAGIC = 0x51464243; // "QFBC"
+const quint16 FEEDBAG_CACHE_VERSION = 1;
+// Journal is merged into snapshot when it becomes longer than this
+// number of records or than half of the items count
+const int FEEDBAG_JOURNAL_LIMIT = 256;
+
+enum FeedbagCacheOperation
+{
+	CacheItemPut = 1,
+	CacheItemRemove = 2
+};
+
+static void appendRecord(DataUnit &unit, const FeedbagItem &item, FeedbagCacheOperation operation)
+{
+	DataUnit record;
+	record.append<quint8>(operation);
+	record.append<quint16>(item.name(), Util::utf8Codec());
+	record.append<quint16>(item.groupId());
+	record.append<quint16>(item.itemId());
+	record.append<quint16>(item.type());
+	if (operation == CacheItemPut) {
+		record.append<quint16>(item.constData().valuesSize());
+		record.append(item.constData());
+	}
+	unit.append<quint32>(record.data().size());
+	unit.append(record.data());
+}
+
+FeedbagCache::FeedbagCache() : m_journalSize(0)
+{
+}
+
+void FeedbagCache::setFileName(const QString &fileName)
+{
+	m_journal.close();
+	m_fileName = fileName;
+	m_journalSize = 0;
+}
+
+QString FeedbagCache::fileName() const
+{
+	return m_fileName;
+}
+
+bool FeedbagCache::load(Feedbag *feedbag, AllItemsHash &items, uint &lastUpdateTime)
+{
+	QFile file(m_fileName);
+	if (!file.open(QIODevice::ReadOnly) || file.size() < 10)
+		return false;
+	const uchar *map = file.map(0, file.size());
+	QByteArray buffer = map ? QByteArray::fromRawData(reinterpret_cast<const char*>(map), file.size())
+							: file.readAll();
+	DataUnit data(buffer);
+	if (data.read<quint32>() != FEEDBAG_CACHE_MAGIC || data.read<quint16>() != FEEDBAG_CACHE_VERSION) {
+		qDebug() << "Unsupported feedbag cache" << file.fileName();
+		return false;
+	}
+	lastUpdateTime = data.read<quint32>();
+	int records = 0;
+	while (data.dataSize() >= sizeof(quint32)) {
+		quint32 length = data.read<quint32>();
+		// The last record may be incomplete if we have crashed while writing it
+		if (length > data.dataSize())
+			break;
+		DataUnit record(data.readData(length));
+		quint8 operation = record.read<quint8>();
+		QString name = record.read<QString, quint16>(Util::utf8Codec());
+		quint16 groupId = record.read<quint16>();
+		quint16 itemId = record.read<quint16>();
+		quint16 type = record.read<quint16>();
+		FeedbagItem item(feedbag, type, itemId, groupId, name);
+		if (operation == CacheItemRemove) {
+			items.remove(item.pairId());
+		} else {
+			item.setData(record.read<DataUnit, quint16>().read<TLVMap>());
+			items.insert(item.pairId(), item);
+		}
+		++records;
+	}
+	m_journalSize = qMax(records - items.size(), 0);
+	if (map)
+		file.unmap(const_cast<uchar*>(map));
+	return true;
+}
+
+bool FeedbagCache::save(const AllItemsHash &items, uint lastUpdateTime)
+{
+	m_journal.close();
+	QDir().mkpath(QFileInfo(m_fileName).absolutePath());
+	QSaveFile file(m_fileName);
+	if (!file.open(QIODevice::WriteOnly)) {
+		qWarning() << "Can not write feedbag cache to" << m_fileName;
+		return false;
+	}
+	DataUnit unit;
+	unit.append<quint32>(FEEDBAG_CACHE_MAGIC);
+	unit.append<quint16>(FEEDBAG_CACHE_VERSION);
+	unit.append<quint32>(lastUpdateTime);
+	foreach (const FeedbagItem &item, items)
+		appendRecord(unit, item, CacheItemPut);
+	file.write(unit.data());
+	if (!file.commit())
+		return false;
+	m_journalSize = 0;
+	return true;
+}
+
+bool FeedbagCache::append(const FeedbagItem &item, bool removed, int itemsCount)
+{
+	if (m_journalSize >= qMax(FEEDBAG_JOURNAL_LIMIT, itemsCount / 2))
+		return false;
+	if (!m_journal.isOpen()) {
+		m_journal.setFileName(m_fileName);
+		// Journal has sense only in pair with snapshot
+		if (!m_journal.exists() || !m_journal.open(QIODevice::WriteOnly | QIODevice::Append))
+			return false;
+	}
+	DataUnit unit;
+	appendRecord(unit, item, removed ? CacheItemRemove : CacheItemPut);
+	m_journal.write(unit.data());
+	m_journal.flush();
+	++m_journalSize;
+	return true;
+}
+
+int FeedbagCache::journalSize() const
+{
+	return m_journalSize;
+}
+
+} } // namespace qutim_sdk_0_3::oscar
@@ -0,0 +1,63 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Alexey Prokhin <alexey.prokhin@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef OSCAR_FEEDBAGCACHE_H
+#define OSCAR_FEEDBAGCACHE_H
+
+#include "feedbag.h"
+#include <QFile>
+
+namespace qutim_sdk_0_3 {
+
+namespace oscar {
+
+typedef QHash<QPair<quint16, quint16>, FeedbagItem> AllItemsHash;
+
+// Binary feedbag cache: header followed by length prefixed item records.
+// Snapshot is written after the whole list is received from server,
+// later changes are appended to the end as journal records.
+class FeedbagCache
+{
+public:
+	FeedbagCache();
+	void setFileName(const QString &fileName);
+	QString fileName() const;
+	// Reads snapshot and replays journal on top of it
+	bool load(Feedbag *feedbag, AllItemsHash &items, uint &lastUpdateTime);
+	// Writes snapshot of all items, journal is merged into it
+	bool save(const AllItemsHash &items, uint lastUpdateTime);
+	// Appends record to the journal. Returns false if snapshot should be
+	// written instead, i.e. journal is too long or there is no snapshot
+	bool append(const FeedbagItem &item, bool removed, int itemsCount);
+	int journalSize() const;
+private:
+	QString m_fileName;
+	QFile m_journal;
+	int m_journalSize;
+};
+
+} } // namespace qutim_sdk_0_3::oscar
+
+#endif // OSCAR_FEEDBAGCACHE_H
@@ -0,0 +1,170 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Alexey Prokhin <alexey.prokhin@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "oftchecksum.h"
+#include <QtAlgorithms>
+
+#if (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)) \
+	&& !defined(__CHAR_UNSIGNED__) && !defined(_CHAR_UNSIGNED)
+#  define OFT_CHECKSUM_SSE2
+#  include <emmintrin.h>
+#  ifdef __AVX2__
+#    define OFT_CHECKSUM_AVX2
+#    include <immintrin.h>
+#  endif
+#endif
+
+namespace qutim_sdk_0_3 {
+
+namespace oscar {
+
+// Checksum is calculated by blocks of this size, see OftChecksum::update
+const int CHECKSUM_BLOCK_SIZE = 1024;
+
+quint32 OftChecksum::updateScalar(const char *buffer, int len, quint32 oldChecksum, int offset)
+{
+	// code adapted from miranda's oft_calc_checksum
+	quint32 checksum = (oldChecksum >> 16) & 0xffff;
+	checksum = subtractChecksum(buffer, len, checksum, offset);
+	checksum = ((checksum & 0x0000ffff) + (checksum >> 16));
+	checksum = ((checksum & 0x0000ffff) + (checksum >> 16));
+	return (quint32)checksum << 16;
+}
+
+quint32 OftChecksum::subtractChecksum(const char *buffer, int len, quint32 checksum, int offset)
+{
+	for (int i = 0; i < len; i++)
+	{
+		quint16 val = buffer[i];
+		if (((i + offset) & 1) == 0)
+			val = val << 8;
+		if (checksum < val)
+			checksum -= val + 1;
+		else // simulate carry
+			checksum -= val;
+	}
+	return checksum;
+}
+
+// Returns the sum of all values subtracted by subtractChecksum for the block.
+// Bytes at even positions are shifted by 8 bits, bytes at odd positions are
+// sign extended to 16 bits (buffer is a signed char array on x86).
+quint64 OftChecksum::blockSum(const char *buffer, int len, int offset)
+{
+	int i = 0;
+	quint64 sum = 0;
+#ifdef OFT_CHECKSUM_SSE2
+	const uchar *data = reinterpret_cast<const uchar*>(buffer);
+	quint64 evenSum = 0;
+	quint64 oddSum = 0;
+	int evenNegative = 0;
+	int oddNegative = 0;
+# ifdef OFT_CHECKSUM_AVX2
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i lowMask = _mm256_set1_epi16(0x00ff);
+		__m256i evenAcc = zero;
+		__m256i oddAcc = zero;
+		for (; i + 32 <= len; i += 32) {
+			__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+			evenAcc = _mm256_add_epi64(evenAcc, _mm256_sad_epu8(_mm256_and_si256(v, lowMask), zero));
+			oddAcc = _mm256_add_epi64(oddAcc, _mm256_sad_epu8(_mm256_srli_epi16(v, 8), zero));
+			quint32 negative = quint32(_mm256_movemask_epi8(v));
+			evenNegative += qPopulationCount(negative & 0x55555555u);
+			oddNegative += qPopulationCount(negative & 0xaaaaaaaau);
+		}
+		quint64 lanes[4];
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), evenAcc);
+		evenSum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), oddAcc);
+		oddSum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	}
+# endif
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i lowMask = _mm_set1_epi16(0x00ff);
+		__m128i evenAcc = zero;
+		__m128i oddAcc = zero;
+		for (; i + 16 <= len; i += 16) {
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+			evenAcc = _mm_add_epi64(evenAcc, _mm_sad_epu8(_mm_and_si128(v, lowMask), zero));
+			oddAcc = _mm_add_epi64(oddAcc, _mm_sad_epu8(_mm_srli_epi16(v, 8), zero));
+			quint32 negative = quint32(_mm_movemask_epi8(v));
+			evenNegative += qPopulationCount(negative & 0x5555u);
+			oddNegative += qPopulationCount(negative & 0xaaaau);
+		}
+		quint64 lanes[2];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), evenAcc);
+		evenSum += lanes[0] + lanes[1];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), oddAcc);
+		oddSum += lanes[0] + lanes[1];
+	}
+	// Vectorized part always ends at even index, so parity of i is parity of the position
+	if (offset & 1) {
+		qSwap(evenSum, oddSum);
+		qSwap(evenNegative, oddNegative);
+	}
+	sum = (evenSum << 8) + oddSum + quint64(oddNegative) * 0xff00;
+#endif
+	for (; i < len; ++i) {
+		quint16 val = buffer[i];
+		if (((i + offset) & 1) == 0)
+			val = val << 8;
+		sum += val;
+	}
+	return sum;
+}
+
+quint32 OftChecksum::update(const char *buffer, int len, quint32 oldChecksum, int offset)
+{
+	quint32 checksum = (oldChecksum >> 16) & 0xffff;
+	// If the block's sum is not greater than the checksum no carry may happen inside
+	// of the block, so it can be subtracted at once. Otherwise process the block
+	// byte by byte, it happens rarely as after the first carry the checksum is huge.
+	for (int i = 0; i < len; i += CHECKSUM_BLOCK_SIZE) {
+		int blockLen = qMin(CHECKSUM_BLOCK_SIZE, len - i);
+		quint64 sum = blockSum(buffer + i, blockLen, offset + i);
+		if (sum <= checksum)
+			checksum -= quint32(sum);
+		else
+			checksum = subtractChecksum(buffer + i, blockLen, checksum, offset + i);
+	}
+	checksum = ((checksum & 0x0000ffff) + (checksum >> 16));
+	checksum = ((checksum & 0x0000ffff) + (checksum >> 16));
+	return (quint32)checksum << 16;
+}
+
+const char *OftChecksum::implementation()
+{
+#if defined(OFT_CHECKSUM_AVX2)
+	return "avx2";
+#elif defined(OFT_CHECKSUM_SSE2)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
+
+} } // namespace qutim_sdk_0_3::oscar
@@ -0,0 +1,53 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Alexey Prokhin <alexey.prokhin@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef OSCAR_OFTCHECKSUM_H
+#define OSCAR_OFTCHECKSUM_H
+
+#include <QtGlobal>
+
+namespace qutim_sdk_0_3 {
+
+namespace oscar {
+
+// Checksum of OFT file transfers. The checksum of a file is calculated
+// starting from 0xFFFF0000 by chunks, offset is a position of the chunk
+// in the file, only its parity matters.
+class OftChecksum
+{
+public:
+	static quint32 update(const char *buffer, int len, quint32 checksum, int offset);
+	// Reference byte-by-byte implementation, update must always give the same result
+	static quint32 updateScalar(const char *buffer, int len, quint32 checksum, int offset);
+	// Instruction set used by update, i.e. "avx2", "sse2" or "scalar"
+	static const char *implementation();
+private:
+	static quint32 subtractChecksum(const char *buffer, int len, quint32 checksum, int offset);
+	static quint64 blockSum(const char *buffer, int len, int offset);
+};
+
+} } // namespace qutim_sdk_0_3::oscar
+
+#endif // OSCAR_OFTCHECKSUM_H
@@ -24,6 +24,7 @@
 ****************************************************************************/
 
 #include "oscarfiletransfer_p.h"
+#include "oftchecksum.h"
 #include "buddycaps.h"
 #include "icqcontact.h"
 #include "tlv.h"
@@ -42,7 +43,15 @@ namespace oscar {
 QHash<quint16, OftServer*> OftFileTransferFactory::m_servers;
 bool OftFileTransferFactory::m_allowAnyPort;
 
-const int BUFFER_SIZE = 4096;
+const int BUFFER_SIZE = 64 * 1024;
+// Data which isn't read because of the bandwidth limit stays in the kernel's
+// buffer, so TCP flow control slows the sender down
+const qint64 SOCKET_READ_BUFFER_SIZE = 256 * 1024;
+// Sender keeps up to this much data in the socket's buffer, see OftConnection::onSendData
+const qint64 MIN_SEND_CHUNK = 16 * 1024;
+const qint64 MAX_SEND_CHUNK = 1024 * 1024;
+// Size of memory mapped windows, used both for checksum calculation and sending
+const qint64 MAP_WINDOW_SIZE = 16 * 1024 * 1024;
 using namespace Util;
 
 OftHeader::OftHeader() :
@@ -431,47 +440,41 @@ void OftServer::onTimeout()
 	close();
 }
 
-OftChecksumThread::OftChecksumThread(QIODevice *f, int b) :
+OftChecksumThread::OftChecksumThread(QIODevice *f, qint64 b) :
 	file(f), bytes(b)
 {
 }
 
-quint32 OftChecksumThread::chunkChecksum(const char *buffer, int len, quint32 oldChecksum, int offset)
-{
-	// code adapted from miranda's oft_calc_checksum
-	quint32 checksum = (oldChecksum >> 16) & 0xffff;
-	for (int i = 0; i < len; i++)
-	{
-		quint16 val = buffer[i];
-		//quint32 oldchecksum = checksum;
-		if (((i + offset) & 1) == 0)
-			val = val << 8;
-		if (checksum < val)
-			checksum -= val + 1;
-		else // simulate carry
-			checksum -= val;
-	}
-	checksum = ((checksum & 0x0000ffff) + (checksum >> 16));
-	checksum = ((checksum & 0x0000ffff) + (checksum >> 16));
-	return (quint32)checksum << 16;
-}
-
 void OftChecksumThread::run()
 {
 	quint32 checksum = 0xFFFF0000;
 	QByteArray data;
-	data.reserve(BUFFER_SIZE);
-	int totalRead = 0;
+	qint64 totalRead = 0;
 	if (bytes <= 0)
 		bytes = file->size();
 	bool isOpen = file->isOpen();
 	if (!isOpen)
 		file->open(QIODevice::ReadOnly);
+	QFile *mappable = qobject_cast<QFile*>(file);
 	while (totalRead < bytes) {
-		data = file->read(qMin(BUFFER_SIZE, bytes - totalRead));
-		checksum = chunkChecksum(data.constData(), data.size(), checksum, totalRead);
+		if (mappable) {
+			qint64 windowSize = qMin(MAP_WINDOW_SIZE, bytes - totalRead);
+			if (uchar *window = mappable->map(totalRead, windowSize)) {
+				checksum = OftChecksum::update(reinterpret_cast<const char*>(window), int(windowSize),
+											   checksum, int(totalRead & 1));
+				mappable->unmap(window);
+				totalRead += windowSize;
+				continue;
+			}
+			// Device can not be mapped (i.e. it's opened only for writing), read it
+			mappable = 0;
+			file->seek(totalRead);
+		}
+		data = file->read(qMin<qint64>(BUFFER_SIZE, bytes - totalRead));
+		if (data.isEmpty())
+			break;
+		checksum = OftChecksum::update(data.constData(), data.size(), checksum, int(totalRead & 1));
 		totalRead += data.size();
-		//QApplication::processEvents(); // This call causes crashes
 	}
 	if (!isOpen)
 		file->close();
@@ -482,17 +485,25 @@ OftConnection::OftConnection(IcqContact *contact, Direction direction, quint64 c
 	FileTransferJob(contact, direction, manager),
 	m_transfer(manager),
 	m_contact(contact),
-	m_account(contact->account()),
+	m_account(contact ? contact->account() : 0),
 	m_cookie(cookie),
 	m_proxy(forceProxy),
-	m_connInited(false)
+	m_connInited(false),
+	m_window(0),
+	m_windowOffset(0),
+	m_windowSize(0),
+	m_sendChunk(MIN_SEND_CHUNK)
 {
-	m_transfer->addConnection(this);
+	// Data stage of the connection may be run without factory, see oftconnectiontest
+	if (m_transfer)
+		m_transfer->addConnection(this);
+	connect(this, SIGNAL(bandwidthAvailable()), SLOT(onBandwidthAvailable()));
 }
 
 OftConnection::~OftConnection()
 {
-	m_transfer->removeConnection(this);
+	if (m_transfer)
+		m_transfer->removeConnection(this);
 }
 
 int OftConnection::localPort() const
@@ -550,6 +561,7 @@ void OftConnection::close(bool error)
 			m_socket.data()->close();
 		m_socket.data()->deleteLater();
 	}
+	releaseSendWindow();
 	if (m_data)
 		m_data.reset();
 	if (error) {
@@ -656,6 +668,7 @@ void OftConnection::setSocket(OftSocket *socket)
 		m_socket = socket;
 		m_socket.data()->setParent(this);
 		m_socket.data()->setCookie(m_cookie);
+		m_socket.data()->setReadBufferSize(SOCKET_READ_BUFFER_SIZE);
 		connect(m_socket.data(), SIGNAL(proxyInitialized()), SLOT(sendFileRequest()));
 		connect(m_socket.data(), SIGNAL(initialized()), SLOT(connected()));
 		connect(m_socket.data(), SIGNAL(error(QAbstractSocket::SocketError)),
@@ -771,11 +784,16 @@ void OftConnection::onNewData()
 	}
 	if (m_socket.data()->bytesAvailable() <= 0)
 		return;
-	QByteArray buf = m_socket.data()->read(m_header.size - m_header.bytesReceived);
+	qint64 toRead = qMin<qint64>(m_socket.data()->bytesAvailable(), m_header.size - m_header.bytesReceived);
+	// Data above the limit is left in the socket, it's read on bandwidthAvailable
+	toRead = requestBandwidth(toRead);
+	if (toRead <= 0)
+		return;
+	QByteArray buf = m_socket.data()->read(toRead);
 	m_header.receivedChecksum =
-			OftChecksumThread::chunkChecksum(buf.constData(), buf.size(),
-											 m_header.receivedChecksum,
-											 m_header.bytesReceived);
+			OftChecksum::update(buf.constData(), buf.size(),
+								m_header.receivedChecksum,
+								m_header.bytesReceived);
 	m_header.bytesReceived += buf.size();
 	m_data.data()->write(buf);
 	setFileProgress(m_header.bytesReceived);
@@ -794,22 +812,91 @@ void OftConnection::onNewData()
 
 void OftConnection::onSendData()
 {
-	if (!m_data && m_socket.data()->bytesToWrite())
+	if (!m_data)
 		return;
-	QByteArray buf = m_data.data()->read(BUFFER_SIZE);
-	m_header.receivedChecksum =
-			OftChecksumThread::chunkChecksum(buf.constData(), buf.size(),
-											 m_header.receivedChecksum,
-											 m_header.bytesReceived);
-	m_header.bytesReceived += buf.size();
-	m_socket.data()->write(buf);
+	OftSocket *socket = m_socket.data();
+	// Adapt the amount of data queued in the socket to the link: grow it while
+	// the socket manages to send everything we gave it, shrink it otherwise
+	qint64 pending = socket->bytesToWrite();
+	if (pending == 0)
+		m_sendChunk = qMin(m_sendChunk * 2, MAX_SEND_CHUNK);
+	else if (pending >= m_sendChunk)
+		return;
+	else if (pending > m_sendChunk / 2)
+		m_sendChunk = qMax(m_sendChunk / 2, MIN_SEND_CHUNK);
+	qint64 toSend = qMin(m_sendChunk - pending, qint64(m_header.size - m_header.bytesReceived));
+	toSend = requestBandwidth(toSend);
+	while (toSend > 0) {
+		qint64 available = 0;
+		const char *data = sendWindow(m_header.bytesReceived, &available);
+		QByteArray buf;
+		if (!data) {
+			buf = m_data.data()->read(qMin<qint64>(toSend, BUFFER_SIZE));
+			if (buf.isEmpty())
+				break;
+			data = buf.constData();
+			available = buf.size();
+		}
+		int len = int(qMin(toSend, available));
+		m_header.receivedChecksum =
+				OftChecksum::update(data, len,
+									m_header.receivedChecksum,
+									m_header.bytesReceived);
+		socket->write(data, len);
+		m_header.bytesReceived += len;
+		toSend -= len;
+	}
 	setFileProgress(m_header.bytesReceived);
 	if (m_header.bytesReceived == m_header.size) {
-		disconnect(m_socket.data(), SIGNAL(bytesWritten(qint64)), this, SLOT(onSendData()));
+		disconnect(socket, SIGNAL(bytesWritten(qint64)), this, SLOT(onSendData()));
+		releaseSendWindow();
 		m_data.reset();
 	}
 }
 
+void OftConnection::onBandwidthAvailable()
+{
+	if (!m_data || !m_socket)
+		return;
+	if (direction() == Incoming)
+		onNewData();
+	else
+		onSendData();
+}
+
+const char *OftConnection::sendWindow(qint64 pos, qint64 *available)
+{
+	if (!m_window || pos < m_windowOffset || pos >= m_windowOffset + m_windowSize) {
+		QFile *file = qobject_cast<QFile*>(m_data.data());
+		if (!file)
+			return 0;
+		releaseSendWindow();
+		qint64 size = qMin(MAP_WINDOW_SIZE, file->size() - pos);
+		if (size <= 0)
+			return 0;
+		m_window = file->map(pos, size);
+		if (!m_window) {
+			file->seek(pos);
+			return 0;
+		}
+		m_windowOffset = pos;
+		m_windowSize = size;
+	}
+	*available = m_windowOffset + m_windowSize - pos;
+	return reinterpret_cast<const char*>(m_window) + (pos - m_windowOffset);
+}
+
+void OftConnection::releaseSendWindow()
+{
+	if (m_window) {
+		if (QFile *file = qobject_cast<QFile*>(m_data.data()))
+			file->unmap(m_window);
+		m_window = 0;
+	}
+	m_windowOffset = 0;
+	m_windowSize = 0;
+}
+
 void OftConnection::startFileSending()
 {
 	int index = currentIndex()+1;
@@ -818,6 +905,7 @@ void OftConnection::startFileSending()
 		setState(Finished);
 		return;
 	}
+	releaseSendWindow();
 	m_data.reset(setCurrentIndex(index));
 	if (!m_data) {
 		setState(Error);
@@ -1025,6 +1113,8 @@ void OftConnection::onHeaderReaded()
 		case OftAcknowledge: {	// receiver are waiting file
 			m_socket.data()->dataReaded();
 			if (m_data.data()->open(QFile::ReadOnly)) {
+				m_data.data()->seek(m_header.bytesReceived);
+				m_sendChunk = MIN_SEND_CHUNK;
 				connect(m_socket.data(), SIGNAL(bytesWritten(qint64)), this, SLOT(onSendData()));
 				setState(Started);
 				onSendData();
@@ -1041,7 +1131,7 @@ void OftConnection::onHeaderReaded()
 }
 
 OftFileTransferFactory::OftFileTransferFactory():
-	FileTransferFactory(tr("Oscar"), CanSendMultiple)
+	FileTransferFactory(tr("Oscar"), CanSendMultiple | CanLimitBandwidth)
 {
 	reloadSettings();
 	m_capabilities << ICQ_CAPABILITY_AIMSENDFILE;
@@ -38,6 +38,8 @@
 #include <QHostInfo>
 #include <QThread>
 
+class OftConnectionTest;
+
 namespace qutim_sdk_0_3 {
 
 class Account;
@@ -180,15 +182,14 @@ class OftChecksumThread : public QThread
 {
 	Q_OBJECT
 public:
-	OftChecksumThread(QIODevice *file, int bytes = 0);
-	static quint32 chunkChecksum(const char *buffer, int len, quint32 checksum, int offset);
+	OftChecksumThread(QIODevice *file, qint64 bytes = 0);
 protected:
 	void run();
 signals:
 	void done(quint32 checksum);
 private:
 	QIODevice *file;
-	int bytes;
+	qint64 bytes;
 };
 
 class OftConnection : public FileTransferJob
@@ -214,6 +215,8 @@ private:
 	void startFileSending();
 	void startFileReceiving(const int index);
 	void startFileReceivingImpl(bool resume);
+	const char *sendWindow(qint64 pos, qint64 *available);
+	void releaseSendWindow();
 private slots:
 	void close() { close(true); }
 	void startNextStage();
@@ -223,12 +226,14 @@ private slots:
 	void onHeaderReaded();
 	void onNewData();
 	void onSendData();
+	void onBandwidthAvailable();
 	void startFileSendingImpl(quint32 checksum);
 	void startFileReceivingImpl(quint32 checksum);
 	void resumeFileReceivingImpl(quint32 checksum);
 private:
 	friend class OftServer;
 	friend class OftFileTransferFactory;
+	friend class ::OftConnectionTest;
 	QPointer<OftSocket> m_socket;
 	QPointer<OftServer> m_server;
 	QScopedPointer<QIODevice> m_data;
@@ -242,6 +247,10 @@ private:
 	bool m_connInited;
 	QString m_outputDir;
 	QHostAddress m_clientVerifiedIP;
+	uchar *m_window;
+	qint64 m_windowOffset;
+	qint64 m_windowSize;
+	qint64 m_sendChunk;
 };
 
 class OftFileTransferFactory : public FileTransferFactory, public MessagePlugin
@@ -0,0 +1,464 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Alexey Prokhin <alexey.prokhin@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "../plugins/identify/clientidentify.h"
+#include "connection.h"
+#include "buddycaps.h"
+#include <QtTest>
+
+using namespace qutim_sdk_0_3;
+using namespace qutim_sdk_0_3::oscar;
+
+// Identification results are compared with the ones of the original
+// implementation, rows are the smallest inputs which reach every branch of it
+class ClientIdentifyTest : public QObject
+{
+	Q_OBJECT
+private slots:
+	void knownClients_data();
+	void knownClients();
+
+private:
+	ClientIdentify m_identify;
+};
+
+struct KnownClient
+{
+	const char *client;
+	const char *icon;
+	quint16 protocol;
+	quint32 info;
+	quint32 extInfo;
+	quint32 extStatusInfo;
+	quint32 port;
+	quint32 authCookie;
+	// Names of the standard capabilities or hex of the other ones
+	const char *capabilities;
+};
+
+static const KnownClient knownClients[] = {
+	{ "&RQ", "RQ-icq", 0, 0xffffff7f, 0, 0, 0, 0,
+	  "" },
+	{ "&RQ 9.1.4.7", "rnq-icq", 0, 0, 0, 0, 0, 0,
+	  "522651696e7369646507040109050108" },
+	{ "-", "unknown-icq", 0, 0, 0, 0, 0, 0,
+	  "" },
+	{ "0.0.0.0", "mip-icq", 0, 0, 0, 0, 0, 0,
+	  "4d495020000000000000000000000000" },
+	{ "Agile Messenger", "agile-icq", 0, 0xffffff7f, 0, 0, 0, 0,
+	  "SRVxRELAY DIRECT TYPING UTF8" },
+	{ "Alicq 0.0.0", "unknown-icq", 0, 0xffffffbe, 0, 0, 0, 0,
+	  "" },
+	{ "Anastasia", "anastasia-icq", 0, 0, 0, 0, 0, 0,
+	  "44e5bfceb096e547bd65efd6a37e3602" },
+	{ "bayanICQ v", "bayanicq-icq", 0, 0, 0, 0, 0, 0,
+	  "626179616e4943510000000000000000" },
+	{ "bayanICQ v68275614", "bayanicq-icq", 0, 0, 0, 0, 0, 0,
+	  "626179616e4943513638323735363134" },
+	{ "bayanICQ v7.875143", "bayanicq-icq", 0, 0, 0, 0, 0, 0,
+	  "626179616e494351372e383735313433" },
+	{ "BeejiveIM", "beejive-icq", 0, 0, 0, 0, 0, 0,
+	  "RTFxMSGS UTF8" },
+	{ "Centericq", "centerim-icq-icq", 0, 0x3aa773ee, 0x3aa66380, 0, 0, 0,
+	  "RTFxMSGS" },
+	{ "climm 0.0.0.0/Win32", "climm-icq", 0, 0, 0, 0x02000020, 0, 0,
+	  "636c696d6da920522e4b2e2000000000" },
+	{ "climm 3.1.0.3/MacOS X", "climm-icq", 0, 0, 0, 0x03000800, 0, 0,
+	  "636c696d6da920522e4b2e2003010003" },
+	{ "climm 4294967168.0.3.4294967168 alpha/MacOS X", "climm-icq", 0, 0, 0, 0x03000800, 0, 0,
+	  "636c696d6da920522e4b2e2080000380" },
+	{ "climm 4294967168.2.1.4294967168 alpha", "climm-icq", 0, 0, 0, 0, 0, 0,
+	  "636c696d6da920522e4b2e2080020180" },
+	{ "climm 4294967168.4294967168.4294967168.0 alpha/Win32", "climm-icq", 0, 0, 0, 0x02000020, 0, 0,
+	  "636c696d6da920522e4b2e2080808000" },
+	{ "climm 53.46.57.48", "climm-icq", 0, 0, 0, 0, 0, 0,
+	  "636c696d6da920522e4b2e20352e3930" },
+	{ "CORE Pager", "jimm-corepager-icq", 0, 0, 0, 0, 0, 0,
+	  "434f5245205061676572800300800180" },
+	{ "D[i]Chat", "di_chat-icq", 0, 0x66666666, 0, 0x66666666, 0, 0,
+	  "" },
+	{ "D[i]Chat  ", "dichat-icq", 0, 0, 0, 0, 0, 0,
+	  "445b695d436861742000000000000000" },
+	{ "D[i]Chat  1.12441", "dichat-icq", 0, 0, 0, 0, 0, 0,
+	  "445b695d4368617420312e3132343431" },
+	{ "D[i]Chat  9300524", "dichat-icq", 0, 0, 0, 0, 0, 0,
+	  "445b695d436861742039333030353234" },
+	{ "D[i]Chat v.0.1a", "di_chat-icq", 0, 0x66666666, 0x00010000, 0x66666666, 0, 0,
+	  "" },
+	{ "Easy Message", "unknown-icq", 0, 0, 0, 0, 0, 0,
+	  "AIMCHAT AIMSENDFILE" },
+	{ "Gaim", "gaim-icq", 0, 0xffffffff, 0xffffffff, 0, 0, 0,
+	  "" },
+	{ "Gaim/AdiumX", "gaim-icq", 0, 0, 0, 0, 0, 0,
+	  "AIMIMAGE AIMSENDFILE UTF8 BART" },
+	{ "GlICQ", "glicq-icq", 0, 0, 0, 0xffffffab, 0, 0,
+	  "RTFxMSGS DIRECT UTF8 TYPING" },
+	{ "GnomeICU", "unknown-icq", 7, 0, 0, 0, 0, 0,
+	  "RTFxMSGS" },
+	{ "GnomeICU 0.99.5+", "unknown-icq", 8, 0, 0, 0, 0, 0,
+	  "SRVxRELAY RTFxMSGS UTF8" },
+	{ "IC@", "unknown-icq", 8, 0, 0, 0, 1, 0,
+	  "RTFxMSGS UTF8 SRVxRELAY" },
+	{ "ICQ 2000", "icq-2000-icq", 7, 0, 0, 0x44f523b0, 0, 0,
+	  "SRVxRELAY" },
+	{ "ICQ 2001", "icq-2001-icq", 8, 0x3aa773ee, 0, 0, 0, 0,
+	  "SRVxRELAY 2e7a6475fadf4dc8886fea3595fdb6df" },
+	{ "ICQ 2002", "icq-2002-icq", 8, 0, 0, 0, 0, 0,
+	  "SRVxRELAY 10cf40d14c7f11d1822244455354302e" },
+	{ "ICQ 2002/2003a", "icq-2002-icq", 8, 0, 0x00800000, 0, 0, 0,
+	  "SRVxRELAY RTFxMSGS UTF8" },
+	{ "ICQ 2003b Pro", "icq-2003pro-icq", 10, 0, 0, 0, 0, 0,
+	  "UTF8 TYPING DIRECT RTFxMSGS SRVxRELAY" },
+	{ "ICQ 5", "icq-50-icq", 9, 0, 0, 0, 0, 0,
+	  "AIMSENDFILE XTRAZ" },
+	{ "ICQ 5 (Abv)", "icq-50-icq", 9, 0, 0, 0, 0, 0,
+	  "AIMSENDFILE 00e7e0dfa9d04fe19162c8909a132a1b XTRAZ" },
+	{ "ICQ 5 (Netvigator)", "icq-50-icq", 9, 0, 0, 0, 0, 0,
+	  "4c6b90a33d2d480e89d62e4b2c10d99f AIMSENDFILE XTRAZ" },
+	{ "ICQ 5 (Rambler)", "icq-50-icq", 9, 0, 0, 0, 0, 0,
+	  "XTRAZ 7e11b778a3534926a80244735208c42a AIMSENDFILE" },
+	{ "ICQ 5.1", "icq-51-icq", 9, 0, 0, 0, 0, 0,
+	  "TZERS AIMSENDFILE XTRAZ" },
+	{ "ICQ 5.1 (Abv)", "icq-51-icq", 9, 0, 0, 0, 0, 0,
+	  "AIMSENDFILE XTRAZ 00e7e0dfa9d04fe19162c8909a132a1b TZERS" },
+	{ "ICQ 5.1 (Netvigator)", "icq-51-icq", 9, 0, 0, 0, 0, 0,
+	  "AIMSENDFILE 4c6b90a33d2d480e89d62e4b2c10d99f TZERS XTRAZ" },
+	{ "ICQ 5.1 (Rambler)", "icq-51-icq", 9, 0, 0, 0, 0, 0,
+	  "XTRAZ 7e11b778a3534926a80244735208c42a TZERS AIMSENDFILE" },
+	{ "ICQ 6", "icq-60-icq", 9, 0, 0, 0, 0, 0,
+	  "XTRAZ AIMSENDFILE HTMLMSGS TZERS" },
+	{ "ICQ 6 (Abv)", "icq-60-icq", 9, 0, 0, 0, 0, 0,
+	  "XTRAZ HTMLMSGS 00e7e0dfa9d04fe19162c8909a132a1b TZERS AIMSENDFILE" },
+	{ "ICQ 6 (Netvigator)", "icq-60-icq", 9, 0, 0, 0, 0, 0,
+	  "AIMSENDFILE HTMLMSGS 4c6b90a33d2d480e89d62e4b2c10d99f TZERS XTRAZ" },
+	{ "ICQ 6 (Rambler)", "icq-60-icq", 9, 0, 0, 0, 0, 0,
+	  "AIMSENDFILE 7e11b778a3534926a80244735208c42a TZERS XTRAZ HTMLMSGS" },
+	{ "ICQ 7", "icq-70-icq", 9, 0, 0, 0, 0, 0,
+	  "AIMSENDFILE c8953a9f21f14faab0b26de663abf5b7 XTRAZ" },
+	{ "ICQ 7 (Abv)", "icq-70-icq", 9, 0, 0, 0, 0, 0,
+	  "AIMSENDFILE c8953a9f21f14faab0b26de663abf5b7 00e7e0dfa9d04fe19162c8909a132a1b XTRAZ" },
+	{ "ICQ 7 (Netvigator)", "icq-70-icq", 9, 0, 0, 0, 0, 0,
+	  "XTRAZ AIMSENDFILE c8953a9f21f14faab0b26de663abf5b7 4c6b90a33d2d480e89d62e4b2c10d99f" },
+	{ "ICQ 7 (Rambler)", "icq-70-icq", 9, 0, 0, 0, 0, 0,
+	  "AIMSENDFILE c8953a9f21f14faab0b26de663abf5b7 XTRAZ 7e11b778a3534926a80244735208c42a" },
+	{ "ICQ for Mac", "icq-mac-icq", 0, 0, 0, 0, 0, 0,
+	  "dd16f20284e611d490db00104b9b4b7d" },
+	{ "ICQ for Pocket PC", "unknown-icq", 8, 0, 0, 0, 0, 0,
+	  "SRVxRELAY 2e7a6475fadf4dc8886fea3595fdb6df" },
+	{ "ICQ Lite", "icq-4lite-icq", 9, 0, 0, 0, 0, 0,
+	  "AIMSENDFILE BART AIMCONTSEND UTF8 AIMCHAT" },
+	{ "ICQ Lite v4", "icq-4lite-icq", 9, 0, 0, 0, 0, 0,
+	  "DIRECT XTRAZ" },
+	{ "Icq2Go! (Flash)", "icq-2go-icq", 7, 0, 0, 0, 0, 0,
+	  "UTF8" },
+	{ "Icq2Go! (Java)", "icq-2go-icq", 7, 0, 0, 0, 0, 0,
+	  "TYPING UTF8" },
+	{ "IM Gate", "imgate-icq", 8, 0, 0, 0, 0, 0,
+	  "SRVxRELAY DIRECT UTF8 AVATAR XTRAZ" },
+	{ "IM+", "implus-icq", 0, 0x494d2b01, 0, 0, 0, 0,
+	  "" },
+	{ "IM2", "im2-icq", 0, 0, 0, 0, 0, 0,
+	  "74edc33644df485b8b1c671a1f86099f" },
+	{ "IMadering", "unknown-icq", 0, 0, 0, 0, 0, 0,
+	  "494d61646572696e6720436c69656e74" },
+	{ "Inlux Messenger", "inlux-icq", 0, 0, 0, 0, 0, 0,
+	  "a7e40a96b3a0479ab845c9e467c56b1f" },
+	{ "Jasmine 1.9.1", "jasmine-icq", 0, 0, 0, 0, 0, 0,
+	  "4a61736d696e65204943512023232323 4a61736d696e6520766572ff01090102" },
+	{ "JICQ 0.0.0.0", "jicq-icq", 0, 0, 0, 0, 0, 0,
+	  "4a494351000000000000000000000000" },
+	{ "Jimm", "jimm-icq", 0, 0xfffffffe, 0, 0xfffffffe, 0, 0,
+	  "" },
+	{ "Jimm ", "jimm-icq", 0, 0, 0, 0, 0, 0,
+	  "4a696d6d200000000000000000000000" },
+	{ "Jimm 53060543530", "jimm-icq", 0, 0, 0, 0, 0, 0,
+	  "4a696d6d203533303630353433353330" },
+	{ "Jimm 8.080794527", "jimm-icq", 0, 0, 0, 0, 0, 0,
+	  "4a696d6d20382e303830373934353237" },
+	{ "k8qutIM v57.49.56.13105 (2)", "qutim-k8-icq", 0, 0, 0, 0, 0, 0,
+	  "6b38717574494d322e39313833313039" },
+	{ "Kopete v51.46.5756", "kopete-icq", 0, 0, 0, 0, 0, 0,
+	  "4b6f70657465204943512020332e3938" },
+	{ "KXicq2", "kxicq-icq", 0, 0x3b4c4c0c, 0, 0x3b7248ed, 0, 0,
+	  "" },
+	{ "libicq2000", "icq-2000-icq", 0, 0x3aa773ee, 0x3aa66380, 0, 0, 0,
+	  "" },
+	{ "libicq2000 (Unicode)", "icq-2000-icq", 0, 0x3aa773ee, 0x3aa66380, 0, 0, 0,
+	  "UTF8" },
+	{ "Licq v0.0", "licq-icq", 0, 0x7d000000, 0, 0, 0, 0,
+	  "" },
+	{ "Licq v1.23.4", "licq-icq", 0, 0x7d0004d2, 0, 0, 0, 0,
+	  "" },
+	{ "Licq v1.23.4/SSL", "licq-icq", 0, 0x7d8004d2, 0, 0, 0, 0,
+	  "" },
+	{ "Mail.Ru Agent", "mrim-icq", 9, 0, 0, 0, 0, 0,
+	  "TZERS XTRAZ" },
+	{ "MDC", "mdc-icq", 9, 0, 0, 0, 0, 0,
+	  "RTFxMSGS TZERS XTRAZ AIMSENDFILE HTMLMSGS" },
+	{ "MDC (Abv)", "mdc-icq", 9, 0, 0, 0, 0, 0,
+	  "TZERS XTRAZ HTMLMSGS 00e7e0dfa9d04fe19162c8909a132a1b RTFxMSGS AIMSENDFILE" },
+	{ "MDC (Netvigator)", "mdc-icq", 9, 0, 0, 0, 0, 0,
+	  "XTRAZ TZERS HTMLMSGS AIMSENDFILE 4c6b90a33d2d480e89d62e4b2c10d99f RTFxMSGS" },
+	{ "MDC (Rambler)", "mdc-icq", 9, 0, 0, 0, 0, 0,
+	  "RTFxMSGS HTMLMSGS AIMSENDFILE 7e11b778a3534926a80244735208c42a TZERS XTRAZ" },
+	{ "Meebo", "meebo-icq", 0, 0, 0, 0, 0, 0,
+	  "UTF8 BART AIMCHAT" },
+	{ "mICQ", "micq-icq", 0, 0xffffff42, 0, 0, 0, 0,
+	  "" },
+	{ "mICQ v4294967168.4294967168.4294967168.4294967168 alpha", "micq-icq", 0, 0, 0, 0, 0, 0,
+	  "6d49435120a920522e4b2e2080808080" },
+	{ "mICQ v53.49.57.53", "micq-icq", 0, 0, 0, 0, 0, 0,
+	  "6d49435120a920522e4b2e2035313935" },
+	{ "MIP ", "mip-icq", 0, 0, 0, 0, 0, 0,
+	  "4d495020000106020800020703020801" },
+	{ "MIP 076929050401", "mip-icq", 0, 0, 0, 0, 0, 0,
+	  "4d495020303736393239303530343031" },
+	{ "MIP 5.7198878551", "mip-icq", 0, 0, 0, 0, 0, 0,
+	  "4d495020352e37313938383738353531" },
+	{ "Miranda IM (ICQ 0.255.255.171 alpha)", "miranda-icq", 0, 0x7fffffff, 0xffffffab, 0, 0, 0,
+	  "" },
+	{ "Miranda IM 0.0 (ICQ Plus 0.0.0.0)", "miranda-icq", 0, 0, 0, 0, 0, 0,
+	  "69637170000000000000000000000000" },
+	{ "Miranda IM 0.0 (ICQ S!N 0.0.0.0)Miranda IM (ICQ SSS & S7)", "miranda-icq", 0, 0, 0, 0, 0, 0,
+	  "6963716a000000000000000000000000 73696e6a000000000000000000000000" },
+	{ "Miranda IM 0.0 (ICQ S!N 0.0.0.0)Miranda IM (ICQ SSS & S7)(SecureIM)", "miranda-icq", 0, 0, 0, 0, 0, 0,
+	  "6963716a0053656375726500494d0000 73696e6a000000000000000000000000" },
+	{ "Miranda IM 0.0 (ICQ S7 & SSS 0.0.0.0)Miranda IM (ICQ SSS & S7)", "miranda-icq", 0, 0, 0, 0, 0, 0,
+	  "6963716a000000000000000000000000" },
+	{ "Miranda IM 0.0 (ICQ S7 & SSS 0.0.0.0)Miranda IM (ICQ SSS & S7)(SecureIM)", "miranda-icq", 0, 0, 0, 0, 0, 0,
+	  "6963716a000000000000000000000000 6963716a0053656375726500494d0000" },
+	{ "Miranda IM 0.0 alpha build #128 (ICQ eternity/PlusPlus++ 0.2.128.1 alpha)", "miranda-icq", 0, 0, 0, 0, 0, 0,
+	  "656e716a800000808002800100038080" },
+	{ "Miranda IM 0.0 Unicode (ICQ eternity/PlusPlus++ 0.0.0.0) (SecureIM)", "miranda-icq", 0, 0x7fffffff, 0, 0x5afec0de, 0, 0,
+	  "656e716a000000000000000000000000" },
+	{ "Miranda IM 0.0 Unicode (ICQ S7 & SSS 0.0.0.0) (SecureIM)", "miranda-icq", 0, 0x7fffffff, 0, 0x5afec0de, 0, 0,
+	  "6963716a000000000000000000000000" },
+	{ "Miranda IM 0.128.128 (ICQ  0.3.128.3 alpha)", "miranda-icq", 0, 0, 0, 0, 0, 0,
+	  "4d6972616e64614d0080800080038003" },
+	{ "Miranda IM 1.1 alpha build #2 Unicode (ICQ Plus 0.0.0.2 alpha) (SecureIM)", "miranda-icq", 0, 0x7fffffff, 0, 0, 0, 0,
+	  "69637170010100028000000202038080" },
+	{ "Miranda IM 1.2.2 (ICQ S!N 0.0.128.128 alpha)", "miranda-icq", 0, 0, 0, 0, 0, 0,
+	  "73696e6a010202008000808000808000" },
+	{ "Miranda IM 1.3.128 (ICQ S7 & SSS 0.3.3.1 alpha)", "miranda-icq", 0, 0, 0, 0, 0, 0,
+	  "6963716a010380008003030100808080" },
+	{ "Miranda IM 1.4 Unicode (ICQ S!N 3.8.2.0) (SecureIM)", "miranda-icq", 0, 0, 0, 0x80000000, 0, 0,
+	  "73696e6a010400000308020001080101" },
+	{ "Miranda IM 2.2 alpha build #3 (ICQ S7 & SSS 0.2.128.2 alpha)", "miranda-icq", 0, 0, 0, 0, 0, 0,
+	  "6963716a020200038002800200030180" },
+	{ "Miranda IM 3.0 alpha build #128 (ICQ S!N 0.0.128.128 alpha)", "miranda-icq", 0, 0, 0, 0, 0, 0,
+	  "73696e6a030000808000808000800080" },
+	{ "Miranda IM 3.1.3 (ICQ Plus 0.0.1.0 alpha)", "miranda-icq", 0, 0, 0, 0, 0, 0,
+	  "69637170030103008000010000018003" },
+	{ "Miranda IM 3.3.128 (ICQ eternity/PlusPlus++ 0.0.128.3 alpha)", "miranda-icq", 0, 0, 0, 0, 0, 0,
+	  "656e716a030380008000800300808080" },
+	{ "Miranda IM Mobile 111.98.105 alpha build #108 Unicode (ICQ  101.51.46.52) (SecureIM)", "miranda-icq", 0, 0x7fffffff, 0, 0x5afec0de, 0, 0,
+	  "4d6972616e64614d6f62696c65332e34" },
+	{ "NanoICQ", "unknown-icq", 10, 0, 0, 0, 0, 0,
+	  "UTF8" },
+	{ "NatICQ Siemens (revision %s)", "naticq-icq", 0, 0, 0, 0, 0, 0,
+	  "4e617449435107090102000906090005" },
+	{ "Pidgin/AdiumX", "pidgin-icq", 0, 0, 0, 0, 0, 0,
+	  "AIMCHAT UTF8 AIMIMAGE AIMSENDFILE BART" },
+	{ "Pigeon", "pigeon-icq", 0, 0, 0, 0, 0, 0,
+	  "504947454f4e21000000000000000000" },
+	{ "PreludeICQ", "unknown-icq", 8, 0, 0, 0, 0, 0,
+	  "TYPING SRVxRELAY UTF8" },
+	{ "PyICQ-t Jabber Transport", "pyicq-icq", 9, 0, 0, 0, 0, 0,
+	  "XTRAZ" },
+	{ "QIP ", "qip-2005-icq", 0, 0, 0, 0, 0, 0,
+	  "563fc8090b6f41514950000000000000" },
+	{ "QIP .9893", "qip-2005-icq", 0, 0, 0, 0, 0, 0,
+	  "563fc8090b6f41514950332e39383933" },
+	{ "QIP 2005 (Build 0000)", "qip-2005-icq", 0, 0, 14, 15, 0, 0,
+	  "563fc8090b6f41514950202020202022" },
+	{ "QIP 2010", "qip-2010-icq", 0, 0, 0, 0, 0, 0,
+	  "7a7b7c7d7e7f0a030b04015313431e1a" },
+	{ "QIP 2010 (Build 33554464)", "qip-2010-icq", 0, 0x02000020, 0, 0, 0, 0,
+	  "7a7b7c7d7e7f0a030b04015313431e1a" },
+	{ "QIP 2010 (Build 984052718) Beta", "qip-2010-icq", 0, 0x3aa773ee, 11, 0, 0, 0,
+	  "7a7b7c7d7e7f0a030b04015313431e1a" },
+	{ "QIP 2010 Beta", "qip-2010-icq", 0, 0, 11, 0, 0, 0,
+	  "7a7b7c7d7e7f0a030b04015313431e1a" },
+	{ "QIP 2012", "qip-2012-icq", 0, 0, 0, 0, 0, 0,
+	  "7f7f7c7d7e7f0a030b04015313431e1a" },
+	{ "QIP 2012 (Build 4294964838)", "qip-2012-icq", 0, 0xfffff666, 0, 0, 0, 0,
+	  "7f7f7c7d7e7f0a030b04015313431e1a" },
+	{ "QIP 2012 (Build 4294967167) Beta", "qip-2012-icq", 0, 0xffffff7f, 11, 0, 0, 0,
+	  "7f7f7c7d7e7f0a030b04015313431e1a" },
+	{ "QIP 2012 Beta", "qip-2012-icq", 0, 0, 11, 0, 0, 0,
+	  "7f7f7c7d7e7f0a030b04015313431e1a" },
+	{ "QIP 23006", "qip-2005-icq", 0, 0, 0, 0, 0, 0,
+	  "563fc8090b6f41514950343233303036" },
+	{ "QIP Infium", "qip-infium-icq", 0, 0, 0, 0, 0, 0,
+	  "7c737502c3be4f3ea69f015313431e1a" },
+	{ "QIP Infium (Build 4294967167)", "qip-infium-icq", 0, 0xffffff7f, 0, 0, 0, 0,
+	  "7c737502c3be4f3ea69f015313431e1a" },
+	{ "QIP Infium (Build 50333696) Beta", "qip-infium-icq", 0, 0x03000800, 11, 0, 0, 0,
+	  "7c737502c3be4f3ea69f015313431e1a" },
+	{ "QIP Infium Beta", "qip-infium-icq", 0, 0, 11, 0, 0, 0,
+	  "7c737502c3be4f3ea69f015313431e1a" },
+	{ "QIP Mobile (Symbian)", "qip-symbian-icq", 0, 0, 0, 0, 0, 0,
+	  "51add1907204473da1a149f4a397a41f" },
+	{ "QNext", "unknown-icq", 10, 0, 0, 0, 0, 0,
+	  "" },
+	{ "qutIM v0.0.0 (os0-0)", "qutim-icq", 0, 0, 0, 0, 0, 0,
+	  "717574696d0000000000000000000000" },
+	{ "qutIM v0.7", "qutim-icq", 0, 0, 0, 0, 0, 0,
+	  "717574696d302e373534303230353435" },
+	{ "qutIM v1.5.5.1 (os6-134219012)", "qutim-icq", 0, 0, 0, 0, 0, 0,
+	  "717574696d0601050501000800050406" },
+	{ "qutIM v2.2.1 svn2051 (os0-33554697)", "qutim-icq", 0, 0, 0, 0, 0, 0,
+	  "717574696d0002020108030200010908" },
+	{ "R&Q 0", "rnq-icq", 0, 0xfffff666, 0, 0, 0, 0,
+	  "" },
+	{ "R&Q-masked (SIM)", "rnq-icq", 0, 0, 0, 0, 0, 0,
+	  "53494d20636c69656e74202000000000" },
+	{ "Slick", "slick-icq", 0, 0, 0, 0x7fffffff, 0, 0,
+	  "SRVxRELAY DIRECT AIMGETFILE AIMSENDFILE UTF8" },
+	{ "SmapeR  ", "smaper-icq", 0, 0, 0, 0, 0, 0,
+	  "536d6170657220000000000000000000" },
+	{ "SmapeR  3.8181581", "smaper-icq", 0, 0, 0, 0, 0, 0,
+	  "536d6170657220332e38313831353831" },
+	{ "SmapeR  722151801", "smaper-icq", 0, 0, 0, 0, 0, 0,
+	  "536d6170657220373232313531383031" },
+	{ "SmartICQ", "unknown-icq", 0, 0xddddeeff, 0, 0, 0, 0,
+	  "" },
+	{ "Spam Bot", "icqbot-icq", 0, 0xffffffff, 0, 0x3b7248ed, 0, 0,
+	  "" },
+	{ "stICQ", "sticq-icq", 2, 0x3ba8dbaf, 0, 0, 0, 0,
+	  "" },
+	{ "StrICQ", "unknown-icq", 0, 0xffffff8f, 0, 0, 0, 0,
+	  "" },
+	{ "TICQClient", "unknown-icq", 8, 0, 0, 0, 0, 0,
+	  "2e7a6475fadf4dc8886fea3595fdb6df SRVxRELAY RTFxMSGS" },
+	{ "Trillian", "trillian-icq", 0, 0x3b75ac09, 0, 0, 0, 0,
+	  "" },
+	{ "Trillian Astra", "trillian-icq", 0, 0, 0, 0, 0, 0,
+	  "RTFxMSGS f2e7c7f4fead4dfbb23536798bdf0501 AIMSENDFILE" },
+	{ "Trillian v3", "trillian-icq", 0, 0, 0, 0, 0, 0,
+	  "RTFxMSGS 97b12751243c4334ad22d6abf73f1409" },
+	{ "vICQ", "unknown-icq", 0, 0x04031980, 0, 0, 0, 0,
+	  "" },
+	{ "VmICQ ", "vmicq-icq", 0, 0, 0, 0, 0, 0,
+	  "566d4943510000000000000000000000" },
+	{ "VmICQ 16589049177", "vmicq-icq", 0, 0, 0, 0, 0, 0,
+	  "566d4943513136353839303439313737" },
+	{ "VmICQ 4.475438941", "vmicq-icq", 0, 0, 0, 0, 0, 0,
+	  "566d494351342e343735343338393431" },
+	{ "WebICQ", "webicq-icq", 7, 0xffffffff, 0, 0, 0, 0,
+	  "" },
+	{ "WebIcqPro 0.0.0", "webicq-icq", 0, 0, 0, 0, 0, 0,
+	  "57656249637150726f00000000000000" },
+	{ "Yapp! v", "yapp-icq", 0, 0, 0, 0, 0, 0,
+	  "59617070808002030080018001800002" },
+	{ "Yapp! v87469", "yapp-icq", 0, 0, 0, 0, 0, 0,
+	  "59617070382e30383837343639393230" },
+	{ "YSM", "unknown-icq", 0, 0xffffffab, 0, 0, 0, 0,
+	  "" },
+};
+
+static const struct
+{
+	const char *name;
+	const Capability &capability;
+} standardCapabilities[] = {
+	{ "AIMCHAT", ICQ_CAPABILITY_AIMCHAT },
+	{ "AIMCONTSEND", ICQ_CAPABILITY_AIMCONTSEND },
+	{ "AIMGETFILE", ICQ_CAPABILITY_AIMGETFILE },
+	{ "AIMIMAGE", ICQ_CAPABILITY_AIMIMAGE },
+	{ "AIMSENDFILE", ICQ_CAPABILITY_AIMSENDFILE },
+	{ "AVATAR", ICQ_CAPABILITY_AVATAR },
+	{ "BART", ICQ_CAPABILITY_BART },
+	{ "DIRECT", ICQ_CAPABILITY_DIRECT },
+	{ "HTMLMSGS", ICQ_CAPABILITY_HTMLMSGS },
+	{ "RTFxMSGS", ICQ_CAPABILITY_RTFxMSGS },
+	{ "SRVxRELAY", ICQ_CAPABILITY_SRVxRELAY },
+	{ "TYPING", ICQ_CAPABILITY_TYPING },
+	{ "TZERS", ICQ_CAPABILITY_TZERS },
+	{ "UTF8", ICQ_CAPABILITY_UTF8 },
+	{ "XTRAZ", ICQ_CAPABILITY_XTRAZ }
+};
+
+static Capabilities parseCapabilities(const char *str)
+{
+	Capabilities capabilities;
+	foreach (const QByteArray &token, QByteArray(str).split(' ')) {
+		if (token.isEmpty())
+			continue;
+		if (token.size() == 2 * Capability::Size) {
+			capabilities << Capability(QByteArray::fromHex(token));
+			continue;
+		}
+		bool found = false;
+		for (const auto &standard : standardCapabilities) {
+			if (token == standard.name) {
+				capabilities << standard.capability;
+				found = true;
+				break;
+			}
+		}
+		if (!found)
+			qFatal("Unknown capability %s", token.constData());
+	}
+	return capabilities;
+}
+
+static DirectConnectionInfo connectionInfo(const KnownClient &client)
+{
+	DirectConnectionInfo info = DirectConnectionInfo();
+	info.protocol_version = client.protocol;
+	info.info_utime = client.info;
+	info.extinfo_utime = client.extInfo;
+	info.extstatus_utime = client.extStatusInfo;
+	info.port = client.port;
+	info.auth_cookie = client.authCookie;
+	return info;
+}
+
+void ClientIdentifyTest::knownClients_data()
+{
+	QTest::addColumn<int>("index");
+	for (int i = 0; i < int(sizeof(knownClients) / sizeof(knownClients[0])); ++i)
+		QTest::newRow(knownClients[i].client) << i;
+}
+
+void ClientIdentifyTest::knownClients()
+{
+	QFETCH(int, index);
+	const KnownClient &client = knownClients[index];
+	const Capabilities capabilities = parseCapabilities(client.capabilities);
+	const DirectConnectionInfo info = connectionInfo(client);
+
+	// Second time the result is taken from the cache
+	for (int i = 0; i < 2; ++i) {
+		m_identify.identify(capabilities, info);
+		QCOMPARE(m_identify.clientId(), QString::fromUtf8(client.client));
+		QCOMPARE(m_identify.clientIcon().name(), QString::fromLatin1(client.icon));
+	}
+}
+
+QTEST_GUILESS_MAIN(ClientIdentifyTest)
+
+#include "clientidentifytest.moc"
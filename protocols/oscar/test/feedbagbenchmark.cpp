@@ -0,0 +1,281 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Alexey Prokhin <alexey.prokhin@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "feedbagcache.h"
+#include "icq_global.h"
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QElapsedTimer>
+
+using namespace qutim_sdk_0_3::oscar;
+
+// Synthetic contact list of 10k items: buddies are spread over the groups
+// and have a nick and a comment like the ones of real ICQ accounts
+static const int ITEMS_COUNT = 10000;
+static const int GROUPS_COUNT = 50;
+static const int BUDDIES_COUNT = ITEMS_COUNT - GROUPS_COUNT;
+static const quint16 NICK_FIELD = 0x0131;
+static const quint16 COMMENT_FIELD = 0x013C;
+
+static FeedbagItem buddy(int i, int revision = 0)
+{
+	FeedbagItem item(0, SsiBuddy, quint16(i + 1), quint16(1 + i % GROUPS_COUNT),
+					 QString::number(100000000 + i * 7919));
+	item.setField(NICK_FIELD, QString::fromUtf8("Контакт %1").arg(i).toUtf8());
+	if (revision)
+		item.setField(COMMENT_FIELD, QString::fromLatin1("Revision %1").arg(revision).toUtf8());
+	return item;
+}
+
+class FeedbagBenchmark : public QObject
+{
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void snapshot();
+	void journal();
+	void incompleteRecord();
+	void compaction();
+	void load_data();
+	void load();
+	void append();
+	void save();
+
+private:
+	QString fileName(const char *name) const;
+	// Appends changes of buddies to the journal and applies them to items
+	bool writeJournal(FeedbagCache &cache, AllItemsHash &items, int count);
+	void compare(const AllItemsHash &actual, const AllItemsHash &expected);
+
+	QTemporaryDir m_dir;
+	AllItemsHash m_items;
+};
+
+void FeedbagBenchmark::initTestCase()
+{
+	QVERIFY(m_dir.isValid());
+	m_items.reserve(ITEMS_COUNT);
+	for (int i = 0; i < GROUPS_COUNT; ++i) {
+		FeedbagItem group(0, SsiGroup, 0, quint16(i + 1), QString::fromLatin1("Group %1").arg(i));
+		m_items.insert(group.pairId(), group);
+	}
+	for (int i = 0; i < BUDDIES_COUNT; ++i) {
+		FeedbagItem item = buddy(i);
+		m_items.insert(item.pairId(), item);
+	}
+	QCOMPARE(m_items.size(), ITEMS_COUNT);
+}
+
+QString FeedbagBenchmark::fileName(const char *name) const
+{
+	return m_dir.path() + QLatin1Char('/') + QLatin1String(name) + QLatin1String(".cache");
+}
+
+bool FeedbagBenchmark::writeJournal(FeedbagCache &cache, AllItemsHash &items, int count)
+{
+	for (int j = 0; j < count; ++j) {
+		const int i = (j * 7919) % BUDDIES_COUNT;
+		FeedbagItem item = buddy(i, j + 1);
+		// Every fifth change removes the buddy
+		const bool removed = j % 5 == 4;
+		if (removed)
+			items.remove(item.pairId());
+		else
+			items.insert(item.pairId(), item);
+		if (!cache.append(item, removed, items.size()))
+			return false;
+	}
+	return true;
+}
+
+void FeedbagBenchmark::compare(const AllItemsHash &actual, const AllItemsHash &expected)
+{
+	QCOMPARE(actual.size(), expected.size());
+	for (AllItemsHash::ConstIterator it = expected.constBegin(); it != expected.constEnd(); ++it) {
+		const FeedbagItem item = actual.value(it.key());
+		QVERIFY(!item.isNull());
+		QCOMPARE(item.name(), it.value().name());
+		QCOMPARE(item.constData().size(), it.value().constData().size());
+		QCOMPARE(item.field(NICK_FIELD).data(), it.value().field(NICK_FIELD).data());
+		QCOMPARE(item.field(COMMENT_FIELD).data(), it.value().field(COMMENT_FIELD).data());
+	}
+}
+
+void FeedbagBenchmark::snapshot()
+{
+	FeedbagCache cache;
+	cache.setFileName(fileName("snapshot"));
+	QVERIFY(cache.save(m_items, 42));
+
+	FeedbagCache loader;
+	loader.setFileName(cache.fileName());
+	AllItemsHash items;
+	uint lastUpdateTime = 0;
+	QVERIFY(loader.load(0, items, lastUpdateTime));
+	QCOMPARE(lastUpdateTime, 42u);
+	QCOMPARE(loader.journalSize(), 0);
+	compare(items, m_items);
+}
+
+void FeedbagBenchmark::journal()
+{
+	FeedbagCache cache;
+	cache.setFileName(fileName("journal"));
+	QVERIFY(cache.save(m_items, 42));
+	AllItemsHash expected = m_items;
+	QVERIFY(writeJournal(cache, expected, 4000));
+	QCOMPARE(cache.journalSize(), 4000);
+
+	FeedbagCache loader;
+	loader.setFileName(cache.fileName());
+	AllItemsHash items;
+	uint lastUpdateTime = 0;
+	QVERIFY(loader.load(0, items, lastUpdateTime));
+	QCOMPARE(lastUpdateTime, 42u);
+	QVERIFY(loader.journalSize() > 0);
+	compare(items, expected);
+}
+
+// Record being written at the moment of crash is skipped, the rest of
+// the journal is replayed
+void FeedbagBenchmark::incompleteRecord()
+{
+	FeedbagCache cache;
+	cache.setFileName(fileName("incomplete"));
+	QVERIFY(cache.save(m_items, 42));
+	AllItemsHash expected = m_items;
+	QVERIFY(writeJournal(cache, expected, 100));
+
+	QFile file(cache.fileName());
+	QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Append));
+	DataUnit unit;
+	unit.append<quint32>(1000);
+	unit.append<quint8>(1);
+	file.write(unit.data());
+	file.close();
+
+	FeedbagCache loader;
+	loader.setFileName(cache.fileName());
+	AllItemsHash items;
+	uint lastUpdateTime = 0;
+	QVERIFY(loader.load(0, items, lastUpdateTime));
+	compare(items, expected);
+}
+
+// Journal is merged into snapshot once it grows to half of the items
+void FeedbagBenchmark::compaction()
+{
+	FeedbagCache cache;
+	cache.setFileName(fileName("compaction"));
+	QVERIFY(cache.save(m_items, 42));
+	AllItemsHash expected = m_items;
+	QVERIFY(!writeJournal(cache, expected, ITEMS_COUNT));
+	QVERIFY(cache.journalSize() > 256);
+	QVERIFY(cache.journalSize() >= expected.size() / 2);
+	const qint64 journalFileSize = QFileInfo(cache.fileName()).size();
+
+	QVERIFY(cache.save(expected, 43));
+	QCOMPARE(cache.journalSize(), 0);
+	QVERIFY(QFileInfo(cache.fileName()).size() < journalFileSize);
+	QVERIFY(cache.append(buddy(0, 1), false, expected.size()));
+
+	FeedbagCache loader;
+	loader.setFileName(cache.fileName());
+	AllItemsHash items;
+	uint lastUpdateTime = 0;
+	QVERIFY(loader.load(0, items, lastUpdateTime));
+	QCOMPARE(lastUpdateTime, 43u);
+	QCOMPARE(loader.journalSize(), 1);
+	expected.insert(buddy(0, 1).pairId(), buddy(0, 1));
+	compare(items, expected);
+}
+
+void FeedbagBenchmark::load_data()
+{
+	QTest::addColumn<int>("journal");
+
+	QTest::newRow("snapshot") << 0;
+	QTest::newRow("journal 256") << 256;
+	QTest::newRow("journal 4000") << 4000;
+}
+
+void FeedbagBenchmark::load()
+{
+	QFETCH(int, journal);
+
+	FeedbagCache cache;
+	cache.setFileName(fileName("load"));
+	QVERIFY(cache.save(m_items, 42));
+	AllItemsHash expected = m_items;
+	QVERIFY(writeJournal(cache, expected, journal));
+
+	FeedbagCache loader;
+	loader.setFileName(cache.fileName());
+	QElapsedTimer timer;
+	timer.start();
+	int runs = 0;
+	QBENCHMARK {
+		AllItemsHash items;
+		uint lastUpdateTime = 0;
+		QVERIFY(loader.load(0, items, lastUpdateTime));
+		QCOMPARE(items.size(), expected.size());
+		++runs;
+	}
+	qDebug("%d records, %.0f records/s", ITEMS_COUNT + journal,
+		   double(ITEMS_COUNT + journal) * runs * 1000 / qMax<qint64>(1, timer.elapsed()));
+}
+
+// Every record is flushed to disk on its own
+void FeedbagBenchmark::append()
+{
+	FeedbagCache cache;
+	cache.setFileName(fileName("append"));
+	QVERIFY(cache.save(m_items, 42));
+	AllItemsHash expected = m_items;
+	QElapsedTimer timer;
+	timer.start();
+	QBENCHMARK_ONCE {
+		QVERIFY(writeJournal(cache, expected, 4000));
+	}
+	qDebug("%.0f records/s", 4000.0 * 1000 / qMax<qint64>(1, timer.elapsed()));
+}
+
+void FeedbagBenchmark::save()
+{
+	FeedbagCache cache;
+	cache.setFileName(fileName("save"));
+	QElapsedTimer timer;
+	timer.start();
+	int runs = 0;
+	QBENCHMARK {
+		QVERIFY(cache.save(m_items, 42));
+		++runs;
+	}
+	qDebug("%d items, %.0f items/s", ITEMS_COUNT,
+		   double(ITEMS_COUNT) * runs * 1000 / qMax<qint64>(1, timer.elapsed()));
+}
+
+QTEST_MAIN(FeedbagBenchmark)
+#include "feedbagbenchmark.moc"
@@ -0,0 +1,149 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Alexey Prokhin <alexey.prokhin@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "oftchecksum.h"
+#include <QtTest>
+
+using namespace qutim_sdk_0_3::oscar;
+
+// Vectorized checksum is compared with the byte-by-byte one for every length
+// up to a few blocks, every alignment of the buffer and both parities of the
+// offset, on random data, on every repeated byte value and on chained chunks
+class OftChecksumTest : public QObject
+{
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void lengths();
+	void byteValues();
+	void chained();
+	void checksum_data();
+	void checksum();
+
+private:
+	QByteArray m_random;
+};
+
+static const quint32 initialChecksums[] = {
+	0xFFFF0000u,
+	// Carry happens at the very first bytes
+	0x00000000u,
+	0x00010000u,
+	0x12340000u
+};
+
+void OftChecksumTest::initTestCase()
+{
+#if defined(__AVX2__) && (defined(Q_CC_GNU) || defined(Q_CC_CLANG))
+	if (!__builtin_cpu_supports("avx2"))
+		QSKIP("CPU doesn't support AVX2");
+#endif
+	qDebug() << "Implementation:" << OftChecksum::implementation();
+	qsrand(42);
+	m_random.resize(16 * 1024 * 1024);
+	for (int i = 0; i < m_random.size(); ++i)
+		m_random[i] = char(qrand());
+}
+
+void OftChecksumTest::lengths()
+{
+	for (int len = 0; len <= 3 * 1024 + 64; ++len) {
+		for (int alignment = 0; alignment < 32; ++alignment) {
+			const char *data = m_random.constData() + len * 32 + alignment;
+			for (int offset = 0; offset < 2; ++offset) {
+				for (quint32 checksum : initialChecksums) {
+					const quint32 expected = OftChecksum::updateScalar(data, len, checksum, offset);
+					const quint32 actual = OftChecksum::update(data, len, checksum, offset);
+					if (actual != expected) {
+						QFAIL(qPrintable(QString::fromLatin1("len %1, alignment %2, offset %3, checksum %4: %5 != %6")
+										 .arg(len).arg(alignment).arg(offset).arg(checksum, 8, 16)
+										 .arg(actual, 8, 16).arg(expected, 8, 16)));
+					}
+				}
+			}
+		}
+	}
+}
+
+void OftChecksumTest::byteValues()
+{
+	// Bytes above 0x7f are sign extended, so every value is checked alone
+	for (int value = 0; value < 256; ++value) {
+		const QByteArray data(3 * 1024 + 37, char(value));
+		for (int len : { 1, 15, 16, 31, 32, 33, 1024, data.size() }) {
+			for (int offset = 0; offset < 2; ++offset) {
+				for (quint32 checksum : initialChecksums) {
+					QCOMPARE(OftChecksum::update(data.constData(), len, checksum, offset),
+							 OftChecksum::updateScalar(data.constData(), len, checksum, offset));
+				}
+			}
+		}
+	}
+}
+
+void OftChecksumTest::chained()
+{
+	// Split of the file into chunks must not change its checksum
+	const int size = 4 * 1024 + 17;
+	const char *data = m_random.constData();
+	const quint32 whole = OftChecksum::updateScalar(data, size, 0xFFFF0000u, 0);
+	for (int split = 0; split <= size; ++split) {
+		quint32 checksum = OftChecksum::update(data, split, 0xFFFF0000u, 0);
+		checksum = OftChecksum::update(data + split, size - split, checksum, split);
+		QCOMPARE(checksum, whole);
+	}
+}
+
+void OftChecksumTest::checksum_data()
+{
+	QTest::addColumn<bool>("scalar");
+	QTest::addColumn<QByteArray>("data");
+	const QByteArray zero(m_random.size(), '\0');
+	const QByteArray full(m_random.size(), '\xff');
+	QTest::newRow("random") << false << m_random;
+	QTest::newRow("random, scalar") << true << m_random;
+	QTest::newRow("zero") << false << zero;
+	QTest::newRow("zero, scalar") << true << zero;
+	QTest::newRow("0xff") << false << full;
+	QTest::newRow("0xff, scalar") << true << full;
+}
+
+void OftChecksumTest::checksum()
+{
+	QFETCH(bool, scalar);
+	QFETCH(QByteArray, data);
+	// The whole file as it's passed by OftChecksumThread
+	quint32 checksum = 0;
+	QBENCHMARK {
+		checksum = scalar
+				? OftChecksum::updateScalar(data.constData(), data.size(), 0xFFFF0000u, 0)
+				: OftChecksum::update(data.constData(), data.size(), 0xFFFF0000u, 0);
+	}
+	QCOMPARE(checksum, OftChecksum::updateScalar(data.constData(), data.size(), 0xFFFF0000u, 0));
+}
+
+QTEST_APPLESS_MAIN(OftChecksumTest)
+
+#include "oftchecksumtest.moc"
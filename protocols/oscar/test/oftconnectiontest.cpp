@@ -0,0 +1,186 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Alexey Prokhin <alexey.prokhin@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "oscarfiletransfer_p.h"
+#include "oftchecksum.h"
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
+
+using namespace qutim_sdk_0_3;
+using namespace qutim_sdk_0_3::oscar;
+
+class LoopbackServer : public QTcpServer
+{
+public:
+	LoopbackServer() : descriptor(0) {}
+	qintptr descriptor;
+protected:
+	void incomingConnection(qintptr socketDescriptor) { descriptor = socketDescriptor; }
+};
+
+static QByteArray fileHash(const QString &fileName)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly))
+		return QByteArray();
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	hash.addData(&file);
+	return hash.result();
+}
+
+// Data stage of OFT transfer between two connections over a loopback socket
+// pair. Handshake needs an account, so its result is set up by hands: sender
+// sends the prompt, receiver accepts it by OftConnection's own code and
+// sender starts to send the file from memory mapped windows on the ack.
+class OftConnectionTest : public QObject
+{
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void transfer_data();
+	void transfer();
+
+private:
+	QTemporaryDir m_dir;
+};
+
+void OftConnectionTest::initTestCase()
+{
+	QVERIFY(m_dir.isValid());
+	qsrand(42);
+}
+
+void OftConnectionTest::transfer_data()
+{
+	QTest::addColumn<qint64>("size");
+	QTest::addColumn<qint64>("limit");
+
+	QTest::newRow("1 MB") << qint64(1024 * 1024) << qint64(0);
+	// Windows are 16 MB, the last one is incomplete and starts at even offset
+	QTest::newRow("40 MB and some") << qint64(40 * 1024 * 1024 + 12345) << qint64(0);
+	QTest::newRow("128 MB") << qint64(128 * 1024 * 1024) << qint64(0);
+	QTest::newRow("24 MB at 8 MB/s") << qint64(24 * 1024 * 1024) << qint64(8 * 1024 * 1024);
+}
+
+void OftConnectionTest::transfer()
+{
+	QFETCH(qint64, size);
+	QFETCH(qint64, limit);
+
+	const QString source = m_dir.path() + QLatin1String("/source");
+	const QString target = m_dir.path() + QLatin1String("/target");
+	QFile::remove(target);
+	quint32 checksum = 0xFFFF0000;
+	{
+		QFile file(source);
+		QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+		QByteArray chunk(1024 * 1024, Qt::Uninitialized);
+		for (qint64 written = 0; written < size; written += chunk.size()) {
+			chunk.resize(int(qMin<qint64>(chunk.size(), size - written)));
+			for (int i = 0; i < chunk.size(); ++i)
+				chunk[i] = char(qrand());
+			checksum = OftChecksum::update(chunk.constData(), chunk.size(), checksum, int(written & 1));
+			QCOMPARE(file.write(chunk), qint64(chunk.size()));
+		}
+	}
+
+	LoopbackServer server;
+	QVERIFY(server.listen(QHostAddress::LocalHost));
+	OftSocket *senderSocket = new OftSocket;
+	senderSocket->connectToHost(QHostAddress::LocalHost, server.serverPort());
+	QTRY_VERIFY(server.descriptor != 0 && senderSocket->state() == QAbstractSocket::ConnectedState);
+	OftSocket *receiverSocket = new OftSocket(server.descriptor);
+
+	OftConnection sender(0, FileTransferJob::Outgoing, 1, 0, false);
+	OftConnection receiver(0, FileTransferJob::Incoming, 1, 0, false);
+	if (limit > 0)
+		sender.setBandwidthLimit(limit);
+	sender.setSocket(senderSocket);
+	sender.m_data.reset(new QFile(source));
+
+	OftHeader prompt;
+	prompt.type = OftPrompt;
+	prompt.cookie = 1;
+	prompt.size = quint32(size);
+	prompt.totalSize = quint32(size);
+	prompt.checksum = checksum;
+	prompt.modTime = 0;
+	prompt.creationTime = 0;
+	prompt.resourceForkSize = 0;
+	prompt.fileName = QLatin1String("source");
+	prompt.writeData(senderSocket);
+	QTRY_COMPARE(receiverSocket->readingState(), OftSocket::ReadData);
+
+	// As OftConnection::startFileReceiving does for a new file
+	receiver.m_socket = receiverSocket;
+	receiverSocket->setParent(&receiver);
+	receiverSocket->setReadBufferSize(256 * 1024);
+	receiver.m_header = receiverSocket->lastHeader();
+	receiver.m_header.type = OftAcknowledge;
+	receiver.m_data.reset(new QFile(target));
+	QVERIFY(receiver.m_data->open(QIODevice::WriteOnly));
+
+	QElapsedTimer timer;
+	qint64 senderTime = -1;
+	qint64 receiverTime = -1;
+	connect(senderSocket, &QIODevice::bytesWritten, [&] () {
+		if (senderTime < 0 && sender.m_header.bytesReceived == size && senderSocket->bytesToWrite() == 0)
+			senderTime = timer.elapsed();
+	});
+	connect(&receiver, &FileTransferJob::stateChanged, [&] (FileTransferJob::State state) {
+		if (state == FileTransferJob::Finished)
+			receiverTime = timer.elapsed();
+	});
+	timer.start();
+	receiver.startFileReceivingImpl(false);
+
+	// Sender finishes after the receiver has acknowledged the whole file
+	QTRY_COMPARE_WITH_TIMEOUT(sender.state(), FileTransferJob::Finished, 120000);
+	QCOMPARE(receiver.state(), FileTransferJob::Finished);
+	QVERIFY(senderTime >= 0);
+	QVERIFY(receiverTime >= senderTime);
+	QVERIFY(!sender.m_window);
+
+	QCOMPARE(qint64(receiver.m_header.bytesReceived), size);
+	QCOMPARE(receiver.m_header.receivedChecksum, checksum);
+	QCOMPARE(sender.m_header.receivedChecksum, checksum);
+	QCOMPARE(QFileInfo(target).size(), size);
+	QCOMPARE(fileHash(target), fileHash(source));
+
+	if (limit > 0) {
+		// Bucket of the limiter is full at start, it holds a second of traffic
+		QVERIFY2(senderTime >= (size - limit) * 1000 / limit * 9 / 10,
+				 qPrintable(QString::number(senderTime)));
+	}
+	const double megabytes = size / 1024.0 / 1024.0;
+	qDebug("sender: %.1f MB/s, receiver: %.1f MB/s",
+		   megabytes * 1000 / qMax<qint64>(1, senderTime),
+		   megabytes * 1000 / qMax<qint64>(1, receiverTime));
+}
+
+QTEST_MAIN(OftConnectionTest)
+#include "oftconnectiontest.moc"
@@ -34,6 +34,7 @@
 #include <QFile>
 #include <qutim/json.h>
 #include "quetzalactiongenerator.h"
+#include "quetzaleventloop.h"
 
 extern "C" {
 	void _purple_buddy_icons_blist_loaded_cb();
@@ -612,15 +613,31 @@ int QuetzalAccount::sendRawData(const QByteArray &data)
 	return -1;
 }
 
+#ifndef QT_NO_DEBUG
+static void quetzal_dump_event_loop_stats(PurplePluginAction *)
+{
+	QuetzalEventLoop::instance()->dumpStats();
+}
+#endif
+
 MenuController::ActionList QuetzalAccount::dynamicActions() const
 {
 	MenuController::ActionList actions;
+	QList<QByteArray> off;
+#ifndef QT_NO_DEBUG
+	// Event loop is shared by all accounts, but account menu is the only place
+	// where libpurple actions are shown
+	PurplePluginAction *dumpAction = purple_plugin_action_new("Dump event loop statistics",
+															  quetzal_dump_event_loop_stats);
+	ActionGenerator *dumpGen = new QuetzalActionGenerator(dumpAction);
+	dumpGen->setType(2)->setPriority(-1000);
+	actions << (MenuController::Action){ dumpGen, off };
+#endif
 	if (!m_account->gc || status() == Status::Connecting)
 		return actions;
 	GList *menu = m_account->gc->prpl->info->actions(m_account->gc->prpl, m_account->gc);
 	if (!menu)
 		return actions;
-	QList<QByteArray> off;
 	int i = 0;
 	for (GList *it = menu; it; it = it->next, i--) {
 		PurplePluginAction *action = reinterpret_cast<PurplePluginAction*>(it->data);
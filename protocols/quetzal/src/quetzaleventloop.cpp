@@ -25,22 +25,55 @@
 
 #include "quetzaleventloop.h"
 #include <qutim/debug.h>
-#include <QTimerEvent>
 #include <QThread>
 #include <QCoreApplication>
 #include <QVariant>
-#include <QTimer>
-
-Q_DECLARE_METATYPE(int*)
+#include <algorithm>
+#include <QVarLengthArray>
+#include <climits>
+#include <cstring>
 
 using namespace qutim_sdk_0_3;
 
+// Disabled socket notifiers are kept for reuse, libpurple often removes
+// and adds watches for the same socket
+const int MAX_IDLE_NOTIFIERS = 32;
+
 QuetzalEventLoop *QuetzalEventLoop::m_self = NULL;
 
+static inline int firstBit(quint64 value)
+{
+#if defined(Q_CC_GNU)
+	return __builtin_ctzll(value);
+#else
+	int result = 0;
+	while (!(value & 1)) {
+		value >>= 1;
+		++result;
+	}
+	return result;
+#endif
+}
+
+static inline qint64 notifierKey(int fd, QSocketNotifier::Type type)
+{
+	return (qint64(fd) << 2) | type;
+}
+
 QuetzalEventLoop::QuetzalEventLoop(QObject *parent):
-		QObject(parent), m_socketId(0)
+		QObject(parent), m_currentTick(0), m_scheduledTick(0), m_freeTimer(-1),
+		m_timerId(0), m_pendingTimers(0), m_freeFile(-1), m_socketId(0)
 {
-	qRegisterMetaType<int*>("int*");
+	m_clock.start();
+	for (int level = 0; level < WheelLevels; ++level) {
+		m_occupied[level] = 0;
+		for (int slot = 0; slot < WheelSlots; ++slot)
+			m_slots[level][slot] = -1;
+	}
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_wheelTimer.setSingleShot(true);
+	m_wheelTimer.setTimerType(Qt::PreciseTimer);
+	connect(&m_wheelTimer, SIGNAL(timeout()), this, SLOT(onWheelTimeout()));
 }
 
 QuetzalEventLoop *QuetzalEventLoop::instance()
@@ -51,68 +84,273 @@ QuetzalEventLoop *QuetzalEventLoop::instance()
 	return m_self;
 }
 
-//static GSourceFunc quetzal_accounts_save_cb = NULL;
+quint64 QuetzalEventLoop::currentTick() const
+{
+	return quint64(m_clock.elapsed()) / WheelTick;
+}
 
 uint QuetzalEventLoop::addTimer(guint interval, GSourceFunc function, gpointer data)
 {
-//	// This hook is used for plugin to know when accounts's data should be saved
-//	if (!quetzal_accounts_save_cb && interval == 5000)
-//		quetzal_accounts_save_cb = function;
-	bool isMainThread = QThread::currentThread() == qApp->thread();
-	int id = -1;
-	if (isMainThread) {
-		id = QObject::startTimer(interval);
+	guint id;
+	do {
+		id = static_cast<guint>(m_timerId.fetchAndAddRelaxed(1) + 1);
+	} while (id == 0);
+	if (QThread::currentThread() == thread()) {
+		int index = insertTimer(id, interval, function, data);
+		if (!m_scheduledTick || m_timers.at(index).expires < m_scheduledTick)
+			updateWheelTimer();
+	} else {
+		// Don't block the caller's thread, the timer is inserted by our thread
+		PendingTimer *pending = new PendingTimer;
+		pending->id = id;
+		pending->interval = interval;
+		pending->function = function;
+		pending->data = data;
+		PendingTimer *head;
+		do {
+			head = m_pendingTimers.loadAcquire();
+			pending->next = head;
+		} while (!m_pendingTimers.testAndSetRelease(head, pending));
+		if (!head)
+			QMetaObject::invokeMethod(this, "processPendingTimers", Qt::QueuedConnection);
+	}
+	return id;
+}
+
+void QuetzalEventLoop::processPendingTimers()
+{
+	PendingTimer *pending = m_pendingTimers.fetchAndStoreAcquire(0);
+	if (!pending)
+		return;
+	// Stack is filled in reverse order
+	PendingTimer *ordered = 0;
+	while (pending) {
+		PendingTimer *next = pending->next;
+		pending->next = ordered;
+		ordered = pending;
+		pending = next;
+	}
+	while (ordered) {
+		insertTimer(ordered->id, ordered->interval, ordered->function, ordered->data);
+		++m_stats.crossThreadTimers;
+		PendingTimer *next = ordered->next;
+		delete ordered;
+		ordered = next;
+	}
+	updateWheelTimer();
+}
+
+int QuetzalEventLoop::insertTimer(guint id, guint interval, GSourceFunc function, gpointer data)
+{
+	// Nothing to fire, so the wheel may be safely moved to the current time
+	if (m_stats.timers == 0)
+		m_currentTick = qMax(m_currentTick, currentTick());
+	int index;
+	if (m_freeTimer >= 0) {
+		index = m_freeTimer;
+		m_freeTimer = m_timers.at(index).next;
 	} else {
-		QMetaObject::invokeMethod(this, "startTimer", Qt::BlockingQueuedConnection,
-								  Q_ARG(int, interval), Q_ARG(int*, &id));
+		index = m_timers.size();
+		m_timers.resize(index + 1);
 	}
-	QMutexLocker locker(&m_timerMutex);
-	m_timers.insert(id, new TimerInfo(function, data));
-	return static_cast<uint>(id);
+	TimerInfo &info = m_timers[index];
+	info.function = function;
+	info.data = data;
+	info.id = id;
+	info.interval = interval;
+	info.active = true;
+	info.firing = false;
+	m_timerIds.insert(id, index);
+	++m_stats.timers;
+	scheduleTimer(index);
+	return index;
+}
+
+void QuetzalEventLoop::scheduleTimer(int index)
+{
+	TimerInfo &info = m_timers[index];
+	quint64 expires = (quint64(m_clock.elapsed()) + info.interval + WheelTick - 1) / WheelTick;
+	info.expires = qMax(expires, m_currentTick + 1);
+	linkTimer(index);
 }
 
-void QuetzalEventLoop::startTimer(int interval, int *id)
+void QuetzalEventLoop::linkTimer(int index)
 {
-	QMutexLocker locker(&m_timerMutex);
-	*id = QObject::startTimer(interval);
+	TimerInfo &info = m_timers[index];
+	quint64 delta = info.expires > m_currentTick ? info.expires - m_currentTick : 0;
+	int level = 0;
+	while (level < WheelLevels - 1 && delta >= (quint64(1) << (WheelBits * (level + 1))))
+		++level;
+	quint64 position = info.expires;
+	// Timer is too far, put it to the most distant slot, it will be cascaded again
+	if (delta >= (quint64(1) << (WheelBits * WheelLevels)))
+		position = m_currentTick + (quint64(1) << (WheelBits * WheelLevels)) - 1;
+	int slot = int((position >> (WheelBits * level)) & WheelMask);
+	int &head = m_slots[level][slot];
+	info.level = level;
+	info.slot = slot;
+	info.prev = -1;
+	info.next = head;
+	if (head >= 0)
+		m_timers[head].prev = index;
+	head = index;
+	m_occupied[level] |= quint64(1) << slot;
+}
+
+void QuetzalEventLoop::unlinkTimer(int index)
+{
+	TimerInfo &info = m_timers[index];
+	if (info.prev >= 0)
+		m_timers[info.prev].next = info.next;
+	else
+		m_slots[info.level][info.slot] = info.next;
+	if (info.next >= 0)
+		m_timers[info.next].prev = info.prev;
+	if (m_slots[info.level][info.slot] < 0)
+		m_occupied[info.level] &= ~(quint64(1) << info.slot);
+	info.prev = -1;
+	info.next = -1;
+}
+
+void QuetzalEventLoop::freeTimer(int index)
+{
+	TimerInfo &info = m_timers[index];
+	info.active = false;
+	info.firing = false;
+	info.function = 0;
+	info.data = 0;
+	info.next = m_freeTimer;
+	m_freeTimer = index;
+	--m_stats.timers;
 }
 
 gboolean QuetzalEventLoop::removeTimer(guint handle)
 {
 	Q_ASSERT(QThread::currentThread() == qApp->thread());
-	int id = static_cast<int>(handle);
-	QMutexLocker locker(&m_timerMutex);
-	QMap<int, TimerInfo *>::iterator it = m_timers.find(id);
-	if (it == m_timers.end())
+	processPendingTimers();
+	QHash<guint, int>::iterator it = m_timerIds.find(handle);
+	if (it == m_timerIds.end())
 		return FALSE;
-	killTimer(id);
-	delete it.value();
-	m_timers.erase(it);
+	int index = it.value();
+	m_timerIds.erase(it);
+	TimerInfo &info = m_timers[index];
+	if (info.firing) {
+		// It's freed after the callback returns
+		info.active = false;
+	} else {
+		unlinkTimer(index);
+		freeTimer(index);
+	}
+	if (m_stats.timers == 0) {
+		m_wheelTimer.stop();
+		m_scheduledTick = 0;
+	}
 	return TRUE;
 }
 
-void QuetzalEventLoop::timerEvent(QTimerEvent *event)
+void QuetzalEventLoop::cascade(int level, int slot)
 {
-	m_timerMutex.lock();
-	QMap<int, TimerInfo *>::iterator it = m_timers.find(event->timerId());
-	if (it == m_timers.end()) {
-		m_timerMutex.unlock();
-		return;
+	int index = m_slots[level][slot];
+	m_slots[level][slot] = -1;
+	m_occupied[level] &= ~(quint64(1) << slot);
+	while (index >= 0) {
+		int next = m_timers.at(index).next;
+		linkTimer(index);
+		index = next;
 	}
-	TimerInfo info = *it.value();
-	m_timerMutex.unlock();
-//	if (info.function == quetzal_accounts_save_cb)
-//		purple_blist_schedule_save();
-	gboolean result = (*info.function)(info.data);
-	if (!result) {
-		QMutexLocker locker(&m_timerMutex);
-		it = m_timers.find(event->timerId());
-		if (it == m_timers.end())
-			return;
-		killTimer(it.key());
-		delete it.value();
-		m_timers.erase(it);
+}
+
+void QuetzalEventLoop::fireSlot(int slot)
+{
+	// Callbacks never put timers to the slot being fired, so it's drained.
+	// Timers of the next rotation may appear here only if a callback has spun
+	// a nested event loop, they are linked again after the slot is drained.
+	QVarLengthArray<int, 16> postponed;
+	int index;
+	while ((index = m_slots[0][slot]) >= 0) {
+		unlinkTimer(index);
+		TimerInfo info = m_timers.at(index);
+		if (info.expires > m_currentTick) {
+			postponed.append(index);
+			continue;
+		}
+		m_timers[index].firing = true;
+		++m_stats.timerCallbacks;
+		++m_callbackCounts[reinterpret_cast<void *>(info.function)];
+		gboolean result = (*info.function)(info.data);
+		// Callback may add new timers, so m_timers may be reallocated
+		TimerInfo &current = m_timers[index];
+		current.firing = false;
+		if (!current.active) {
+			freeTimer(index);
+		} else if (!result) {
+			m_timerIds.remove(current.id);
+			freeTimer(index);
+		} else {
+			scheduleTimer(index);
+		}
+	}
+	for (int i = 0; i < postponed.size(); ++i)
+		linkTimer(postponed.at(i));
+}
+
+quint64 QuetzalEventLoop::nextWakeTick() const
+{
+	quint64 result = 0;
+	for (int level = 0; level < WheelLevels; ++level) {
+		quint64 occupied = m_occupied[level];
+		if (!occupied)
+			continue;
+		int shift = WheelBits * level;
+		quint64 position = m_currentTick >> shift;
+		int current = int(position & WheelMask);
+		quint64 above = current == WheelMask ? 0 : occupied & (~quint64(0) << (current + 1));
+		quint64 base = position - current;
+		// For upper levels it's the moment of cascading, not the expiration itself
+		quint64 tick = (above ? base + firstBit(above) : base + WheelSlots + firstBit(occupied)) << shift;
+		if (!result || tick < result)
+			result = tick;
+	}
+	return result;
+}
+
+void QuetzalEventLoop::advance(quint64 target)
+{
+	forever {
+		quint64 tick = nextWakeTick();
+		if (!tick || tick > target)
+			break;
+		m_currentTick = tick;
+		for (int level = WheelLevels - 1; level > 0; --level) {
+			int shift = WheelBits * level;
+			if ((tick & ((quint64(1) << shift) - 1)) == 0)
+				cascade(level, int((tick >> shift) & WheelMask));
+		}
+		fireSlot(int(tick & WheelMask));
+	}
+	m_currentTick = qMax(m_currentTick, target);
+}
+
+void QuetzalEventLoop::updateWheelTimer()
+{
+	quint64 tick = nextWakeTick();
+	if (!tick) {
+		m_wheelTimer.stop();
+		m_scheduledTick = 0;
+		return;
 	}
+	m_scheduledTick = tick;
+	qint64 delay = qint64(tick * WheelTick) - m_clock.elapsed();
+	m_wheelTimer.start(int(qBound<qint64>(0, delay, INT_MAX)));
+}
+
+void QuetzalEventLoop::onWheelTimeout()
+{
+	++m_stats.wakeups;
+	m_scheduledTick = 0;
+	processPendingTimers();
+	advance(currentTick());
+	updateWheelTimer();
 }
 
 guint QuetzalEventLoop::addIO(int fd, PurpleInputCondition cond, PurpleInputFunction func, gpointer user_data)
@@ -129,11 +367,31 @@ guint QuetzalEventLoop::addIO(int fd, PurpleInputCondition cond, PurpleInputFunc
 	else
 		type = QSocketNotifier::Write;
 
-	QSocketNotifier *socket = new QSocketNotifier(fd, type, this);
-	socket->setProperty("quetzal_id", m_socketId);
-	connect(socket, SIGNAL(activated(int)), this, SLOT(onSocket(int)));
+	QSocketNotifier *socket = m_idleNotifiers.take(notifierKey(fd, type));
+	if (!socket) {
+		socket = new QSocketNotifier(fd, type, this);
+		connect(socket, SIGNAL(activated(int)), this, SLOT(onSocket(int)));
+	}
 
-	m_files.insert(m_socketId, new FileInfo(fd, socket, cond, func, user_data));
+	int index;
+	if (m_freeFile >= 0) {
+		index = m_freeFile;
+		m_freeFile = m_files.at(index).nextFree;
+	} else {
+		index = m_files.size();
+		m_files.resize(index + 1);
+	}
+	FileInfo &info = m_files[index];
+	info.fd = fd;
+	info.socket = socket;
+	info.cond = cond;
+	info.func = func;
+	info.data = user_data;
+	info.id = m_socketId;
+	info.nextFree = -1;
+	m_fileIds.insert(m_socketId, index);
+	m_notifiers.insert(socket, index);
+	++m_stats.ioWatches;
 	socket->setEnabled(true);
 	return m_socketId++;
 }
@@ -141,13 +399,25 @@ guint QuetzalEventLoop::addIO(int fd, PurpleInputCondition cond, PurpleInputFunc
 gboolean QuetzalEventLoop::removeIO(guint handle)
 {
 	Q_ASSERT(QThread::currentThread() == qApp->thread());
-	QMap<uint, FileInfo *>::iterator it = m_files.find(handle);
-	if (it == m_files.end())
+	QHash<guint, int>::iterator it = m_fileIds.find(handle);
+	if (it == m_fileIds.end())
 		return FALSE;
-	FileInfo *info = it.value();
-	info->socket->deleteLater();
-	m_files.erase(it);
-	delete info;
+	int index = it.value();
+	m_fileIds.erase(it);
+	FileInfo &info = m_files[index];
+	QSocketNotifier *socket = info.socket;
+	socket->setEnabled(false);
+	m_notifiers.remove(socket);
+	if (m_idleNotifiers.size() < MAX_IDLE_NOTIFIERS)
+		m_idleNotifiers.insert(notifierKey(socket->socket(), socket->type()), socket);
+	else
+		socket->deleteLater();
+	info.socket = 0;
+	info.func = 0;
+	info.data = 0;
+	info.nextFree = m_freeFile;
+	m_freeFile = index;
+	--m_stats.ioWatches;
 	return TRUE;
 }
 
@@ -160,15 +430,45 @@ int QuetzalEventLoop::getIOError(int fd, int *error)
 
 void QuetzalEventLoop::onSocket(int fd)
 {
-	QSocketNotifier *socket = qobject_cast<QSocketNotifier *>(sender());
-	guint id = socket->property("quetzal_id").toUInt();
-	QMap<uint, FileInfo *>::iterator it = m_files.find(id);
-	if (it != m_files.end()) {
-		FileInfo *info = it.value();
-		socket->setEnabled(false);
-		(*info->func)(info->data, fd, info->cond);
+	QSocketNotifier *socket = static_cast<QSocketNotifier *>(sender());
+	int index = m_notifiers.value(socket, -1);
+	if (index < 0)
+		return;
+	FileInfo info = m_files.at(index);
+	socket->setEnabled(false);
+	++m_stats.ioCallbacks;
+	++m_callbackCounts[reinterpret_cast<void *>(info.func)];
+	(*info.func)(info.data, fd, info.cond);
+	// Callback may remove the watch, notifier may be even reused by another one
+	if (m_notifiers.value(socket, -1) == index && m_files.at(index).id == info.id)
 		socket->setEnabled(true);
-	}
+}
+
+QuetzalEventLoop::Stats QuetzalEventLoop::stats() const
+{
+	Stats result = m_stats;
+	result.timerSlabSize = m_timers.size();
+	result.ioSlabSize = m_files.size();
+	return result;
+}
+
+void QuetzalEventLoop::dumpStats() const
+{
+	Stats current = stats();
+	debug() << "Quetzal event loop:" << current.timers << "timers,"
+			<< current.ioWatches << "io watches, slabs:"
+			<< current.timerSlabSize << current.ioSlabSize;
+	debug() << "Wakeups:" << current.wakeups << "timer callbacks:" << current.timerCallbacks
+			<< "io callbacks:" << current.ioCallbacks
+			<< "timers from other threads:" << current.crossThreadTimers;
+	QVector<QPair<quint64, void *> > callbacks;
+	callbacks.reserve(m_callbackCounts.size());
+	QHash<void *, quint64>::const_iterator it = m_callbackCounts.constBegin();
+	for (; it != m_callbackCounts.constEnd(); ++it)
+		callbacks.append(qMakePair(it.value(), it.key()));
+	std::sort(callbacks.begin(), callbacks.end());
+	for (int i = callbacks.size() - 1; i >= 0 && i >= callbacks.size() - 10; --i)
+		debug() << "Callback" << callbacks.at(i).second << "called" << callbacks.at(i).first << "times";
 }
 
 static guint quetzal_timeout_add(guint interval, GSourceFunc function, gpointer data)
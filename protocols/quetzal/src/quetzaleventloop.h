@@ -28,56 +28,129 @@
 
 #include <QSocketNotifier>
 #include <purple.h>
-#include <QMap>
-#include <QMutex>
+#include <QHash>
+#include <QVector>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QAtomicPointer>
+#include <QAtomicInt>
 
 class QAction;
 
+// libpurple's event loop implementation.
+// Timers are kept in a hierarchical timer wheel driven by a single QTimer,
+// timer and IO records are stored in slabs and reused.
 class QuetzalEventLoop : public QObject
 {
 	Q_OBJECT
+	enum {
+		// Resolution of the timer wheel in msecs
+		WheelTick = 4,
+		WheelBits = 6,
+		WheelSlots = 1 << WheelBits,
+		WheelMask = WheelSlots - 1,
+		// 4 levels cover about 18 hours, longer timers are cascaded several times
+		WheelLevels = 4
+	};
 	struct TimerInfo
 	{
-		TimerInfo(GSourceFunc f, gpointer d) : function(f), data(d) {}
+		GSourceFunc function;
+		gpointer data;
+		guint id;
+		guint interval;
+		quint64 expires;
+		int level;
+		int slot;
+		int prev;
+		int next;
+		bool active;
+		bool firing;
+	};
+	// Timer added from non-main thread, it's inserted to the wheel by main thread
+	struct PendingTimer
+	{
+		PendingTimer *next;
+		guint id;
+		guint interval;
 		GSourceFunc function;
 		gpointer data;
 	};
 	struct FileInfo
 	{
-		FileInfo(int fd_, QSocketNotifier *s, PurpleInputCondition c, PurpleInputFunction f, gpointer d) :
-				fd(fd_), socket(s), cond(c), func(f), data(d) {}
 		int fd;
 		QSocketNotifier *socket;
 		PurpleInputCondition cond;
 		PurpleInputFunction func;
 		gpointer data;
+		guint id;
+		int nextFree;
 	};
 
 public:
+	struct Stats
+	{
+		int timers;
+		int ioWatches;
+		int timerSlabSize;
+		int ioSlabSize;
+		quint64 wakeups;
+		quint64 timerCallbacks;
+		quint64 ioCallbacks;
+		quint64 crossThreadTimers;
+	};
+
 	static QuetzalEventLoop *instance();
 	uint addTimer(guint interval, GSourceFunc function, gpointer data);
 	gboolean removeTimer(guint handle);
 	guint addIO(int fd, PurpleInputCondition cond, PurpleInputFunction func, gpointer user_data);
 	gboolean removeIO(guint handle);
 	int getIOError(int fd, int *error);
-	Q_INVOKABLE void startTimer(int interval, int *id);
+	Stats stats() const;
+	// Prints counters and callbacks called most often, helps to find misbehaving prpls
+	Q_INVOKABLE void dumpStats() const;
 public slots:
 	void onAction(QAction *action);
-protected:
-	virtual void timerEvent(QTimerEvent *event);
 private slots:
 	void onSocket(int fd);
+	void onWheelTimeout();
+	void processPendingTimers();
 
 private:
 	explicit QuetzalEventLoop(QObject *parent = 0);
+	quint64 currentTick() const;
+	int insertTimer(guint id, guint interval, GSourceFunc function, gpointer data);
+	void scheduleTimer(int index);
+	void linkTimer(int index);
+	void unlinkTimer(int index);
+	void freeTimer(int index);
+	void cascade(int level, int slot);
+	void fireSlot(int slot);
+	quint64 nextWakeTick() const;
+	void advance(quint64 target);
+	void updateWheelTimer();
+
 	static QuetzalEventLoop *m_self;
-	QMutex m_timerMutex;
-	QMap<int, TimerInfo *> m_timers;
-	QMap<guint, FileInfo *> m_files;
+	QElapsedTimer m_clock;
+	QTimer m_wheelTimer;
+	quint64 m_currentTick;
+	quint64 m_scheduledTick;
+	int m_slots[WheelLevels][WheelSlots];
+	quint64 m_occupied[WheelLevels];
+	QVector<TimerInfo> m_timers;
+	int m_freeTimer;
+	QHash<guint, int> m_timerIds;
+	QAtomicInt m_timerId;
+	QAtomicPointer<PendingTimer> m_pendingTimers;
+	QVector<FileInfo> m_files;
+	int m_freeFile;
+	QHash<guint, int> m_fileIds;
+	QHash<QSocketNotifier *, int> m_notifiers;
+	QMultiHash<qint64, QSocketNotifier *> m_idleNotifiers;
 	guint m_socketId;
+	Stats m_stats;
+	QHash<void *, quint64> m_callbackCounts;
 };
 
 extern PurpleEventLoopUiOps quetzal_eventloop_uiops;
 
 #endif // QUETZALEVENTLOOP_H
-
@@ -152,12 +152,20 @@ void VContact::handleMessage(const Vreen::Message &msg)
 	coreMessage.setProperty("subject", msg.subject());
 
 	qutim_sdk_0_3::ChatSession *s = ChatLayer::get(this);
-	if (msg.isIncoming()) {
-		if (!s->isActive())
-			m_unreadMessages.append(coreMessage);
-		else
-			chatSession()->markMessagesAsRead(Vreen::IdList() << msg.id(), true);
-	} else
+	if (msg.isIncoming() && !s->isActive()) {
+		// Handlers may detach the message, so its id in the unread list
+		// is known only after appending
+		QPointer<VContact> self(this);
+		const int mid = msg.id();
+		s->append(coreMessage, [self, mid] (qint64 result, const Message &message, const QString &) {
+			if (result > 0 && self)
+				self->m_unreadMessages.insert(message.id(), mid);
+		});
+		return;
+	}
+	if (msg.isIncoming())
+		chatSession()->markMessagesAsRead(Vreen::IdList() << msg.id(), true);
+	else
 		coreMessage.setProperty("history", true);
 	s->appendMessage(coreMessage);
 }
@@ -294,22 +302,18 @@ void VContact::onMessageSent(const QVariant &)
 	}
 }
 
-void VContact::onUnreadChanged(MessageList unread)
+void VContact::onUnreadMarked(quint64 id)
 {
 	Vreen::IdList idList;
-	MessageList::iterator i = m_unreadMessages.begin();
-	for (; i != m_unreadMessages.end(); ++i) {
-		int index = -1;
-		MessageList::iterator j = unread.begin();
-		for (; j != unread.end(); ++j) {
-			if (i->property("mid") == j->property("mid")) {
-				index = j - unread.begin();
-				unread.removeAt(index);
-				break;
-			}
+	if (id == Q_UINT64_C(0xffffffffffffffff)) {
+		idList = m_unreadMessages.values();
+		m_unreadMessages.clear();
+	} else {
+		QHash<quint64, int>::iterator it = m_unreadMessages.find(id);
+		if (it != m_unreadMessages.end()) {
+			idList.append(it.value());
+			m_unreadMessages.erase(it);
 		}
-		if (index == -1)
-			idList.append(m_unreadMessages.takeAt(i-m_unreadMessages.begin()).property("mid").toInt());
 	}
 	if (idList.count())
 		chatSession()->markMessagesAsRead(idList, true);
@@ -318,7 +322,7 @@ void VContact::onUnreadChanged(MessageList unread)
 void VContact::onSessionCreated(ChatSession *session)
 {
 	if (session->unit() == this)
-		connect(session, SIGNAL(unreadChanged(qutim_sdk_0_3::MessageList)), SLOT(onUnreadChanged(qutim_sdk_0_3::MessageList)));
+		connect(session, SIGNAL(unreadMarked(quint64)), SLOT(onUnreadMarked(quint64)));
 }
 
 void VContact::onPhotoSourceChanged(const QString &, Vreen::Contact::PhotoSize size)
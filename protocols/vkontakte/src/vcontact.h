@@ -73,7 +73,7 @@ private slots:
 	void onTagsChanged(const QStringList &tags);
 	void onNameChanged(const QString &name);
 	void onMessageSent(const QVariant &response);
-	void onUnreadChanged(qutim_sdk_0_3::MessageList unread);
+	void onUnreadMarked(quint64 id);
 	void onSessionCreated(qutim_sdk_0_3::ChatSession *session);
 	void onPhotoSourceChanged(const QString &source, Vreen::Contact::PhotoSize);
 private:
@@ -86,7 +86,8 @@ private:
 	QString m_avatar;
 
 	//TODO rewrite on unite message handler
-	qutim_sdk_0_3::MessageList m_unreadMessages;
+	// Ids of unread messages in the chat session mapped to VK message ids
+	QHash<quint64, int> m_unreadMessages;
 	uint m_unreachedMessagesCount;
 	typedef QList<QPair<int, int> > SentMessagesList;
 	SentMessagesList m_sentMessages;
@@ -28,6 +28,7 @@
 #include "vroster.h"
 #include <vcontact.h>
 #include <QApplication>
+#include <QPointer>
 #include <qutim/notification.h>
 
 using namespace qutim_sdk_0_3;
@@ -107,12 +108,20 @@ void VGroupChat::handleMessage(const Vreen::Message &msg)
 		coreMessage.setProperty("senderId", from->id());
 
 		ChatSession *s = ChatLayer::get(this);
-		if (msg.isIncoming()) {
-			if (!s->isActive())
-				m_unreadMessages.append(coreMessage);
-			else
-				chatSession()->markMessagesAsRead(Vreen::IdList() << msg.id(), true);
-		} else
+		if (msg.isIncoming() && !s->isActive()) {
+			// Handlers may detach the message, so its id in the unread list
+			// is known only after appending
+			QPointer<VGroupChat> self(this);
+			const int mid = msg.id();
+			s->append(coreMessage, [self, mid] (qint64 result, const Message &message, const QString &) {
+				if (result > 0 && self)
+					self->m_unreadMessages.insert(message.id(), mid);
+			});
+			return;
+		}
+		if (msg.isIncoming())
+			chatSession()->markMessagesAsRead(Vreen::IdList() << msg.id(), true);
+		else
 			coreMessage.setProperty("history", true);
 		s->appendMessage(coreMessage);
 	}
@@ -269,22 +278,18 @@ void VGroupChat::onMessageSent(const QVariant &response)
 	}
 }
 
-void VGroupChat::onUnreadChanged(qutim_sdk_0_3::MessageList unread)
+void VGroupChat::onUnreadMarked(quint64 id)
 {
 	Vreen::IdList idList;
-	MessageList::iterator i = m_unreadMessages.begin();
-	for (; i != m_unreadMessages.end(); ++i) {
-		int index = -1;
-		MessageList::iterator j = unread.begin();
-		for (; j != unread.end(); ++j) {
-			if (i->property("mid") == j->property("mid")) {
-				index = j - unread.begin();
-				unread.removeAt(index);
-				break;
-			}
+	if (id == Q_UINT64_C(0xffffffffffffffff)) {
+		idList = m_unreadMessages.values();
+		m_unreadMessages.clear();
+	} else {
+		QHash<quint64, int>::iterator it = m_unreadMessages.find(id);
+		if (it != m_unreadMessages.end()) {
+			idList.append(it.value());
+			m_unreadMessages.erase(it);
 		}
-		if (index == -1)
-			idList.append(m_unreadMessages.takeAt(i-m_unreadMessages.begin()).property("mid").toInt());
 	}
 	if (idList.count())
 		chatSession()->markMessagesAsRead(idList, true);
@@ -293,5 +298,5 @@ void VGroupChat::onUnreadChanged(qutim_sdk_0_3::MessageList unread)
 void VGroupChat::onSessionCreated(qutim_sdk_0_3::ChatSession *session)
 {
 	if (session->unit() == this)
-		connect(session, SIGNAL(unreadChanged(qutim_sdk_0_3::MessageList)), SLOT(onUnreadChanged(qutim_sdk_0_3::MessageList)));
+		connect(session, SIGNAL(unreadMarked(quint64)), SLOT(onUnreadMarked(quint64)));
 }
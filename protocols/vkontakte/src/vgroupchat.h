@@ -65,7 +65,7 @@ protected slots:
 	void onTitleChanged(const QString &title);
 	void onMessageGet(const QVariant &response);
 	void onMessageSent(const QVariant &response);
-	void onUnreadChanged(qutim_sdk_0_3::MessageList unread);
+	void onUnreadMarked(quint64 id);
 	void onSessionCreated(qutim_sdk_0_3::ChatSession *session);
 private:
 	VAccount *m_account;
@@ -74,7 +74,8 @@ private:
 	QString m_title;
 
 	//TODO rewrite on unite message handler
-	qutim_sdk_0_3::MessageList m_unreadMessages;
+	// Ids of unread messages in the chat session mapped to VK message ids
+	QHash<quint64, int> m_unreadMessages;
 	uint m_unreachedMessagesCount;
 	typedef QList<QPair<int, int> > SentMessagesList;
 	SentMessagesList m_sentMessages;